@@ -1,8 +1,11 @@
 import sys
 import subprocess
+from ctypes import cdll, string_at, c_char, c_char_p, c_float, c_int, c_int64, c_size_t, c_ssize_t, c_uint, c_uint64, c_void_p, POINTER, Structure
+from typing import Any
 
 
 _audio_driver_prefix = "audio_driver"
+_audio_so: Any = None
 
 
 class RunCodeReturn:
@@ -82,9 +85,50 @@ def record(device: str, filename: str):
     return make_ret(r)
 
 
+class VadStat(Structure):
+    """
+    语音活动检测统计, 对应 audio_vad_stat_t。
+    """
+
+    _fields_ = [
+        ("in_frames", c_size_t),
+        ("out_frames", c_size_t),
+        ("segments", c_size_t),
+        ("noise_db", c_float),
+        ("threshold_db", c_float),
+    ]
+
+
+def _load_audio_so():
+    """
+    加载 audio.so, 没有编译时返回 None。
+    """
+
+    global _audio_so
+    if _audio_so is None:
+        try:
+            _audio_so = cdll.LoadLibrary(f"./{_audio_driver_prefix}/audio.so")
+            # int wav_concat(const char* const* inputs, size_t count, const char* output);
+            _audio_so.wav_concat.argtypes = [POINTER(c_char_p), c_size_t, c_char_p]
+            _audio_so.wav_concat.restype = c_int
+
+            # ssize_t audio_vad_trim_wav(const audio_vad_config_t* cfg, const char* in, const char* out,
+            #     audio_vad_stat_t* stat);
+            _audio_so.audio_vad_trim_wav.argtypes = [c_void_p, c_char_p, c_char_p, POINTER(VadStat)]
+            _audio_so.audio_vad_trim_wav.restype = c_ssize_t
+
+            # ssize_t audio_resample_wav(const char* in, const char* out, unsigned out_rate);
+            _audio_so.audio_resample_wav.argtypes = [c_char_p, c_char_p, c_uint]
+            _audio_so.audio_resample_wav.restype = c_ssize_t
+        except OSError:
+            _audio_so = False
+    return _audio_so
+
+
 def splicing_audio(files: list[str], outfile: str):
     """
     拼接多个音频文件成一个音频文件。
+    audio.so 可用且格式一致时使用原生拼接, 否则使用 sox。
 
     Args:
         files (list[str]): 要拼接的音频文件列表。
@@ -93,9 +137,472 @@ def splicing_audio(files: list[str], outfile: str):
     
     run_cmd(["rm", "-f ", outfile])
 
+    # 格式一致时直接拼接 PCM 数据, 不启动 sox 也不重新编解码
+    so = _load_audio_so()
+    if so and len(files):
+        paths = (c_char_p * len(files))(*[f.encode() for f in files])
+        if 0 == so.wav_concat(paths, len(files), outfile.encode()):
+            run = RunCodeReturn()
+            run.returncode = 0
+            run.stdout = f"native concat {len(files)} files"
+            return run
+
     cmd = ["/bin/bash", f"{_audio_driver_prefix}/splicing_audio.sh"]
     cmd.extend(files)
     cmd.append(outfile)
 
     r = run_cmd(cmd)
     return make_ret(r)
+
+
+def vad_trim(infile: str, outfile: str):
+    """
+    去掉 WAV 文件首尾静音并压缩长停顿, 减少语音识别上传的数据量。
+
+    Args:
+        infile (str): 输入 16 位 PCM WAV 文件路径。
+        outfile (str): 输出文件路径, 可与输入相同。
+
+    Returns:
+        VadStat: 统计信息, segments 为 0 表示没有检测到语音(此时不写文件)。
+                 audio.so 不可用或处理失败时返回 None。
+    """
+
+    so = _load_audio_so()
+    if not so:
+        return None
+    stat = VadStat()
+    if so.audio_vad_trim_wav(None, infile.encode(), outfile.encode(), stat) < 0:
+        return None
+    return stat
+
+
+def resample(infile: str, outfile: str, rate: int = 16000):
+    """
+    把 WAV 文件重采样为单声道, 默认转为语音识别使用的 16kHz。
+
+    Args:
+        infile (str): 输入 16 位 PCM WAV 文件路径。
+        outfile (str): 输出文件路径, 可与输入相同。
+        rate (int): 输出采样率。
+
+    Returns:
+        int: 输出帧数, audio.so 不可用或处理失败时返回 -1。
+    """
+
+    so = _load_audio_so()
+    if not so:
+        return -1
+    return so.audio_resample_wav(infile.encode(), outfile.encode(), rate)
+
+
+class PlayerStat(Structure):
+    """
+    播放统计, 对应 audio_player_stat_t。
+    """
+
+    _fields_ = [
+        ("written", c_uint64),
+        ("played", c_uint64),
+        ("underruns", c_uint),
+        ("first_play_us", c_int64),
+    ]
+
+
+def chat_to_pcm_stream(chat: str):
+    """
+    启动边合成边解码的 TTS 进程。
+
+    Args:
+        chat (str): 要转换的聊天内容。
+
+    Returns:
+        subprocess.Popen: 进程, stdout 输出 16 位 24kHz 单声道 PCM。
+    """
+
+    return subprocess.Popen(
+        ["/bin/bash", f"{_audio_driver_prefix}/chat_to_pcm.sh", chat],
+        stdout=subprocess.PIPE,
+        stderr=subprocess.PIPE,
+    )
+
+
+class AudioPlayer:
+    """
+    流式播放器, 数据边到边播, 攒够 prebuffer_ms 就开始出声, 不用等整段音频生成完。
+
+    device 可用 `wav:/path.wav` 或 `null` 在没有声卡的环境测试。
+    """
+
+    audio_so: Any
+    player: Any = None
+
+    def __init__(self, driver_so_path: str, device: str = "default", rate: int = 24000, channels: int = 1,
+                 prebuffer_ms: int = 200, buffer_ms: int = 0):
+        self.audio_so = cdll.LoadLibrary(driver_so_path)
+        self.__hook_setup()
+        self.channels = channels
+        self.player = self.audio_so.audio_player_init(device.encode(), rate, channels, prebuffer_ms, buffer_ms)
+        if not self.player:
+            raise RuntimeError(f"fail to open playback device: {device}")
+
+    def __hook_setup(self):
+        # audio_player_t* audio_player_init(const char* device, unsigned rate, unsigned channels,
+        #     unsigned prebuffer_ms, unsigned buffer_ms);
+        self.audio_so.audio_player_init.argtypes = [c_char_p, c_uint, c_uint, c_uint, c_uint]
+        self.audio_so.audio_player_init.restype = c_void_p
+
+        # void audio_player_exit(audio_player_t* p);
+        self.audio_so.audio_player_exit.argtypes = [c_void_p]
+
+        # ssize_t audio_player_write(audio_player_t* p, const int16_t* pcm, size_t frames);
+        self.audio_so.audio_player_write.argtypes = [c_void_p, c_char_p, c_size_t]
+        self.audio_so.audio_player_write.restype = c_ssize_t
+
+        # void audio_player_finish(audio_player_t* p);
+        self.audio_so.audio_player_finish.argtypes = [c_void_p]
+
+        # int audio_player_wait(audio_player_t* p, int timeout_ms);
+        self.audio_so.audio_player_wait.argtypes = [c_void_p, c_int]
+        self.audio_so.audio_player_wait.restype = c_int
+
+        # void audio_player_get_stat(audio_player_t* p, audio_player_stat_t* stat);
+        self.audio_so.audio_player_get_stat.argtypes = [c_void_p, POINTER(PlayerStat)]
+
+    def write(self, pcm: bytes):
+        """
+        写入 16 位 PCM 数据, 缓冲区满时阻塞。
+
+        Args:
+            pcm (bytes): PCM 数据, 多声道交错存放, 不完整的帧会被丢弃。
+
+        Return:
+            int: 写入帧数, 失败返回 -1。
+        """
+
+        frames = len(pcm) // (2 * self.channels)
+        return self.audio_so.audio_player_write(self.player, pcm, frames)
+
+    def finish(self):
+        """
+        数据已全部写入, 剩余数据不足 prebuffer 也开始播放。
+        """
+
+        self.audio_so.audio_player_finish(self.player)
+
+    def wait(self, timeout_ms: int = -1):
+        """
+        等待已写入的数据播放完。
+
+        Return:
+            int: 播放完返回 0, 超时或出错返回 -1。
+        """
+
+        return self.audio_so.audio_player_wait(self.player, timeout_ms)
+
+    def stat(self):
+        """
+        获取播放统计。
+
+        Return:
+            PlayerStat: 写入/播放帧数, 欠载次数, 第一次写入到开始播放的时间。
+        """
+
+        stat = PlayerStat()
+        self.audio_so.audio_player_get_stat(self.player, stat)
+        return stat
+
+    def write_stream(self, stream, chunk_bytes: int = 4800):
+        """
+        从文件对象(如 TTS 进程的 stdout)边读边写入, 不结束本段, 可以接着写入下一段。
+
+        Args:
+            stream: 提供 read() 的文件对象, 内容为 16 位 PCM。
+            chunk_bytes (int): 每次读取的字节数。
+
+        Return:
+            int: 成功返回 0, 失败返回 -1。
+        """
+
+        rest = b""
+        while True:
+            data = stream.read(chunk_bytes)
+            if not data:
+                break
+            data = rest + data
+            used = len(data) - len(data) % (2 * self.channels)
+            rest = data[used:]
+            if used and self.write(data[:used]) < 0:
+                return -1
+        return 0
+
+    def play_stream(self, stream, chunk_bytes: int = 4800):
+        """
+        从文件对象(如 TTS 进程的 stdout)边读边播, 读完后等待播放结束。
+
+        Args:
+            stream: 提供 read() 的文件对象, 内容为 16 位 PCM。
+            chunk_bytes (int): 每次读取的字节数。
+
+        Return:
+            int: 成功返回 0, 失败返回 -1。
+        """
+
+        if self.write_stream(stream, chunk_bytes) < 0:
+            return -1
+        self.finish()
+        return self.wait()
+
+    def __del__(self):
+        if self.player:
+            self.audio_so.audio_player_exit(self.player)
+            self.player = None
+
+
+class AudioCapture:
+    """
+    常驻采集引擎, 代替每次按键启动 arecord。
+
+    采集线程一直运行, begin() 时回退 preroll_ms 开始截取, end() 时得到整段音频,
+    device 可用 `wav:/path.wav` 或 `null` 在没有麦克风的环境测试。
+    """
+
+    audio_so: Any
+    capture: Any = None
+
+    def __init__(self, driver_so_path: str, device: str, rate: int = 44100, channels: int = 1,
+                 preroll_ms: int = 300, ring_ms: int = 0):
+        self.audio_so = cdll.LoadLibrary(driver_so_path)
+        self.__hook_setup()
+        self.capture = self.audio_so.audio_capture_init(device.encode(), rate, channels, ring_ms, preroll_ms)
+        if not self.capture:
+            raise RuntimeError(f"fail to open capture device: {device}")
+
+    def __hook_setup(self):
+        # audio_capture_t* audio_capture_init(const char* device, unsigned rate, unsigned channels,
+        #     unsigned ring_ms, unsigned preroll_ms);
+        self.audio_so.audio_capture_init.argtypes = [POINTER(c_char), c_uint, c_uint, c_uint, c_uint]
+        self.audio_so.audio_capture_init.restype = c_void_p
+
+        # void audio_capture_exit(audio_capture_t* c);
+        self.audio_so.audio_capture_exit.argtypes = [c_void_p]
+
+        # void audio_capture_set_preroll(audio_capture_t* c, unsigned preroll_ms);
+        self.audio_so.audio_capture_set_preroll.argtypes = [c_void_p, c_uint]
+
+        # unsigned audio_capture_get_rate(audio_capture_t* c);
+        self.audio_so.audio_capture_get_rate.argtypes = [c_void_p]
+        self.audio_so.audio_capture_get_rate.restype = c_uint
+
+        # unsigned audio_capture_get_channels(audio_capture_t* c);
+        self.audio_so.audio_capture_get_channels.argtypes = [c_void_p]
+        self.audio_so.audio_capture_get_channels.restype = c_uint
+
+        # int audio_capture_begin(audio_capture_t* c);
+        self.audio_so.audio_capture_begin.argtypes = [c_void_p]
+        self.audio_so.audio_capture_begin.restype = c_int
+
+        # ssize_t audio_capture_end(audio_capture_t* c);
+        self.audio_so.audio_capture_end.argtypes = [c_void_p]
+        self.audio_so.audio_capture_end.restype = c_ssize_t
+
+        # const int16_t* audio_capture_segment(audio_capture_t* c, size_t* frames);
+        self.audio_so.audio_capture_segment.argtypes = [c_void_p, POINTER(c_size_t)]
+        self.audio_so.audio_capture_segment.restype = c_void_p
+
+        # int audio_capture_save_wav(audio_capture_t* c, const char* path);
+        self.audio_so.audio_capture_save_wav.argtypes = [c_void_p, POINTER(c_char)]
+        self.audio_so.audio_capture_save_wav.restype = c_int
+
+        # void audio_capture_set_tap(audio_capture_t* c, audio_capture_tap_fn fn, void* arg);
+        self.audio_so.audio_capture_set_tap.argtypes = [c_void_p, c_void_p, c_void_p]
+
+    @property
+    def rate(self) -> int:
+        return self.audio_so.audio_capture_get_rate(self.capture)
+
+    @property
+    def channels(self) -> int:
+        return self.audio_so.audio_capture_get_channels(self.capture)
+
+    def set_preroll(self, preroll_ms: int):
+        """
+        设置按下时回退的时长。
+
+        Args:
+            preroll_ms (int): 回退时长(毫秒)。
+        """
+
+        self.audio_so.audio_capture_set_preroll(self.capture, preroll_ms)
+
+    def begin(self):
+        """
+        开始截取(按键按下)。
+        """
+
+        return self.audio_so.audio_capture_begin(self.capture)
+
+    def end(self):
+        """
+        结束截取(按键松开)。
+
+        Return:
+            int: 截取到的帧数, 失败返回 -1。
+        """
+
+        return self.audio_so.audio_capture_end(self.capture)
+
+    def segment(self):
+        """
+        获取最近一次截取到的 16 位 PCM 数据。
+
+        Return:
+            bytes: PCM 数据, 多声道交错存放。
+        """
+
+        frames = c_size_t(0)
+        pcm = self.audio_so.audio_capture_segment(self.capture, frames)
+        if not pcm or not frames.value:
+            return b""
+        return string_at(pcm, frames.value * self.channels * 2)
+
+    def save_wav(self, path: str):
+        """
+        把最近一次截取到的音频保存为 WAV 文件。
+
+        Args:
+            path (str): 输出文件路径。
+
+        Return:
+            int: 成功返回 0, 失败返回 -1。
+        """
+
+        return self.audio_so.audio_capture_save_wav(self.capture, path.encode())
+
+    def set_tap(self, fn: int = None, arg: int = None):
+        """
+        设置采集旁路, 采集线程每读到一个周期就调用一次 fn, 全程不经过 Python。
+
+        Args:
+            fn (int): C 函数地址, 原型为 audio_capture_tap_fn, 如 Display.meter_tap; None 取消旁路。
+            arg (int): 传给 fn 的参数, 如 Display.display_meter_start 返回的控件。
+        """
+
+        self.audio_so.audio_capture_set_tap(self.capture, fn, arg)
+
+    def __del__(self):
+        if self.capture:
+            self.audio_so.audio_capture_exit(self.capture)
+            self.capture = None
+
+
+class SplitStat(Structure):
+    """
+    分句统计, 对应 tts_split_stat_t。
+    """
+
+    _fields_ = [
+        ("sentences", c_size_t),
+        ("dropped", c_size_t),
+        ("first_us", c_int64),
+    ]
+
+
+class SentenceSplitter:
+    """
+    流式分句, 大模型生成的增量文字边写入边切出完整的句子, TTS 线程从队列取出合成,
+    第一句生成完就可以开始合成, 不用等整段回答。
+
+    写入不会阻塞; pop() 在队列为空时等待, finish() 之后取完返回 None。
+    """
+
+    audio_so: Any
+    split: Any = None
+
+    def __init__(self, driver_so_path: str, queue: int = 0):
+        self.audio_so = cdll.LoadLibrary(driver_so_path)
+        self.__hook_setup()
+        self.split = self.audio_so.tts_split_init(None, queue)
+        if not self.split:
+            raise RuntimeError("fail to create sentence splitter")
+
+    def __hook_setup(self):
+        # tts_split_t* tts_split_init(const tts_split_config_t* cfg, size_t queue);
+        self.audio_so.tts_split_init.argtypes = [c_void_p, c_size_t]
+        self.audio_so.tts_split_init.restype = c_void_p
+
+        # void tts_split_exit(tts_split_t* s);
+        self.audio_so.tts_split_exit.argtypes = [c_void_p]
+
+        # int tts_split_feed(tts_split_t* s, const char* text, size_t len);
+        self.audio_so.tts_split_feed.argtypes = [c_void_p, c_char_p, c_size_t]
+        self.audio_so.tts_split_feed.restype = c_int
+
+        # void tts_split_finish(tts_split_t* s);
+        self.audio_so.tts_split_finish.argtypes = [c_void_p]
+
+        # void tts_split_cancel(tts_split_t* s);
+        self.audio_so.tts_split_cancel.argtypes = [c_void_p]
+
+        # int tts_split_pop(tts_split_t* s, const char** sentence, int timeout_ms);
+        self.audio_so.tts_split_pop.argtypes = [c_void_p, POINTER(c_char_p), c_int]
+        self.audio_so.tts_split_pop.restype = c_int
+
+        # void tts_split_get_stat(tts_split_t* s, tts_split_stat_t* stat);
+        self.audio_so.tts_split_get_stat.argtypes = [c_void_p, POINTER(SplitStat)]
+
+    def feed(self, text: str):
+        """
+        写入增量文字。
+
+        Return:
+            int: 成功返回 0, 已结束或失败返回 -1。
+        """
+
+        data = text.encode("utf-8")
+        return self.audio_so.tts_split_feed(self.split, data, len(data))
+
+    def finish(self):
+        """
+        文字已全部写入, 剩余文字作为最后一句。
+        """
+
+        self.audio_so.tts_split_finish(self.split)
+
+    def cancel(self):
+        """
+        丢弃还没取出的句子, 等待中的 pop() 返回 None。
+        """
+
+        self.audio_so.tts_split_cancel(self.split)
+
+    def pop(self, timeout_ms: int = -1):
+        """
+        取出下一句, 队列为空时等待。
+
+        Return:
+            str: 句子; 已结束且没有剩余句子返回 None; 超时返回空字符串。
+        """
+
+        sentence = c_char_p()
+        ret = self.audio_so.tts_split_pop(self.split, sentence, timeout_ms)
+        if ret > 0:
+            return sentence.value.decode("utf-8", "ignore")
+        return None if ret == 0 else ""
+
+    def stat(self):
+        """
+        获取分句统计。
+
+        Return:
+            SplitStat: 句子数, 丢弃的片段数, 第一次写入到第一句切出的时间。
+        """
+
+        stat = SplitStat()
+        self.audio_so.tts_split_get_stat(self.split, stat)
+        return stat
+
+    def __del__(self):
+        if self.split:
+            self.audio_so.tts_split_exit(self.split)
+            self.split = None
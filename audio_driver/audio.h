@@ -0,0 +1,27 @@
+#ifndef __AUDIO_H__
+#define __AUDIO_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 功能: audio.so 公共入口, 各模块接口见对应头文件.
+
+#include "audio_capture.h"
+#include "audio_player.h"
+#include "audio_resample.h"
+#include "audio_vad.h"
+#include "wav.h"
+
+/**
+ * 设置调试模式。
+ *
+ * @param enable 是否启用调试模式，1 为启用，0 为禁用。
+ */
+void audio_set_debug(char enable);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif//__AUDIO_H__
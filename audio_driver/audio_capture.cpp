@@ -0,0 +1,450 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio_capture.h"
+#include "audio_source.h"
+#include "debug.h"
+#include "wav.h"
+
+typedef struct audio_capture_t {
+    audio_source_t* source;  // 采集源
+    pthread_t thread;        // 采集线程
+    int thread_running;      // 采集线程是否已启动
+    int stop;                // 通知采集线程退出
+    int16_t* ring;           // 环形缓冲区
+    size_t ring_frames;      // 环形缓冲区帧数, 2 的幂
+    uint64_t write_pos;      // 已写入总帧数, 只由采集线程写
+    size_t preroll;          // 回退帧数
+    int active;              // 是否正在截取
+    uint64_t seg_start;      // 截取起点
+    int16_t* seg;            // 段缓冲区
+    size_t seg_cap;          // 段缓冲区容量(帧)
+    size_t seg_frames;       // 段帧数
+    pthread_mutex_t tap_lock; // 保护 tap 和 tap_arg
+    audio_capture_tap_fn tap; // 采集旁路
+    void* tap_arg;           // 传给 tap 的参数
+} audio_capture_t;
+
+/**
+ * @brief 采集线程: 把采集源数据直接读入环形缓冲区
+ *
+ * @param arg 指向采集引擎的指针
+ */
+static void* audio_capture_thread(void* arg)
+{
+    audio_capture_t* c = (audio_capture_t*)arg;
+    size_t channels = c->source->channels;
+    size_t mask = c->ring_frames - 1;
+
+    while (!__atomic_load_n(&c->stop, __ATOMIC_ACQUIRE)) {
+        uint64_t pos = c->write_pos;
+        size_t off = pos & mask;
+        size_t frames = c->source->period;
+        if (frames > c->ring_frames - off)
+            frames = c->ring_frames - off;
+
+        ssize_t ret = c->source->read(c->source, c->ring + off * channels, frames);
+        if (ret < 0) {
+            LOG_ERR("capture read fail, stop");
+            break;
+        }
+        __atomic_store_n(&c->write_pos, pos + ret, __ATOMIC_RELEASE);
+
+        if (ret > 0 && __atomic_load_n(&c->tap, __ATOMIC_RELAXED)) {
+            pthread_mutex_lock(&c->tap_lock);
+            if (c->tap)
+                c->tap(c->tap_arg, c->ring + off * channels, ret, channels);
+            pthread_mutex_unlock(&c->tap_lock);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * 设置按下时回退的时长。
+ *
+ * @param c 指向采集引擎的指针。
+ * @param preroll_ms 回退时长, 超过环形缓冲时长时按缓冲时长处理。
+ */
+void audio_capture_set_preroll(audio_capture_t* c, unsigned preroll_ms)
+{
+    if (!c)
+        return;
+    c->preroll = (size_t)c->source->rate * preroll_ms / 1000;
+}
+
+/**
+ * 设置采集旁路, 每个采集周期的 PCM 都会交给 fn, 用于电平显示等实时处理。
+ * 返回后旧的回调不会再被调用。
+ *
+ * @param c 指向采集引擎的指针。
+ * @param fn 回调, NULL 取消旁路。
+ * @param arg 传给 fn 的参数。
+ */
+void audio_capture_set_tap(audio_capture_t* c, audio_capture_tap_fn fn, void* arg)
+{
+    if (!c)
+        return;
+    pthread_mutex_lock(&c->tap_lock);
+    c->tap_arg = arg;
+    __atomic_store_n(&c->tap, fn, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&c->tap_lock);
+}
+
+/**
+ * 获取实际采样率。
+ *
+ * @param c 指向采集引擎的指针。
+ * @return 采样率。
+ */
+unsigned audio_capture_get_rate(audio_capture_t* c)
+{
+    return c ? c->source->rate : 0;
+}
+
+/**
+ * 获取实际声道数。
+ *
+ * @param c 指向采集引擎的指针。
+ * @return 声道数。
+ */
+unsigned audio_capture_get_channels(audio_capture_t* c)
+{
+    return c ? c->source->channels : 0;
+}
+
+/**
+ * @brief 环形缓冲区中可安全读取的最多帧数
+ *
+ * 采集线程可能正在写入下一个周期, 要留出一个周期的余量。
+ */
+static inline size_t audio_capture_safe_frames(audio_capture_t* c)
+{
+    return c->ring_frames - c->source->period;
+}
+
+/**
+ * 开始截取一段音频(按键按下), 起点为当前位置减去 preroll。
+ *
+ * @param c 指向采集引擎的指针。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int audio_capture_begin(audio_capture_t* c)
+{
+    if (!c)
+        return -1;
+
+    uint64_t pos = __atomic_load_n(&c->write_pos, __ATOMIC_ACQUIRE);
+    size_t back = c->preroll < audio_capture_safe_frames(c) ? c->preroll : audio_capture_safe_frames(c);
+    c->seg_start = pos > back ? pos - back : 0;
+    c->active = 1;
+
+    return 0;
+}
+
+/**
+ * 结束截取(按键松开), 把这一段音频拷贝到引擎内部的段缓冲区。
+ *
+ * @param c 指向采集引擎的指针。
+ * @return 成功返回段帧数，未开始截取返回 -1。
+ */
+ssize_t audio_capture_end(audio_capture_t* c)
+{
+    if (!c || !c->active)
+        return -1;
+    c->active = 0;
+
+    size_t channels = c->source->channels;
+    size_t mask = c->ring_frames - 1;
+    uint64_t end = __atomic_load_n(&c->write_pos, __ATOMIC_ACQUIRE);
+    uint64_t start = c->seg_start;
+    if (end - start > audio_capture_safe_frames(c)) {
+        LOG_ERR("capture too long, drop %llu frames",
+            (unsigned long long)(end - start - audio_capture_safe_frames(c)));
+        start = end - audio_capture_safe_frames(c);
+    }
+
+    size_t frames = end - start;
+    if (frames > c->seg_cap) {
+        size_t cap = c->seg_cap ? c->seg_cap : c->source->rate;
+        while (cap < frames)
+            cap *= 2;
+        int16_t* seg = (int16_t*)realloc(c->seg, cap * channels * sizeof(int16_t));
+        if (!seg) {
+            LOG_ERR("fail to malloc capture segment");
+            c->seg_frames = 0;
+            return -1;
+        }
+        c->seg = seg;
+        c->seg_cap = cap;
+    }
+
+    for (size_t done = 0; done < frames;) {
+        size_t off = (start + done) & mask;
+        size_t n = c->ring_frames - off < frames - done ? c->ring_frames - off : frames - done;
+        memcpy(c->seg + done * channels, c->ring + off * channels, n * channels * sizeof(int16_t));
+        done += n;
+    }
+
+    // 拷贝期间采集线程可能覆盖了段开头, 丢掉被覆盖的部分
+    uint64_t now = __atomic_load_n(&c->write_pos, __ATOMIC_ACQUIRE);
+    if (now - start > audio_capture_safe_frames(c)) {
+        size_t lost = now - start - audio_capture_safe_frames(c);
+        lost = lost < frames ? lost : frames;
+        memmove(c->seg, c->seg + lost * channels, (frames - lost) * channels * sizeof(int16_t));
+        frames -= lost;
+    }
+    c->seg_frames = frames;
+
+    return frames;
+}
+
+/**
+ * 获取最近一次截取到的音频段, 下次 audio_capture_end 前有效。
+ *
+ * @param c 指向采集引擎的指针。
+ * @param frames 输出帧数。
+ * @return 音频段数据, 多声道交错存放。
+ */
+const int16_t* audio_capture_segment(audio_capture_t* c, size_t* frames)
+{
+    if (!c) {
+        if (frames)
+            *frames = 0;
+        return NULL;
+    }
+    if (frames)
+        *frames = c->seg_frames;
+    return c->seg;
+}
+
+/**
+ * 把最近一次截取到的音频段保存为 WAV 文件。
+ *
+ * @param c 指向采集引擎的指针。
+ * @param path 输出文件路径。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int audio_capture_save_wav(audio_capture_t* c, const char* path)
+{
+    if (!c || !path)
+        return -1;
+    return wav_save(path, c->seg, c->seg_frames, c->source->rate, c->source->channels);
+}
+
+/**
+ * 停止采集线程并释放采集引擎。
+ *
+ * @param c 指向采集引擎的指针。
+ */
+void audio_capture_exit(audio_capture_t* c)
+{
+    if (!c)
+        return;
+
+    if (c->thread_running) {
+        __atomic_store_n(&c->stop, 1, __ATOMIC_RELEASE);
+        pthread_join(c->thread, NULL);
+        c->thread_running = 0;
+    }
+    if (c->source) {
+        c->source->close(c->source);
+        c->source = NULL;
+    }
+    pthread_mutex_destroy(&c->tap_lock);
+    free(c->ring);
+    free(c->seg);
+    free(c);
+}
+
+/**
+ * 打开采集源并启动采集线程。
+ *
+ * @param device 设备名, 见 audio_source.h, 如 `hw:0,0`、`wav:/tmp/a.wav`、`null`。
+ * @param rate 采样率。
+ * @param channels 声道数。
+ * @param ring_ms 环形缓冲时长, 0 使用默认值。
+ * @param preroll_ms 按下时回退的时长。
+ * @return 成功返回采集引擎指针，失败返回 NULL。
+ */
+audio_capture_t* audio_capture_init(const char* device, unsigned rate, unsigned channels,
+    unsigned ring_ms, unsigned preroll_ms)
+{
+    assert(device && "arg failed!");
+
+    audio_capture_t* c = (audio_capture_t*)malloc(sizeof(audio_capture_t));
+    if (!c) {
+        LOG_ERR("fail to malloc capture");
+        return NULL;
+    }
+    memset(c, 0, sizeof(audio_capture_t));
+    pthread_mutex_init(&c->tap_lock, NULL);
+
+    c->source = audio_source_open(device, rate, channels);
+    if (!c->source) {
+        LOG_ERR("fail to open capture device: %s", device);
+        goto err;
+    }
+
+    {
+        size_t need = (size_t)c->source->rate * (ring_ms ? ring_ms : AUDIO_CAPTURE_RING_MS) / 1000
+            + c->source->period * 2;
+        c->ring_frames = 1;
+        while (c->ring_frames < need)
+            c->ring_frames <<= 1;
+    }
+    c->ring = (int16_t*)calloc(c->ring_frames * c->source->channels, sizeof(int16_t));
+    if (!c->ring) {
+        LOG_ERR("fail to malloc capture ring(%zu)", c->ring_frames);
+        goto err;
+    }
+    audio_capture_set_preroll(c, preroll_ms);
+
+    if (pthread_create(&c->thread, NULL, audio_capture_thread, c)) {
+        LOG_ERR("fail to create capture thread");
+        goto err;
+    }
+    c->thread_running = 1;
+
+    LOG_DBG("capture(%p) %s rate(%u) channels(%u) ring(%zu)",
+        c, device, c->source->rate, c->source->channels, c->ring_frames);
+
+    return c;
+err:
+    audio_capture_exit(c);
+    return NULL;
+}
+
+#ifdef __XTEST__
+
+#include <unistd.h>
+
+char g_dbg_enable = 1;
+
+#define TEST_RATE (8000)
+#define TEST_PREROLL (TEST_RATE / 5)
+
+typedef struct {
+    size_t frames; // 旁路收到的总帧数
+    int16_t next;  // 期望的下一个采样值, -1 表示还没收到
+} test_tap_t;
+
+static int test_tap(void* arg, const int16_t* pcm, size_t frames, unsigned channels)
+{
+    test_tap_t* t = (test_tap_t*)arg;
+    assert(pcm && frames && channels == 1);
+    // 旁路按采集顺序收到每个周期, 不丢不重
+    for (size_t i = 0; i < frames; ++i) {
+        assert(t->next < 0 || pcm[i] == t->next);
+        t->next = (pcm[i] + 1) % TEST_RATE;
+    }
+    t->frames += frames;
+    return 0;
+}
+
+/**
+ * @brief 等待采集线程写到 pos, 只用于防止卡死, 不检查时间
+ */
+static uint64_t test_wait_pos(audio_capture_t* c, uint64_t pos)
+{
+    for (int i = 0; i < 1000; ++i) {
+        uint64_t now = __atomic_load_n(&c->write_pos, __ATOMIC_ACQUIRE);
+        if (now >= pos)
+            return now;
+        usleep(10 * 1000);
+    }
+    assert(0 && "capture thread stalled");
+    return 0;
+}
+
+int main(void)
+{
+    // 生成 1 秒锯齿波, 每个采样值等于其序号, 循环播放时位置 p 处的采样值为 p % TEST_RATE
+    const char* path = "/tmp/audio_capture_test.wav";
+    int16_t pcm[TEST_RATE];
+    for (int i = 0; i < TEST_RATE; ++i)
+        pcm[i] = i;
+    assert(0 == wav_save(path, pcm, TEST_RATE, TEST_RATE, 1));
+
+    audio_capture_t* c = audio_capture_init("wav:/tmp/audio_capture_test.wav", 16000, 2, 2000, 200);
+    assert(c);
+    assert(audio_capture_get_rate(c) == TEST_RATE && audio_capture_get_channels(c) == 1);
+    assert(c->preroll == TEST_PREROLL);
+
+    // 环形缓冲区中先积累超过 preroll 的数据
+    test_wait_pos(c, TEST_PREROLL * 2);
+    assert(audio_capture_end(c) < 0);
+
+    // 起点正好回退 preroll
+    uint64_t before = __atomic_load_n(&c->write_pos, __ATOMIC_ACQUIRE);
+    assert(0 == audio_capture_begin(c));
+    uint64_t after = __atomic_load_n(&c->write_pos, __ATOMIC_ACQUIRE);
+    uint64_t start = c->seg_start;
+    assert(start + TEST_PREROLL >= before && start + TEST_PREROLL <= after);
+
+    test_wait_pos(c, start + TEST_PREROLL + TEST_RATE / 2);
+    before = __atomic_load_n(&c->write_pos, __ATOMIC_ACQUIRE);
+    ssize_t frames = audio_capture_end(c);
+    after = __atomic_load_n(&c->write_pos, __ATOMIC_ACQUIRE);
+    printf("captured %zd frames\n", frames);
+
+    // 段从起点连续截到松开时的写入位置, 内容与源位置一一对应
+    assert(frames > TEST_PREROLL + TEST_RATE / 2 - 1);
+    assert(start + frames >= before && start + frames <= after);
+    size_t n = 0;
+    const int16_t* seg = audio_capture_segment(c, &n);
+    assert(seg && n == (size_t)frames);
+    for (size_t i = 0; i < n; ++i)
+        assert(seg[i] == (int16_t)((start + i) % TEST_RATE));
+
+    assert(0 == audio_capture_save_wav(c, path));
+    int16_t first = seg[0];
+
+    // 回退超过环形缓冲区时只回退到缓冲区能安全读取的位置
+    audio_capture_set_preroll(c, 1000 * 1000);
+    before = __atomic_load_n(&c->write_pos, __ATOMIC_ACQUIRE);
+    assert(0 == audio_capture_begin(c));
+    assert(c->seg_start + audio_capture_safe_frames(c) >= before);
+    audio_capture_set_preroll(c, 200);
+
+    // 旁路收到采集线程读到的每个周期
+    test_tap_t tap = { 0, -1 };
+    audio_capture_set_tap(c, test_tap, &tap);
+    uint64_t pos = __atomic_load_n(&c->write_pos, __ATOMIC_ACQUIRE);
+    test_wait_pos(c, pos + TEST_RATE / 5);
+    audio_capture_set_tap(c, NULL, NULL);
+    size_t tapped = tap.frames;
+    printf("tapped %zu frames\n", tapped);
+    assert(tapped > 0);
+    // 取消后不再回调
+    pos = __atomic_load_n(&c->write_pos, __ATOMIC_ACQUIRE);
+    test_wait_pos(c, pos + c->source->period * 2);
+    assert(tap.frames == tapped);
+
+    ssize_t long_frames = audio_capture_end(c);
+    assert(long_frames > 0 && (size_t)long_frames <= audio_capture_safe_frames(c));
+    seg = audio_capture_segment(c, &n);
+    for (size_t i = 1; i < n; ++i)
+        assert(seg[i] == (seg[i - 1] + 1) % TEST_RATE);
+    audio_capture_exit(c);
+
+    int16_t* saved = NULL;
+    size_t saved_frames = 0;
+    assert(0 == wav_load(path, &saved, &saved_frames, NULL));
+    assert(saved_frames == (size_t)frames && saved[0] == first);
+    free(saved);
+    unlink(path);
+
+    c = audio_capture_init("null", 16000, 1, 0, 0);
+    assert(c && audio_capture_get_rate(c) == 16000);
+    audio_capture_exit(c);
+
+    printf("audio capture test pass\n");
+    return 0;
+}
+
+#endif //__XTEST__
@@ -0,0 +1,131 @@
+#ifndef __AUDIO_CAPTURE_H__
+#define __AUDIO_CAPTURE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// 功能: 常驻采集引擎, 采集线程持续把 PCM 写入无锁环形缓冲区,
+// 按键按下时回退 preroll 开始截取, 松开时把这一段拷贝出来, 全程不落盘.
+//
+// example:
+//   audio_capture_t* c = audio_capture_init("hw:0,0", 16000, 1, 0, 300);
+//   audio_capture_begin(c);           // 按键按下
+//   ...
+//   audio_capture_end(c);             // 按键松开
+//   audio_capture_save_wav(c, "/tmp/record/record.wav");
+//   audio_capture_exit(c);
+
+#define AUDIO_CAPTURE_RING_MS (30 * 1000)  // 默认环形缓冲时长, 也是单段最大时长
+#define AUDIO_CAPTURE_PREROLL_MS (300)     // 默认回退时长
+
+/**
+ * 采集旁路回调, 在采集线程中每读到一个周期调用一次, 不能阻塞。
+ *
+ * @param arg audio_capture_set_tap 传入的参数。
+ * @param pcm 本周期的 PCM, 多声道交错存放。
+ * @param frames 帧数。
+ * @param channels 声道数。
+ * @return 返回值被忽略。
+ */
+typedef int (*audio_capture_tap_fn)(void* arg, const int16_t* pcm, size_t frames, unsigned channels);
+
+struct audio_capture_t;
+
+/**
+ * 打开采集源并启动采集线程。
+ *
+ * @param device 设备名, 见 audio_source.h, 如 `hw:0,0`、`wav:/tmp/a.wav`、`null`。
+ * @param rate 采样率。
+ * @param channels 声道数。
+ * @param ring_ms 环形缓冲时长, 0 使用默认值。
+ * @param preroll_ms 按下时回退的时长。
+ * @return 成功返回采集引擎指针，失败返回 NULL。
+ */
+audio_capture_t* audio_capture_init(const char* device, unsigned rate, unsigned channels,
+    unsigned ring_ms, unsigned preroll_ms);
+
+/**
+ * 停止采集线程并释放采集引擎。
+ *
+ * @param c 指向采集引擎的指针。
+ */
+void audio_capture_exit(audio_capture_t* c);
+
+/**
+ * 设置按下时回退的时长。
+ *
+ * @param c 指向采集引擎的指针。
+ * @param preroll_ms 回退时长, 超过环形缓冲时长时按缓冲时长处理。
+ */
+void audio_capture_set_preroll(audio_capture_t* c, unsigned preroll_ms);
+
+/**
+ * 设置采集旁路, 每个采集周期的 PCM 都会交给 fn, 用于电平显示等实时处理。
+ * 返回后旧的回调不会再被调用。
+ *
+ * @param c 指向采集引擎的指针。
+ * @param fn 回调, NULL 取消旁路。
+ * @param arg 传给 fn 的参数。
+ */
+void audio_capture_set_tap(audio_capture_t* c, audio_capture_tap_fn fn, void* arg);
+
+/**
+ * 获取实际采样率。
+ *
+ * @param c 指向采集引擎的指针。
+ * @return 采样率。
+ */
+unsigned audio_capture_get_rate(audio_capture_t* c);
+
+/**
+ * 获取实际声道数。
+ *
+ * @param c 指向采集引擎的指针。
+ * @return 声道数。
+ */
+unsigned audio_capture_get_channels(audio_capture_t* c);
+
+/**
+ * 开始截取一段音频(按键按下), 起点为当前位置减去 preroll。
+ *
+ * @param c 指向采集引擎的指针。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int audio_capture_begin(audio_capture_t* c);
+
+/**
+ * 结束截取(按键松开), 把这一段音频拷贝到引擎内部的段缓冲区。
+ *
+ * @param c 指向采集引擎的指针。
+ * @return 成功返回段帧数，未开始截取返回 -1。
+ */
+ssize_t audio_capture_end(audio_capture_t* c);
+
+/**
+ * 获取最近一次截取到的音频段, 下次 audio_capture_end 前有效。
+ *
+ * @param c 指向采集引擎的指针。
+ * @param frames 输出帧数。
+ * @return 音频段数据, 多声道交错存放。
+ */
+const int16_t* audio_capture_segment(audio_capture_t* c, size_t* frames);
+
+/**
+ * 把最近一次截取到的音频段保存为 WAV 文件。
+ *
+ * @param c 指向采集引擎的指针。
+ * @param path 输出文件路径。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int audio_capture_save_wav(audio_capture_t* c, const char* path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__AUDIO_CAPTURE_H__
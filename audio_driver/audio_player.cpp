@@ -0,0 +1,400 @@
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio_player.h"
+#include "audio_sink.h"
+#include "debug.h"
+
+typedef struct audio_player_t {
+    audio_sink_t* sink;      // 播放设备
+    pthread_t thread;        // 播放线程
+    int thread_running;      // 播放线程是否已启动
+    pthread_mutex_t lock;    // 保护下面的成员
+    pthread_cond_t cond;     // 缓冲区或播放状态变化
+    int16_t* ring;           // 抖动缓冲区
+    size_t ring_frames;      // 抖动缓冲区容量(帧)
+    size_t head;             // 最旧数据的位置
+    size_t fill;             // 缓冲区中的帧数
+    size_t prebuffer;        // 开始播放前需要缓冲的帧数
+    int16_t* period;         // 播放线程每次交给设备的数据
+    int playing;             // 正在播放, 缓冲区播空后清零重新缓冲
+    int finished;            // 调用者已写完
+    int stop;                // 通知播放线程退出
+    int error;               // 设备出错
+    uint64_t written;        // 已写入帧数
+    uint64_t played;         // 已交给设备的帧数
+    unsigned underruns;      // 欠载次数
+    uint64_t first_write_us; // 本段第一次写入的时间
+    int64_t first_play_us;   // 本段第一次写入到开始播放的时间
+} audio_player_t;
+
+static uint64_t audio_player_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief 本段已写完且全部交给设备
+ */
+static inline int audio_player_drained(audio_player_t* p)
+{
+    return p->finished && !p->fill && !p->playing;
+}
+
+/**
+ * @brief 播放线程: 缓冲够了就按周期把数据交给设备
+ *
+ * @param arg 指向播放器的指针
+ */
+static void* audio_player_thread(void* arg)
+{
+    audio_player_t* p = (audio_player_t*)arg;
+    size_t channels = p->sink->channels;
+
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        while (!p->stop && !p->error) {
+            if (!p->playing && (p->fill >= p->prebuffer || (p->finished && p->fill))) {
+                p->playing = 1;
+                if (p->first_play_us < 0)
+                    p->first_play_us = audio_player_now_us() - p->first_write_us;
+            }
+            if (p->playing && p->fill)
+                break;
+            if (p->playing) {
+                // 缓冲区播空, 没写完就是欠载, 重新缓冲够再播放
+                p->playing = 0;
+                if (!p->finished) {
+                    ++p->underruns;
+                    LOG_DBG("player underrun(%u)", p->underruns);
+                }
+                pthread_cond_broadcast(&p->cond);
+            }
+            pthread_cond_wait(&p->cond, &p->lock);
+        }
+        if (p->stop || p->error)
+            break;
+
+        size_t n = p->fill < p->sink->period ? p->fill : p->sink->period;
+        for (size_t done = 0; done < n;) {
+            size_t c = p->ring_frames - p->head < n - done ? p->ring_frames - p->head : n - done;
+            memcpy(p->period + done * channels, p->ring + p->head * channels, c * channels * sizeof(int16_t));
+            p->head = (p->head + c) % p->ring_frames;
+            done += c;
+        }
+        p->fill -= n;
+        pthread_cond_broadcast(&p->cond);
+
+        pthread_mutex_unlock(&p->lock);
+        ssize_t ret = p->sink->write(p->sink, p->period, n);
+        pthread_mutex_lock(&p->lock);
+
+        if (ret < 0) {
+            LOG_ERR("player write fail, stop");
+            p->error = 1;
+            pthread_cond_broadcast(&p->cond);
+            break;
+        }
+        p->played += n;
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    return NULL;
+}
+
+/**
+ * 写入 PCM 数据, 缓冲区满时阻塞直到全部写入。
+ * audio_player_finish 之后再写入会接着播放, 上一段已播放完时开始新的一段(重新 prebuffer)。
+ *
+ * @param p 指向播放器的指针。
+ * @param pcm 16 位 PCM 数据, 多声道交错存放。
+ * @param frames 帧数。
+ * @return 成功返回写入帧数，设备出错返回 -1。
+ */
+ssize_t audio_player_write(audio_player_t* p, const int16_t* pcm, size_t frames)
+{
+    if (!p || (!pcm && frames))
+        return -1;
+
+    size_t channels = p->sink->channels;
+    pthread_mutex_lock(&p->lock);
+    if (audio_player_drained(p) || !p->first_write_us) {
+        p->first_write_us = audio_player_now_us();
+        p->first_play_us = -1;
+    }
+    p->finished = 0;
+
+    size_t done = 0;
+    while (done < frames) {
+        while (p->fill == p->ring_frames && !p->stop && !p->error)
+            pthread_cond_wait(&p->cond, &p->lock);
+        if (p->stop || p->error)
+            break;
+
+        size_t tail = (p->head + p->fill) % p->ring_frames;
+        size_t n = p->ring_frames - p->fill;
+        n = n < p->ring_frames - tail ? n : p->ring_frames - tail;
+        n = n < frames - done ? n : frames - done;
+        memcpy(p->ring + tail * channels, pcm + done * channels, n * channels * sizeof(int16_t));
+        p->fill += n;
+        p->written += n;
+        done += n;
+        pthread_cond_broadcast(&p->cond);
+    }
+    int failed = p->stop || p->error;
+    pthread_mutex_unlock(&p->lock);
+
+    return failed ? -1 : (ssize_t)done;
+}
+
+/**
+ * 数据已全部写入, 不足 prebuffer 也开始播放。
+ *
+ * @param p 指向播放器的指针。
+ */
+void audio_player_finish(audio_player_t* p)
+{
+    if (!p)
+        return;
+    pthread_mutex_lock(&p->lock);
+    p->finished = 1;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+}
+
+/**
+ * 等待 audio_player_finish 之前写入的数据全部播放完。
+ *
+ * @param p 指向播放器的指针。
+ * @param timeout_ms 超时时间, 负数一直等待。
+ * @return 播放完返回 0，超时或出错返回 -1。
+ */
+int audio_player_wait(audio_player_t* p, int timeout_ms)
+{
+    if (!p)
+        return -1;
+
+    struct timespec deadline;
+    if (timeout_ms >= 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    int ret = 0;
+    pthread_mutex_lock(&p->lock);
+    while (!audio_player_drained(p) && !p->stop && !p->error) {
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&p->cond, &p->lock);
+        } else if (ETIMEDOUT == pthread_cond_timedwait(&p->cond, &p->lock, &deadline)) {
+            break;
+        }
+    }
+    if (!audio_player_drained(p) || p->error)
+        ret = -1;
+    pthread_mutex_unlock(&p->lock);
+
+    return ret;
+}
+
+/**
+ * 获取播放统计。
+ *
+ * @param p 指向播放器的指针。
+ * @param stat 输出统计。
+ */
+void audio_player_get_stat(audio_player_t* p, audio_player_stat_t* stat)
+{
+    if (!p || !stat)
+        return;
+    pthread_mutex_lock(&p->lock);
+    stat->written = p->written;
+    stat->played = p->played;
+    stat->underruns = p->underruns;
+    stat->first_play_us = p->first_play_us;
+    pthread_mutex_unlock(&p->lock);
+}
+
+/**
+ * 停止播放(丢弃未播放的数据), 关闭设备并释放播放器。
+ *
+ * @param p 指向播放器的指针。
+ */
+void audio_player_exit(audio_player_t* p)
+{
+    if (!p)
+        return;
+
+    if (p->thread_running) {
+        pthread_mutex_lock(&p->lock);
+        p->stop = 1;
+        pthread_cond_broadcast(&p->cond);
+        pthread_mutex_unlock(&p->lock);
+        pthread_join(p->thread, NULL);
+        p->thread_running = 0;
+    }
+    if (p->sink) {
+        p->sink->close(p->sink);
+        p->sink = NULL;
+    }
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->lock);
+    free(p->ring);
+    free(p->period);
+    free(p);
+}
+
+/**
+ * 打开播放设备并启动播放线程。
+ *
+ * @param device 设备名, 见 audio_sink.h, 如 `default`、`wav:/tmp/a.wav`、`null`。
+ * @param rate 采样率。
+ * @param channels 声道数。
+ * @param prebuffer_ms 开始播放前缓冲的时长, 0 使用默认值。
+ * @param buffer_ms 抖动缓冲区时长, 0 使用默认值。
+ * @return 成功返回播放器指针，失败返回 NULL。
+ */
+audio_player_t* audio_player_init(const char* device, unsigned rate, unsigned channels,
+    unsigned prebuffer_ms, unsigned buffer_ms)
+{
+    assert(device && "arg failed!");
+
+    audio_player_t* p = (audio_player_t*)malloc(sizeof(audio_player_t));
+    if (!p) {
+        LOG_ERR("fail to malloc player");
+        return NULL;
+    }
+    memset(p, 0, sizeof(audio_player_t));
+    p->first_play_us = -1;
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&p->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&p->lock, NULL);
+
+    p->sink = audio_sink_open(device, rate, channels);
+    if (!p->sink) {
+        LOG_ERR("fail to open playback device: %s", device);
+        goto err;
+    }
+
+    p->ring_frames = (size_t)p->sink->rate * (buffer_ms ? buffer_ms : AUDIO_PLAYER_BUFFER_MS) / 1000;
+    p->prebuffer = (size_t)p->sink->rate * (prebuffer_ms ? prebuffer_ms : AUDIO_PLAYER_PREBUFFER_MS) / 1000;
+    // 缓冲区至少能放下 prebuffer 和一个周期, 否则写入会一直阻塞
+    if (p->ring_frames < p->prebuffer + p->sink->period)
+        p->ring_frames = p->prebuffer + p->sink->period;
+    p->ring = (int16_t*)malloc(p->ring_frames * p->sink->channels * sizeof(int16_t));
+    p->period = (int16_t*)malloc(p->sink->period * p->sink->channels * sizeof(int16_t));
+    if (!p->ring || !p->period) {
+        LOG_ERR("fail to malloc player buffer(%zu)", p->ring_frames);
+        goto err;
+    }
+
+    if (pthread_create(&p->thread, NULL, audio_player_thread, p)) {
+        LOG_ERR("fail to create player thread");
+        goto err;
+    }
+    p->thread_running = 1;
+
+    LOG_DBG("player(%p) %s rate(%u) channels(%u) prebuffer(%zu) buffer(%zu)",
+        p, device, p->sink->rate, p->sink->channels, p->prebuffer, p->ring_frames);
+
+    return p;
+err:
+    audio_player_exit(p);
+    return NULL;
+}
+
+#ifdef __XTEST__
+
+#include <unistd.h>
+
+#include "wav.h"
+
+char g_dbg_enable = 1;
+
+#define TEST_RATE (8000)
+
+int main(void)
+{
+    const char* path = "/tmp/audio_player_test.wav";
+    const size_t total = TEST_RATE;
+    int16_t pcm[TEST_RATE];
+    for (size_t i = 0; i < total; ++i)
+        pcm[i] = i;
+
+    audio_player_t* p = audio_player_init("wav:/tmp/audio_player_test.wav", TEST_RATE, 1, 100, 500);
+    assert(p);
+    audio_player_stat_t stat;
+
+    // 不够 100ms 不开始播放
+    size_t pos = 0;
+    assert(400 == audio_player_write(p, pcm, 400));
+    pos += 400;
+    usleep(200 * 1000);
+    audio_player_get_stat(p, &stat);
+    assert(stat.played == 0 && stat.first_play_us < 0);
+
+    // 攒够后开始播放, 其余数据比实时更快写入, 缓冲区满时阻塞
+    assert(400 == audio_player_write(p, pcm + pos, 400));
+    pos += 400;
+    usleep(50 * 1000);
+    audio_player_get_stat(p, &stat);
+    printf("first play after %lld us\n", (long long)stat.first_play_us);
+    assert(stat.played > 0 && stat.first_play_us >= 200 * 1000);
+    for (; pos < total; pos += 160)
+        assert(160 == audio_player_write(p, pcm + pos, 160));
+    audio_player_finish(p);
+    assert(0 == audio_player_wait(p, 3000));
+    audio_player_get_stat(p, &stat);
+    assert(stat.underruns == 0 && stat.played == total && stat.written == total);
+
+    // 写入中断导致欠载, 之后继续播放
+    assert(1600 == audio_player_write(p, pcm, 1600));
+    usleep(400 * 1000);
+    assert(1600 == audio_player_write(p, pcm + 1600, 1600));
+    audio_player_finish(p);
+    assert(0 == audio_player_wait(p, 3000));
+    audio_player_get_stat(p, &stat);
+    printf("underruns %u, played %llu\n", stat.underruns, (unsigned long long)stat.played);
+    assert(stat.underruns == 1 && stat.played == total + 3200);
+    audio_player_exit(p);
+
+    // 播放的数据按顺序完整写入设备
+    int16_t* out = NULL;
+    size_t frames = 0;
+    assert(0 == wav_load(path, &out, &frames, NULL));
+    assert(frames == total + 3200);
+    assert(0 == memcmp(out, pcm, total * sizeof(int16_t)));
+    assert(0 == memcmp(out + total, pcm, 3200 * sizeof(int16_t)));
+    free(out);
+    unlink(path);
+
+    // 不足 prebuffer 时 finish 也会播放
+    p = audio_player_init("null", TEST_RATE, 2, 0, 0);
+    assert(p);
+    int16_t stereo[160 * 2] = { 0 };
+    assert(160 == audio_player_write(p, stereo, 160));
+    assert(audio_player_wait(p, 50) < 0);
+    audio_player_finish(p);
+    assert(0 == audio_player_wait(p, 1000));
+    audio_player_exit(p);
+
+    printf("audio player test pass\n");
+    return 0;
+}
+
+#endif //__XTEST__
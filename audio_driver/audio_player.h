@@ -0,0 +1,94 @@
+#ifndef __AUDIO_PLAYER_H__
+#define __AUDIO_PLAYER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// 功能: 流式播放器, 调用者边解码边写入 PCM, 抖动缓冲区攒够 prebuffer 后就开始播放,
+// 不必等整段音频生成完. 缓冲区播空(欠载)时重新攒够 prebuffer 再继续.
+//
+// example:
+//   audio_player_t* p = audio_player_init("default", 24000, 1, 0, 0);
+//   while ((n = decode(pcm)) > 0)
+//       audio_player_write(p, pcm, n);  // 缓冲区满时阻塞
+//   audio_player_finish(p);
+//   audio_player_wait(p, -1);           // 等待播放完
+//   audio_player_exit(p);
+
+#define AUDIO_PLAYER_PREBUFFER_MS (200)  // 默认开始播放前缓冲的时长
+#define AUDIO_PLAYER_BUFFER_MS (2000)    // 默认抖动缓冲区时长
+
+typedef struct audio_player_stat_t {
+    uint64_t written;      // 已写入帧数
+    uint64_t played;       // 已交给设备的帧数
+    unsigned underruns;    // 欠载次数
+    int64_t first_play_us; // 第一次写入到开始播放的时间, 未开始播放为 -1
+} audio_player_stat_t;
+
+struct audio_player_t;
+
+/**
+ * 打开播放设备并启动播放线程。
+ *
+ * @param device 设备名, 见 audio_sink.h, 如 `default`、`wav:/tmp/a.wav`、`null`。
+ * @param rate 采样率。
+ * @param channels 声道数。
+ * @param prebuffer_ms 开始播放前缓冲的时长, 0 使用默认值。
+ * @param buffer_ms 抖动缓冲区时长, 0 使用默认值。
+ * @return 成功返回播放器指针，失败返回 NULL。
+ */
+audio_player_t* audio_player_init(const char* device, unsigned rate, unsigned channels,
+    unsigned prebuffer_ms, unsigned buffer_ms);
+
+/**
+ * 停止播放(丢弃未播放的数据), 关闭设备并释放播放器。
+ *
+ * @param p 指向播放器的指针。
+ */
+void audio_player_exit(audio_player_t* p);
+
+/**
+ * 写入 PCM 数据, 缓冲区满时阻塞直到全部写入。
+ * audio_player_finish 之后再写入会接着播放, 上一段已播放完时开始新的一段(重新 prebuffer)。
+ *
+ * @param p 指向播放器的指针。
+ * @param pcm 16 位 PCM 数据, 多声道交错存放。
+ * @param frames 帧数。
+ * @return 成功返回写入帧数，设备出错返回 -1。
+ */
+ssize_t audio_player_write(audio_player_t* p, const int16_t* pcm, size_t frames);
+
+/**
+ * 数据已全部写入, 不足 prebuffer 也开始播放。
+ *
+ * @param p 指向播放器的指针。
+ */
+void audio_player_finish(audio_player_t* p);
+
+/**
+ * 等待 audio_player_finish 之前写入的数据全部播放完。
+ *
+ * @param p 指向播放器的指针。
+ * @param timeout_ms 超时时间, 负数一直等待。
+ * @return 播放完返回 0，超时或出错返回 -1。
+ */
+int audio_player_wait(audio_player_t* p, int timeout_ms);
+
+/**
+ * 获取播放统计。
+ *
+ * @param p 指向播放器的指针。
+ * @param stat 输出统计。
+ */
+void audio_player_get_stat(audio_player_t* p, audio_player_stat_t* stat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__AUDIO_PLAYER_H__
@@ -0,0 +1,517 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "audio_resample.h"
+#include "debug.h"
+#include "wav.h"
+
+#define AUDIO_RESAMPLE_ROLLOFF (0.85)  // 截止频率相对输出奈奎斯特频率的比例
+#define AUDIO_RESAMPLE_BETA (7.0)      // Kaiser 窗参数, 约 70dB 阻带衰减
+
+typedef struct audio_resampler_t {
+    unsigned in_rate;   // 输入采样率
+    unsigned out_rate;  // 输出采样率
+    unsigned channels;  // 输入声道数
+    unsigned up;        // 插值倍数 L
+    unsigned down;      // 抽取倍数 M
+    unsigned taps;      // 每相抽头数 K
+    float* coefs;       // L 组系数, 每组 K 个倒序存放, 与输入窗口直接点积
+    float* buf;         // 单声道输入缓存, 开头 K - 1 个为历史数据
+    size_t buf_len;     // 缓存中的采样数
+    size_t buf_cap;     // 缓存容量
+    size_t idx;         // 下一个输出对应的最新输入在 buf 中的位置
+    unsigned phase;     // 下一个输出的相位
+} audio_resampler_t;
+
+static unsigned audio_resample_gcd(unsigned a, unsigned b)
+{
+    while (b) {
+        unsigned t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/**
+ * @brief 零阶修正贝塞尔函数, 用于 Kaiser 窗
+ */
+static double audio_resample_bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 64; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12)
+            break;
+    }
+    return sum;
+}
+
+/**
+ * @brief 设计原型低通滤波器并拆分为 L 相
+ *
+ * 原型工作在 in_rate * L 上, 长度 N = K * L, 第 p 相取 h[p + k * L]。
+ */
+static void audio_resample_design(audio_resampler_t* r)
+{
+    size_t n = (size_t)r->taps * r->up;
+    double center = (n - 1) / 2.0;
+    double cutoff = 0.5 * (r->in_rate < r->out_rate ? r->in_rate : r->out_rate) * AUDIO_RESAMPLE_ROLLOFF;
+    double fc = cutoff / ((double)r->in_rate * r->up);
+    double i0_beta = audio_resample_bessel_i0(AUDIO_RESAMPLE_BETA);
+
+    for (size_t i = 0; i < n; ++i) {
+        double t = i - center;
+        double sinc = t == 0 ? 2.0 * fc : sin(2.0 * M_PI * fc * t) / (M_PI * t);
+        double w = (2.0 * i) / (n - 1) - 1.0;
+        double kaiser = audio_resample_bessel_i0(AUDIO_RESAMPLE_BETA * sqrt(1.0 - w * w)) / i0_beta;
+        unsigned p = i % r->up;
+        unsigned k = i / r->up;
+        r->coefs[(size_t)p * r->taps + (r->taps - 1 - k)] = (float)(sinc * kaiser * r->up);
+    }
+}
+
+/**
+ * @brief 点积, 标量版本
+ */
+static inline float audio_resample_dot_c(const float* a, const float* b, unsigned n)
+{
+    float sum = 0.0f;
+    for (unsigned i = 0; i < n; ++i)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+/**
+ * @brief 点积, 有 SSE/NEON 时一次处理 8 个, n 必须是 4 的倍数, coefs 16 字节对齐
+ */
+static inline float audio_resample_dot(const float* coefs, const float* x, unsigned n)
+{
+#if defined(__SSE__)
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    unsigned i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_load_ps(coefs + i), _mm_loadu_ps(x + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_load_ps(coefs + i + 4), _mm_loadu_ps(x + i + 4)));
+    }
+    if (i < n)
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_load_ps(coefs + i), _mm_loadu_ps(x + i)));
+    acc0 = _mm_add_ps(acc0, acc1);
+    acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+    acc0 = _mm_add_ss(acc0, _mm_shuffle_ps(acc0, acc0, 1));
+    return _mm_cvtss_f32(acc0);
+#elif defined(__ARM_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0.0f), acc1 = vdupq_n_f32(0.0f);
+    unsigned i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(coefs + i), vld1q_f32(x + i));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(coefs + i + 4), vld1q_f32(x + i + 4));
+    }
+    if (i < n)
+        acc0 = vmlaq_f32(acc0, vld1q_f32(coefs + i), vld1q_f32(x + i));
+    return vaddvq_f32(vaddq_f32(acc0, acc1));
+#else
+    return audio_resample_dot_c(coefs, x, n);
+#endif
+}
+
+/**
+ * @brief 确保缓存能再放下 n 个采样
+ */
+static int audio_resample_reserve(audio_resampler_t* r, size_t n)
+{
+    if (r->buf_len + n <= r->buf_cap)
+        return 0;
+    size_t cap = r->buf_cap ? r->buf_cap : 1024;
+    while (cap < r->buf_len + n)
+        cap *= 2;
+    float* buf = (float*)realloc(r->buf, cap * sizeof(float));
+    if (!buf) {
+        LOG_ERR("fail to malloc resample buffer(%zu)", cap);
+        return -1;
+    }
+    r->buf = buf;
+    r->buf_cap = cap;
+    return 0;
+}
+
+/**
+ * @brief 计算缓存中能算出的输出, 然后丢掉不再需要的输入
+ */
+static size_t audio_resample_run(audio_resampler_t* r, int16_t* out, size_t out_cap)
+{
+    size_t produced = 0;
+    unsigned taps = r->taps;
+
+    while (r->idx < r->buf_len && produced < out_cap) {
+        const float* coefs = r->coefs + (size_t)r->phase * taps;
+        float y = audio_resample_dot(coefs, r->buf + r->idx + 1 - taps, taps) * 32768.0f;
+        out[produced++] = y >= 32767.0f ? 32767 : y <= -32768.0f ? -32768 : (int16_t)lrintf(y);
+
+        r->phase += r->down;
+        r->idx += r->phase / r->up;
+        r->phase %= r->up;
+    }
+
+    // 保留下一个输出需要的 K - 1 个历史采样
+    size_t drop = r->idx + 1 - taps;
+    if (drop > r->buf_len)
+        drop = r->buf_len;
+    memmove(r->buf, r->buf + drop, (r->buf_len - drop) * sizeof(float));
+    r->buf_len -= drop;
+    r->idx -= drop;
+
+    return produced;
+}
+
+/**
+ * 输入 in_frames 帧时最多输出的帧数, 用于分配输出缓冲区。
+ *
+ * @param r 指向重采样器的指针。
+ * @param in_frames 输入帧数。
+ * @return 输出帧数上限。
+ */
+size_t audio_resampler_max_out(audio_resampler_t* r, size_t in_frames)
+{
+    if (!r)
+        return 0;
+    return (in_frames * r->up + r->down - 1) / r->down + 1;
+}
+
+/**
+ * 输入一块数据, 输出当前能算出的全部数据。
+ * 输出与输入在时间上对齐(已扣除滤波器延时), 每个输出需要约 taps / 2 帧的后续输入才能算出。
+ *
+ * @param r 指向重采样器的指针。
+ * @param in 输入 16 位 PCM 数据, 多声道交错存放。
+ * @param in_frames 输入帧数。
+ * @param out 输出单声道数据。
+ * @param out_cap 输出缓冲区容量(帧), 不能小于 audio_resampler_max_out。
+ * @return 成功返回输出帧数，失败返回 -1。
+ */
+ssize_t audio_resampler_process(audio_resampler_t* r, const int16_t* in, size_t in_frames,
+    int16_t* out, size_t out_cap)
+{
+    if (!r || (!in && in_frames) || !out)
+        return -1;
+    if (audio_resample_reserve(r, in_frames) < 0)
+        return -1;
+
+    float* dst = r->buf + r->buf_len;
+    if (r->channels == 1) {
+        for (size_t i = 0; i < in_frames; ++i)
+            dst[i] = in[i] * (1.0f / 32768.0f);
+    } else {
+        float scale = 1.0f / (32768.0f * r->channels);
+        for (size_t i = 0; i < in_frames; ++i) {
+            int32_t sum = 0;
+            for (unsigned c = 0; c < r->channels; ++c)
+                sum += in[i * r->channels + c];
+            dst[i] = sum * scale;
+        }
+    }
+    r->buf_len += in_frames;
+
+    return audio_resample_run(r, out, out_cap);
+}
+
+/**
+ * 输入结束, 补零输出滤波器中剩余的数据。
+ *
+ * @param r 指向重采样器的指针。
+ * @param out 输出单声道数据。
+ * @param out_cap 输出缓冲区容量(帧)。
+ * @return 成功返回输出帧数，失败返回 -1。
+ */
+ssize_t audio_resampler_flush(audio_resampler_t* r, int16_t* out, size_t out_cap)
+{
+    if (!r || !out)
+        return -1;
+    if (audio_resample_reserve(r, r->taps) < 0)
+        return -1;
+
+    memset(r->buf + r->buf_len, 0, r->taps * sizeof(float));
+    r->buf_len += r->taps;
+
+    return audio_resample_run(r, out, out_cap);
+}
+
+/**
+ * 释放重采样器。
+ *
+ * @param r 指向重采样器的指针。
+ */
+void audio_resampler_exit(audio_resampler_t* r)
+{
+    if (!r)
+        return;
+    free(r->coefs);
+    free(r->buf);
+    free(r);
+}
+
+/**
+ * 创建重采样器。
+ *
+ * @param in_rate 输入采样率。
+ * @param out_rate 输出采样率。
+ * @param in_channels 输入声道数, 输出固定为单声道。
+ * @param taps 每相抽头数, 0 使用 AUDIO_RESAMPLE_TAPS, 会向上取整为 4 的倍数。
+ * @return 成功返回重采样器指针，失败返回 NULL。
+ */
+audio_resampler_t* audio_resampler_init(unsigned in_rate, unsigned out_rate, unsigned in_channels,
+    unsigned taps)
+{
+    if (!in_rate || !out_rate || !in_channels) {
+        LOG_ERR("bad resample args: %u -> %u, channels(%u)", in_rate, out_rate, in_channels);
+        return NULL;
+    }
+
+    audio_resampler_t* r = (audio_resampler_t*)malloc(sizeof(audio_resampler_t));
+    if (!r) {
+        LOG_ERR("fail to malloc resampler");
+        return NULL;
+    }
+    memset(r, 0, sizeof(audio_resampler_t));
+
+    unsigned g = audio_resample_gcd(in_rate, out_rate);
+    r->in_rate = in_rate;
+    r->out_rate = out_rate;
+    r->channels = in_channels;
+    r->up = out_rate / g;
+    r->down = in_rate / g;
+    r->taps = ((taps ? taps : AUDIO_RESAMPLE_TAPS) + 3) & ~3u;
+
+    if (posix_memalign((void**)&r->coefs, 16, (size_t)r->up * r->taps * sizeof(float))) {
+        LOG_ERR("fail to malloc resample coefs(%u x %u)", r->up, r->taps);
+        r->coefs = NULL;
+        goto err;
+    }
+    audio_resample_design(r);
+
+    // 开头放 K - 1 个 0 作为历史, 再把起点后移原型滤波器的延时 (N - 1) / 2,
+    // 使第一个输出对应第一个输入
+    if (audio_resample_reserve(r, r->taps - 1) < 0)
+        goto err;
+    memset(r->buf, 0, (r->taps - 1) * sizeof(float));
+    r->buf_len = r->taps - 1;
+    {
+        size_t delay = ((size_t)r->taps * r->up - 1) / 2;
+        r->idx = r->taps - 1 + delay / r->up;
+        r->phase = delay % r->up;
+    }
+
+    LOG_DBG("resampler(%p) %u -> %u, L(%u) M(%u) taps(%u)", r, in_rate, out_rate, r->up, r->down, r->taps);
+
+    return r;
+err:
+    audio_resampler_exit(r);
+    return NULL;
+}
+
+/**
+ * 把 WAV 文件重采样为单声道, 输出时长与输入一致, in 与 out 可以相同。
+ *
+ * @param in 输入 16 位 PCM WAV 文件路径。
+ * @param out 输出文件路径。
+ * @param out_rate 输出采样率, 与输入相同且为单声道时直接拷贝。
+ * @return 成功返回输出帧数，失败返回 -1。
+ */
+ssize_t audio_resample_wav(const char* in, const char* out, unsigned out_rate)
+{
+    if (!in || !out || !out_rate)
+        return -1;
+
+    int16_t* pcm = NULL;
+    int16_t* res = NULL;
+    size_t frames = 0;
+    ssize_t ret = -1;
+    wav_info_t info;
+    audio_resampler_t* r = NULL;
+    if (wav_load(in, &pcm, &frames, &info) < 0)
+        return -1;
+
+    if (info.rate == out_rate && info.channels == 1) {
+        ret = frames;
+        if (strcmp(in, out) && wav_save(out, pcm, frames, out_rate, 1) < 0)
+            ret = -1;
+        goto out;
+    }
+
+    r = audio_resampler_init(info.rate, out_rate, info.channels, 0);
+    if (!r)
+        goto out;
+
+    {
+        size_t cap = audio_resampler_max_out(r, frames) + audio_resampler_max_out(r, r->taps);
+        res = (int16_t*)malloc(cap * sizeof(int16_t));
+        if (!res) {
+            LOG_ERR("fail to malloc resample output(%zu)", cap);
+            goto out;
+        }
+        ssize_t n = audio_resampler_process(r, pcm, frames, res, cap);
+        ssize_t tail = n < 0 ? -1 : audio_resampler_flush(r, res + n, cap - n);
+        if (n < 0 || tail < 0)
+            goto out;
+
+        // 补零输出会多出一点, 截到与输入时长一致
+        size_t want = ((uint64_t)frames * out_rate + info.rate - 1) / info.rate;
+        want = want < (size_t)(n + tail) ? want : n + tail;
+        if (wav_save(out, res, want, out_rate, 1) < 0)
+            goto out;
+        ret = want;
+    }
+
+out:
+    audio_resampler_exit(r);
+    free(res);
+    free(pcm);
+    return ret;
+}
+
+#ifdef __XTEST__
+
+#include <time.h>
+#include <unistd.h>
+
+char g_dbg_enable = 1;
+
+#define TEST_IN_RATE (44100)
+#define TEST_OUT_RATE (16000)
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief 生成正弦波
+ */
+static void test_sine(int16_t* pcm, size_t n, double freq, double amp, unsigned rate)
+{
+    for (size_t i = 0; i < n; ++i)
+        pcm[i] = (int16_t)lrint(amp * sin(2 * M_PI * freq * i / rate));
+}
+
+/**
+ * @brief 分块重采样, 块大小不规则以覆盖流式处理的边界
+ */
+static size_t test_resample(audio_resampler_t* r, const int16_t* in, size_t n, int16_t* out, size_t cap)
+{
+    static const size_t chunks[] = { 441, 1000, 37, 1, 4410, 882 };
+    size_t done = 0, produced = 0;
+    for (int i = 0; done < n; ++i) {
+        size_t c = chunks[i % (sizeof(chunks) / sizeof(chunks[0]))];
+        c = c < n - done ? c : n - done;
+        ssize_t ret = audio_resampler_process(r, in + done, c, out + produced, cap - produced);
+        assert(ret >= 0 && (size_t)ret <= audio_resampler_max_out(r, c));
+        produced += ret;
+        done += c;
+    }
+    return produced;
+}
+
+int main(void)
+{
+    // 向量化点积与标量结果一致
+    float a[68] __attribute__((aligned(16))), b[69];
+    for (int i = 0; i < 68; ++i) {
+        a[i] = sinf(i * 0.37f);
+        b[i + 1] = cosf(i * 0.11f);
+    }
+    for (unsigned n = 4; n <= 68; n += 4)
+        assert(fabsf(audio_resample_dot(a, b + 1, n) - audio_resample_dot_c(a, b + 1, n)) < 1e-4f);
+
+    const size_t n = TEST_IN_RATE * 10;
+    int16_t* in = (int16_t*)malloc(n * sizeof(int16_t));
+    int16_t* out = (int16_t*)malloc(n * sizeof(int16_t));
+    assert(in && out);
+
+    // 1kHz 正弦与理想结果比较信噪比
+    const double amp = 16000;
+    test_sine(in, n, 1000, amp, TEST_IN_RATE);
+    audio_resampler_t* r = audio_resampler_init(TEST_IN_RATE, TEST_OUT_RATE, 1, 0);
+    assert(r);
+    size_t produced = test_resample(r, in, n, out, n);
+    double sig = 0, err = 0;
+    for (size_t i = 64; i + 64 < produced; ++i) {
+        double ref = amp * sin(2 * M_PI * 1000 * i / TEST_OUT_RATE);
+        sig += ref * ref;
+        err += (out[i] - ref) * (out[i] - ref);
+    }
+    double snr = 10 * log10(sig / err);
+    printf("1kHz: %zu -> %zu frames, snr %.1f dB\n", n, produced, snr);
+    assert(produced >= n * TEST_OUT_RATE / TEST_IN_RATE - AUDIO_RESAMPLE_TAPS);
+    assert(snr > 60);
+
+    // 一次处理与分块处理结果一致
+    audio_resampler_t* r2 = audio_resampler_init(TEST_IN_RATE, TEST_OUT_RATE, 1, 0);
+    int16_t* out2 = (int16_t*)malloc(n * sizeof(int16_t));
+    assert(r2 && out2);
+    assert((ssize_t)produced == audio_resampler_process(r2, in, n, out2, n));
+    assert(0 == memcmp(out, out2, produced * sizeof(int16_t)));
+    audio_resampler_exit(r2);
+    free(out2);
+
+    // 高于输出奈奎斯特频率的 12kHz 应被滤除, 不折叠到 4kHz
+    audio_resampler_exit(r);
+    r = audio_resampler_init(TEST_IN_RATE, TEST_OUT_RATE, 1, 0);
+    test_sine(in, n, 12000, amp, TEST_IN_RATE);
+    produced = test_resample(r, in, n, out, n);
+    double leak = 0;
+    for (size_t i = 64; i + 64 < produced; ++i)
+        leak += (double)out[i] * out[i];
+    double atten = 10 * log10(sig / (leak + 1e-9));
+    printf("12kHz: attenuation %.1f dB\n", atten);
+    assert(atten > 60);
+
+    // 实时率: 处理时间 / 音频时长
+    audio_resampler_exit(r);
+    r = audio_resampler_init(TEST_IN_RATE, TEST_OUT_RATE, 1, 0);
+    double start = now_s();
+    produced = test_resample(r, in, n, out, n);
+    double cost = now_s() - start;
+    printf("realtime factor %.4f (%.1f ms for %zu s)\n", cost / 10, cost * 1000, n / TEST_IN_RATE);
+    assert(cost < 10);
+    audio_resampler_exit(r);
+
+    // 立体声 WAV 转 16kHz 单声道, 时长不变
+    const char* path = "/tmp/audio_resample_test.wav";
+    for (size_t i = 0; i < n / 2; ++i) {
+        in[i * 2] = (int16_t)(8000 * sin(2 * M_PI * 440 * i / TEST_IN_RATE));
+        in[i * 2 + 1] = in[i * 2];
+    }
+    assert(0 == wav_save(path, in, n / 2, TEST_IN_RATE, 2));
+    ssize_t frames = audio_resample_wav(path, path, TEST_OUT_RATE);
+    assert(frames == (ssize_t)((n / 2 * TEST_OUT_RATE + TEST_IN_RATE - 1) / TEST_IN_RATE));
+    int16_t* pcm = NULL;
+    size_t pcm_frames = 0;
+    wav_info_t info;
+    assert(0 == wav_load(path, &pcm, &pcm_frames, &info));
+    assert(info.rate == TEST_OUT_RATE && info.channels == 1 && pcm_frames == (size_t)frames);
+    // 对齐输入: 第 i 个输出对应输入时刻 i / 16000
+    for (size_t i = 100; i < (size_t)frames - 100; ++i)
+        assert(fabs(pcm[i] - 8000 * sin(2 * M_PI * 440 * i / TEST_OUT_RATE)) < 200);
+    free(pcm);
+    unlink(path);
+
+    free(in);
+    free(out);
+
+    printf("audio resample test pass\n");
+    return 0;
+}
+
+#endif //__XTEST__
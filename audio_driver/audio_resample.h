@@ -0,0 +1,93 @@
+#ifndef __AUDIO_RESAMPLE_H__
+#define __AUDIO_RESAMPLE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// 功能: 多相 FIR 重采样, 多声道输入混为单声道输出, 支持流式分块处理.
+// 主要用于把 44.1kHz 采集数据转为语音识别需要的 16kHz 单声道.
+//
+// example:
+//   audio_resampler_t* r = audio_resampler_init(44100, 16000, 1, 0);
+//   int16_t out[1024];
+//   ssize_t n = audio_resampler_process(r, in, in_frames, out, 1024);
+//   ...
+//   n = audio_resampler_flush(r, out, 1024);
+//   audio_resampler_exit(r);
+
+#define AUDIO_RESAMPLE_TAPS (64)  // 默认每相抽头数, 越大过渡带越窄
+
+struct audio_resampler_t;
+
+/**
+ * 创建重采样器。
+ *
+ * @param in_rate 输入采样率。
+ * @param out_rate 输出采样率。
+ * @param in_channels 输入声道数, 输出固定为单声道。
+ * @param taps 每相抽头数, 0 使用 AUDIO_RESAMPLE_TAPS, 会向上取整为 4 的倍数。
+ * @return 成功返回重采样器指针，失败返回 NULL。
+ */
+audio_resampler_t* audio_resampler_init(unsigned in_rate, unsigned out_rate, unsigned in_channels,
+    unsigned taps);
+
+/**
+ * 释放重采样器。
+ *
+ * @param r 指向重采样器的指针。
+ */
+void audio_resampler_exit(audio_resampler_t* r);
+
+/**
+ * 输入 in_frames 帧时最多输出的帧数, 用于分配输出缓冲区。
+ *
+ * @param r 指向重采样器的指针。
+ * @param in_frames 输入帧数。
+ * @return 输出帧数上限。
+ */
+size_t audio_resampler_max_out(audio_resampler_t* r, size_t in_frames);
+
+/**
+ * 输入一块数据, 输出当前能算出的全部数据。
+ * 输出与输入在时间上对齐(已扣除滤波器延时), 每个输出需要约 taps / 2 帧的后续输入才能算出。
+ *
+ * @param r 指向重采样器的指针。
+ * @param in 输入 16 位 PCM 数据, 多声道交错存放。
+ * @param in_frames 输入帧数。
+ * @param out 输出单声道数据。
+ * @param out_cap 输出缓冲区容量(帧), 不能小于 audio_resampler_max_out。
+ * @return 成功返回输出帧数，失败返回 -1。
+ */
+ssize_t audio_resampler_process(audio_resampler_t* r, const int16_t* in, size_t in_frames,
+    int16_t* out, size_t out_cap);
+
+/**
+ * 输入结束, 补零输出滤波器中剩余的数据。
+ *
+ * @param r 指向重采样器的指针。
+ * @param out 输出单声道数据。
+ * @param out_cap 输出缓冲区容量(帧)。
+ * @return 成功返回输出帧数，失败返回 -1。
+ */
+ssize_t audio_resampler_flush(audio_resampler_t* r, int16_t* out, size_t out_cap);
+
+/**
+ * 把 WAV 文件重采样为单声道, 输出时长与输入一致, in 与 out 可以相同。
+ *
+ * @param in 输入 16 位 PCM WAV 文件路径。
+ * @param out 输出文件路径。
+ * @param out_rate 输出采样率, 与输入相同且为单声道时直接拷贝。
+ * @return 成功返回输出帧数，失败返回 -1。
+ */
+ssize_t audio_resample_wav(const char* in, const char* out, unsigned out_rate);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__AUDIO_RESAMPLE_H__
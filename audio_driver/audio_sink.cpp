@@ -0,0 +1,235 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef AUDIO_WITH_ALSA
+#include <alsa/asoundlib.h>
+#endif // AUDIO_WITH_ALSA
+
+#include "audio_sink.h"
+#include "debug.h"
+#include "wav.h"
+
+#define AUDIO_SINK_PERIOD_MS (20) // 每次写入时长
+
+typedef struct audio_sink_sim_t {
+    audio_sink_t base;     // 基类, 必须放第一个
+    int fd;                // WAV 文件, 静音设备为 -1
+    uint64_t frames;       // 已写入帧数
+    struct timespec next;  // 下一次可以写入的时间
+} audio_sink_sim_t;
+
+/**
+ * @brief 按实时速度等待设备"播放"完上一次写入的数据
+ */
+static void audio_sink_sim_pace(audio_sink_sim_t* s, size_t frames)
+{
+    if (!s->next.tv_sec && !s->next.tv_nsec)
+        clock_gettime(CLOCK_MONOTONIC, &s->next);
+
+    while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &s->next, NULL)) { }
+
+    uint64_t ns = (uint64_t)frames * 1000000000LU / s->base.rate;
+    s->next.tv_nsec += ns % 1000000000LU;
+    s->next.tv_sec += ns / 1000000000LU + s->next.tv_nsec / 1000000000LU;
+    s->next.tv_nsec %= 1000000000LU;
+}
+
+static ssize_t audio_sink_sim_write(audio_sink_t* base, const int16_t* pcm, size_t frames)
+{
+    audio_sink_sim_t* s = (audio_sink_sim_t*)base;
+
+    audio_sink_sim_pace(s, frames);
+    if (s->fd >= 0) {
+        size_t len = frames * base->channels * sizeof(int16_t);
+        const uint8_t* p = (const uint8_t*)pcm;
+        while (len) {
+            ssize_t ret = write(s->fd, p, len);
+            if (ret < 0 && errno == EINTR)
+                continue;
+            if (ret <= 0) {
+                LOG_ERR("fail to write sink wav: %s", strerror(errno));
+                return -1;
+            }
+            p += ret;
+            len -= ret;
+        }
+    }
+    s->frames += frames;
+
+    return frames;
+}
+
+static void audio_sink_sim_close(audio_sink_t* base)
+{
+    audio_sink_sim_t* s = (audio_sink_sim_t*)base;
+    if (!s)
+        return;
+
+    // 等最后一次写入的数据"播放"完
+    if (s->frames)
+        audio_sink_sim_pace(s, 0);
+    if (s->fd >= 0) {
+        // 回填文件头中的数据大小
+        wav_info_t info;
+        memset(&info, 0, sizeof(info));
+        info.channels = base->channels;
+        info.rate = base->rate;
+        info.bits = 16;
+        info.data_size = s->frames * base->channels * sizeof(int16_t);
+        if (lseek(s->fd, 0, SEEK_SET) < 0 || wav_write_header(s->fd, &info) < 0)
+            LOG_ERR("fail to update sink wav header");
+        close(s->fd);
+    }
+    free(s);
+}
+
+/**
+ * @brief 打开 WAV 或静音模拟设备
+ */
+static audio_sink_t* audio_sink_sim_open(const char* wav_path, unsigned rate, unsigned channels)
+{
+    audio_sink_sim_t* s = (audio_sink_sim_t*)malloc(sizeof(audio_sink_sim_t));
+    if (!s) {
+        LOG_ERR("fail to malloc audio sink");
+        return NULL;
+    }
+    memset(s, 0, sizeof(audio_sink_sim_t));
+    s->fd = -1;
+    s->base.write = audio_sink_sim_write;
+    s->base.close = audio_sink_sim_close;
+    s->base.rate = rate;
+    s->base.channels = channels;
+    s->base.period = rate * AUDIO_SINK_PERIOD_MS / 1000;
+
+    if (wav_path) {
+        s->fd = open(wav_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (s->fd < 0) {
+            LOG_ERR("fail to open sink wav %s: %s", wav_path, strerror(errno));
+            free(s);
+            return NULL;
+        }
+        // 先写一个数据大小为 0 的文件头, 关闭时回填
+        wav_info_t info;
+        memset(&info, 0, sizeof(info));
+        info.channels = channels;
+        info.rate = rate;
+        info.bits = 16;
+        if (wav_write_header(s->fd, &info) < 0) {
+            LOG_ERR("fail to write sink wav header: %s", wav_path);
+            audio_sink_sim_close(&s->base);
+            return NULL;
+        }
+    }
+
+    return &s->base;
+}
+
+#ifdef AUDIO_WITH_ALSA
+
+typedef struct audio_sink_alsa_t {
+    audio_sink_t base;  // 基类, 必须放第一个
+    snd_pcm_t* pcm;     // ALSA 播放句柄
+} audio_sink_alsa_t;
+
+static ssize_t audio_sink_alsa_write(audio_sink_t* base, const int16_t* pcm, size_t frames)
+{
+    audio_sink_alsa_t* s = (audio_sink_alsa_t*)base;
+    size_t done = 0;
+
+    while (done < frames) {
+        snd_pcm_sframes_t ret = snd_pcm_writei(s->pcm, pcm + done * base->channels, frames - done);
+        if (ret >= 0) {
+            done += ret;
+            continue;
+        }
+        // 欠载(EPIPE)或挂起后恢复继续播放
+        if (snd_pcm_recover(s->pcm, ret, 1) < 0) {
+            LOG_ERR("fail to write alsa: %s", snd_strerror(ret));
+            return -1;
+        }
+    }
+    return done;
+}
+
+static void audio_sink_alsa_close(audio_sink_t* base)
+{
+    audio_sink_alsa_t* s = (audio_sink_alsa_t*)base;
+    if (!s)
+        return;
+    if (s->pcm) {
+        snd_pcm_drain(s->pcm);
+        snd_pcm_close(s->pcm);
+    }
+    free(s);
+}
+
+/**
+ * @brief 打开 ALSA 播放设备
+ */
+static audio_sink_t* audio_sink_alsa_open(const char* device, unsigned rate, unsigned channels)
+{
+    audio_sink_alsa_t* s = (audio_sink_alsa_t*)malloc(sizeof(audio_sink_alsa_t));
+    if (!s) {
+        LOG_ERR("fail to malloc audio sink");
+        return NULL;
+    }
+    memset(s, 0, sizeof(audio_sink_alsa_t));
+    s->base.write = audio_sink_alsa_write;
+    s->base.close = audio_sink_alsa_close;
+
+    int ret = snd_pcm_open(&s->pcm, device, SND_PCM_STREAM_PLAYBACK, 0);
+    if (ret < 0) {
+        LOG_ERR("fail to open %s: %s", device, snd_strerror(ret));
+        s->pcm = NULL;
+        audio_sink_alsa_close(&s->base);
+        return NULL;
+    }
+    ret = snd_pcm_set_params(s->pcm, SND_PCM_FORMAT_S16_LE, SND_PCM_ACCESS_RW_INTERLEAVED,
+        channels, rate, 1, AUDIO_SINK_PERIOD_MS * 1000 * 4);
+    if (ret < 0) {
+        LOG_ERR("fail to set %s params: %s", device, snd_strerror(ret));
+        audio_sink_alsa_close(&s->base);
+        return NULL;
+    }
+
+    snd_pcm_uframes_t buffer_size = 0, period_size = 0;
+    snd_pcm_get_params(s->pcm, &buffer_size, &period_size);
+    s->base.rate = rate;
+    s->base.channels = channels;
+    s->base.period = period_size ? period_size : rate * AUDIO_SINK_PERIOD_MS / 1000;
+
+    return &s->base;
+}
+
+#endif // AUDIO_WITH_ALSA
+
+/**
+ * 打开播放设备。
+ *
+ * @param device 设备名, 见 audio_sink.h 开头说明。
+ * @param rate 采样率。
+ * @param channels 声道数。
+ * @return 成功返回播放设备指针，失败返回 NULL。
+ */
+audio_sink_t* audio_sink_open(const char* device, unsigned rate, unsigned channels)
+{
+    assert(device && rate && channels && "arg failed!");
+
+    if (0 == strcmp(device, AUDIO_SINK_NULL))
+        return audio_sink_sim_open(NULL, rate, channels);
+    if (0 == strncmp(device, AUDIO_SINK_WAV_PREFIX, strlen(AUDIO_SINK_WAV_PREFIX)))
+        return audio_sink_sim_open(device + strlen(AUDIO_SINK_WAV_PREFIX), rate, channels);
+
+#ifdef AUDIO_WITH_ALSA
+    return audio_sink_alsa_open(device, rate, channels);
+#else
+    LOG_ERR("build without alsa, unsupport device: %s", device);
+    return NULL;
+#endif // AUDIO_WITH_ALSA
+}
@@ -0,0 +1,59 @@
+#ifndef __AUDIO_SINK_H__
+#define __AUDIO_SINK_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// 功能: 16 位 PCM 播放设备, write 按实时速度阻塞.
+//
+// 设备名:
+//   default / hw:0,0 等   ALSA 播放设备(编译时需有 ALSA, 见 Makefile)
+//   wav:/path/to/a.wav    按实时速度写入 WAV 文件, 模拟声卡
+//   null                  按实时速度丢弃数据, 用于无声卡环境测试
+
+#define AUDIO_SINK_WAV_PREFIX "wav:"
+#define AUDIO_SINK_NULL "null"
+
+typedef struct audio_sink_t {
+    unsigned rate;      // 实际采样率
+    unsigned channels;  // 实际声道数
+    size_t period;      // 每次写入的建议帧数
+
+    /**
+     * 写入 PCM 数据, 阻塞直到设备接收。
+     *
+     * @param s 指向播放设备的指针。
+     * @param pcm PCM 数据, 多声道交错存放。
+     * @param frames 帧数。
+     * @return 成功返回写入帧数，失败返回 -1。
+     */
+    ssize_t (*write)(struct audio_sink_t* s, const int16_t* pcm, size_t frames);
+
+    /**
+     * 等待已写入的数据播放完, 关闭设备并释放内存。
+     *
+     * @param s 指向播放设备的指针。
+     */
+    void (*close)(struct audio_sink_t* s);
+} audio_sink_t;
+
+/**
+ * 打开播放设备。
+ *
+ * @param device 设备名, 见文件开头说明。
+ * @param rate 采样率。
+ * @param channels 声道数。
+ * @return 成功返回播放设备指针，失败返回 NULL。
+ */
+audio_sink_t* audio_sink_open(const char* device, unsigned rate, unsigned channels);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__AUDIO_SINK_H__
@@ -0,0 +1,203 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef AUDIO_WITH_ALSA
+#include <alsa/asoundlib.h>
+#endif // AUDIO_WITH_ALSA
+
+#include "audio_source.h"
+#include "debug.h"
+#include "wav.h"
+
+#define AUDIO_SOURCE_PERIOD_MS (20) // 每次读取时长
+
+typedef struct audio_source_sim_t {
+    audio_source_t base;     // 基类, 必须放第一个
+    int16_t* pcm;            // WAV 数据, 静音源为 NULL
+    size_t frames;           // WAV 帧数
+    size_t pos;              // 当前播放位置
+    struct timespec next;    // 下一次返回数据的时间
+} audio_source_sim_t;
+
+/**
+ * @brief 按实时速度等待下一个周期
+ */
+static void audio_source_sim_pace(audio_source_sim_t* s, size_t frames)
+{
+    if (!s->next.tv_sec && !s->next.tv_nsec)
+        clock_gettime(CLOCK_MONOTONIC, &s->next);
+
+    uint64_t ns = (uint64_t)frames * 1000000000LU / s->base.rate;
+    s->next.tv_nsec += ns % 1000000000LU;
+    s->next.tv_sec += ns / 1000000000LU + s->next.tv_nsec / 1000000000LU;
+    s->next.tv_nsec %= 1000000000LU;
+
+    while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &s->next, NULL)) { }
+}
+
+/**
+ * @brief 模拟源读取: WAV 循环播放或静音
+ */
+static ssize_t audio_source_sim_read(audio_source_t* base, int16_t* pcm, size_t frames)
+{
+    audio_source_sim_t* s = (audio_source_sim_t*)base;
+    size_t channels = base->channels;
+
+    if (frames > base->period)
+        frames = base->period;
+    audio_source_sim_pace(s, frames);
+
+    if (!s->pcm) {
+        memset(pcm, 0, frames * channels * sizeof(int16_t));
+        return frames;
+    }
+    for (size_t done = 0; done < frames;) {
+        size_t n = s->frames - s->pos < frames - done ? s->frames - s->pos : frames - done;
+        memcpy(pcm + done * channels, s->pcm + s->pos * channels, n * channels * sizeof(int16_t));
+        done += n;
+        s->pos = (s->pos + n) % s->frames;
+    }
+    return frames;
+}
+
+static void audio_source_sim_close(audio_source_t* base)
+{
+    audio_source_sim_t* s = (audio_source_sim_t*)base;
+    if (!s)
+        return;
+    free(s->pcm);
+    free(s);
+}
+
+/**
+ * @brief 打开 WAV 或静音模拟源
+ */
+static audio_source_t* audio_source_sim_open(const char* wav_path, unsigned rate, unsigned channels)
+{
+    audio_source_sim_t* s = (audio_source_sim_t*)malloc(sizeof(audio_source_sim_t));
+    if (!s) {
+        LOG_ERR("fail to malloc audio source");
+        return NULL;
+    }
+    memset(s, 0, sizeof(audio_source_sim_t));
+    s->base.read = audio_source_sim_read;
+    s->base.close = audio_source_sim_close;
+    s->base.rate = rate;
+    s->base.channels = channels;
+
+    if (wav_path) {
+        wav_info_t info;
+        if (wav_load(wav_path, &s->pcm, &s->frames, &info) < 0 || !s->frames) {
+            LOG_ERR("fail to load source wav: %s", wav_path);
+            audio_source_sim_close(&s->base);
+            return NULL;
+        }
+        s->base.rate = info.rate;
+        s->base.channels = info.channels;
+    }
+    s->base.period = s->base.rate * AUDIO_SOURCE_PERIOD_MS / 1000;
+
+    return &s->base;
+}
+
+#ifdef AUDIO_WITH_ALSA
+
+typedef struct audio_source_alsa_t {
+    audio_source_t base;  // 基类, 必须放第一个
+    snd_pcm_t* pcm;       // ALSA 采集句柄
+} audio_source_alsa_t;
+
+static ssize_t audio_source_alsa_read(audio_source_t* base, int16_t* pcm, size_t frames)
+{
+    audio_source_alsa_t* s = (audio_source_alsa_t*)base;
+
+    for (;;) {
+        snd_pcm_sframes_t ret = snd_pcm_readi(s->pcm, pcm, frames);
+        if (ret >= 0)
+            return ret;
+        // 溢出(EPIPE)或挂起后恢复继续采集
+        if (snd_pcm_recover(s->pcm, ret, 1) < 0) {
+            LOG_ERR("fail to read alsa: %s", snd_strerror(ret));
+            return -1;
+        }
+    }
+}
+
+static void audio_source_alsa_close(audio_source_t* base)
+{
+    audio_source_alsa_t* s = (audio_source_alsa_t*)base;
+    if (!s)
+        return;
+    if (s->pcm)
+        snd_pcm_close(s->pcm);
+    free(s);
+}
+
+/**
+ * @brief 打开 ALSA 采集设备
+ */
+static audio_source_t* audio_source_alsa_open(const char* device, unsigned rate, unsigned channels)
+{
+    audio_source_alsa_t* s = (audio_source_alsa_t*)malloc(sizeof(audio_source_alsa_t));
+    if (!s) {
+        LOG_ERR("fail to malloc audio source");
+        return NULL;
+    }
+    memset(s, 0, sizeof(audio_source_alsa_t));
+    s->base.read = audio_source_alsa_read;
+    s->base.close = audio_source_alsa_close;
+
+    int ret = snd_pcm_open(&s->pcm, device, SND_PCM_STREAM_CAPTURE, 0);
+    if (ret < 0) {
+        LOG_ERR("fail to open %s: %s", device, snd_strerror(ret));
+        s->pcm = NULL;
+        audio_source_alsa_close(&s->base);
+        return NULL;
+    }
+    ret = snd_pcm_set_params(s->pcm, SND_PCM_FORMAT_S16_LE, SND_PCM_ACCESS_RW_INTERLEAVED,
+        channels, rate, 1, AUDIO_SOURCE_PERIOD_MS * 1000 * 4);
+    if (ret < 0) {
+        LOG_ERR("fail to set %s params: %s", device, snd_strerror(ret));
+        audio_source_alsa_close(&s->base);
+        return NULL;
+    }
+
+    snd_pcm_uframes_t buffer_size = 0, period_size = 0;
+    snd_pcm_get_params(s->pcm, &buffer_size, &period_size);
+    s->base.rate = rate;
+    s->base.channels = channels;
+    s->base.period = period_size ? period_size : rate * AUDIO_SOURCE_PERIOD_MS / 1000;
+
+    return &s->base;
+}
+
+#endif // AUDIO_WITH_ALSA
+
+/**
+ * 打开采集源。
+ *
+ * @param device 设备名, 见 audio_source.h 开头说明。
+ * @param rate 期望采样率, WAV 源以文件为准。
+ * @param channels 期望声道数, WAV 源以文件为准。
+ * @return 成功返回采集源指针，失败返回 NULL。
+ */
+audio_source_t* audio_source_open(const char* device, unsigned rate, unsigned channels)
+{
+    assert(device && rate && channels && "arg failed!");
+
+    if (0 == strcmp(device, AUDIO_SOURCE_NULL))
+        return audio_source_sim_open(NULL, rate, channels);
+    if (0 == strncmp(device, AUDIO_SOURCE_WAV_PREFIX, strlen(AUDIO_SOURCE_WAV_PREFIX)))
+        return audio_source_sim_open(device + strlen(AUDIO_SOURCE_WAV_PREFIX), rate, channels);
+
+#ifdef AUDIO_WITH_ALSA
+    return audio_source_alsa_open(device, rate, channels);
+#else
+    LOG_ERR("build without alsa, unsupport device: %s", device);
+    return NULL;
+#endif // AUDIO_WITH_ALSA
+}
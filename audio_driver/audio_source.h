@@ -0,0 +1,59 @@
+#ifndef __AUDIO_SOURCE_H__
+#define __AUDIO_SOURCE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// 功能: 16 位 PCM 采集源, read 按实时速度阻塞返回数据.
+//
+// 设备名:
+//   hw:0,0 / default 等   ALSA 采集设备(编译时需有 ALSA, 见 Makefile)
+//   wav:/path/to/a.wav    循环播放 WAV 文件模拟麦克风
+//   null                  静音, 用于无麦克风环境测试
+
+#define AUDIO_SOURCE_WAV_PREFIX "wav:"
+#define AUDIO_SOURCE_NULL "null"
+
+typedef struct audio_source_t {
+    unsigned rate;      // 实际采样率
+    unsigned channels;  // 实际声道数
+    size_t period;      // 每次读取的建议帧数
+
+    /**
+     * 读取 PCM 数据, 阻塞直到读到数据。
+     *
+     * @param s 指向采集源的指针。
+     * @param pcm 输出缓冲区, 多声道交错存放。
+     * @param frames 最多读取帧数。
+     * @return 成功返回读取帧数，失败返回 -1。
+     */
+    ssize_t (*read)(struct audio_source_t* s, int16_t* pcm, size_t frames);
+
+    /**
+     * 关闭采集源并释放内存。
+     *
+     * @param s 指向采集源的指针。
+     */
+    void (*close)(struct audio_source_t* s);
+} audio_source_t;
+
+/**
+ * 打开采集源。
+ *
+ * @param device 设备名, 见文件开头说明。
+ * @param rate 期望采样率, WAV 源以文件为准。
+ * @param channels 期望声道数, WAV 源以文件为准。
+ * @return 成功返回采集源指针，失败返回 NULL。
+ */
+audio_source_t* audio_source_open(const char* device, unsigned rate, unsigned channels);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__AUDIO_SOURCE_H__
@@ -0,0 +1,426 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "audio_vad.h"
+#include "debug.h"
+#include "wav.h"
+
+#define AUDIO_VAD_WEAK_DB (10.0f)     // 清辅音能量最多比阈值低多少 dB
+#define AUDIO_VAD_NOISE_PERCENT (10)  // 取能量最低的百分之多少估计底噪
+#define AUDIO_VAD_FLAT_DB (8.0f)      // 底噪与中位数相差不到这么多时认为整段都是语音
+
+/**
+ * 获取默认配置。
+ *
+ * @param cfg 输出配置。
+ */
+void audio_vad_config_default(audio_vad_config_t* cfg)
+{
+    if (!cfg)
+        return;
+    cfg->frame_ms = 20;
+    cfg->energy_db = -50.0f;
+    cfg->snr_db = 12.0f;
+    cfg->zcr_min = 0.25f;
+    cfg->hangover_ms = 200;
+    cfg->min_speech_ms = 100;
+    cfg->pad_ms = 150;
+    cfg->split_pause_ms = 700;
+}
+
+/**
+ * @brief 计算平方和与过零次数, 标量版本, 也用于处理向量化后剩下的尾部
+ *
+ * @param pcm 单声道数据
+ * @param n 采样数
+ * @param sum 累加平方和
+ * @param zc 累加过零次数, 统计 pcm[i] 与 pcm[i + 1] 异号的次数
+ */
+static void audio_vad_features_c(const int16_t* pcm, size_t n, uint64_t* sum, uint32_t* zc)
+{
+    uint64_t s = 0;
+    uint32_t z = 0;
+    for (size_t i = 0; i < n; ++i) {
+        s += (int32_t)pcm[i] * pcm[i];
+        if (i + 1 < n)
+            z += (pcm[i] ^ pcm[i + 1]) < 0;
+    }
+    *sum += s;
+    *zc += z;
+}
+
+/**
+ * @brief 计算平方和与过零次数, 有 SSE2/NEON 时一次处理 8 个采样
+ *
+ * 过零计数用 16 位通道累加, n 不能超过 8 * 65535, 按分析帧调用即可。
+ */
+static void audio_vad_features(const int16_t* pcm, size_t n, uint64_t* sum, uint32_t* zc)
+{
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    // madd 两两相加最大为 2 * 32768^2 = 2^31, 按无符号扩展到 64 位累加不会溢出
+    __m128i acc = _mm_setzero_si128();
+    __m128i zacc = _mm_setzero_si128();
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 9 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(pcm + i));
+        __m128i next = _mm_loadu_si128((const __m128i*)(pcm + i + 1));
+        __m128i sq = _mm_madd_epi16(v, v);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(sq, zero));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(sq, zero));
+        // 异号时符号位为 1, 算术右移得到 -1
+        zacc = _mm_sub_epi16(zacc, _mm_srai_epi16(_mm_xor_si128(v, next), 15));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    *sum += lanes[0] + lanes[1];
+    uint16_t zl[8];
+    _mm_storeu_si128((__m128i*)zl, zacc);
+    for (int k = 0; k < 8; ++k)
+        *zc += zl[k];
+#elif defined(__ARM_NEON)
+    uint64x2_t acc = vdupq_n_u64(0);
+    int16x8_t zacc = vdupq_n_s16(0);
+    for (; i + 9 <= n; i += 8) {
+        int16x8_t v = vld1q_s16(pcm + i);
+        int16x8_t next = vld1q_s16(pcm + i + 1);
+        int32x4_t lo = vmull_s16(vget_low_s16(v), vget_low_s16(v));
+        int32x4_t hi = vmull_s16(vget_high_s16(v), vget_high_s16(v));
+        acc = vpadalq_u32(acc, vreinterpretq_u32_s32(lo));
+        acc = vpadalq_u32(acc, vreinterpretq_u32_s32(hi));
+        zacc = vsubq_s16(zacc, vshrq_n_s16(veorq_s16(v, next), 15));
+    }
+    *sum += vgetq_lane_u64(acc, 0) + vgetq_lane_u64(acc, 1);
+    *zc += vaddlvq_u16(vreinterpretq_u16_s16(zacc));
+#endif
+
+    // 尾部, 从 i 开始的过零也在这里统计
+    audio_vad_features_c(pcm + i, n - i, sum, zc);
+}
+
+static int audio_vad_cmp_float(const void* a, const void* b)
+{
+    float x = *(const float*)a, y = *(const float*)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief 追加一个语音段, 与上一段的间隔小于 gap 或超过容量时合并
+ *
+ * @return 当前语音段个数
+ */
+static size_t audio_vad_push_segment(audio_vad_segment_t* segs, size_t count, size_t max_segs,
+    size_t start, size_t end, size_t gap)
+{
+    if (count && (start <= segs[count - 1].end + gap || count == max_segs)) {
+        if (end > segs[count - 1].end)
+            segs[count - 1].end = end;
+        return count;
+    }
+    segs[count].start = start;
+    segs[count].end = end;
+    return count + 1;
+}
+
+/**
+ * 检测语音段。
+ * 语音段数超过 max_segs 时, 多出的部分合并到最后一段, 保证不丢语音。
+ *
+ * @param cfg 配置, 为 NULL 时使用默认配置。
+ * @param pcm 16 位 PCM 数据, 多声道交错存放。
+ * @param frames 帧数。
+ * @param rate 采样率。
+ * @param channels 声道数。
+ * @param segs 输出语音段, 按时间顺序排列。
+ * @param max_segs segs 容量。
+ * @param stat 输出统计, 可为 NULL。
+ * @return 成功返回语音段个数，失败返回 -1。
+ */
+ssize_t audio_vad_detect(const audio_vad_config_t* cfg, const int16_t* pcm, size_t frames,
+    unsigned rate, unsigned channels, audio_vad_segment_t* segs, size_t max_segs,
+    audio_vad_stat_t* stat)
+{
+    audio_vad_config_t def;
+    if (!cfg) {
+        audio_vad_config_default(&def);
+        cfg = &def;
+    }
+    if ((!pcm && frames) || !rate || !channels || !segs || !max_segs || !cfg->frame_ms)
+        return -1;
+
+    size_t frame_len = (size_t)rate * cfg->frame_ms / 1000;
+    if (!frame_len)
+        frame_len = 1;
+    size_t nf = (frames + frame_len - 1) / frame_len;
+    ssize_t count = -1;
+    float* db = (float*)malloc((nf ? nf : 1) * sizeof(float) * 2);
+    uint8_t* voiced = (uint8_t*)malloc(nf ? nf : 1);
+    int16_t* mono = channels > 1 ? (int16_t*)malloc(frame_len * sizeof(int16_t)) : NULL;
+    float noise = cfg->energy_db, thr = cfg->energy_db;
+    if (!db || !voiced || (channels > 1 && !mono)) {
+        LOG_ERR("fail to malloc vad buffer");
+        goto out;
+    }
+
+    {
+        float* zcr = db + nf;
+        for (size_t f = 0; f < nf; ++f) {
+            size_t start = f * frame_len;
+            size_t n = frames - start < frame_len ? frames - start : frame_len;
+            const int16_t* p = pcm + start * channels;
+            if (channels > 1) {
+                for (size_t i = 0; i < n; ++i) {
+                    int32_t s = 0;
+                    for (unsigned c = 0; c < channels; ++c)
+                        s += p[i * channels + c];
+                    mono[i] = s / (int32_t)channels;
+                }
+                p = mono;
+            }
+
+            uint64_t sum = 0;
+            uint32_t zc = 0;
+            audio_vad_features(p, n, &sum, &zc);
+            double ms = (double)sum / n / (32768.0 * 32768.0);
+            db[f] = ms > 1e-12 ? 10.0 * log10(ms) : -120.0f;
+            zcr[f] = n > 1 ? (float)zc / (n - 1) : 0.0f;
+        }
+
+        // 底噪取能量最低的一部分帧, 录音整段都是语音时退化为固定阈值
+        if (nf) {
+            float* sorted = (float*)malloc(nf * sizeof(float));
+            if (!sorted) {
+                LOG_ERR("fail to malloc vad buffer");
+                goto out;
+            }
+            memcpy(sorted, db, nf * sizeof(float));
+            qsort(sorted, nf, sizeof(float), audio_vad_cmp_float);
+            noise = sorted[nf * AUDIO_VAD_NOISE_PERCENT / 100];
+            // 能量最低的帧也和中位数差不多响, 说明它们不是底噪, 改用固定阈值
+            if (noise > cfg->energy_db && sorted[nf / 2] - noise < AUDIO_VAD_FLAT_DB)
+                noise = cfg->energy_db;
+            free(sorted);
+        }
+        thr = noise + cfg->snr_db > cfg->energy_db ? noise + cfg->snr_db : cfg->energy_db;
+        float weak = thr - AUDIO_VAD_WEAK_DB > cfg->energy_db ? thr - AUDIO_VAD_WEAK_DB : cfg->energy_db;
+        for (size_t f = 0; f < nf; ++f)
+            voiced[f] = db[f] >= thr || (db[f] >= weak && zcr[f] >= cfg->zcr_min);
+    }
+
+    {
+        size_t hangover = (cfg->hangover_ms + cfg->frame_ms - 1) / cfg->frame_ms;
+        size_t min_speech = (cfg->min_speech_ms + cfg->frame_ms - 1) / cfg->frame_ms;
+        size_t pad = (size_t)rate * cfg->pad_ms / 1000;
+        size_t gap = (size_t)rate * cfg->split_pause_ms / 1000;
+        size_t seg_start = 0, last = 0;
+        int in_speech = 0;
+
+        count = 0;
+        for (size_t f = 0; f <= nf; ++f) {
+            if (f < nf && voiced[f]) {
+                if (!in_speech)
+                    seg_start = f;
+                in_speech = 1;
+                last = f;
+                continue;
+            }
+            // 静音超过 hangover 或到结尾, 结束当前语音段
+            if (!in_speech || (f < nf && f - last <= hangover))
+                continue;
+            in_speech = 0;
+            if (last + 1 - seg_start < min_speech)
+                continue;
+
+            size_t start = seg_start * frame_len;
+            size_t end = (last + 1 + hangover) * frame_len;
+            start = start > pad ? start - pad : 0;
+            end = end + pad < frames ? end + pad : frames;
+            count = audio_vad_push_segment(segs, count, max_segs, start, end, gap);
+        }
+    }
+
+out:
+    if (stat) {
+        stat->in_frames = frames;
+        stat->out_frames = 0;
+        stat->segments = count > 0 ? count : 0;
+        for (ssize_t i = 0; i < count; ++i)
+            stat->out_frames += segs[i].end - segs[i].start;
+        stat->noise_db = noise;
+        stat->threshold_db = thr;
+    }
+    free(db);
+    free(voiced);
+    free(mono);
+
+    return count;
+}
+
+/**
+ * 去掉静音, 把所有语音段依次拼接到 pcm 开头。
+ *
+ * @param cfg 配置, 为 NULL 时使用默认配置。
+ * @param pcm 16 位 PCM 数据, 原地修改。
+ * @param frames 帧数。
+ * @param rate 采样率。
+ * @param channels 声道数。
+ * @param stat 输出统计, 可为 NULL。
+ * @return 成功返回剩余帧数(没有语音时为 0)，失败返回 -1。
+ */
+ssize_t audio_vad_trim(const audio_vad_config_t* cfg, int16_t* pcm, size_t frames,
+    unsigned rate, unsigned channels, audio_vad_stat_t* stat)
+{
+    audio_vad_segment_t segs[64];
+    ssize_t count = audio_vad_detect(cfg, pcm, frames, rate, channels,
+        segs, sizeof(segs) / sizeof(segs[0]), stat);
+    if (count < 0)
+        return -1;
+
+    size_t out = 0;
+    for (ssize_t i = 0; i < count; ++i) {
+        size_t n = segs[i].end - segs[i].start;
+        memmove(pcm + out * channels, pcm + segs[i].start * channels, n * channels * sizeof(int16_t));
+        out += n;
+    }
+
+    return out;
+}
+
+/**
+ * 去掉 WAV 文件中的静音, 写入新文件, in 与 out 可以相同。
+ *
+ * @param cfg 配置, 为 NULL 时使用默认配置。
+ * @param in 输入 16 位 PCM WAV 文件路径。
+ * @param out 输出文件路径。
+ * @param stat 输出统计, 可为 NULL。
+ * @return 成功返回剩余帧数(没有语音时为 0, 不写文件)，失败返回 -1。
+ */
+ssize_t audio_vad_trim_wav(const audio_vad_config_t* cfg, const char* in, const char* out,
+    audio_vad_stat_t* stat)
+{
+    if (!in || !out)
+        return -1;
+
+    int16_t* pcm = NULL;
+    size_t frames = 0;
+    wav_info_t info;
+    if (wav_load(in, &pcm, &frames, &info) < 0)
+        return -1;
+
+    ssize_t ret = audio_vad_trim(cfg, pcm, frames, info.rate, info.channels, stat);
+    if (ret > 0 && wav_save(out, pcm, ret, info.rate, info.channels) < 0)
+        ret = -1;
+    free(pcm);
+
+    return ret;
+}
+
+#ifdef __XTEST__
+
+#include <unistd.h>
+
+char g_dbg_enable = 1;
+
+#define TEST_RATE (16000)
+
+/**
+ * @brief 生成测试数据: 静音段加微弱噪声, 语音段用 300Hz 正弦模拟
+ */
+static void test_fill(int16_t* pcm, size_t start, size_t n, int speech)
+{
+    for (size_t i = start; i < start + n; ++i) {
+        int noise = rand() % 64 - 32;
+        pcm[i] = speech ? (int16_t)(8000 * sin(2 * M_PI * 300 * i / TEST_RATE)) + noise : noise;
+    }
+}
+
+int main(void)
+{
+    // 向量化结果要和标量版本完全一致, 包括 -32768 的边界
+    int16_t buf[1003];
+    for (size_t i = 0; i < sizeof(buf) / sizeof(buf[0]); ++i)
+        buf[i] = i % 7 ? (int16_t)rand() : -32768;
+    for (size_t n = 0; n < sizeof(buf) / sizeof(buf[0]); n += 37) {
+        uint64_t s0 = 0, s1 = 0;
+        uint32_t z0 = 0, z1 = 0;
+        audio_vad_features_c(buf, n, &s0, &z0);
+        audio_vad_features(buf, n, &s1, &z1);
+        assert(s0 == s1 && z0 == z1);
+    }
+
+    // 1s 静音, 0.5s 语音, 0.1s 停顿, 0.4s 语音, 1.5s 静音, 0.5s 语音, 1s 静音
+    const size_t layout[][2] = {
+        { 16000, 0 }, { 8000, 1 }, { 1600, 0 }, { 6400, 1 }, { 24000, 0 }, { 8000, 1 }, { 16000, 0 },
+    };
+    size_t frames = 0;
+    for (size_t i = 0; i < sizeof(layout) / sizeof(layout[0]); ++i)
+        frames += layout[i][0];
+    int16_t* pcm = (int16_t*)malloc(frames * sizeof(int16_t));
+    assert(pcm);
+    for (size_t i = 0, pos = 0; i < sizeof(layout) / sizeof(layout[0]); pos += layout[i][0], ++i)
+        test_fill(pcm, pos, layout[i][0], layout[i][1]);
+
+    audio_vad_segment_t segs[8];
+    audio_vad_stat_t stat;
+    ssize_t count = audio_vad_detect(NULL, pcm, frames, TEST_RATE, 1, segs, 8, &stat);
+    printf("segments %zd, noise %.1f dB, threshold %.1f dB\n", count, stat.noise_db, stat.threshold_db);
+    for (ssize_t i = 0; i < count; ++i)
+        printf("  [%zu, %zu)\n", segs[i].start, segs[i].end);
+
+    // 0.1s 的停顿在 hangover 内不切分, 1.5s 的停顿切分
+    assert(count == 2);
+    assert(segs[0].start <= 16000 && segs[0].start >= 16000 - 3200);
+    assert(segs[0].end >= 32000 && segs[0].end <= 32000 + 8000);
+    assert(segs[1].start <= 56000 && segs[1].start >= 56000 - 3200);
+    assert(segs[1].end >= 64000 && segs[1].end <= 64000 + 8000);
+
+    // 容量不足时合并到最后一段
+    assert(1 == audio_vad_detect(NULL, pcm, frames, TEST_RATE, 1, segs, 1, NULL));
+    assert(segs[0].end >= 64000);
+
+    const char* path = "/tmp/audio_vad_test.wav";
+    assert(0 == wav_save(path, pcm, frames, TEST_RATE, 1));
+    ssize_t left = audio_vad_trim_wav(NULL, path, path, &stat);
+    printf("trim %zu -> %zd frames, removed %.2fs\n", frames, left,
+        (double)(frames - left) / TEST_RATE);
+    assert(left > 0 && (size_t)left == stat.out_frames && left < (ssize_t)frames * 6 / 10);
+
+    int16_t* trimmed = NULL;
+    size_t trimmed_frames = 0;
+    assert(0 == wav_load(path, &trimmed, &trimmed_frames, NULL));
+    assert(trimmed_frames == (size_t)left);
+    assert(0 == memcmp(trimmed, pcm + segs[0].start, 16 * sizeof(int16_t)));
+    free(trimmed);
+    unlink(path);
+
+    // 整段都是语音, 包络在 0.3~1.0 之间起伏, 底噪估计退化为固定阈值, 整段保留
+    for (size_t i = 0; i < 2 * TEST_RATE; ++i) {
+        double env = 0.65 + 0.35 * sin(2 * M_PI * 3 * i / TEST_RATE);
+        pcm[i] = (int16_t)(env * 8000 * sin(2 * M_PI * 300 * i / TEST_RATE));
+    }
+    count = audio_vad_detect(NULL, pcm, 2 * TEST_RATE, TEST_RATE, 1, segs, 8, &stat);
+    printf("all speech: segments %zd, noise %.1f dB, threshold %.1f dB\n", count, stat.noise_db, stat.threshold_db);
+    assert(count == 1 && segs[0].start == 0 && segs[0].end == 2 * TEST_RATE);
+    assert(stat.noise_db == -50.0f);
+
+    // 全静音
+    test_fill(pcm, 0, frames, 0);
+    assert(0 == audio_vad_trim(NULL, pcm, frames, TEST_RATE, 1, &stat));
+    assert(stat.segments == 0 && stat.out_frames == 0);
+    free(pcm);
+
+    printf("audio vad test pass\n");
+    return 0;
+}
+
+#endif //__XTEST__
@@ -0,0 +1,99 @@
+#ifndef __AUDIO_VAD_H__
+#define __AUDIO_VAD_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// 功能: 语音活动检测(VAD), 按短时能量和过零率找出语音段,
+// 去掉首尾静音并压缩长停顿, 减少上传给语音识别的数据量.
+//
+// example:
+//   audio_vad_stat_t stat;
+//   audio_vad_trim_wav(NULL, "/tmp/record/capture.wav", "/tmp/record/trimmed.wav", &stat);
+//   printf("removed %zu of %zu frames\n", stat.in_frames - stat.out_frames, stat.in_frames);
+
+typedef struct audio_vad_config_t {
+    unsigned frame_ms;        // 分析帧长
+    float energy_db;          // 最低能量阈值(dBFS), 低于它一定是静音
+    float snr_db;             // 能量高于底噪多少 dB 判为语音
+    float zcr_min;            // 能量略低于阈值但过零率高于此值的帧按清辅音处理, 0~1
+    unsigned hangover_ms;     // 语音结束后保持的时长, 避免字间短停顿被切断
+    unsigned min_speech_ms;   // 短于此时长的语音段视为噪声丢弃
+    unsigned pad_ms;          // 每个语音段前后保留的时长
+    unsigned split_pause_ms;  // 停顿超过此时长时切分为两个语音段, 中间的静音被去掉
+} audio_vad_config_t;
+
+typedef struct audio_vad_segment_t {
+    size_t start;  // 起始帧
+    size_t end;    // 结束帧(不含)
+} audio_vad_segment_t;
+
+typedef struct audio_vad_stat_t {
+    size_t in_frames;    // 输入帧数
+    size_t out_frames;   // 语音段总帧数
+    size_t segments;     // 语音段个数
+    float noise_db;      // 估计的底噪(dBFS)
+    float threshold_db;  // 实际使用的能量阈值(dBFS)
+} audio_vad_stat_t;
+
+/**
+ * 获取默认配置。
+ *
+ * @param cfg 输出配置。
+ */
+void audio_vad_config_default(audio_vad_config_t* cfg);
+
+/**
+ * 检测语音段。
+ * 语音段数超过 max_segs 时, 多出的部分合并到最后一段, 保证不丢语音。
+ *
+ * @param cfg 配置, 为 NULL 时使用默认配置。
+ * @param pcm 16 位 PCM 数据, 多声道交错存放。
+ * @param frames 帧数。
+ * @param rate 采样率。
+ * @param channels 声道数。
+ * @param segs 输出语音段, 按时间顺序排列。
+ * @param max_segs segs 容量。
+ * @param stat 输出统计, 可为 NULL。
+ * @return 成功返回语音段个数，失败返回 -1。
+ */
+ssize_t audio_vad_detect(const audio_vad_config_t* cfg, const int16_t* pcm, size_t frames,
+    unsigned rate, unsigned channels, audio_vad_segment_t* segs, size_t max_segs,
+    audio_vad_stat_t* stat);
+
+/**
+ * 去掉静音, 把所有语音段依次拼接到 pcm 开头。
+ *
+ * @param cfg 配置, 为 NULL 时使用默认配置。
+ * @param pcm 16 位 PCM 数据, 原地修改。
+ * @param frames 帧数。
+ * @param rate 采样率。
+ * @param channels 声道数。
+ * @param stat 输出统计, 可为 NULL。
+ * @return 成功返回剩余帧数(没有语音时为 0)，失败返回 -1。
+ */
+ssize_t audio_vad_trim(const audio_vad_config_t* cfg, int16_t* pcm, size_t frames,
+    unsigned rate, unsigned channels, audio_vad_stat_t* stat);
+
+/**
+ * 去掉 WAV 文件中的静音, 写入新文件, in 与 out 可以相同。
+ *
+ * @param cfg 配置, 为 NULL 时使用默认配置。
+ * @param in 输入 16 位 PCM WAV 文件路径。
+ * @param out 输出文件路径。
+ * @param stat 输出统计, 可为 NULL。
+ * @return 成功返回剩余帧数(没有语音时为 0, 不写文件)，失败返回 -1。
+ */
+ssize_t audio_vad_trim_wav(const audio_vad_config_t* cfg, const char* in, const char* out,
+    audio_vad_stat_t* stat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__AUDIO_VAD_H__
@@ -0,0 +1,25 @@
+#!/bin/bash
+
+# 边合成边解码, 向标准输出写 16 位 24kHz 单声道 PCM, 供 AudioPlayer 流式播放
+
+which edge-tts > /dev/null
+if [ ! $? -eq 0 ]; then
+	# 标准输出是 PCM 流, 安装信息只能写到标准错误
+	pip3 install edge-tts >&2
+fi
+
+which ffmpeg > /dev/null
+if [ ! $? -eq 0 ]; then
+    sudo apt-get install -y ffmpeg >&2
+fi
+
+default_speak_mode=zh-CN-XiaoxiaoNeural
+
+speak_txt=/tmp/speak_stream.txt
+
+rm -f ${speak_txt}
+
+echo "$@" > ${speak_txt}
+
+edge-tts -f ${speak_txt} --write-media /dev/stdout -v ${default_speak_mode} \
+    | ffmpeg -loglevel error -f mp3 -i pipe:0 -f s16le -ac 1 -ar 24000 pipe:1
@@ -0,0 +1,130 @@
+// WAV 拼接性能对比: 原生 wav_concat 与 sox 子进程.
+//
+// usage:
+//   wav_bench [chunks] [seconds_per_chunk] [rounds]
+//
+// 生成 chunks 个 44100Hz 单声道 WAV 片段(模拟多次按键录音), 分别用
+// wav_concat 和 `sox a.wav b.wav ... out.wav` 拼接 rounds 次, 输出平均耗时.
+// 没有安装 sox 时只测原生拼接.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "wav.h"
+
+char g_dbg_enable = 0;
+
+#define BENCH_RATE (44100)
+#define BENCH_DIR "/tmp/wav_bench"
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/**
+ * @brief 运行 sox 拼接, 等待结束
+ *
+ * @return 成功返回 0，失败或没有 sox 返回 -1
+ */
+static int run_sox(char** inputs, int count, const char* output)
+{
+    char** argv = (char**)calloc(count + 3, sizeof(char*));
+    if (!argv)
+        return -1;
+    argv[0] = (char*)"sox";
+    for (int i = 0; i < count; ++i)
+        argv[i + 1] = inputs[i];
+    argv[count + 1] = (char*)output;
+
+    pid_t pid = fork();
+    if (0 == pid) {
+        execvp("sox", argv);
+        _exit(127);
+    }
+    free(argv);
+    if (pid < 0)
+        return -1;
+
+    int status = 0;
+    if (waitpid(pid, &status, 0) < 0)
+        return -1;
+    return WIFEXITED(status) && 0 == WEXITSTATUS(status) ? 0 : -1;
+}
+
+int main(int argc, char* argv[])
+{
+    int chunks = argc > 1 ? atoi(argv[1]) : 8;
+    int seconds = argc > 2 ? atoi(argv[2]) : 3;
+    int rounds = argc > 3 ? atoi(argv[3]) : 20;
+    if (chunks <= 0 || seconds <= 0 || rounds <= 0) {
+        fprintf(stderr, "usage: %s [chunks] [seconds_per_chunk] [rounds]\n", argv[0]);
+        return -1;
+    }
+
+    size_t frames = (size_t)BENCH_RATE * seconds;
+    int16_t* pcm = (int16_t*)malloc(frames * sizeof(int16_t));
+    char** inputs = (char**)calloc(chunks, sizeof(char*));
+    if (!pcm || !inputs) {
+        fprintf(stderr, "fail to malloc\n");
+        return -1;
+    }
+    for (size_t i = 0; i < frames; ++i)
+        pcm[i] = (int16_t)(rand() - RAND_MAX / 2);
+
+    mkdir(BENCH_DIR, 0755);
+    for (int i = 0; i < chunks; ++i) {
+        inputs[i] = (char*)malloc(64);
+        snprintf(inputs[i], 64, BENCH_DIR "/chunk_%d.wav", i);
+        if (wav_save(inputs[i], pcm, frames, BENCH_RATE, 1) < 0) {
+            fprintf(stderr, "fail to write %s\n", inputs[i]);
+            return -1;
+        }
+    }
+    free(pcm);
+
+    printf("%d chunks x %ds, %zu KB total, %d rounds\n",
+        chunks, seconds, chunks * frames * sizeof(int16_t) / 1024, rounds);
+
+    double start = now_ms();
+    for (int r = 0; r < rounds; ++r) {
+        if (wav_concat(inputs, chunks, BENCH_DIR "/native.wav") < 0) {
+            fprintf(stderr, "wav_concat fail\n");
+            return -1;
+        }
+    }
+    double native = (now_ms() - start) / rounds;
+    printf("native wav_concat: %8.3f ms\n", native);
+
+    start = now_ms();
+    int r = 0;
+    for (; r < rounds; ++r) {
+        if (run_sox(inputs, chunks, BENCH_DIR "/sox.wav") < 0)
+            break;
+    }
+    if (r == rounds) {
+        double sox = (now_ms() - start) / rounds;
+        printf("sox subprocess:    %8.3f ms (%.1fx)\n", sox, sox / native);
+    } else {
+        printf("sox subprocess:    unavailable\n");
+    }
+
+    for (int i = 0; i < chunks; ++i) {
+        unlink(inputs[i]);
+        free(inputs[i]);
+    }
+    free(inputs);
+    unlink(BENCH_DIR "/native.wav");
+    unlink(BENCH_DIR "/sox.wav");
+    rmdir(BENCH_DIR);
+
+    return 0;
+}
@@ -0,0 +1,630 @@
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "debug.h"
+#include "tts_split.h"
+
+#define TTS_SPLIT_FIRST_CLAUSE (4)  // 默认第一句在逗号处切分的说话长度
+#define TTS_SPLIT_CLAUSE (12)       // 默认之后的句子在逗号处切分的说话长度
+#define TTS_SPLIT_MAX_LENGTH (40)   // 默认强制切分的说话长度
+#define TTS_SPLIT_BUF_INIT (256)    // 文字缓冲区初始大小
+
+typedef struct tts_split_t {
+    tts_split_config_t cfg;  // 配置
+    pthread_mutex_t lock;    // 保护下面的成员
+    pthread_cond_t cond;     // 队列有句子或结束
+    char* buf;               // 还没切出的文字
+    size_t len;              // 文字字节数
+    size_t cap;              // 文字缓冲区大小
+    char** queue;            // 句子队列
+    size_t queue_cap;        // 队列长度
+    size_t head;             // 最早的句子的位置
+    size_t count;            // 队列中的句子数
+    char* current;           // 最近一次取出的句子
+    int finished;            // 文字已全部写入
+    uint64_t first_feed_us;  // 第一次写入的时间, 0 表示还没有写入
+    tts_split_stat_t stat;   // 统计
+} tts_split_t;
+
+static uint64_t tts_split_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief 解码一个 UTF-8 字符
+ *
+ * @param p 字符开始。
+ * @param len 剩余字节数。
+ * @param cp 输出码点, 非法字节输出 0xfffd。
+ * @return 字符字节数, 字符不完整返回 0。
+ */
+static size_t tts_split_decode(const uint8_t* p, size_t len, uint32_t* cp)
+{
+    size_t n = p[0] < 0x80 ? 1 : (p[0] & 0xe0) == 0xc0 ? 2 : (p[0] & 0xf0) == 0xe0 ? 3
+        : (p[0] & 0xf8) == 0xf0 ? 4 : 0;
+    if (!n) {
+        *cp = 0xfffd;
+        return 1;
+    }
+    if (n > len)
+        return 0;
+    uint32_t c = n == 1 ? p[0] : p[0] & (0x7f >> n);
+    for (size_t i = 1; i < n; ++i) {
+        if ((p[i] & 0xc0) != 0x80) {
+            *cp = 0xfffd;
+            return 1;
+        }
+        c = c << 6 | (p[i] & 0x3f);
+    }
+    *cp = c;
+    return n;
+}
+
+// 汉字、假名、谚文和全角字母数字, 每个字算一个说话长度
+static inline int tts_split_is_cjk(uint32_t c)
+{
+    return (c >= 0x3040 && c <= 0x30ff) || (c >= 0x3400 && c <= 0x4dbf) || (c >= 0x4e00 && c <= 0x9fff)
+        || (c >= 0xac00 && c <= 0xd7af) || (c >= 0xf900 && c <= 0xfaff)
+        || (c >= 0xff10 && c <= 0xff19) || (c >= 0xff21 && c <= 0xff3a) || (c >= 0xff41 && c <= 0xff5a);
+}
+
+// 组成单词的字符, 每个单词算一个说话长度
+static inline int tts_split_is_word(uint32_t c)
+{
+    return (c < 0x80 && ((c | 0x20) - 'a' < 26 || c - '0' < 10)) || (c >= 0xc0 && c <= 0x24f);
+}
+
+static inline int tts_split_is_digit(uint32_t c)
+{
+    return c - '0' < 10;
+}
+
+// 立即切分的句末标点
+static inline int tts_split_is_end(uint32_t c)
+{
+    return c == '\n' || c == 0x3002 || c == 0xff01 || c == 0xff1f || c == 0xff1b || c == 0x2026
+        || c == 0xff0e || c == 0xff61;
+}
+
+// 要看下一个字符才能确定的英文句末标点
+static inline int tts_split_is_ascii_end(uint32_t c)
+{
+    return c == '.' || c == '!' || c == '?' || c == ';';
+}
+
+// 分句标点
+static inline int tts_split_is_clause(uint32_t c)
+{
+    return c == ',' || c == ':' || c == 0xff0c || c == 0x3001 || c == 0xff1a;
+}
+
+// 句子开头不用读出的字符: 空白、上一句的右引号右括号和多余的标点
+static inline int tts_split_is_lead(uint32_t c)
+{
+    return c <= ' ' || c == ')' || c == ']' || c == '"' || c == '\'' || c == 0x201d || c == 0x2019
+        || c == 0x300d || c == 0x300f || c == 0xff09 || c == 0x300b || c == 0x3011 || c == 0x3000
+        || tts_split_is_end(c) || tts_split_is_ascii_end(c) || tts_split_is_clause(c);
+}
+
+/**
+ * @brief 判断英文句点是否在缩写、姓名首字母或行首编号中, 这些句点不切分
+ *
+ * @param p 文字。
+ * @param dot 句点位置。
+ * @param units 句点之前的说话长度(含句点前的单词)。
+ * @return 不切分返回 1。
+ */
+static int tts_split_is_abbr(const char* p, size_t dot, size_t units)
+{
+    static const char* abbrs[] = {
+        "Mr", "Mrs", "Ms", "Dr", "Prof", "Sr", "Jr", "St", "vs", "Inc", "Ltd", "Co", "No", "Fig",
+        "Vol", "Mt", "Gen", "Col", "Lt", "Sgt", "Rev", "Ave", "Jan", "Feb", "Mar", "Apr", "Jun",
+        "Jul", "Aug", "Sep", "Sept", "Oct", "Nov", "Dec",
+    };
+
+    size_t w = dot;
+    while (w > 0 && tts_split_is_word((uint8_t)p[w - 1]))
+        --w;
+    size_t n = dot - w;
+    if (!n)
+        return 0;
+    // 姓名首字母或 U.S. e.g. 这样的缩写
+    if (n == 1 && ((p[w] >= 'A' && p[w] <= 'Z') || (w > 0 && p[w - 1] == '.')))
+        return 1;
+    // 行首编号 "1. "
+    int digits = 1;
+    for (size_t i = w; i < dot; ++i)
+        digits &= tts_split_is_digit((uint8_t)p[i]);
+    if (digits)
+        return units == 1;
+    for (size_t i = 0; i < sizeof(abbrs) / sizeof(abbrs[0]); ++i) {
+        if (strlen(abbrs[i]) == n && 0 == memcmp(abbrs[i], p + w, n))
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 找出文字开头的第一句
+ *
+ * @param cfg 配置。
+ * @param p 文字。
+ * @param len 字节数。
+ * @param final 文字已全部写入, 结尾的文字也是一句。
+ * @param first 是否是第一句。
+ * @param units 输出这一句的说话长度。
+ * @return 这一句的字节数, 还没有结束的句子返回 0。
+ */
+static size_t tts_split_find(const tts_split_config_t* cfg, const char* p, size_t len, int final, int first,
+    size_t* units)
+{
+    const uint8_t* u = (const uint8_t*)p;
+    size_t clause = first ? cfg->first_clause : cfg->clause;
+    uint32_t prev = 0;
+    int in_word = 0;
+    *units = 0;
+
+    for (size_t i = 0; i < len;) {
+        uint32_t c = 0;
+        size_t n = tts_split_decode(u + i, len - i, &c);
+        if (!n)
+            return final ? len : 0;
+        size_t j = i + n;
+
+        if (tts_split_is_cjk(c)) {
+            *units += 1;
+            in_word = 0;
+        } else if (tts_split_is_word(c)) {
+            *units += !in_word;
+            in_word = 1;
+        } else {
+            in_word = 0;
+        }
+
+        if (tts_split_is_end(c))
+            return j;
+
+        uint32_t next = 0;
+        int need_next = tts_split_is_ascii_end(c) || ((c == ',' || c == ':') && *units >= clause);
+        if (need_next) {
+            if (j == len)
+                return final ? len : 0;
+            tts_split_decode(u + j, len - j, &next);
+        }
+
+        if (tts_split_is_ascii_end(c)) {
+            // 3.14, example.com, ?! 连续的标点切在最后一个
+            if (!tts_split_is_word(next) && !tts_split_is_ascii_end(next)
+                && !(c == '.' && tts_split_is_abbr(p, i, *units)))
+                return j;
+        } else if (tts_split_is_clause(c) && *units >= clause) {
+            // 1,000 和 3:30 中的标点不切分
+            if (c > 0x7f || !(tts_split_is_digit(prev) && tts_split_is_digit(next)))
+                return j;
+        } else if (*units >= cfg->max_length && (c == ' ' || tts_split_is_cjk(c))) {
+            return j;
+        }
+        prev = c;
+        i = j;
+    }
+    return final ? len : 0;
+}
+
+/**
+ * @brief 去掉句子首尾不用读出的字符
+ *
+ * @param p 句子。
+ * @param len 字节数, 输出去掉后的字节数。
+ * @return 去掉后的开头。
+ */
+static const char* tts_split_trim(const char* p, size_t* len)
+{
+    const uint8_t* u = (const uint8_t*)p;
+    size_t start = 0;
+    while (start < *len) {
+        uint32_t c = 0;
+        size_t n = tts_split_decode(u + start, *len - start, &c);
+        if (!n || !tts_split_is_lead(c))
+            break;
+        start += n;
+    }
+    size_t end = *len;
+    while (end > start && u[end - 1] <= ' ')
+        --end;
+    *len = end - start;
+    return p + start;
+}
+
+/**
+ * @brief 把缓冲区中已经结束的句子放入队列, 直到队列满, 调用者需持有 s->lock
+ */
+static void tts_split_cut_locked(tts_split_t* s)
+{
+    while (s->count < s->queue_cap && s->len) {
+        size_t units = 0;
+        size_t cut = tts_split_find(&s->cfg, s->buf, s->len, s->finished, s->stat.sentences == 0, &units);
+        if (!cut)
+            break;
+
+        size_t n = cut;
+        const char* text = tts_split_trim(s->buf, &n);
+        if (!units) {
+            s->stat.dropped++;
+        } else {
+            char* sentence = (char*)malloc(n + 1);
+            if (!sentence) {
+                LOG_ERR("fail to malloc sentence(%zu)", n);
+                break;
+            }
+            memcpy(sentence, text, n);
+            sentence[n] = '\0';
+            s->queue[(s->head + s->count) % s->queue_cap] = sentence;
+            s->count++;
+            if (!s->stat.sentences++)
+                s->stat.first_us = tts_split_now_us() - s->first_feed_us;
+            pthread_cond_broadcast(&s->cond);
+        }
+        memmove(s->buf, s->buf + cut, s->len - cut);
+        s->len -= cut;
+    }
+    if (s->finished && !s->count)
+        pthread_cond_broadcast(&s->cond);
+}
+
+/**
+ * 获取默认配置。
+ *
+ * @param cfg 输出配置。
+ */
+void tts_split_config_default(tts_split_config_t* cfg)
+{
+    assert(cfg && "arg failed!");
+    cfg->first_clause = TTS_SPLIT_FIRST_CLAUSE;
+    cfg->clause = TTS_SPLIT_CLAUSE;
+    cfg->max_length = TTS_SPLIT_MAX_LENGTH;
+}
+
+/**
+ * 写入增量文字, 切出已经结束的句子放入队列, 不会阻塞。
+ * 增量可以在 UTF-8 字符中间断开, 不完整的字符留到下一次写入。
+ *
+ * @param s 指向分句器的指针。
+ * @param text UTF-8 文字。
+ * @param len 字节数。
+ * @return 成功返回 0，失败(内存不足或已结束)返回 -1。
+ */
+int tts_split_feed(tts_split_t* s, const char* text, size_t len)
+{
+    if (!s || (!text && len))
+        return -1;
+
+    int ret = 0;
+    pthread_mutex_lock(&s->lock);
+    if (s->finished) {
+        ret = -1;
+        goto out;
+    }
+    if (!s->first_feed_us)
+        s->first_feed_us = tts_split_now_us();
+    if (s->len + len > s->cap) {
+        size_t cap = s->cap * 2 > s->len + len ? s->cap * 2 : s->len + len;
+        char* buf = (char*)realloc(s->buf, cap);
+        if (!buf) {
+            LOG_ERR("fail to realloc split buffer(%zu)", cap);
+            ret = -1;
+            goto out;
+        }
+        s->buf = buf;
+        s->cap = cap;
+    }
+    memcpy(s->buf + s->len, text, len);
+    s->len += len;
+    tts_split_cut_locked(s);
+out:
+    pthread_mutex_unlock(&s->lock);
+    return ret;
+}
+
+/**
+ * 文字已全部写入, 剩余的文字作为最后一句。
+ *
+ * @param s 指向分句器的指针。
+ */
+void tts_split_finish(tts_split_t* s)
+{
+    if (!s)
+        return;
+    pthread_mutex_lock(&s->lock);
+    s->finished = 1;
+    tts_split_cut_locked(s);
+    pthread_mutex_unlock(&s->lock);
+}
+
+/**
+ * 取消: 丢弃还没取出的文字和句子, 等待中的 tts_split_pop 返回 0。
+ *
+ * @param s 指向分句器的指针。
+ */
+void tts_split_cancel(tts_split_t* s)
+{
+    if (!s)
+        return;
+    pthread_mutex_lock(&s->lock);
+    for (; s->count; s->count--, s->head = (s->head + 1) % s->queue_cap)
+        free(s->queue[s->head]);
+    s->len = 0;
+    s->finished = 1;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+}
+
+/**
+ * 取出下一句, 队列为空时等待。
+ *
+ * @param s 指向分句器的指针。
+ * @param sentence 输出句子, 以 '\0' 结尾, 首尾不含空白, 下一次取出或释放前有效。
+ * @param timeout_ms 超时时间, 负数一直等待。
+ * @return 取到返回 1, 已结束且没有剩余句子返回 0, 超时返回 -1。
+ */
+int tts_split_pop(tts_split_t* s, const char** sentence, int timeout_ms)
+{
+    if (!s || !sentence)
+        return 0;
+
+    struct timespec deadline;
+    if (timeout_ms >= 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    int ret = 0;
+    pthread_mutex_lock(&s->lock);
+    while (!s->count && !(s->finished && !s->len)) {
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&s->cond, &s->lock);
+        } else if (ETIMEDOUT == pthread_cond_timedwait(&s->cond, &s->lock, &deadline)) {
+            break;
+        }
+    }
+    if (s->count) {
+        free(s->current);
+        s->current = s->queue[s->head];
+        s->head = (s->head + 1) % s->queue_cap;
+        s->count--;
+        *sentence = s->current;
+        ret = 1;
+        // 队列满时留在缓冲区的句子补进队列
+        tts_split_cut_locked(s);
+    } else if (!s->finished || s->len) {
+        ret = -1;
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    return ret;
+}
+
+/**
+ * 获取统计。
+ *
+ * @param s 指向分句器的指针。
+ * @param stat 输出统计。
+ */
+void tts_split_get_stat(tts_split_t* s, tts_split_stat_t* stat)
+{
+    if (!s || !stat)
+        return;
+    pthread_mutex_lock(&s->lock);
+    *stat = s->stat;
+    pthread_mutex_unlock(&s->lock);
+}
+
+/**
+ * 释放分句器, 调用者保证没有线程在等待。
+ *
+ * @param s 指向分句器的指针。
+ */
+void tts_split_exit(tts_split_t* s)
+{
+    if (!s)
+        return;
+    if (s->queue) {
+        for (; s->count; s->count--, s->head = (s->head + 1) % s->queue_cap)
+            free(s->queue[s->head]);
+    }
+    pthread_cond_destroy(&s->cond);
+    pthread_mutex_destroy(&s->lock);
+    free(s->current);
+    free(s->queue);
+    free(s->buf);
+    free(s);
+}
+
+/**
+ * 创建分句器。
+ *
+ * @param cfg 配置, 为 NULL 时使用默认配置。
+ * @param queue 队列长度, 0 使用默认值。
+ * @return 成功返回分句器指针，失败返回 NULL。
+ */
+tts_split_t* tts_split_init(const tts_split_config_t* cfg, size_t queue)
+{
+    tts_split_t* s = (tts_split_t*)malloc(sizeof(tts_split_t));
+    if (!s) {
+        LOG_ERR("fail to malloc split");
+        return NULL;
+    }
+    memset(s, 0, sizeof(tts_split_t));
+    if (cfg)
+        s->cfg = *cfg;
+    else
+        tts_split_config_default(&s->cfg);
+    s->stat.first_us = -1;
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&s->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&s->lock, NULL);
+
+    s->queue_cap = queue ? queue : TTS_SPLIT_QUEUE;
+    s->queue = (char**)malloc(s->queue_cap * sizeof(char*));
+    s->cap = TTS_SPLIT_BUF_INIT;
+    s->buf = (char*)malloc(s->cap);
+    if (!s->queue || !s->buf) {
+        LOG_ERR("fail to malloc split buffer");
+        tts_split_exit(s);
+        return NULL;
+    }
+    return s;
+}
+
+#ifdef __XTEST__
+
+#include <unistd.h>
+
+char g_dbg_enable = 1;
+
+/**
+ * 按 step 字节一次写入, 检查切出的句子
+ */
+static void test_split(const char* text, size_t step, const char** expect, size_t count)
+{
+    tts_split_t* s = tts_split_init(NULL, 64);
+    assert(s);
+    size_t len = strlen(text);
+    for (size_t i = 0; i < len; i += step)
+        assert(0 == tts_split_feed(s, text + i, len - i < step ? len - i : step));
+    tts_split_finish(s);
+
+    const char* sentence = NULL;
+    for (size_t i = 0; i < count; ++i) {
+        assert(1 == tts_split_pop(s, &sentence, 0));
+        if (strcmp(sentence, expect[i])) {
+            printf("expect [%s] got [%s]\n", expect[i], sentence);
+            assert(0);
+        }
+    }
+    assert(0 == tts_split_pop(s, &sentence, 0));
+    tts_split_exit(s);
+}
+
+#define TEST_SPLIT(text, ...) do { \
+        const char* expect[] = { __VA_ARGS__ }; \
+        for (size_t step = 1; step <= strlen(text); step = step * 2 + 1) \
+            test_split(text, step, expect, sizeof(expect) / sizeof(expect[0])); \
+    } while (0)
+
+typedef struct test_producer_t {
+    tts_split_t* s;
+    const char* text;
+} test_producer_t;
+
+static void* test_producer(void* arg)
+{
+    test_producer_t* p = (test_producer_t*)arg;
+    for (const char* c = p->text; *c; c += 3) {
+        tts_split_feed(p->s, c, strlen(c) < 3 ? strlen(c) : 3);
+        usleep(1000);
+    }
+    tts_split_finish(p->s);
+    return NULL;
+}
+
+int main(void)
+{
+    // 中文句末标点立即切分, 右引号等留在下一句开头的去掉
+    TEST_SPLIT("你好。今天天气不错！我们去公园吧",
+        "你好。", "今天天气不错！", "我们去公园吧");
+    TEST_SPLIT("他说：“走吧。”然后就走了……",
+        "他说：“走吧。", "然后就走了…");
+    // 第一句说话长度够了就在逗号处切分, 之后的句子阈值更大
+    TEST_SPLIT("好的，我来帮你查一下今天的天气，稍等，马上就好。",
+        "好的，我来帮你查一下今天的天气，", "稍等，马上就好。");
+    // 英文缩写、小数、网址、编号
+    TEST_SPLIT("Mr. Smith paid 3.50 dollars. Then he left! Did he?! Yes.",
+        "Mr. Smith paid 3.50 dollars.", "Then he left!", "Did he?!", "Yes.");
+    TEST_SPLIT("Visit example.com, e.g. today. 1. First item\n2. Second",
+        "Visit example.com, e.g. today.", "1. First item", "2. Second");
+    TEST_SPLIT("J. K. Rowling wrote it in 1,997: then 3:30 came, and it was done, finally done.",
+        "J. K. Rowling wrote it in 1,997:", "then 3:30 came, and it was done, finally done.");
+    // 只有标点的片段丢弃, 中英混合
+    TEST_SPLIT("。。。OK. 这是 GPT 的回答。",
+        "OK.", "这是 GPT 的回答。");
+    // 没有标点的长句按说话长度强制切分
+    TEST_SPLIT("one two three four five six seven eight nine ten one two three four five six seven eight "
+               "nine ten one two three four five six seven eight nine ten one two three four five six seven "
+               "eight nine ten end",
+        "one two three four five six seven eight nine ten one two three four five six seven eight "
+        "nine ten one two three four five six seven eight nine ten one two three four five six seven "
+        "eight nine ten", "end");
+
+    // 英文句点要看到下一个字符, 流暂停时不切分
+    tts_split_t* s = tts_split_init(NULL, 2);
+    const char* sentence = NULL;
+    assert(0 == tts_split_feed(s, "It is 3.", 8));
+    assert(-1 == tts_split_pop(s, &sentence, 10));
+    assert(0 == tts_split_feed(s, "14 now. A. B. C. D. E.", 22));
+    // 队列满时句子留在缓冲区, 取出一句后补进队列
+    tts_split_finish(s);
+    assert(-1 == tts_split_feed(s, "x", 1));
+    assert(1 == tts_split_pop(s, &sentence, 0) && !strcmp(sentence, "It is 3.14 now."));
+    assert(1 == tts_split_pop(s, &sentence, 0) && !strcmp(sentence, "A. B. C. D. E."));
+    assert(0 == tts_split_pop(s, &sentence, 0));
+    tts_split_stat_t stat;
+    tts_split_get_stat(s, &stat);
+    assert(stat.sentences == 2 && stat.first_us >= 0);
+    tts_split_exit(s);
+
+    s = tts_split_init(NULL, 2);
+    for (int i = 0; i < 5; ++i)
+        assert(0 == tts_split_feed(s, "第一句。", strlen("第一句。")));
+    tts_split_finish(s);
+    for (int i = 0; i < 5; ++i)
+        assert(1 == tts_split_pop(s, &sentence, 0) && !strcmp(sentence, "第一句。"));
+    assert(0 == tts_split_pop(s, &sentence, 0));
+    tts_split_exit(s);
+
+    // 生成与取出在不同线程, 取出的顺序与生成一致
+    const char* text = "第一句话。第二句话！Third sentence here. 第四句，比较长一点的分句，还有结尾。";
+    const char* expect[] = { "第一句话。", "第二句话！", "Third sentence here.", "第四句，比较长一点的分句，还有结尾。" };
+    s = tts_split_init(NULL, 2);
+    test_producer_t p = { s, text };
+    pthread_t th;
+    pthread_create(&th, NULL, test_producer, &p);
+    size_t n = 0;
+    while (1 == tts_split_pop(s, &sentence, -1)) {
+        assert(n < 4 && !strcmp(sentence, expect[n]));
+        n++;
+    }
+    pthread_join(th, NULL);
+    assert(n == 4);
+    tts_split_get_stat(s, &stat);
+    printf("first sentence after %lld us\n", (long long)stat.first_us);
+    tts_split_exit(s);
+
+    // 取消时等待的线程返回 0
+    s = tts_split_init(NULL, 0);
+    assert(0 == tts_split_feed(s, "还没说完", strlen("还没说完")));
+    tts_split_cancel(s);
+    assert(0 == tts_split_pop(s, &sentence, -1));
+    tts_split_exit(s);
+
+    printf("tts split test pass\n");
+    return 0;
+}
+
+#endif //__XTEST__
@@ -0,0 +1,116 @@
+#ifndef __TTS_SPLIT_H__
+#define __TTS_SPLIT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// 功能: 流式分句. 大模型边生成边把 UTF-8 增量文字写入, 句子或分句一结束就放入队列,
+// TTS 线程从队列取出合成, 第 N 句的合成与第 N+1 句的生成同时进行, 不用等整段回答生成完.
+// 句末标点: 中文 。！？；… 以及换行立即切分; 英文 . ! ? ; 要看到下一个字符才能确定,
+// 小数、缩写(Mr. e.g. 单个大写字母)、网址和行首编号(1. )中的点不切分.
+// 说话长度超过阈值后逗号、顿号、冒号也切分, 第一句的阈值更小, 尽快开始出声.
+// 写入不会阻塞, 队列满时完整的句子留在缓冲区, 取出一句后再补进队列.
+//
+// example:
+//   tts_split_t* s = tts_split_init(NULL, 0);
+//   // 生成线程
+//   tts_split_feed(s, delta, strlen(delta));
+//   tts_split_finish(s);
+//   // TTS 线程
+//   const char* sentence = NULL;
+//   while (tts_split_pop(s, &sentence, -1) > 0)
+//       speak(sentence);
+//   tts_split_exit(s);
+
+#define TTS_SPLIT_QUEUE (4)   // 默认队列长度
+
+typedef struct tts_split_config_t {
+    size_t first_clause;  // 第一句说话长度达到此值后在逗号处切分, 说话长度按汉字和英文单词计
+    size_t clause;        // 之后的句子说话长度达到此值后在逗号处切分
+    size_t max_length;    // 说话长度超过此值时在下一个空格或汉字处强制切分
+} tts_split_config_t;
+
+typedef struct tts_split_stat_t {
+    size_t sentences;     // 已放入队列的句子数
+    size_t dropped;       // 只有标点没有可读内容被丢弃的片段数
+    int64_t first_us;     // 第一次写入到第一句放入队列的时间, 还没有句子为 -1
+} tts_split_stat_t;
+
+struct tts_split_t;
+
+/**
+ * 获取默认配置。
+ *
+ * @param cfg 输出配置。
+ */
+void tts_split_config_default(tts_split_config_t* cfg);
+
+/**
+ * 创建分句器。
+ *
+ * @param cfg 配置, 为 NULL 时使用默认配置。
+ * @param queue 队列长度, 0 使用默认值。
+ * @return 成功返回分句器指针，失败返回 NULL。
+ */
+tts_split_t* tts_split_init(const tts_split_config_t* cfg, size_t queue);
+
+/**
+ * 释放分句器, 调用者保证没有线程在等待。
+ *
+ * @param s 指向分句器的指针。
+ */
+void tts_split_exit(tts_split_t* s);
+
+/**
+ * 写入增量文字, 切出已经结束的句子放入队列, 不会阻塞。
+ * 增量可以在 UTF-8 字符中间断开, 不完整的字符留到下一次写入。
+ *
+ * @param s 指向分句器的指针。
+ * @param text UTF-8 文字。
+ * @param len 字节数。
+ * @return 成功返回 0，失败(内存不足或已结束)返回 -1。
+ */
+int tts_split_feed(tts_split_t* s, const char* text, size_t len);
+
+/**
+ * 文字已全部写入, 剩余的文字作为最后一句。
+ *
+ * @param s 指向分句器的指针。
+ */
+void tts_split_finish(tts_split_t* s);
+
+/**
+ * 取消: 丢弃还没取出的文字和句子, 等待中的 tts_split_pop 返回 0。
+ *
+ * @param s 指向分句器的指针。
+ */
+void tts_split_cancel(tts_split_t* s);
+
+/**
+ * 取出下一句, 队列为空时等待。
+ *
+ * @param s 指向分句器的指针。
+ * @param sentence 输出句子, 以 '\0' 结尾, 首尾不含空白, 下一次取出或释放前有效。
+ * @param timeout_ms 超时时间, 负数一直等待。
+ * @return 取到返回 1, 已结束且没有剩余句子返回 0, 超时返回 -1。
+ */
+int tts_split_pop(tts_split_t* s, const char** sentence, int timeout_ms);
+
+/**
+ * 获取统计。
+ *
+ * @param s 指向分句器的指针。
+ * @param stat 输出统计。
+ */
+void tts_split_get_stat(tts_split_t* s, tts_split_stat_t* stat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__TTS_SPLIT_H__
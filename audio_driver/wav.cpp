@@ -0,0 +1,447 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "wav.h"
+
+#define WAV_CHUNK_HEADER_SIZE (8)
+#define WAV_FMT_MIN_SIZE (16)
+
+/**
+ * @brief 读取小端整数
+ */
+static inline uint32_t wav_le32(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint16_t wav_le16(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+/**
+ * @brief 写入小端整数
+ */
+static inline void wav_put_le32(uint8_t* p, uint32_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = v >> 24;
+}
+
+static inline void wav_put_le16(uint8_t* p, uint16_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+/**
+ * @brief 写满指定长度
+ *
+ * @return 成功返回 0，失败返回 -1
+ */
+static int wav_write_full(int fd, const void* buf, size_t len)
+{
+    const uint8_t* p = (const uint8_t*)buf;
+    while (len) {
+        ssize_t ret = write(fd, p, len);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return -1;
+        p += ret;
+        len -= ret;
+    }
+    return 0;
+}
+
+/**
+ * 解析 WAV 文件头, 找到 PCM 数据位置。
+ * 兼容 arecord 等流式写入时 data 大小未回填的文件, 此时按文件实际大小计算。
+ *
+ * @param fd WAV 文件描述符, 调用后文件偏移不确定。
+ * @param info 输出文件信息。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int wav_read_info(int fd, wav_info_t* info)
+{
+    assert(info && "arg failed!");
+    memset(info, 0, sizeof(*info));
+
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+        return -1;
+    uint64_t file_size = st.st_size;
+
+    uint8_t riff[12];
+    if (pread(fd, riff, sizeof(riff), 0) != sizeof(riff)
+        || memcmp(riff, "RIFF", 4) || memcmp(riff + 8, "WAVE", 4)) {
+        LOG_ERR("not a wav file");
+        return -1;
+    }
+
+    int has_fmt = 0;
+    uint64_t offset = sizeof(riff);
+    while (offset + WAV_CHUNK_HEADER_SIZE <= file_size) {
+        uint8_t chunk[WAV_CHUNK_HEADER_SIZE];
+        if (pread(fd, chunk, sizeof(chunk), offset) != sizeof(chunk))
+            return -1;
+        uint64_t size = wav_le32(chunk + 4);
+        offset += WAV_CHUNK_HEADER_SIZE;
+
+        if (0 == memcmp(chunk, "fmt ", 4)) {
+            uint8_t fmt[WAV_FMT_MIN_SIZE];
+            if (size < WAV_FMT_MIN_SIZE || pread(fd, fmt, sizeof(fmt), offset) != sizeof(fmt)) {
+                LOG_ERR("bad wav fmt chunk");
+                return -1;
+            }
+            info->format = wav_le16(fmt);
+            info->channels = wav_le16(fmt + 2);
+            info->rate = wav_le32(fmt + 4);
+            info->block_align = wav_le16(fmt + 12);
+            info->bits = wav_le16(fmt + 14);
+            has_fmt = 1;
+        } else if (0 == memcmp(chunk, "data", 4)) {
+            if (!has_fmt) {
+                LOG_ERR("wav data before fmt");
+                return -1;
+            }
+            info->data_offset = offset;
+            // 流式录音可能没有回填大小(0 或 0xffffffff), 以实际文件大小为准
+            if (!size || offset + size > file_size)
+                size = file_size - offset;
+            info->data_size = size - size % (info->block_align ? info->block_align : 1);
+            break;
+        }
+        offset += size + (size & 1); // chunk 按 2 字节对齐
+    }
+
+    if (!info->data_offset) {
+        LOG_ERR("wav data chunk not found");
+        return -1;
+    }
+    if (info->format != WAV_FORMAT_PCM || !info->channels || !info->rate
+        || !info->bits || info->block_align != info->channels * info->bits / 8) {
+        LOG_ERR("unsupport wav format(%u) channels(%u) rate(%u) bits(%u)",
+            info->format, info->channels, info->rate, info->bits);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * 在文件当前位置写入 44 字节标准 WAV 文件头。
+ *
+ * @param fd WAV 文件描述符。
+ * @param info 文件信息, 使用其中的 channels/rate/bits/data_size。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int wav_write_header(int fd, const wav_info_t* info)
+{
+    assert(info && "arg failed!");
+
+    uint16_t block_align = info->channels * info->bits / 8;
+    uint32_t data_size = info->data_size > UINT32_MAX - WAV_HEADER_SIZE ?
+        UINT32_MAX - WAV_HEADER_SIZE : info->data_size;
+
+    uint8_t hdr[WAV_HEADER_SIZE];
+    memcpy(hdr, "RIFF", 4);
+    wav_put_le32(hdr + 4, WAV_HEADER_SIZE - 8 + data_size);
+    memcpy(hdr + 8, "WAVEfmt ", 8);
+    wav_put_le32(hdr + 16, WAV_FMT_MIN_SIZE);
+    wav_put_le16(hdr + 20, WAV_FORMAT_PCM);
+    wav_put_le16(hdr + 22, info->channels);
+    wav_put_le32(hdr + 24, info->rate);
+    wav_put_le32(hdr + 28, info->rate * block_align);
+    wav_put_le16(hdr + 32, block_align);
+    wav_put_le16(hdr + 34, info->bits);
+    memcpy(hdr + 36, "data", 4);
+    wav_put_le32(hdr + 40, data_size);
+
+    return wav_write_full(fd, hdr, sizeof(hdr));
+}
+
+/**
+ * 把 16 位 PCM 数据保存为 WAV 文件。
+ *
+ * @param path 输出文件路径。
+ * @param pcm PCM 数据, 多声道交错存放。
+ * @param frames 帧数。
+ * @param rate 采样率。
+ * @param channels 声道数。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int wav_save(const char* path, const int16_t* pcm, size_t frames, unsigned rate, unsigned channels)
+{
+    assert(path && (pcm || !frames) && "arg failed!");
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOG_ERR("fail to open %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    wav_info_t info;
+    memset(&info, 0, sizeof(info));
+    info.channels = channels;
+    info.rate = rate;
+    info.bits = 16;
+    info.data_size = frames * channels * sizeof(int16_t);
+
+    int ret = wav_write_header(fd, &info);
+    if (!ret)
+        ret = wav_write_full(fd, pcm, info.data_size);
+    if (close(fd) < 0)
+        ret = -1;
+    if (ret < 0)
+        LOG_ERR("fail to write %s", path);
+
+    return ret;
+}
+
+/**
+ * 读取 16 位 PCM WAV 文件全部数据。
+ *
+ * @param path 文件路径。
+ * @param pcm 输出 PCM 数据, 使用完需 free。
+ * @param frames 输出帧数。
+ * @param info 输出文件信息, 可为 NULL。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int wav_load(const char* path, int16_t** pcm, size_t* frames, wav_info_t* info)
+{
+    assert(path && pcm && frames && "arg failed!");
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_ERR("fail to open %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    wav_info_t wi;
+    if (wav_read_info(fd, &wi) < 0 || wi.bits != 16) {
+        LOG_ERR("%s is not 16 bit pcm wav", path);
+        close(fd);
+        return -1;
+    }
+
+    int16_t* data = (int16_t*)malloc(wi.data_size ? wi.data_size : 1);
+    if (!data) {
+        close(fd);
+        return -1;
+    }
+    size_t done = 0;
+    while (done < wi.data_size) {
+        ssize_t ret = pread(fd, (uint8_t*)data + done, wi.data_size - done, wi.data_offset + done);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            break;
+        done += ret;
+    }
+    close(fd);
+    if (done != wi.data_size) {
+        LOG_ERR("fail to read %s", path);
+        free(data);
+        return -1;
+    }
+
+    *pcm = data;
+    *frames = wi.data_size / wi.block_align;
+    if (info)
+        *info = wi;
+    return 0;
+}
+
+/**
+ * @brief 在两个文件之间拷贝数据, 尽量不经过用户态
+ *
+ * @param in_fd 输入文件
+ * @param in_off 输入偏移
+ * @param out_fd 输出文件, 从当前偏移写入
+ * @param len 拷贝长度
+ * @return 成功返回 0，失败返回 -1
+ */
+static int wav_copy_range(int in_fd, uint64_t in_off, int out_fd, uint64_t len)
+{
+    static int no_copy_file_range = 0;
+    static int no_sendfile = 0;
+
+    while (len && !no_copy_file_range) {
+        loff_t off = in_off;
+        ssize_t ret = copy_file_range(in_fd, &off, out_fd, NULL, len, 0);
+        if (ret > 0) {
+            in_off += ret;
+            len -= ret;
+            continue;
+        }
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret < 0 && errno != ENOSYS && errno != EXDEV && errno != EINVAL
+            && errno != EOPNOTSUPP && errno != EBADF)
+            return -1;
+        // 内核或文件系统不支持, 以后都不再尝试
+        if (ret < 0 && errno == ENOSYS)
+            no_copy_file_range = 1;
+        break;
+    }
+
+    while (len && !no_sendfile) {
+        off_t off = in_off;
+        ssize_t ret = sendfile(out_fd, in_fd, &off, len);
+        if (ret > 0) {
+            in_off += ret;
+            len -= ret;
+            continue;
+        }
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret < 0 && errno != ENOSYS && errno != EINVAL)
+            return -1;
+        if (ret < 0 && errno == ENOSYS)
+            no_sendfile = 1;
+        break;
+    }
+
+    uint8_t buf[64 * 1024];
+    while (len) {
+        ssize_t ret = pread(in_fd, buf, len < sizeof(buf) ? len : sizeof(buf), in_off);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0 || wav_write_full(out_fd, buf, ret) < 0)
+            return -1;
+        in_off += ret;
+        len -= ret;
+    }
+
+    return 0;
+}
+
+/**
+ * 拼接多个 WAV 文件, 只拷贝 PCM 数据并写入一个修正后的文件头, 不重新编解码。
+ * 所有输入的声道数/采样率/位数必须一致。
+ * 数据拷贝优先使用 copy_file_range, 不支持时退回 sendfile, 再退回 read/write。
+ *
+ * @param inputs 输入文件路径数组。
+ * @param count 输入文件个数。
+ * @param output 输出文件路径。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int wav_concat(const char* const* inputs, size_t count, const char* output)
+{
+    if (!inputs || !count || !output)
+        return -1;
+
+    int ret = -1;
+    int out_fd = -1;
+    wav_info_t total;
+    int* fds = (int*)malloc(count * sizeof(int));
+    wav_info_t* infos = (wav_info_t*)malloc(count * sizeof(wav_info_t));
+    if (!fds || !infos) {
+        LOG_ERR("fail to malloc concat info");
+        goto out;
+    }
+    for (size_t i = 0; i < count; ++i)
+        fds[i] = -1;
+
+    for (size_t i = 0; i < count; ++i) {
+        fds[i] = open(inputs[i], O_RDONLY | O_CLOEXEC);
+        if (fds[i] < 0 || wav_read_info(fds[i], &infos[i]) < 0) {
+            LOG_ERR("bad wav input: %s", inputs[i]);
+            goto out;
+        }
+        if (i && (infos[i].channels != infos[0].channels || infos[i].rate != infos[0].rate
+                || infos[i].bits != infos[0].bits)) {
+            LOG_ERR("wav format mismatch: %s (%u, %u, %u) != (%u, %u, %u)", inputs[i],
+                infos[i].channels, infos[i].rate, infos[i].bits,
+                infos[0].channels, infos[0].rate, infos[0].bits);
+            goto out;
+        }
+    }
+
+    total = infos[0];
+    total.data_size = 0;
+    for (size_t i = 0; i < count; ++i)
+        total.data_size += infos[i].data_size;
+
+    out_fd = open(output, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out_fd < 0) {
+        LOG_ERR("fail to open %s: %s", output, strerror(errno));
+        goto out;
+    }
+    if (wav_write_header(out_fd, &total) < 0)
+        goto out;
+    for (size_t i = 0; i < count; ++i) {
+        if (wav_copy_range(fds[i], infos[i].data_offset, out_fd, infos[i].data_size) < 0) {
+            LOG_ERR("fail to copy %s: %s", inputs[i], strerror(errno));
+            goto out;
+        }
+    }
+    ret = 0;
+
+out:
+    if (out_fd >= 0 && close(out_fd) < 0)
+        ret = -1;
+    if (ret < 0 && out_fd >= 0)
+        unlink(output);
+    for (size_t i = 0; fds && i < count; ++i) {
+        if (fds[i] >= 0)
+            close(fds[i]);
+    }
+    free(fds);
+    free(infos);
+
+    return ret;
+}
+
+#ifdef __WAV_XTEST__
+
+char g_dbg_enable = 1;
+
+int main(void)
+{
+    int16_t a[300], b[500];
+    for (int i = 0; i < 300; ++i)
+        a[i] = i;
+    for (int i = 0; i < 500; ++i)
+        b[i] = -i;
+    assert(0 == wav_save("/tmp/wav_test_a.wav", a, 300, 16000, 1));
+    assert(0 == wav_save("/tmp/wav_test_b.wav", b, 500, 16000, 1));
+    assert(0 == wav_save("/tmp/wav_test_c.wav", b, 500, 8000, 1));
+
+    const char* inputs[] = { "/tmp/wav_test_a.wav", "/tmp/wav_test_b.wav", "/tmp/wav_test_a.wav" };
+    assert(0 == wav_concat(inputs, 3, "/tmp/wav_test_out.wav"));
+
+    int16_t* pcm = NULL;
+    size_t frames = 0;
+    wav_info_t info;
+    assert(0 == wav_load("/tmp/wav_test_out.wav", &pcm, &frames, &info));
+    assert(frames == 1100 && info.rate == 16000 && info.channels == 1);
+    assert(0 == memcmp(pcm, a, sizeof(a)));
+    assert(0 == memcmp(pcm + 300, b, sizeof(b)));
+    assert(0 == memcmp(pcm + 800, a, sizeof(a)));
+    free(pcm);
+
+    const char* mismatch[] = { "/tmp/wav_test_a.wav", "/tmp/wav_test_c.wav" };
+    assert(wav_concat(mismatch, 2, "/tmp/wav_test_out.wav") < 0);
+
+    unlink("/tmp/wav_test_a.wav");
+    unlink("/tmp/wav_test_b.wav");
+    unlink("/tmp/wav_test_c.wav");
+    unlink("/tmp/wav_test_out.wav");
+
+    printf("wav test pass\n");
+    return 0;
+}
+
+#endif //__WAV_XTEST__
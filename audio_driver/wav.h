@@ -0,0 +1,84 @@
+#ifndef __WAV_H__
+#define __WAV_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 功能: WAV(RIFF) 文件头解析与写入, 只支持 PCM 格式.
+
+#define WAV_FORMAT_PCM (1)        // PCM 格式
+#define WAV_HEADER_SIZE (44)      // 标准文件头大小
+
+typedef struct wav_info_t {
+    uint16_t format;       // 音频格式, 只支持 WAV_FORMAT_PCM
+    uint16_t channels;     // 声道数
+    uint32_t rate;         // 采样率
+    uint16_t bits;         // 采样位数
+    uint16_t block_align;  // 每帧字节数
+    uint64_t data_offset;  // PCM 数据在文件中的偏移
+    uint64_t data_size;    // PCM 数据字节数
+} wav_info_t;
+
+/**
+ * 解析 WAV 文件头, 找到 PCM 数据位置。
+ * 兼容 arecord 等流式写入时 data 大小未回填的文件, 此时按文件实际大小计算。
+ *
+ * @param fd WAV 文件描述符, 调用后文件偏移不确定。
+ * @param info 输出文件信息。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int wav_read_info(int fd, wav_info_t* info);
+
+/**
+ * 在文件当前位置写入 44 字节标准 WAV 文件头。
+ *
+ * @param fd WAV 文件描述符。
+ * @param info 文件信息, 使用其中的 channels/rate/bits/data_size。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int wav_write_header(int fd, const wav_info_t* info);
+
+/**
+ * 把 16 位 PCM 数据保存为 WAV 文件。
+ *
+ * @param path 输出文件路径。
+ * @param pcm PCM 数据, 多声道交错存放。
+ * @param frames 帧数。
+ * @param rate 采样率。
+ * @param channels 声道数。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int wav_save(const char* path, const int16_t* pcm, size_t frames, unsigned rate, unsigned channels);
+
+/**
+ * 读取 16 位 PCM WAV 文件全部数据。
+ *
+ * @param path 文件路径。
+ * @param pcm 输出 PCM 数据, 使用完需 free。
+ * @param frames 输出帧数。
+ * @param info 输出文件信息, 可为 NULL。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int wav_load(const char* path, int16_t** pcm, size_t* frames, wav_info_t* info);
+
+/**
+ * 拼接多个 WAV 文件, 只拷贝 PCM 数据并写入一个修正后的文件头, 不重新编解码。
+ * 所有输入的声道数/采样率/位数必须一致。
+ * 数据拷贝优先使用 copy_file_range, 不支持时退回 sendfile, 再退回 read/write。
+ *
+ * @param inputs 输入文件路径数组。
+ * @param count 输入文件个数。
+ * @param output 输出文件路径。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int wav_concat(const char* const* inputs, size_t count, const char* output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__WAV_H__
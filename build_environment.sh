@@ -1,6 +1,13 @@
 #!/bin/bash
 
-sudo apt-get install -y python3 python3-pip sox make
+sudo apt-get install -y python3 python3-pip sox make pkg-config libasound2-dev
+
+# 没有 ALSA 开发包时 audio.so 只支持 wav:/null 设备, 不能录音和播放
+pkg-config --exists alsa
+if [[ ! $? -eq 0 ]]; then
+    echo "libasound2-dev not found, audio driver can not be built with ALSA. "
+    exit 1
+fi
 
 which mplayer > /dev/null
 if [[ ! $? -eq 0 ]]; then
@@ -27,6 +34,8 @@ edge-tts' > /tmp/requirements.txt
 pip3 install -r /tmp/requirements.txt
 
 cd display_driver && make && cd -
+cd audio_driver && make && cd -
+cd button_driver && make && cd -
 
 if [[ ! -z "$OPENAI_API_KEY" ]]; then
     echo "export OPENAI_API_KEY=your-openai-key"
@@ -1,5 +1,11 @@
-import evdev
 import time
+from ctypes import cdll, c_char_p, c_int, c_int32, c_uint16, c_uint64, c_void_p, CFUNCTYPE, POINTER, Structure
+from typing import Any
+
+try:
+    import evdev
+except ImportError:
+    evdev = None
 
 log_dbg = print
 
@@ -9,21 +15,161 @@ class ButtonType:
     KEY_B = "KEY_B"
     KEY_A = "KEY_A"
 
+# linux/input-event-codes.h
+KEY_CODES = {
+    ButtonType.KEY_RIGHT: 106,
+    ButtonType.KEY_LEFT: 105,
+    ButtonType.KEY_B: 48,
+    ButtonType.KEY_A: 30,
+}
+KEY_NAMES = {code: name for name, code in KEY_CODES.items()}
+
+
+class ButtonEvent(Structure):
+    """
+    按键事件, 对应 button_event_t。
+    """
+
+    _fields_ = [
+        ("code", c_uint16),
+        ("value", c_int32),
+        ("time_us", c_uint64),
+        ("source", c_int),
+    ]
+
+
+# void (*button_callback_t)(const button_event_t* ev, void* arg);
+ButtonCallback = CFUNCTYPE(None, POINTER(ButtonEvent), c_void_p)
+
 class Button:
     running: bool = False
     device_path: str # 键盘设备路径
     device = None
     key_pressed_times: dict = {}
 
-    def __init__(self, device_path = '/dev/input/event0'):
+    button_so: Any = None
+    reactor: Any = None
+    callback: Any = None
+
+    def __init__(self, device_path = '/dev/input/event0', driver_so_path: str = None):
+        """
+        Args:
+            device_path (str): 输入设备路径。
+            driver_so_path (str): button.so 路径, 可用时由 C 事件线程用 epoll 读取按键,
+                                  不再需要 server 线程轮询。
+        """
+
         self.device_path = device_path
+        if driver_so_path:
+            try:
+                self.__reactor_init(driver_so_path)
+            except Exception as e:
+                log_dbg(f"native button unavailable, fallback to evdev: {e}")
+                self.reactor = None
+
+    def __reactor_init(self, driver_so_path: str):
+        self.button_so = cdll.LoadLibrary(driver_so_path)
+
+        # button_reactor_t* button_reactor_init(void);
+        self.button_so.button_reactor_init.restype = c_void_p
+
+        # void button_reactor_exit(button_reactor_t* r);
+        self.button_so.button_reactor_exit.argtypes = [c_void_p]
+
+        # int button_reactor_add_device(button_reactor_t* r, const char* path);
+        self.button_so.button_reactor_add_device.argtypes = [c_void_p, c_char_p]
+        self.button_so.button_reactor_add_device.restype = c_int
+
+        # int button_reactor_add_fd(button_reactor_t* r, int fd);
+        self.button_so.button_reactor_add_fd.argtypes = [c_void_p, c_int]
+        self.button_so.button_reactor_add_fd.restype = c_int
+
+        # void button_reactor_set_callback(button_reactor_t* r, button_callback_t cb, void* arg);
+        self.button_so.button_reactor_set_callback.argtypes = [c_void_p, ButtonCallback, c_void_p]
+
+        # int button_reactor_wait(button_reactor_t* r, button_event_t* ev, int timeout_ms);
+        self.button_so.button_reactor_wait.argtypes = [c_void_p, POINTER(ButtonEvent), c_int]
+        self.button_so.button_reactor_wait.restype = c_int
+
+        # uint64_t button_reactor_pressed(button_reactor_t* r, uint16_t code);
+        self.button_so.button_reactor_pressed.argtypes = [c_void_p, c_uint16]
+        self.button_so.button_reactor_pressed.restype = c_uint64
+
+        self.reactor = self.button_so.button_reactor_init()
+        if not self.reactor:
+            raise RuntimeError("fail to create button reactor")
+        if self.device_path and self.button_so.button_reactor_add_device(self.reactor, self.device_path.encode()) < 0:
+            self.button_so.button_reactor_exit(self.reactor)
+            self.reactor = None
+            raise RuntimeError(f"fail to open {self.device_path}")
+
+    def add_fd(self, fd: int):
+        """
+        监听管道或 socketpair 读端, 写入 struct input_event 模拟按键, 用于测试。
+
+        Args:
+            fd (int): 文件描述符, 由反应器接管。
+
+        Return:
+            int: 输入源序号, 失败返回 -1。
+        """
+
+        if not self.reactor:
+            return -1
+        return self.button_so.button_reactor_add_fd(self.reactor, fd)
+
+    def set_callback(self, fn):
+        """
+        设置按键沿回调, 在 C 事件线程中调用。
+
+        Args:
+            fn: fn(keycode, pressed: bool, time_us: int), 为 None 取消回调。
+        """
+
+        if not self.reactor:
+            return
+        if fn is None:
+            self.callback = None
+            self.button_so.button_reactor_set_callback(self.reactor, ButtonCallback(), None)
+            return
+
+        def on_event(ev, arg):
+            fn(KEY_NAMES.get(ev.contents.code, ev.contents.code), ev.contents.value == 1, ev.contents.time_us)
+
+        # 保留引用, 避免回调对象被回收
+        self.callback = ButtonCallback(on_event)
+        self.button_so.button_reactor_set_callback(self.reactor, self.callback, None)
+
+    def wait_event(self, timeout: float):
+        """
+        等待下一个按键沿, 没有 button.so 时等同于 sleep。
+
+        Args:
+            timeout (float): 最长等待时间(秒)。
+
+        Return:
+            tuple: (keycode, pressed, time_us), 超时返回 None
+        """
+
+        if not self.reactor:
+            time.sleep(timeout)
+            return None
+        ev = ButtonEvent()
+        if self.button_so.button_reactor_wait(self.reactor, ev, int(timeout * 1000)) <= 0:
+            return None
+        keycode = KEY_NAMES.get(ev.code, ev.code)
+        log_dbg(f"按键{'按下' if ev.value else '松开'}: {keycode}")
+        return keycode, ev.value == 1, ev.time_us
 
     # 开始监听按键事件
     def server(self):
         """
-        按键监听服务器
+        按键监听服务器, 使用 button.so 时按键由 C 事件线程读取, 直接返回
         """
 
+        if self.reactor:
+            return
+
         try:
             self.device = evdev.InputDevice(self.device_path)
             self.running = True
@@ -63,8 +209,16 @@ class Button:
              (bool): 按键是否按下, 按下 True 未按下 False
         """
 
+        if self.reactor:
+            code = KEY_CODES.get(keycode, keycode)
+            return self.button_so.button_reactor_pressed(self.reactor, code) != 0
         return keycode in self.key_pressed_times
 
+    def __del__(self):
+        if self.reactor:
+            self.button_so.button_reactor_exit(self.reactor)
+            self.reactor = None
+
 # 示例用法
 if __name__ == "__main__":
     import threading
@@ -0,0 +1,16 @@
+#include <stdio.h>
+
+#include "button.h"
+#include "debug.h"
+
+char g_dbg_enable = 1;
+
+/**
+ * @brief 设置调试模式
+ *
+ * @param enable 如果为非零值，则启用调试模式；如果为零，则禁用调试模式。
+ */
+void button_set_debug(char enable)
+{
+    g_dbg_enable = enable;
+}
@@ -0,0 +1,23 @@
+#ifndef __BUTTON_H__
+#define __BUTTON_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 功能: button.so 公共入口, 各模块接口见对应头文件.
+
+#include "button_reactor.h"
+
+/**
+ * 设置调试模式。
+ *
+ * @param enable 是否启用调试模式，1 为启用，0 为禁用。
+ */
+void button_set_debug(char enable);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif//__BUTTON_H__
@@ -0,0 +1,572 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "button_reactor.h"
+#include "debug.h"
+
+#define BUTTON_REACTOR_WAKE_ID (0xffffffffu)  // epoll 中 eventfd 的标识
+#define BUTTON_SOURCE_BUF_EVENTS (16)         // 每次最多读取的事件个数
+
+#ifdef input_event_sec
+#define BUTTON_EVENT_SEC(ev) ((ev)->input_event_sec)
+#define BUTTON_EVENT_USEC(ev) ((ev)->input_event_usec)
+#else
+#define BUTTON_EVENT_SEC(ev) ((ev)->time.tv_sec)
+#define BUTTON_EVENT_USEC(ev) ((ev)->time.tv_usec)
+#endif
+
+typedef struct button_source_t {
+    int fd;           // 文件描述符, -1 表示已关闭
+    int is_device;    // 是否为输入设备, 设备支持 EVIOCGKEY 重新同步
+    int dropped;      // 收到 SYN_DROPPED, 丢弃事件直到下一个 SYN_REPORT
+    size_t len;       // buf 中未处理的字节数, 管道可能只读到半个事件
+    uint8_t buf[sizeof(struct input_event) * BUTTON_SOURCE_BUF_EVENTS];
+} button_source_t;
+
+typedef struct button_reactor_t {
+    int epoll_fd;                  // epoll 实例
+    int wake_fd;                   // eventfd, 通知事件线程退出
+    pthread_t thread;              // 事件线程
+    int thread_running;            // 事件线程是否已启动
+    int stop;                      // 反应器正在退出
+    pthread_mutex_t lock;          // 保护下面的成员
+    pthread_cond_t cond;           // 队列有新事件
+    button_source_t sources[BUTTON_REACTOR_MAX_SOURCE];
+    int source_count;              // 已添加的输入源个数
+    button_event_t queue[BUTTON_REACTOR_QUEUE_SIZE];
+    unsigned queue_head;           // 最旧事件的位置
+    unsigned queue_count;          // 队列中的事件个数
+    uint64_t pressed[KEY_CNT];     // 按键按下时间, 0 表示未按下
+    button_callback_t cb;          // 按键沿回调
+    void* cb_arg;                  // 回调参数
+} button_reactor_t;
+
+static uint64_t button_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief 记录按键状态, 按键沿放入队列并回调
+ *
+ * @param r 指向反应器的指针
+ * @param ev 按键事件
+ */
+static void button_reactor_dispatch(button_reactor_t* r, const button_event_t* ev)
+{
+    button_callback_t cb = NULL;
+    void* cb_arg = NULL;
+
+    pthread_mutex_lock(&r->lock);
+    if (ev->value == BUTTON_KEY_DOWN)
+        r->pressed[ev->code] = ev->time_us ? ev->time_us : 1;
+    else if (ev->value == BUTTON_KEY_UP)
+        r->pressed[ev->code] = 0;
+
+    if (ev->value != BUTTON_KEY_REPEAT) {
+        if (r->queue_count == BUTTON_REACTOR_QUEUE_SIZE) {
+            LOG_ERR("button queue full, drop key(%u)", r->queue[r->queue_head].code);
+            r->queue_head = (r->queue_head + 1) % BUTTON_REACTOR_QUEUE_SIZE;
+            --r->queue_count;
+        }
+        r->queue[(r->queue_head + r->queue_count) % BUTTON_REACTOR_QUEUE_SIZE] = *ev;
+        ++r->queue_count;
+        pthread_cond_broadcast(&r->cond);
+        cb = r->cb;
+        cb_arg = r->cb_arg;
+    }
+    pthread_mutex_unlock(&r->lock);
+
+    if (cb)
+        cb(ev, cb_arg);
+}
+
+/**
+ * @brief 内核事件缓冲区溢出(SYN_DROPPED)后, 按设备实际状态补发丢失的按键沿
+ */
+static void button_reactor_resync(button_reactor_t* r, int idx)
+{
+    uint8_t bits[KEY_CNT / 8];
+    memset(bits, 0, sizeof(bits));
+    if (ioctl(r->sources[idx].fd, EVIOCGKEY(sizeof(bits)), bits) < 0) {
+        LOG_ERR("fail to resync key state: %s", strerror(errno));
+        return;
+    }
+
+    uint64_t now = button_now_us();
+    for (unsigned code = 0; code < KEY_CNT; ++code) {
+        int down = (bits[code / 8] >> (code % 8)) & 1;
+        pthread_mutex_lock(&r->lock);
+        int was_down = r->pressed[code] != 0;
+        pthread_mutex_unlock(&r->lock);
+        if (down != was_down) {
+            button_event_t ev = { (uint16_t)code, down ? BUTTON_KEY_DOWN : BUTTON_KEY_UP, now, idx };
+            button_reactor_dispatch(r, &ev);
+        }
+    }
+}
+
+/**
+ * @brief 关闭输入源, 设备拔出或管道写端关闭时调用
+ */
+static void button_reactor_close_source(button_reactor_t* r, int idx)
+{
+    button_source_t* s = &r->sources[idx];
+    if (s->fd < 0)
+        return;
+    epoll_ctl(r->epoll_fd, EPOLL_CTL_DEL, s->fd, NULL);
+    close(s->fd);
+    s->fd = -1;
+}
+
+/**
+ * @brief 读取输入源中的全部事件
+ *
+ * @return 成功返回 0，输入源已关闭返回 -1
+ */
+static int button_reactor_read(button_reactor_t* r, int idx)
+{
+    button_source_t* s = &r->sources[idx];
+
+    for (;;) {
+        ssize_t ret = read(s->fd, s->buf + s->len, sizeof(s->buf) - s->len);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret < 0 && errno == EAGAIN)
+            return 0;
+        if (ret <= 0) {
+            LOG_DBG("button source(%d) closed: %s", idx, ret ? strerror(errno) : "eof");
+            return -1;
+        }
+        s->len += ret;
+
+        size_t n = s->len / sizeof(struct input_event);
+        for (size_t i = 0; i < n; ++i) {
+            struct input_event ie;
+            memcpy(&ie, s->buf + i * sizeof(ie), sizeof(ie));
+            if (ie.type == EV_SYN && ie.code == SYN_DROPPED && s->is_device) {
+                s->dropped = 1;
+                continue;
+            }
+            // 溢出后到下一个 SYN_REPORT 为止的事件不完整, 全部丢弃后按设备状态重新同步
+            if (s->dropped) {
+                if (ie.type == EV_SYN && ie.code == SYN_REPORT) {
+                    s->dropped = 0;
+                    button_reactor_resync(r, idx);
+                }
+                continue;
+            }
+            if (ie.type != EV_KEY || ie.code >= KEY_CNT)
+                continue;
+            button_event_t ev;
+            ev.code = ie.code;
+            ev.value = ie.value;
+            ev.time_us = (uint64_t)BUTTON_EVENT_SEC(&ie) * 1000000 + BUTTON_EVENT_USEC(&ie);
+            ev.source = idx;
+            button_reactor_dispatch(r, &ev);
+        }
+        s->len -= n * sizeof(struct input_event);
+        memmove(s->buf, s->buf + n * sizeof(struct input_event), s->len);
+    }
+}
+
+/**
+ * @brief 事件线程: 等待任一输入源可读
+ *
+ * @param arg 指向反应器的指针
+ */
+static void* button_reactor_thread(void* arg)
+{
+    button_reactor_t* r = (button_reactor_t*)arg;
+    struct epoll_event events[BUTTON_REACTOR_MAX_SOURCE + 1];
+
+    for (;;) {
+        int n = epoll_wait(r->epoll_fd, events, BUTTON_REACTOR_MAX_SOURCE + 1, -1);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            LOG_ERR("button epoll fail: %s", strerror(errno));
+            break;
+        }
+        if (__atomic_load_n(&r->stop, __ATOMIC_ACQUIRE))
+            break;
+
+        for (int i = 0; i < n; ++i) {
+            uint32_t idx = events[i].data.u32;
+            if (idx == BUTTON_REACTOR_WAKE_ID)
+                continue;
+            if (button_reactor_read(r, idx) < 0)
+                button_reactor_close_source(r, idx);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief 把 fd 加入 epoll, 成功后由反应器接管
+ */
+static int button_reactor_add(button_reactor_t* r, int fd, int is_device)
+{
+    pthread_mutex_lock(&r->lock);
+    if (r->source_count == BUTTON_REACTOR_MAX_SOURCE) {
+        pthread_mutex_unlock(&r->lock);
+        LOG_ERR("too many button source, max %d", BUTTON_REACTOR_MAX_SOURCE);
+        return -1;
+    }
+    int idx = r->source_count;
+    button_source_t* s = &r->sources[idx];
+    s->fd = fd;
+    s->is_device = is_device;
+    s->len = 0;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = idx;
+    if (epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        LOG_ERR("fail to watch fd(%d): %s", fd, strerror(errno));
+        s->fd = -1;
+        pthread_mutex_unlock(&r->lock);
+        return -1;
+    }
+    ++r->source_count;
+    pthread_mutex_unlock(&r->lock);
+
+    return idx;
+}
+
+/**
+ * 打开并监听输入设备。
+ *
+ * @param r 指向反应器的指针。
+ * @param path 设备路径, 如 `/dev/input/event0`。
+ * @return 成功返回输入源序号，失败返回 -1。
+ */
+int button_reactor_add_device(button_reactor_t* r, const char* path)
+{
+    if (!r || !path)
+        return -1;
+
+    int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_ERR("fail to open %s: %s", path, strerror(errno));
+        return -1;
+    }
+    // 事件时间使用单调时钟, 方便与采集等模块比较
+    int clock_id = CLOCK_MONOTONIC;
+    if (ioctl(fd, EVIOCSCLOCKID, &clock_id) < 0)
+        LOG_DBG("%s not support monotonic clock, use realtime", path);
+
+    int idx = button_reactor_add(r, fd, 1);
+    if (idx < 0) {
+        close(fd);
+        return -1;
+    }
+    LOG_DBG("button source(%d): %s", idx, path);
+
+    return idx;
+}
+
+/**
+ * 监听一个已打开的文件描述符, 如管道或 socketpair 的读端, 内容为 struct input_event 序列。
+ * 反应器接管 fd, 退出时关闭。
+ *
+ * @param r 指向反应器的指针。
+ * @param fd 文件描述符。
+ * @return 成功返回输入源序号，失败返回 -1。
+ */
+int button_reactor_add_fd(button_reactor_t* r, int fd)
+{
+    if (!r || fd < 0)
+        return -1;
+
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        LOG_ERR("fail to set fd(%d) nonblock: %s", fd, strerror(errno));
+        return -1;
+    }
+
+    return button_reactor_add(r, fd, 0);
+}
+
+/**
+ * 设置按键沿回调, 按键重复事件不回调。
+ *
+ * @param r 指向反应器的指针。
+ * @param cb 回调函数, NULL 取消回调。
+ * @param arg 回调参数。
+ */
+void button_reactor_set_callback(button_reactor_t* r, button_callback_t cb, void* arg)
+{
+    if (!r)
+        return;
+    pthread_mutex_lock(&r->lock);
+    r->cb = cb;
+    r->cb_arg = arg;
+    pthread_mutex_unlock(&r->lock);
+}
+
+/**
+ * 等待下一个按键事件(按下/松开, 不含重复)。
+ *
+ * @param r 指向反应器的指针。
+ * @param ev 输出事件。
+ * @param timeout_ms 超时时间, 负数一直等待。
+ * @return 有事件返回 1，超时返回 0，反应器退出或出错返回 -1。
+ */
+int button_reactor_wait(button_reactor_t* r, button_event_t* ev, int timeout_ms)
+{
+    if (!r || !ev)
+        return -1;
+
+    struct timespec deadline;
+    if (timeout_ms >= 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    int ret = 0;
+    pthread_mutex_lock(&r->lock);
+    while (!r->queue_count && !r->stop) {
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&r->cond, &r->lock);
+        } else if (ETIMEDOUT == pthread_cond_timedwait(&r->cond, &r->lock, &deadline)) {
+            break;
+        }
+    }
+    if (r->queue_count) {
+        *ev = r->queue[r->queue_head];
+        r->queue_head = (r->queue_head + 1) % BUTTON_REACTOR_QUEUE_SIZE;
+        --r->queue_count;
+        ret = 1;
+    } else if (r->stop) {
+        ret = -1;
+    }
+    pthread_mutex_unlock(&r->lock);
+
+    return ret;
+}
+
+/**
+ * 查询按键当前是否按下。
+ *
+ * @param r 指向反应器的指针。
+ * @param code 按键码。
+ * @return 按下返回按下时的内核事件时间(微秒, 不为 0)，未按下返回 0。
+ */
+uint64_t button_reactor_pressed(button_reactor_t* r, uint16_t code)
+{
+    if (!r || code >= KEY_CNT)
+        return 0;
+    pthread_mutex_lock(&r->lock);
+    uint64_t t = r->pressed[code];
+    pthread_mutex_unlock(&r->lock);
+    return t;
+}
+
+/**
+ * 停止事件线程, 关闭所有输入源并释放反应器。
+ *
+ * @param r 指向反应器的指针。
+ */
+void button_reactor_exit(button_reactor_t* r)
+{
+    if (!r)
+        return;
+
+    pthread_mutex_lock(&r->lock);
+    r->stop = 1;
+    pthread_cond_broadcast(&r->cond);
+    pthread_mutex_unlock(&r->lock);
+
+    if (r->thread_running) {
+        uint64_t one = 1;
+        if (write(r->wake_fd, &one, sizeof(one)) < 0)
+            LOG_ERR("fail to wake button thread: %s", strerror(errno));
+        pthread_join(r->thread, NULL);
+        r->thread_running = 0;
+    }
+    for (int i = 0; i < r->source_count; ++i)
+        button_reactor_close_source(r, i);
+    if (r->wake_fd >= 0)
+        close(r->wake_fd);
+    if (r->epoll_fd >= 0)
+        close(r->epoll_fd);
+    pthread_cond_destroy(&r->cond);
+    pthread_mutex_destroy(&r->lock);
+    free(r);
+}
+
+/**
+ * 创建反应器并启动事件线程。
+ *
+ * @return 成功返回反应器指针，失败返回 NULL。
+ */
+button_reactor_t* button_reactor_init(void)
+{
+    button_reactor_t* r = (button_reactor_t*)malloc(sizeof(button_reactor_t));
+    if (!r) {
+        LOG_ERR("fail to malloc button reactor");
+        return NULL;
+    }
+    memset(r, 0, sizeof(button_reactor_t));
+    r->epoll_fd = -1;
+    r->wake_fd = -1;
+    for (int i = 0; i < BUTTON_REACTOR_MAX_SOURCE; ++i)
+        r->sources[i].fd = -1;
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&r->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&r->lock, NULL);
+
+    r->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    r->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (r->epoll_fd < 0 || r->wake_fd < 0) {
+        LOG_ERR("fail to create button epoll: %s", strerror(errno));
+        goto err;
+    }
+
+    {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u32 = BUTTON_REACTOR_WAKE_ID;
+        if (epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, r->wake_fd, &ev) < 0) {
+            LOG_ERR("fail to watch wake fd: %s", strerror(errno));
+            goto err;
+        }
+    }
+
+    if (pthread_create(&r->thread, NULL, button_reactor_thread, r)) {
+        LOG_ERR("fail to create button thread");
+        goto err;
+    }
+    r->thread_running = 1;
+
+    return r;
+err:
+    button_reactor_exit(r);
+    return NULL;
+}
+
+#ifdef __XTEST__
+
+#include <sys/socket.h>
+
+char g_dbg_enable = 1;
+
+static int s_callback_count = 0;
+
+static void test_callback(const button_event_t* ev, void* arg)
+{
+    (void)ev;
+    __atomic_add_fetch((int*)arg, 1, __ATOMIC_RELEASE);
+}
+
+static void test_write(int fd, uint16_t type, uint16_t code, int32_t value, uint64_t time_us,
+    size_t split)
+{
+    struct input_event ie;
+    memset(&ie, 0, sizeof(ie));
+    BUTTON_EVENT_SEC(&ie) = time_us / 1000000;
+    BUTTON_EVENT_USEC(&ie) = time_us % 1000000;
+    ie.type = type;
+    ie.code = code;
+    ie.value = value;
+
+    // split 不为 0 时分两次写入, 模拟读到半个事件
+    const uint8_t* p = (const uint8_t*)&ie;
+    if (split) {
+        assert((ssize_t)split == write(fd, p, split));
+        usleep(10 * 1000);
+    }
+    assert((ssize_t)(sizeof(ie) - split) == write(fd, p + split, sizeof(ie) - split));
+}
+
+int main(void)
+{
+    button_reactor_t* r = button_reactor_init();
+    assert(r);
+    button_reactor_set_callback(r, test_callback, &s_callback_count);
+
+    int pipe_fds[2];
+    int sock_fds[2];
+    assert(0 == pipe(pipe_fds));
+    assert(0 == socketpair(AF_UNIX, SOCK_STREAM, 0, sock_fds));
+    int pipe_src = button_reactor_add_fd(r, pipe_fds[0]);
+    int sock_src = button_reactor_add_fd(r, sock_fds[0]);
+    assert(pipe_src == 0 && sock_src == 1);
+
+    button_event_t ev;
+    assert(0 == button_reactor_wait(r, &ev, 20));
+
+    // 按下, 重复, 同步事件, 松开; 只有按下和松开进入队列
+    test_write(pipe_fds[1], EV_KEY, KEY_RIGHT, BUTTON_KEY_DOWN, 1000001, 0);
+    test_write(pipe_fds[1], EV_SYN, SYN_REPORT, 0, 1000001, 0);
+    test_write(pipe_fds[1], EV_KEY, KEY_RIGHT, BUTTON_KEY_REPEAT, 1250000, 0);
+    assert(1 == button_reactor_wait(r, &ev, 1000));
+    assert(ev.code == KEY_RIGHT && ev.value == BUTTON_KEY_DOWN && ev.time_us == 1000001 && ev.source == pipe_src);
+    assert(button_reactor_pressed(r, KEY_RIGHT) == 1000001);
+
+    test_write(sock_fds[1], EV_KEY, KEY_A, BUTTON_KEY_DOWN, 1300000, sizeof(struct input_event) / 2);
+    assert(1 == button_reactor_wait(r, &ev, 1000));
+    assert(ev.code == KEY_A && ev.time_us == 1300000 && ev.source == sock_src);
+
+    test_write(pipe_fds[1], EV_KEY, KEY_RIGHT, BUTTON_KEY_UP, 1500000, 0);
+    assert(1 == button_reactor_wait(r, &ev, 1000));
+    assert(ev.code == KEY_RIGHT && ev.value == BUTTON_KEY_UP && ev.time_us == 1500000);
+    assert(0 == button_reactor_pressed(r, KEY_RIGHT));
+    assert(button_reactor_pressed(r, KEY_A));
+    assert(0 == button_reactor_wait(r, &ev, 20));
+    assert(__atomic_load_n(&s_callback_count, __ATOMIC_ACQUIRE) == 3);
+
+    // SYN_DROPPED 后到下一个 SYN_REPORT 为止的事件被丢弃;
+    // 管道没有 EVIOCGKEY, 重新同步失败不补发按键沿
+    r->sources[pipe_src].is_device = 1;
+    test_write(pipe_fds[1], EV_SYN, SYN_DROPPED, 0, 1510000, 0);
+    test_write(pipe_fds[1], EV_KEY, KEY_B, BUTTON_KEY_DOWN, 1510000, 0);
+    test_write(pipe_fds[1], EV_SYN, SYN_REPORT, 0, 1510000, 0);
+    test_write(pipe_fds[1], EV_KEY, KEY_C, BUTTON_KEY_DOWN, 1520000, 0);
+    assert(1 == button_reactor_wait(r, &ev, 1000));
+    assert(ev.code == KEY_C && ev.time_us == 1520000);
+    assert(0 == button_reactor_pressed(r, KEY_B));
+    assert(0 == button_reactor_wait(r, &ev, 20));
+    assert(__atomic_load_n(&s_callback_count, __ATOMIC_ACQUIRE) == 4);
+
+    // 写端关闭后输入源被移除, 不影响其他输入源
+    close(pipe_fds[1]);
+    usleep(20 * 1000);
+    test_write(sock_fds[1], EV_KEY, KEY_A, BUTTON_KEY_UP, 1600000, 0);
+    assert(1 == button_reactor_wait(r, &ev, 1000));
+    assert(ev.code == KEY_A && ev.value == BUTTON_KEY_UP);
+
+    close(sock_fds[1]);
+    button_reactor_exit(r);
+
+    printf("button reactor test pass\n");
+    return 0;
+}
+
+#endif //__XTEST__
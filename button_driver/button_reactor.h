@@ -0,0 +1,111 @@
+#ifndef __BUTTON_REACTOR_H__
+#define __BUTTON_REACTOR_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// 功能: 按键事件反应器, 事件线程用 epoll 同时监听多个 /dev/input/event* 设备,
+// 按键沿(按下/松开)带内核事件时间戳, 通过回调或阻塞等待交给调用者.
+// 也可以添加管道/socketpair 的读端, 写入 struct input_event 模拟按键, 用于测试.
+//
+// example:
+//   button_reactor_t* r = button_reactor_init();
+//   button_reactor_add_device(r, "/dev/input/event0");
+//   button_event_t ev;
+//   while (button_reactor_wait(r, &ev, -1) > 0)
+//       printf("key %u %s\n", ev.code, ev.value ? "down" : "up");
+//   button_reactor_exit(r);
+
+#define BUTTON_REACTOR_MAX_SOURCE (8)    // 最多监听的输入源个数
+#define BUTTON_REACTOR_QUEUE_SIZE (64)   // 事件队列长度, 满时丢弃最旧的事件
+
+#define BUTTON_KEY_UP (0)      // 松开
+#define BUTTON_KEY_DOWN (1)    // 按下
+#define BUTTON_KEY_REPEAT (2)  // 按住自动重复
+
+typedef struct button_event_t {
+    uint16_t code;     // 按键码, 见 linux/input-event-codes.h, 如 KEY_RIGHT
+    int32_t value;     // BUTTON_KEY_UP / BUTTON_KEY_DOWN / BUTTON_KEY_REPEAT
+    uint64_t time_us;  // 内核事件时间, 设备为 CLOCK_MONOTONIC, 管道为写入者填写的时间
+    int source;        // 输入源序号, 即添加时的返回值
+} button_event_t;
+
+/**
+ * 按键事件回调, 在事件线程中调用, 不能阻塞太久。
+ *
+ * @param ev 按键事件。
+ * @param arg 设置回调时传入的参数。
+ */
+typedef void (*button_callback_t)(const button_event_t* ev, void* arg);
+
+struct button_reactor_t;
+
+/**
+ * 创建反应器并启动事件线程。
+ *
+ * @return 成功返回反应器指针，失败返回 NULL。
+ */
+button_reactor_t* button_reactor_init(void);
+
+/**
+ * 停止事件线程, 关闭所有输入源并释放反应器。
+ *
+ * @param r 指向反应器的指针。
+ */
+void button_reactor_exit(button_reactor_t* r);
+
+/**
+ * 打开并监听输入设备。
+ *
+ * @param r 指向反应器的指针。
+ * @param path 设备路径, 如 `/dev/input/event0`。
+ * @return 成功返回输入源序号，失败返回 -1。
+ */
+int button_reactor_add_device(button_reactor_t* r, const char* path);
+
+/**
+ * 监听一个已打开的文件描述符, 如管道或 socketpair 的读端, 内容为 struct input_event 序列。
+ * 反应器接管 fd, 退出时关闭。
+ *
+ * @param r 指向反应器的指针。
+ * @param fd 文件描述符。
+ * @return 成功返回输入源序号，失败返回 -1。
+ */
+int button_reactor_add_fd(button_reactor_t* r, int fd);
+
+/**
+ * 设置按键沿回调, 按键重复事件不回调。
+ *
+ * @param r 指向反应器的指针。
+ * @param cb 回调函数, NULL 取消回调。
+ * @param arg 回调参数。
+ */
+void button_reactor_set_callback(button_reactor_t* r, button_callback_t cb, void* arg);
+
+/**
+ * 等待下一个按键事件(按下/松开, 不含重复)。
+ *
+ * @param r 指向反应器的指针。
+ * @param ev 输出事件。
+ * @param timeout_ms 超时时间, 负数一直等待。
+ * @return 有事件返回 1，超时返回 0，反应器退出或出错返回 -1。
+ */
+int button_reactor_wait(button_reactor_t* r, button_event_t* ev, int timeout_ms);
+
+/**
+ * 查询按键当前是否按下。
+ *
+ * @param r 指向反应器的指针。
+ * @param code 按键码。
+ * @return 按下返回按下时的内核事件时间(微秒, 不为 0)，未按下返回 0。
+ */
+uint64_t button_reactor_pressed(button_reactor_t* r, uint16_t code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__BUTTON_REACTOR_H__
@@ -1,5 +1,6 @@
-from ctypes import Structure, cdll, c_int, c_size_t, c_uint16, c_void_p, c_char, POINTER
+from ctypes import Structure, cdll, cast, c_int, c_size_t, c_uint8, c_uint16, c_void_p, c_char, c_char_p, c_float, POINTER
 from typing import Any
+import weakref
 
 
 class Color:
@@ -14,6 +15,29 @@ class Color:
         return c_uint16(color)
 
 
+class Image:
+    # image_format_t
+    RGB888: int = 0
+    RGBA8888: int = 1
+    # DISPLAY_IMAGE_*
+    BILINEAR: int = 1 << 0
+    ALPHA: int = 1 << 1
+    DITHER: int = 1 << 2
+
+
+class Meter:
+    # meter_style_t
+    BAR: int = 0
+    WAVE: int = 1
+
+
+class Cache:
+    # DISPLAY_CACHE_*
+    RGB565: int = 16
+    INDEX4: int = 4
+    MONO: int = 1
+
+
 # 
 #     @ Display
 #     @ 原点点定义: 0点为屏幕正方的左上角
@@ -48,6 +72,8 @@ class View(Structure):
     now_x: int
     now_y: int
     font_color: int
+    font_size: int
+    font_scale: int
 
     _fields_ = [
         ("start_x", c_size_t),
@@ -57,6 +83,8 @@ class View(Structure):
         ("now_x", c_size_t),
         ("now_y", c_size_t),
         ("font_color", c_uint16),
+        ("font_size", c_uint8),
+        ("font_scale", c_uint8),
     ]
 
 
@@ -65,6 +93,8 @@ class Display:
     display_driver: Any = None
 
     def __init__(self, driver_so_path: str, framebuffer_dev: str, font_path: str):
+        # display_get_cache 发出的 (视图, ctypes 数组) 弱引用, 显示缓存释放前要让它们失效
+        self.cache_views = []
         self.display_so = cdll.LoadLibrary(driver_so_path)
         # 传入默认的参数初始化
         self.__hook_setup()
@@ -87,6 +117,66 @@ class Display:
         # void display_set_debug(char enable);
         self.display_so.display_set_debug.argtypes = [c_char]
 
+        # void display_set_ansi(display_t* d, int enable);
+        self.display_so.display_set_ansi.argtypes = [POINTER(c_void_p), c_int]
+
+        # void display_set_antialias(display_t* d, int enable);
+        self.display_so.display_set_antialias.argtypes = [POINTER(c_void_p), c_int]
+
+        # int display_set_sprite_cache(display_t* d, size_t max_bytes);
+        self.display_so.display_set_sprite_cache.argtypes = [POINTER(c_void_p), c_size_t]
+        self.display_so.display_set_sprite_cache.restype = c_int
+
+        # int display_sprite_pin(display_t* d, view_t* v, const char* from_code, const char* str, size_t str_len);
+        self.display_so.display_sprite_pin.argtypes = [
+            POINTER(c_void_p),
+            POINTER(View),
+            POINTER(c_char),
+            POINTER(c_char),
+            c_size_t,
+        ]
+        self.display_so.display_sprite_pin.restype = c_int
+
+        # int display_draw_image(display_t* d, view_t* v, size_t x, size_t y, size_t w, size_t h,
+        #     const uint8_t* pixels, size_t img_w, size_t img_h, size_t stride, int format, int flags);
+        self.display_so.display_draw_image.argtypes = [
+            POINTER(c_void_p),
+            POINTER(View),
+            c_size_t,
+            c_size_t,
+            c_size_t,
+            c_size_t,
+            POINTER(c_char),
+            c_size_t,
+            c_size_t,
+            c_size_t,
+            c_int,
+            c_int,
+        ]
+        self.display_so.display_draw_image.restype = c_int
+
+        # int display_draw_ppm(display_t* d, view_t* v, size_t x, size_t y, size_t w, size_t h,
+        #     const char* path, int flags);
+        self.display_so.display_draw_ppm.argtypes = [
+            POINTER(c_void_p),
+            POINTER(View),
+            c_size_t,
+            c_size_t,
+            c_size_t,
+            c_size_t,
+            POINTER(c_char),
+            c_int,
+        ]
+        self.display_so.display_draw_ppm.restype = c_int
+
+        # int display_set_threads(display_t* d, size_t threads);
+        self.display_so.display_set_threads.argtypes = [POINTER(c_void_p), c_size_t]
+        self.display_so.display_set_threads.restype = c_int
+
+        # int display_set_cache_format(display_t* d, int format, const framebuffer_color_t* palette, size_t colors);
+        self.display_so.display_set_cache_format.argtypes = [POINTER(c_void_p), c_int, POINTER(c_uint16), c_size_t]
+        self.display_so.display_set_cache_format.restype = c_int
+
         # size_t display_get_width(display_t *d);
         self.display_so.display_get_width.argtypes = [POINTER(c_void_p)]
         self.display_so.display_get_width.restype = c_size_t
@@ -103,6 +193,23 @@ class Display:
             c_uint16,
         ]
 
+        # framebuffer_color_t* display_get_cache(display_t* d);
+        self.display_so.display_get_cache.argtypes = [POINTER(c_void_p)]
+        self.display_so.display_get_cache.restype = c_void_p
+
+        # size_t display_get_cache_stride(display_t* d);
+        self.display_so.display_get_cache_stride.argtypes = [POINTER(c_void_p)]
+        self.display_so.display_get_cache_stride.restype = c_size_t
+
+        # void display_mark_dirty(display_t* d, size_t x, size_t y, size_t w, size_t h);
+        self.display_so.display_mark_dirty.argtypes = [
+            POINTER(c_void_p),
+            c_size_t,
+            c_size_t,
+            c_size_t,
+            c_size_t,
+        ]
+
         # int display_view_print(display_t* d, view_t *v, const char *from_code, const char* str, size_t str_len);
         self.display_so.display_view_print.argtypes = [
             POINTER(c_void_p),
@@ -113,6 +220,70 @@ class Display:
         ]
         self.display_so.display_view_print.restype = c_int
 
+        # int display_view_set_text(display_t* d, view_t* v, const char* from_code, const char* str, size_t str_len);
+        self.display_so.display_view_set_text.argtypes = [
+            POINTER(c_void_p),
+            POINTER(View),
+            POINTER(c_char),
+            POINTER(c_char),
+            c_size_t,
+        ]
+        self.display_so.display_view_set_text.restype = c_int
+
+        # int display_view_attach(display_t* d, view_t* v, int z);
+        self.display_so.display_view_attach.argtypes = [POINTER(c_void_p), POINTER(View), c_int]
+        self.display_so.display_view_attach.restype = c_int
+
+        # void display_view_detach(display_t* d, view_t* v);
+        self.display_so.display_view_detach.argtypes = [POINTER(c_void_p), POINTER(View)]
+
+        # int display_view_show(display_t* d, view_t* v, int visible);
+        self.display_so.display_view_show.argtypes = [POINTER(c_void_p), POINTER(View), c_int]
+        self.display_so.display_view_show.restype = c_int
+
+        # int display_record_start(display_t* d, const char* path);
+        self.display_so.display_record_start.argtypes = [POINTER(c_void_p), POINTER(c_char)]
+        self.display_so.display_record_start.restype = c_int
+
+        # void display_record_stop(display_t* d);
+        self.display_so.display_record_stop.argtypes = [POINTER(c_void_p)]
+
+        # int display_mirror_start(display_t* d, const char* addr);
+        self.display_so.display_mirror_start.argtypes = [POINTER(c_void_p), POINTER(c_char)]
+        self.display_so.display_mirror_start.restype = c_int
+
+        # void display_mirror_stop(display_t* d);
+        self.display_so.display_mirror_stop.argtypes = [POINTER(c_void_p)]
+
+        # int display_server_start(display_t* d, const char* path);
+        self.display_so.display_server_start.argtypes = [POINTER(c_void_p), POINTER(c_char)]
+        self.display_so.display_server_start.restype = c_int
+
+        # void display_server_stop(display_t* d);
+        self.display_so.display_server_stop.argtypes = [POINTER(c_void_p)]
+
+        # meter_t* display_meter_start(display_t* d, view_t* v, int style, size_t fps, size_t window);
+        self.display_so.display_meter_start.argtypes = [POINTER(c_void_p), POINTER(View), c_int, c_size_t, c_size_t]
+        self.display_so.display_meter_start.restype = c_void_p
+
+        # void display_meter_stop(display_t* d, meter_t* m);
+        self.display_so.display_meter_stop.argtypes = [POINTER(c_void_p), c_void_p]
+
+        # display_anim_t* display_anim_start(display_t* d, view_t* v, const char* from_code, const char* const* frames, size_t count, size_t period_ms);
+        self.display_so.display_anim_start.argtypes = [POINTER(c_void_p), POINTER(View), POINTER(c_char), POINTER(c_char_p), c_size_t, c_size_t]
+        self.display_so.display_anim_start.restype = c_void_p
+
+        # void display_anim_stop(display_t* d, display_anim_t* a);
+        self.display_so.display_anim_stop.argtypes = [POINTER(c_void_p), c_void_p]
+
+        # int meter_push_pcm(void* meter, const int16_t* pcm, size_t frames, unsigned channels);
+        self.display_so.meter_push_pcm.argtypes = [c_void_p, POINTER(c_char), c_size_t, c_int]
+        self.display_so.meter_push_pcm.restype = c_int
+
+        # int meter_push_level(meter_t* m, float level);
+        self.display_so.meter_push_level.argtypes = [c_void_p, c_float]
+        self.display_so.meter_push_level.restype = c_int
+
     def display_fflush(self):
         """
         刷新显示设备的内容。
@@ -140,6 +311,98 @@ class Display:
 
         self.display_driver.display_set_debug(enable)
 
+    def display_set_ansi(self, enable: bool):
+        """
+        设置打印时是否解析 ANSI SGR 颜色转义。
+        开启后可在一次打印中用 `\033[32m`、`\033[7m`、`\033[0m` 等切换颜色,
+        每次打印开始时恢复为视图默认样式。
+
+        Args:
+            enable (bool): 是否开启。
+        """
+
+        self.display_so.display_set_ansi(self.display_driver, 1 if enable else 0)
+
+    def display_set_antialias(self, enable: bool):
+        """
+        设置是否使用抗锯齿字体, 字体目录中需要有对应字号的 *_aa 字体文件。
+
+        Args:
+            enable (bool): 是否开启。
+        """
+
+        self.display_so.display_set_antialias(self.display_driver, 1 if enable else 0)
+
+    def display_set_sprite_cache(self, max_bytes: int):
+        """
+        设置字符串精灵缓存的内存上限, 反复打印的相同单行文字直接拷贝绘制好的像素。
+
+        Args:
+            max_bytes (int): 内存上限, 0 关闭并释放全部精灵。
+
+        Returns:
+            int: 成功返回 0，失败返回 -1。
+        """
+
+        return self.display_so.display_set_sprite_cache(self.display_driver, max_bytes)
+
+    def display_sprite_pin(self, v: View, from_code: str, content: str):
+        """
+        按视图的字号和颜色预先绘制一段文字并固定在精灵缓存中, 用于固定的界面标签。
+
+        Args:
+            v (View): 视图, 只使用字号和颜色。
+            from_code (str): 字符串的编码格式。
+            content (str): 文字。
+
+        Returns:
+            int: 成功返回 0，失败返回 -1。
+        """
+
+        return self.display_so.display_sprite_pin(
+            self.display_driver,
+            v,
+            from_code.encode(),
+            content.encode(),
+            len(content.encode()),
+        )
+
+    def display_set_threads(self, threads: int):
+        """
+        设置条带绘制的线程数, 用于 1080p 等大屏幕。
+        结果与单线程绘制一致, 绘制的像素数较少时仍在调用线程直接绘制。
+
+        Args:
+            threads (int): 参与绘制的线程数, 0 或 1 表示只在调用线程绘制。
+
+        Returns:
+            bool: 是否设置成功。
+        """
+
+        return self.display_so.display_set_threads(self.display_driver, threads) == 0
+
+    def display_set_cache_format(self, format: int, palette: list = None):
+        """
+        设置显示缓存格式。紧凑格式每个像素只存 1 位或 4 位调色板下标,
+        刷新时只把变化区域展开为 RGB565, 适合黑底文字界面。
+        紧凑格式下 display_get_cache 返回 None。
+
+        Args:
+            format (int): Cache.RGB565 / Cache.INDEX4 / Cache.MONO。
+            palette (list): 预设调色板(RGB565 整数), 第一个颜色固定为黑色, None 使用默认调色板。
+
+        Returns:
+            bool: 是否设置成功。
+
+        Raises:
+            BufferError: display_get_cache 返回的视图还被导出(如 numpy 数组), 或它的切片还在使用, 缓存不能释放。
+        """
+
+        self.__release_cache_views()
+        colors = (c_uint16 * len(palette))(*palette) if palette else None
+        return self.display_so.display_set_cache_format(self.display_driver, format, colors,
+                                                        len(palette) if palette else 0) == 0
+
     def display_get_width(self):
         """
         获取显示设备的宽度。
@@ -172,6 +435,72 @@ class Display:
 
         self.display_so.display_set_cache_color(self.display_driver, x, y, color)
 
+    def display_get_cache(self):
+        """
+        获取显示缓存的可写 memoryview, 不发生拷贝。
+
+        视图格式为 'H'(RGB565), 一维, 长度为 height * pitch, 其中每行像素数
+        pitch = display_get_cache_stride() // 2, 第 y 行为 view[y * pitch:(y + 1) * pitch]。
+        可交给 numpy.asarray(view).reshape(height, pitch) 得到 uint16 二维数组批量写入。
+        写入后需调用 display_mark_dirty 标记修改区域再 display_fflush。
+        视图引用 Display, 视图存在期间 Display 不会被释放;
+        display_set_cache_format 会释放显示缓存, 之前返回的视图随之失效(release),
+        之后访问抛出 ValueError, 需要重新获取; 切换前须先释放由视图得到的切片和
+        numpy 数组, 否则切换失败。
+
+        Returns:
+            memoryview: 显示缓存视图, 失败返回 None。
+        """
+
+        cache = self.display_so.display_get_cache(self.display_driver)
+        if not cache:
+            return None
+        stride = self.display_so.display_get_cache_stride(self.display_driver)
+        height = self.display_get_height()
+        mem = (c_uint16 * (stride // 2 * height)).from_address(cache)
+        # ctypes 数组不拥有内存, 由它持有 Display 保证缓存比视图活得久
+        mem.owner = self
+        # ctypes 导出的格式为 '<H', 转成原生 'H' 才能索引; 多维视图不支持切片, 只转成一维
+        view = memoryview(mem).cast("B").cast("H")
+        self.cache_views = [(v, m) for v, m in self.cache_views if m() is not None]
+        self.cache_views.append((weakref.ref(view), weakref.ref(mem)))
+        return view
+
+    def display_get_cache_stride(self):
+        """
+        获取显示缓存每行的字节数。
+
+        Returns:
+            int: 每行字节数, 紧凑格式下没有 RGB565 显示缓存, 返回 0。
+        """
+
+        return self.display_so.display_get_cache_stride(self.display_driver)
+
+    def __release_cache_views(self):
+        # 视图被导出(如 numpy 数组)时 release 抛出 BufferError;
+        # 切片和 cast 得到的视图共享同一个 ctypes 数组, release 后数组仍存活说明还有视图在用.
+        # 这两种情况都不能释放缓存
+        for view_ref, _ in self.cache_views:
+            view = view_ref()
+            if view is not None:
+                view.release()
+        self.cache_views = [(v, m) for v, m in self.cache_views if m() is not None]
+        if self.cache_views:
+            raise BufferError("display cache is still referenced")
+
+    def display_mark_dirty(self, x: int, y: int, w: int, h: int):
+        """
+        标记显示缓存中被直接修改的区域。
+
+        Args:
+            x (int): 区域左上角横坐标。
+            y (int): 区域左上角纵坐标。
+            w (int): 区域宽度。
+            h (int): 区域高度。
+        """
+
+        self.display_so.display_mark_dirty(self.display_driver, x, y, w, h)
+
     def display_view_print(self, v: View, from_code: str, content: str):
         """
         在指定视图上打印字符串。
@@ -190,6 +519,270 @@ class Display:
             len(content.encode()),
         )
 
+    def display_draw_image(self, v: View, x: int, y: int, pixels: bytes, img_w: int, img_h: int,
+                           fmt: int = Image.RGB888, w: int = 0, h: int = 0, flags: int = 0):
+        """
+        在视图上绘制图片, 超出视图的部分被裁剪掉。
+
+        Args:
+            v (View): 视图对象。
+            x (int): 图片左上角相对视图的 x。
+            y (int): 图片左上角相对视图的 y。
+            pixels (bytes): 紧密排列的像素。
+            img_w (int): 图片宽。
+            img_h (int): 图片高。
+            fmt (int): Image.RGB888 或 Image.RGBA8888。
+            w (int): 绘制宽度, 0 为图片宽度, 不同时缩放。
+            h (int): 绘制高度, 0 为图片高度, 不同时缩放。
+            flags (int): Image.BILINEAR / Image.ALPHA / Image.DITHER 的组合。
+
+        Returns:
+            int: 成功返回 0, 失败返回 -1。
+
+        Raises:
+            ValueError: 图片宽高为负, 或 pixels 不足 img_w * img_h 个像素。
+        """
+
+        bpp = 4 if fmt == Image.RGBA8888 else 3
+        if img_w < 0 or img_h < 0:
+            raise ValueError(f"bad image size {img_w}x{img_h}")
+        if len(pixels) < img_w * img_h * bpp:
+            raise ValueError(f"pixels has {len(pixels)} bytes, {img_w}x{img_h} image needs {img_w * img_h * bpp}")
+        return self.display_so.display_draw_image(
+            self.display_driver, v, x, y, w, h, pixels, img_w, img_h, 0, fmt, flags)
+
+    def display_draw_ppm(self, v: View, x: int, y: int, path: str, w: int = 0, h: int = 0, flags: int = 0):
+        """
+        在视图上绘制 PPM(P6) 图片文件。
+
+        Args:
+            v (View): 视图对象。
+            x (int): 图片左上角相对视图的 x。
+            y (int): 图片左上角相对视图的 y。
+            path (str): 图片路径。
+            w (int): 绘制宽度, 0 为图片宽度。
+            h (int): 绘制高度, 0 为图片高度。
+            flags (int): Image.BILINEAR / Image.ALPHA / Image.DITHER 的组合。
+
+        Returns:
+            int: 成功返回 0, 失败返回 -1。
+        """
+
+        return self.display_so.display_draw_ppm(self.display_driver, v, x, y, w, h, path.encode(), flags)
+
+    def display_view_set_text(self, v: View, from_code: str, content: str):
+        """
+        设置视图的全部文字, 只从第一个变化的字符开始重新绘制。
+        适合只修改结尾状态提示的场景, 不需要先清空视图再打印。
+
+        Args:
+            v (View): 要设置文字的视图对象。
+            from_code (str): 字符串的编码格式。
+            content (str): 新的文字内容。
+
+        Returns:
+            int: 成功返回 0, 失败返回 -1。
+        """
+
+        data = content.encode()
+        return self.display_so.display_view_set_text(self.display_driver, v, from_code.encode(), data, len(data))
+
+    def display_view_attach(self, v: View, z: int):
+        """
+        把视图附加为图层, 视图拥有独立的离屏缓存, 按叠放次序合成到屏幕上。
+        弹窗显示/隐藏时只重新合成变化区域, 不需要重绘下面的内容。
+        视图对象在图层存在期间必须保持引用。
+
+        Args:
+            v (View): 要附加的视图对象。
+            z (int): 叠放次序, 越大越靠上。
+
+        Returns:
+            int: 成功返回 0, 失败返回 -1。
+        """
+
+        return self.display_so.display_view_attach(self.display_driver, v, z)
+
+    def display_view_detach(self, v: View):
+        """
+        取消视图的图层, 之后该视图重新直接绘制到显示缓存。
+
+        Args:
+            v (View): 要取消的视图对象。
+        """
+
+        self.display_so.display_view_detach(self.display_driver, v)
+
+    def display_view_show(self, v: View, visible: bool):
+        """
+        显示或隐藏视图图层。
+
+        Args:
+            v (View): 图层视图对象。
+            visible (bool): 是否显示。
+
+        Returns:
+            int: 成功返回 0, 视图不是图层返回 -1。
+        """
+
+        return self.display_so.display_view_show(self.display_driver, v, 1 if visible else 0)
+
+    def display_record_start(self, path: str):
+        """
+        开始录制刷新画面, 之后每次刷新的变化区域以差分形式追加到录像文件。
+        录像可用 tools/frame_replay.app 回放或导出为 PPM。
+
+        Args:
+            path (str): 录像文件路径。
+
+        Returns:
+            int: 成功返回 0, 失败返回 -1。
+        """
+
+        return self.display_so.display_record_start(self.display_driver, path.encode())
+
+    def display_record_stop(self):
+        """
+        停止录制刷新画面。
+        """
+
+        self.display_so.display_record_stop(self.display_driver)
+
+    def display_mirror_start(self, addr: str):
+        """
+        开启画面镜像服务, 每次刷新只把变化区域发送给客户端。
+        参考客户端见 tools/mirror_client.app。
+
+        Args:
+            addr (str): 监听地址, `unix:/path` 或 `tcp:[host:]port`。
+
+        Returns:
+            int: 成功返回 0, 失败返回 -1。
+        """
+
+        return self.display_so.display_mirror_start(self.display_driver, addr.encode())
+
+    def display_mirror_stop(self):
+        """
+        关闭画面镜像服务。
+        """
+
+        self.display_so.display_mirror_stop(self.display_driver)
+
+    def display_server_start(self, path: str):
+        """
+        开启显示服务, 其它进程以 `client:PATH@X,Y,WxH,Z` 作为帧缓冲设备创建 Display,
+        在共享内存图层上绘制, 刷新时只提交变化区域, 由本进程合成到屏幕。
+
+        Args:
+            path (str): Unix 套接字路径。
+
+        Returns:
+            int: 成功返回 0, 失败返回 -1。
+        """
+
+        return self.display_so.display_server_start(self.display_driver, path.encode())
+
+    def display_server_stop(self):
+        """
+        关闭显示服务, 断开所有客户端。
+        """
+
+        self.display_so.display_server_stop(self.display_driver)
+
+    def display_meter_start(self, v: View, style: int = Meter.WAVE, fps: int = 0, window: int = 0):
+        """
+        在视图上启动电平控件, 由独立线程按帧率上限只重画并刷新这个视图的区域。
+        控件存在期间 v 必须保持有效。
+
+        Args:
+            v (View): 视图对象。
+            style (int): Meter.BAR 或 Meter.WAVE。
+            fps (int): 帧率上限, 0 使用默认值。
+            window (int): 每个电平的采样数, 0 使用默认值。
+
+        Returns:
+            int: 控件指针, 失败返回 None。
+        """
+
+        return self.display_so.display_meter_start(self.display_driver, v, style, fps, window)
+
+    def display_meter_stop(self, meter: int):
+        """
+        停止电平控件, 视图保留最后一帧画面。
+
+        Args:
+            meter (int): display_meter_start 返回的控件指针。
+        """
+
+        self.display_so.display_meter_stop(self.display_driver, meter)
+
+    def display_anim_start(self, v: View, from_code: str, frames: list[str], period_ms: int):
+        """
+        在视图上启动文字帧动画, 由动画线程按帧间隔切换并只刷新变化的字符,
+        如 "(Listening.)" "(Listening..)"、旋转符号、闪烁光标。
+        开始时清空视图, 动画期间视图由动画线程使用, 不要再打印这个视图, v 必须保持有效。
+
+        Args:
+            v (View): 视图对象。
+            from_code (str): 文字的编码格式。
+            frames (list[str]): 每一帧的文字。
+            period_ms (int): 帧间隔, 毫秒。
+
+        Returns:
+            int: 动画指针, 失败返回 None。
+        """
+
+        data = (c_char_p * len(frames))(*[frame.encode() for frame in frames])
+        return self.display_so.display_anim_start(self.display_driver, v, from_code.encode(), data, len(frames), period_ms)
+
+    def display_anim_stop(self, anim: int):
+        """
+        停止动画, 视图保留最后一帧画面。
+
+        Args:
+            anim (int): display_anim_start 返回的动画指针。
+        """
+
+        self.display_so.display_anim_stop(self.display_driver, anim)
+
+    def meter_push_pcm(self, meter: int, pcm: bytes, channels: int = 1):
+        """
+        送入 16 位 PCM, 只能有一个线程送入。
+
+        Args:
+            meter (int): display_meter_start 返回的控件指针。
+            pcm (bytes): 交错存放的 16 位 PCM。
+            channels (int): 声道数。
+
+        Returns:
+            int: 成功返回 0, 队列满有数据被丢弃返回 -1。
+        """
+
+        return self.display_so.meter_push_pcm(meter, pcm, len(pcm) // (2 * channels), channels)
+
+    def meter_push_level(self, meter: int, level: float):
+        """
+        送入一个已算好的电平, 只能有一个线程送入。
+
+        Args:
+            meter (int): display_meter_start 返回的控件指针。
+            level (float): 0.0 ~ 1.0 对应 RMS 0 ~ 满幅。
+
+        Returns:
+            int: 成功返回 0, 队列满返回 -1。
+        """
+
+        return self.display_so.meter_push_level(meter, level)
+
+    @property
+    def meter_tap(self) -> int:
+        """
+        meter_push_pcm 的函数地址, 传给 AudioCapture.set_tap 后采集线程直接送入 PCM。
+        """
+
+        return cast(self.display_so.meter_push_pcm, c_void_p).value
+
     def __del__(self):
         if self.display_driver:
             self.display_so.display_exit(self.display_driver)
@@ -0,0 +1,399 @@
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "animator.h"
+#include "debug.h"
+
+struct animator_task_t {
+    uint64_t start;              // 开始时间, 帧号从这里算起
+    uint64_t period_ns;          // 帧间隔
+    uint64_t deadline;           // 下一帧的时间
+    animator_tick_fn tick;       // 到期回调
+    void* arg;                   // 传给 tick 的参数
+    size_t round;                // 最近一次执行所在的唤醒轮次
+    struct animator_task_t* next;
+};
+
+struct animator_t {
+    animator_flush_fn flush;     // 刷新回调
+    void* arg;                   // 传给 flush 的参数
+    pthread_mutex_t lock;        // 保护动画列表和统计, 执行 tick/flush 时不持有
+    pthread_cond_t cond;         // 正在执行的 tick 结束
+    animator_task_t* tasks;      // 动画, 按加入顺序
+    animator_task_t* running;    // 正在执行 tick 的动画
+    size_t round;                // 唤醒轮次
+    int timer_fd;                // 唤醒调度线程, 按最早的 deadline 设置
+    pthread_t thread;            // 调度线程
+    int thread_running;          // 调度线程是否已启动
+    int stop;                    // 通知调度线程退出
+    size_t ticks;                // tick 次数
+    size_t flushes;              // flush 次数
+};
+
+static inline uint64_t animator_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief 按最早的 deadline 设置定时器, 没有动画时停止, 需要退出时立即到期. 调用者需持有 a->lock
+ */
+static void animator_arm(animator_t* a)
+{
+    uint64_t deadline = 0;
+    if (a->stop) {
+        deadline = 1;  // 已经过去的时间, 立即到期
+    } else {
+        for (animator_task_t* t = a->tasks; t; t = t->next) {
+            if (!deadline || t->deadline < deadline)
+                deadline = t->deadline;
+        }
+    }
+
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = (time_t)(deadline / 1000000000ULL);
+    its.it_value.tv_nsec = (long)(deadline % 1000000000ULL);
+    if (timerfd_settime(a->timer_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+        LOG_ERR("fail to set timer: %s", strerror(errno));
+}
+
+/**
+ * @brief 调度线程: 执行到期的动画, 有修改时刷新一次, 然后等到下一个 deadline
+ *
+ * @param arg 指向调度器的指针
+ */
+static void* animator_thread(void* arg)
+{
+    animator_t* a = (animator_t*)arg;
+
+    pthread_mutex_lock(&a->lock);
+    while (!a->stop) {
+        uint64_t now = animator_now_ns();
+        int changed = 0;
+        a->round++;
+        for (;;) {
+            // tick 在锁外执行, 期间列表可能变化, 每次从头找本轮还没有执行的到期动画
+            animator_task_t* t = a->tasks;
+            while (t && (t->round == a->round || t->deadline > now + ANIMATOR_SLACK_MS * 1000000ULL))
+                t = t->next;
+            if (!t)
+                break;
+
+            // 提前执行的按本来的帧号, 晚了的跳到当前帧
+            uint64_t at = now > t->deadline ? now : t->deadline;
+            size_t frame = (size_t)((at - t->start) / t->period_ns);
+            t->deadline = t->start + (frame + 1) * t->period_ns;
+            t->round = a->round;
+            a->running = t;
+            pthread_mutex_unlock(&a->lock);
+            int ret = t->tick(t->arg, frame);
+            pthread_mutex_lock(&a->lock);
+            a->running = NULL;
+            pthread_cond_broadcast(&a->cond);
+            changed |= ret;
+            a->ticks++;
+        }
+        if (changed && a->flush) {
+            pthread_mutex_unlock(&a->lock);
+            a->flush(a->arg);
+            pthread_mutex_lock(&a->lock);
+            a->flushes++;
+        }
+        animator_arm(a);
+        pthread_mutex_unlock(&a->lock);
+
+        // 定时器到期或被重新设置为立即到期时返回
+        uint64_t count = 0;
+        if (read(a->timer_fd, &count, sizeof(count)) < 0 && errno != EINTR && errno != EAGAIN) {
+            LOG_ERR("fail to read timer: %s", strerror(errno));
+            usleep(ANIMATOR_SLACK_MS * 1000);
+        }
+        pthread_mutex_lock(&a->lock);
+    }
+    pthread_mutex_unlock(&a->lock);
+
+    return NULL;
+}
+
+/**
+ * 加入动画, 第 0 帧立即调度。
+ *
+ * @param a 指向调度器的指针。
+ * @param period_ms 帧间隔, 毫秒。
+ * @param tick 到期回调。
+ * @param arg 传给 tick 的参数。
+ * @return 成功返回动画指针，失败返回 NULL。
+ */
+animator_task_t* animator_add(animator_t* a, size_t period_ms, animator_tick_fn tick, void* arg)
+{
+    if (!a || !period_ms || !tick) {
+        LOG_DBG("arg failed: a(%p) period(%zu) tick(%p)", a, period_ms, tick);
+        return NULL;
+    }
+
+    animator_task_t* t = (animator_task_t*)malloc(sizeof(animator_task_t));
+    if (!t) {
+        LOG_ERR("fail to malloc animator task");
+        return NULL;
+    }
+    memset(t, 0, sizeof(animator_task_t));
+    t->start = animator_now_ns();
+    t->period_ns = period_ms * 1000000ULL;
+    t->deadline = t->start;
+    t->tick = tick;
+    t->arg = arg;
+
+    pthread_mutex_lock(&a->lock);
+    animator_task_t** pos = &a->tasks;
+    while (*pos)
+        pos = &(*pos)->next;
+    *pos = t;
+    animator_arm(a);
+    pthread_mutex_unlock(&a->lock);
+
+    return t;
+}
+
+/**
+ * 删除动画, 正在执行的 tick 结束后才返回, 返回后不会再调用它的 tick。
+ * 不能在这个动画的 tick 中调用, 调用者不能持有 tick 中会获取的锁。
+ *
+ * @param a 指向调度器的指针。
+ * @param t animator_add 返回的动画指针。
+ */
+void animator_remove(animator_t* a, animator_task_t* t)
+{
+    if (!a || !t)
+        return;
+
+    pthread_mutex_lock(&a->lock);
+    for (animator_task_t** pos = &a->tasks; *pos; pos = &(*pos)->next) {
+        if (*pos == t) {
+            *pos = t->next;
+            while (a->running == t)
+                pthread_cond_wait(&a->cond, &a->lock);
+            free(t);
+            break;
+        }
+    }
+    animator_arm(a);
+    pthread_mutex_unlock(&a->lock);
+}
+
+/**
+ * 获取已调用的 tick 和 flush 次数。
+ *
+ * @param a 指向调度器的指针。
+ * @param ticks 输出 tick 次数, 可以为 NULL。
+ * @param flushes 输出 flush 次数, 可以为 NULL。
+ */
+void animator_get_stat(animator_t* a, size_t* ticks, size_t* flushes)
+{
+    assert(a && "arg failed!");
+    pthread_mutex_lock(&a->lock);
+    if (ticks)
+        *ticks = a->ticks;
+    if (flushes)
+        *flushes = a->flushes;
+    pthread_mutex_unlock(&a->lock);
+}
+
+/**
+ * 停止调度线程并释放调度器和所有动画, 返回后不会再调用 tick/flush。
+ *
+ * @param a 指向调度器的指针。
+ */
+void animator_exit(animator_t* a)
+{
+    if (!a)
+        return;
+
+    if (a->thread_running) {
+        pthread_mutex_lock(&a->lock);
+        a->stop = 1;
+        animator_arm(a);
+        pthread_mutex_unlock(&a->lock);
+        pthread_join(a->thread, NULL);
+        a->thread_running = 0;
+    }
+    while (a->tasks) {
+        animator_task_t* next = a->tasks->next;
+        free(a->tasks);
+        a->tasks = next;
+    }
+    if (a->timer_fd >= 0) {
+        close(a->timer_fd);
+        a->timer_fd = -1;
+    }
+    pthread_cond_destroy(&a->cond);
+    pthread_mutex_destroy(&a->lock);
+    free(a);
+}
+
+/**
+ * 创建调度器并启动调度线程。
+ *
+ * @param flush 刷新回调, 可以为 NULL。
+ * @param arg 传给 flush 的参数。
+ * @return 成功返回调度器指针，失败返回 NULL。
+ */
+animator_t* animator_init(animator_flush_fn flush, void* arg)
+{
+    animator_t* a = (animator_t*)malloc(sizeof(animator_t));
+    if (!a) {
+        LOG_ERR("fail to malloc animator");
+        return NULL;
+    }
+    memset(a, 0, sizeof(animator_t));
+    a->flush = flush;
+    a->arg = arg;
+    pthread_mutex_init(&a->lock, NULL);
+    pthread_cond_init(&a->cond, NULL);
+
+    a->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (a->timer_fd < 0) {
+        LOG_ERR("fail to create timerfd: %s", strerror(errno));
+        goto err;
+    }
+
+    if (pthread_create(&a->thread, NULL, animator_thread, a)) {
+        LOG_ERR("fail to create animator thread");
+        goto err;
+    }
+    a->thread_running = 1;
+
+    LOG_DBG("animator(%p) start", a);
+
+    return a;
+err:
+    animator_exit(a);
+    return NULL;
+}
+
+#ifdef __XTEST__
+
+char g_dbg_enable = 1;
+
+#define TEST_FRAMES (64)
+
+typedef struct test_task_t {
+    pthread_mutex_t* lock;
+    size_t frames[TEST_FRAMES];
+    size_t count;
+    int changed;              // tick 的返回值
+    useconds_t busy_us;       // tick 中停留的时间, 模拟绘制很慢
+} test_task_t;
+
+typedef struct test_ctx_t {
+    pthread_mutex_t lock;
+    size_t flushes;
+} test_ctx_t;
+
+static int test_tick(void* arg, size_t frame)
+{
+    test_task_t* t = (test_task_t*)arg;
+    pthread_mutex_lock(t->lock);
+    if (t->count < TEST_FRAMES)
+        t->frames[t->count++] = frame;
+    pthread_mutex_unlock(t->lock);
+    if (t->busy_us)
+        usleep(t->busy_us);
+    return t->changed;
+}
+
+static void test_flush(void* arg)
+{
+    test_ctx_t* ctx = (test_ctx_t*)arg;
+    pthread_mutex_lock(&ctx->lock);
+    ctx->flushes++;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+static size_t test_count(test_ctx_t* ctx, test_task_t* t)
+{
+    pthread_mutex_lock(&ctx->lock);
+    size_t n = t->count;
+    pthread_mutex_unlock(&ctx->lock);
+    return n;
+}
+
+int main(void)
+{
+    test_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    pthread_mutex_init(&ctx.lock, NULL);
+
+    animator_t* a = animator_init(test_flush, &ctx);
+    assert(a);
+    assert(!animator_add(a, 0, test_tick, NULL) && !animator_add(a, 10, NULL, NULL));
+
+    // 第 0 帧立即执行, 之后按各自的间隔, 帧号递增
+    test_task_t fast, slow, idle;
+    memset(&fast, 0, sizeof(fast));
+    memset(&slow, 0, sizeof(slow));
+    memset(&idle, 0, sizeof(idle));
+    fast.lock = slow.lock = idle.lock = &ctx.lock;
+    fast.changed = slow.changed = 1;
+    animator_task_t* tf = animator_add(a, 20, test_tick, &fast);
+    animator_task_t* ts = animator_add(a, 50, test_tick, &slow);
+    animator_task_t* ti = animator_add(a, 20, test_tick, &idle);
+    assert(tf && ts && ti);
+    usleep(230 * 1000);
+    animator_remove(a, tf);
+    animator_remove(a, ts);
+    animator_remove(a, ti);
+    size_t nf = test_count(&ctx, &fast);
+    size_t ns = test_count(&ctx, &slow);
+    printf("fast %zu frames, slow %zu frames, %zu flushes\n", nf, ns, ctx.flushes);
+    assert(nf >= 4 && nf <= 16 && ns >= 2 && ns <= 8 && nf > ns);
+    assert(fast.frames[0] == 0 && slow.frames[0] == 0);
+    for (size_t i = 1; i < nf; ++i)
+        assert(fast.frames[i] > fast.frames[i - 1]);
+    for (size_t i = 1; i < ns; ++i)
+        assert(slow.frames[i] > slow.frames[i - 1]);
+
+    // 同时到期的只刷新一次; 没有修改画面的动画不刷新
+    size_t ticks = 0, flushes = 0;
+    animator_get_stat(a, &ticks, &flushes);
+    assert(flushes == ctx.flushes && flushes < nf + ns && flushes >= nf);
+    assert(test_count(&ctx, &idle) >= 4);
+
+    // 删除后不再调用
+    usleep(60 * 1000);
+    assert(test_count(&ctx, &fast) == nf && test_count(&ctx, &slow) == ns);
+    animator_get_stat(a, NULL, &flushes);
+    assert(flushes == ctx.flushes);
+
+    // tick 比帧间隔慢时跳过错过的帧
+    test_task_t late;
+    memset(&late, 0, sizeof(late));
+    late.lock = &ctx.lock;
+    late.busy_us = 35 * 1000;
+    animator_task_t* tl = animator_add(a, 10, test_tick, &late);
+    usleep(200 * 1000);
+    animator_remove(a, tl);
+    size_t nl = test_count(&ctx, &late);
+    assert(nl >= 2 && nl <= 9);
+    for (size_t i = 1; i < nl; ++i)
+        assert(late.frames[i] >= late.frames[i - 1] + 3);
+
+    // 退出时还有动画也能释放
+    assert(animator_add(a, 10, test_tick, &idle));
+    animator_exit(a);
+    pthread_mutex_destroy(&ctx.lock);
+
+    printf("animator test pass\n");
+    return 0;
+}
+
+#endif //__XTEST__
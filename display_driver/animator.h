@@ -0,0 +1,94 @@
+#ifndef __ANIMATOR_H__
+#define __ANIMATOR_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 功能: 动画调度器. 一个线程用一个 timerfd 驱动所有动画, 每个动画有自己的帧间隔,
+// 定时器只按最早到期的动画设置, 没有动画时不唤醒. 同一次唤醒中到期(含 ANIMATOR_SLACK_MS 内将到期)
+// 的动画依次调用 tick, 之后只调用一次 flush, 多个动画的刷新合并为一次.
+// 线程来不及时跳过错过的帧, 帧号始终按开始以来经过的时间计算.
+//
+// example:
+//   animator_t* a = animator_init(flush, ctx);
+//   animator_task_t* t = animator_add(a, 400, tick, arg);
+//   animator_remove(a, t);
+//   animator_exit(a);
+
+#define ANIMATOR_SLACK_MS (4)  // 提前这么久内将到期的动画合并到本次唤醒
+
+/**
+ * 动画到期, 在调度线程中调用。
+ *
+ * @param arg animator_add 传入的参数。
+ * @param frame 帧号, 开始时为 0, 之后为开始以来经过的帧间隔数。
+ * @return 画面有修改返回 1, 否则返回 0。
+ */
+typedef int (*animator_tick_fn)(void* arg, size_t frame);
+
+/**
+ * 一次唤醒中有动画修改了画面, 在所有到期的 tick 之后调用一次。
+ *
+ * @param arg animator_init 传入的参数。
+ */
+typedef void (*animator_flush_fn)(void* arg);
+
+struct animator_t;
+typedef struct animator_t animator_t;
+struct animator_task_t;
+typedef struct animator_task_t animator_task_t;
+
+/**
+ * 创建调度器并启动调度线程。
+ *
+ * @param flush 刷新回调, 可以为 NULL。
+ * @param arg 传给 flush 的参数。
+ * @return 成功返回调度器指针，失败返回 NULL。
+ */
+animator_t* animator_init(animator_flush_fn flush, void* arg);
+
+/**
+ * 停止调度线程并释放调度器和所有动画, 返回后不会再调用 tick/flush。
+ *
+ * @param a 指向调度器的指针。
+ */
+void animator_exit(animator_t* a);
+
+/**
+ * 加入动画, 第 0 帧立即调度。
+ *
+ * @param a 指向调度器的指针。
+ * @param period_ms 帧间隔, 毫秒。
+ * @param tick 到期回调。
+ * @param arg 传给 tick 的参数。
+ * @return 成功返回动画指针，失败返回 NULL。
+ */
+animator_task_t* animator_add(animator_t* a, size_t period_ms, animator_tick_fn tick, void* arg);
+
+/**
+ * 删除动画, 正在执行的 tick 结束后才返回, 返回后不会再调用它的 tick。
+ * 不能在这个动画的 tick 中调用, 调用者不能持有 tick 中会获取的锁。
+ *
+ * @param a 指向调度器的指针。
+ * @param t animator_add 返回的动画指针。
+ */
+void animator_remove(animator_t* a, animator_task_t* t);
+
+/**
+ * 获取已调用的 tick 和 flush 次数。
+ *
+ * @param a 指向调度器的指针。
+ * @param ticks 输出 tick 次数, 可以为 NULL。
+ * @param flushes 输出 flush 次数, 可以为 NULL。
+ */
+void animator_get_stat(animator_t* a, size_t* ticks, size_t* flushes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__ANIMATOR_H__
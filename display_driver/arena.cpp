@@ -0,0 +1,173 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "debug.h"
+
+#define ARENA_ALIGN_UP(x) (((x) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+/**
+ * @brief 申请一个块, 块头和数据放在同一次申请的内存里
+ */
+static arena_block_t* arena_block_new(size_t size)
+{
+    size = ARENA_ALIGN_UP(size);
+    arena_block_t* b = (arena_block_t*)malloc(ARENA_ALIGN_UP(sizeof(arena_block_t)) + size + ARENA_ALIGN);
+    if (!b) {
+        LOG_ERR("fail to malloc arena block(%zu)", size);
+        return NULL;
+    }
+    b->next = NULL;
+    b->size = size;
+    b->used = 0;
+    b->data = (uint8_t*)ARENA_ALIGN_UP((uintptr_t)b + sizeof(arena_block_t));
+    return b;
+}
+
+/**
+ * 分配临时内存, 按 ARENA_ALIGN 对齐, 下次 arena_reset 前有效。
+ *
+ * @param a 指向内存池的指针。
+ * @param size 字节数。
+ * @return 成功返回内存地址，失败返回 NULL。
+ */
+void* arena_alloc(arena_t* a, size_t size)
+{
+    if (!a)
+        return NULL;
+
+    size = ARENA_ALIGN_UP(size ? size : 1);
+    arena_block_t* b = a->head;
+    if (b->size - b->used < size) {
+        // 追加块按 2 倍增长, 至少容纳这次申请
+        size_t grow = b->size * 2;
+        b = arena_block_new(grow > size ? grow : size);
+        if (!b)
+            return NULL;
+        b->next = a->head;
+        a->head = b;
+        a->grows++;
+    }
+
+    void* p = b->data + b->used;
+    b->used += size;
+    a->total += size;
+    return p;
+}
+
+/**
+ * 回收本轮分配的全部临时内存。用到了追加块时合并成一个能容纳本轮总量的块。
+ *
+ * @param a 指向内存池的指针。
+ */
+void arena_reset(arena_t* a)
+{
+    if (!a)
+        return;
+
+    if (a->head->next) {
+        size_t size = a->head->size;
+        while (size < a->total)
+            size *= 2;
+        arena_block_t* b = arena_block_new(size);
+        if (b) {
+            while (a->head) {
+                arena_block_t* next = a->head->next;
+                free(a->head);
+                a->head = next;
+            }
+            a->head = b;
+            a->grows++;
+        } else {
+            // 合并失败时保留所有块, 下一轮继续使用
+            for (arena_block_t* p = a->head; p; p = p->next)
+                p->used = 0;
+        }
+    }
+    a->head->used = 0;
+    a->total = 0;
+}
+
+/**
+ * 释放临时内存池。
+ *
+ * @param a 指向内存池的指针。
+ */
+void arena_exit(arena_t* a)
+{
+    if (!a)
+        return;
+    while (a->head) {
+        arena_block_t* next = a->head->next;
+        free(a->head);
+        a->head = next;
+    }
+    free(a);
+}
+
+/**
+ * 创建临时内存池。
+ *
+ * @param size 初始大小。
+ * @return 成功返回内存池指针，失败返回 NULL。
+ */
+arena_t* arena_init(size_t size)
+{
+    assert(size && "arg failed!");
+
+    arena_t* a = (arena_t*)malloc(sizeof(arena_t));
+    if (!a) {
+        LOG_ERR("fail to malloc arena");
+        return NULL;
+    }
+    memset(a, 0, sizeof(arena_t));
+    a->head = arena_block_new(size);
+    if (!a->head) {
+        free(a);
+        return NULL;
+    }
+
+    return a;
+}
+
+#ifdef __XTEST__
+
+char g_dbg_enable = 1;
+
+int main(void)
+{
+    arena_t* a = arena_init(64);
+    assert(a && a->head->size == 64);
+
+    // 对齐
+    char* p1 = (char*)arena_alloc(a, 3);
+    char* p2 = (char*)arena_alloc(a, 5);
+    assert(p1 && p2 && p2 - p1 == ARENA_ALIGN);
+    assert((uintptr_t)p1 % ARENA_ALIGN == 0);
+    memset(p1, 0xaa, 3);
+
+    // 超出后追加块, 之前的内存保持有效
+    char* big = (char*)arena_alloc(a, 200);
+    assert(big && a->grows == 1 && a->head->next);
+    memset(big, 0x55, 200);
+    assert((uint8_t)p1[0] == 0xaa);
+
+    // reset 时合并, 同样规模不再增长
+    arena_reset(a);
+    assert(!a->head->next && a->head->size >= 16 + 16 + 208);
+    size_t grows = a->grows;
+    for (int round = 0; round < 10; ++round) {
+        assert(arena_alloc(a, 3) && arena_alloc(a, 5) && arena_alloc(a, 200));
+        arena_reset(a);
+    }
+    assert(a->grows == grows);
+
+    arena_exit(a);
+
+    printf("arena test pass\n");
+    return 0;
+}
+
+#endif //__XTEST__
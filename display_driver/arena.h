@@ -0,0 +1,73 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 功能: 临时内存池, 用于一次调用内的临时内存(转码输出等).
+// 分配只移动指针, 不单独释放, 调用结束后 arena_reset 整体回收.
+// 当前块不够时临时追加新块(按 2 倍增长), reset 时把所有块合并成一个足够大的块,
+// 之后同样规模的调用不再向系统申请内存.
+//
+// example:
+//   arena_t* a = arena_init(1024);
+//   char* buf = (char*)arena_alloc(a, len * 2);
+//   ...
+//   arena_reset(a);
+//   arena_exit(a);
+
+#define ARENA_ALIGN (16)  // 分配对齐字节数
+
+typedef struct arena_block_t {
+    struct arena_block_t* next;  // 下一个追加块
+    size_t size;                 // 可用大小
+    size_t used;                 // 已用大小
+    uint8_t* data;               // 数据地址, 已按 ARENA_ALIGN 对齐
+} arena_block_t;
+
+typedef struct arena_t {
+    arena_block_t* head;  // 当前使用的块, 链表尾部为主块
+    size_t total;         // 本轮(上次 reset 以来)分配的总字节数
+    size_t grows;         // 向系统申请新块的次数, 用于统计
+} arena_t;
+
+/**
+ * 创建临时内存池。
+ *
+ * @param size 初始大小。
+ * @return 成功返回内存池指针，失败返回 NULL。
+ */
+arena_t* arena_init(size_t size);
+
+/**
+ * 释放临时内存池。
+ *
+ * @param a 指向内存池的指针。
+ */
+void arena_exit(arena_t* a);
+
+/**
+ * 分配临时内存, 按 ARENA_ALIGN 对齐, 下次 arena_reset 前有效。
+ *
+ * @param a 指向内存池的指针。
+ * @param size 字节数。
+ * @return 成功返回内存地址，失败返回 NULL。
+ */
+void* arena_alloc(arena_t* a, size_t size);
+
+/**
+ * 回收本轮分配的全部临时内存。用到了追加块时合并成一个能容纳本轮总量的块。
+ *
+ * @param a 指向内存池的指针。
+ */
+void arena_reset(arena_t* a);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__ARENA_H__
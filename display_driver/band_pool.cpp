@@ -0,0 +1,303 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "band_pool.h"
+#include "debug.h"
+
+// 每个参与线程待执行的条带序号 [begin, end), 打包在一个 64 位整数里,
+// 低 32 位为 begin, 高 32 位为 end, 取和偷都用一次 CAS 完成
+typedef struct band_queue_t {
+    uint64_t range;
+    uint8_t pad[64 - sizeof(uint64_t)]; // 独占一个缓存行, 避免伪共享
+} band_queue_t;
+
+struct band_pool_t {
+    size_t workers;          // 工作线程个数
+    pthread_t* threads;      // 工作线程
+    band_queue_t* queues;    // 参与线程的条带序号, [0] 为调用线程
+    pthread_mutex_t lock;    // 保护以下字段
+    pthread_cond_t start;    // 有新任务或需要退出
+    pthread_cond_t done;     // 工作线程完成当前任务
+    uint64_t generation;     // 任务序号, 每次 band_pool_run 加一
+    size_t pending;          // 当前任务还没完成的工作线程个数
+    int quit;                // 是否退出
+    band_pool_fn fn;         // 当前任务的条带执行函数
+    void* arg;               // 当前任务的参数
+};
+
+typedef struct band_worker_arg_t {
+    band_pool_t* pool;
+    size_t slot;
+} band_worker_arg_t;
+
+static inline uint64_t band_range_pack(uint32_t begin, uint32_t end)
+{
+    return (uint64_t)end << 32 | begin;
+}
+
+/**
+ * @brief 从自己的条带序号开头取一个
+ *
+ * @return 成功返回 0, 没有剩余返回 -1
+ */
+static int band_queue_pop(band_queue_t* q, size_t* band)
+{
+    uint64_t r = __atomic_load_n(&q->range, __ATOMIC_ACQUIRE);
+    for (;;) {
+        uint32_t begin = (uint32_t)r, end = (uint32_t)(r >> 32);
+        if (begin >= end)
+            return -1;
+        if (__atomic_compare_exchange_n(&q->range, &r, band_range_pack(begin + 1, end), 0,
+                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            *band = begin;
+            return 0;
+        }
+    }
+}
+
+/**
+ * @brief 从其它线程的条带序号末尾偷一个
+ *
+ * @return 成功返回 0, 没有剩余返回 -1
+ */
+static int band_queue_steal(band_queue_t* q, size_t* band)
+{
+    uint64_t r = __atomic_load_n(&q->range, __ATOMIC_ACQUIRE);
+    for (;;) {
+        uint32_t begin = (uint32_t)r, end = (uint32_t)(r >> 32);
+        if (begin >= end)
+            return -1;
+        if (__atomic_compare_exchange_n(&q->range, &r, band_range_pack(begin, end - 1), 0,
+                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            *band = end - 1;
+            return 0;
+        }
+    }
+}
+
+/**
+ * @brief 执行自己的条带, 做完后依次偷其它线程剩下的条带
+ */
+static void band_pool_work(band_pool_t* p, size_t slot)
+{
+    size_t n = p->workers + 1;
+    size_t band = 0;
+    while (0 == band_queue_pop(&p->queues[slot], &band))
+        p->fn(p->arg, band);
+    // 各线程的剩余条带只减不增, 按顺序偷空一个再换下一个即可
+    for (size_t k = 1; k < n; ++k) {
+        band_queue_t* victim = &p->queues[(slot + k) % n];
+        while (0 == band_queue_steal(victim, &band))
+            p->fn(p->arg, band);
+    }
+}
+
+static void* band_pool_thread(void* arg)
+{
+    band_worker_arg_t* wa = (band_worker_arg_t*)arg;
+    band_pool_t* p = wa->pool;
+    size_t slot = wa->slot;
+    free(wa);
+
+    uint64_t seen = 0;
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        while (!p->quit && p->generation == seen)
+            pthread_cond_wait(&p->start, &p->lock);
+        if (p->quit)
+            break;
+        seen = p->generation;
+        pthread_mutex_unlock(&p->lock);
+
+        band_pool_work(p, slot);
+
+        pthread_mutex_lock(&p->lock);
+        if (0 == --p->pending)
+            pthread_cond_signal(&p->done);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+/**
+ * 执行 count 个条带, 调用线程也参与执行, 全部完成后返回。
+ * 同一个线程池同时只能有一个调用者。
+ *
+ * @param p 指向线程池的指针, NULL 时在调用线程中依次执行。
+ * @param count 条带个数。
+ * @param fn 条带执行函数。
+ * @param arg 传给 fn 的参数。
+ */
+void band_pool_run(band_pool_t* p, size_t count, band_pool_fn fn, void* arg)
+{
+    assert(fn && "arg failed!");
+    if (!p || !p->workers || count <= 1) {
+        for (size_t i = 0; i < count; ++i)
+            fn(arg, i);
+        return;
+    }
+
+    size_t n = p->workers + 1;
+    for (size_t s = 0; s < n; ++s) {
+        uint32_t begin = (uint32_t)(count * s / n);
+        uint32_t end = (uint32_t)(count * (s + 1) / n);
+        __atomic_store_n(&p->queues[s].range, band_range_pack(begin, end), __ATOMIC_RELAXED);
+    }
+
+    pthread_mutex_lock(&p->lock);
+    p->fn = fn;
+    p->arg = arg;
+    p->pending = p->workers;
+    p->generation++;
+    pthread_cond_broadcast(&p->start);
+    pthread_mutex_unlock(&p->lock);
+
+    band_pool_work(p, 0);
+
+    pthread_mutex_lock(&p->lock);
+    while (p->pending)
+        pthread_cond_wait(&p->done, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+}
+
+/**
+ * 获取参与执行的线程个数(工作线程 + 调用线程)。
+ *
+ * @param p 指向线程池的指针, NULL 返回 1。
+ * @return 线程个数。
+ */
+size_t band_pool_threads(const band_pool_t* p)
+{
+    return p ? p->workers + 1 : 1;
+}
+
+/**
+ * 停止并释放线程池。
+ *
+ * @param p 指向线程池的指针。
+ */
+void band_pool_exit(band_pool_t* p)
+{
+    if (!p)
+        return;
+
+    pthread_mutex_lock(&p->lock);
+    p->quit = 1;
+    pthread_cond_broadcast(&p->start);
+    pthread_mutex_unlock(&p->lock);
+    for (size_t i = 0; i < p->workers; ++i)
+        pthread_join(p->threads[i], NULL);
+
+    pthread_cond_destroy(&p->done);
+    pthread_cond_destroy(&p->start);
+    pthread_mutex_destroy(&p->lock);
+    free(p->queues);
+    free(p->threads);
+    free(p);
+}
+
+/**
+ * 创建线程池。
+ *
+ * @param workers 工作线程个数, 不含调用线程。
+ * @return 成功返回线程池指针，失败返回 NULL。
+ */
+band_pool_t* band_pool_init(size_t workers)
+{
+    band_pool_t* p = (band_pool_t*)malloc(sizeof(band_pool_t));
+    if (!p) {
+        LOG_ERR("fail to malloc band pool");
+        return NULL;
+    }
+    memset(p, 0, sizeof(band_pool_t));
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->start, NULL);
+    pthread_cond_init(&p->done, NULL);
+
+    p->threads = (pthread_t*)calloc(workers ? workers : 1, sizeof(pthread_t));
+    if (posix_memalign((void**)&p->queues, sizeof(band_queue_t), (workers + 1) * sizeof(band_queue_t)))
+        p->queues = NULL;
+    if (!p->threads || !p->queues) {
+        LOG_ERR("fail to malloc band pool(%zu)", workers);
+        band_pool_exit(p);
+        return NULL;
+    }
+    memset(p->queues, 0, (workers + 1) * sizeof(band_queue_t));
+
+    for (size_t i = 0; i < workers; ++i) {
+        band_worker_arg_t* wa = (band_worker_arg_t*)malloc(sizeof(band_worker_arg_t));
+        if (wa) {
+            wa->pool = p;
+            wa->slot = i + 1;
+        }
+        if (!wa || pthread_create(&p->threads[i], NULL, band_pool_thread, wa)) {
+            LOG_ERR("fail to create band worker %zu", i);
+            free(wa);
+            band_pool_exit(p);
+            return NULL;
+        }
+        p->workers++;
+    }
+    LOG_DBG("band pool(%p) start %zu workers", p, p->workers);
+
+    return p;
+}
+
+#ifdef __XTEST__
+
+#include <unistd.h>
+
+char g_dbg_enable = 1;
+
+typedef struct test_ctx_t {
+    size_t runs[256];
+    pthread_t who[256];
+} test_ctx_t;
+
+static void test_band(void* arg, size_t band)
+{
+    test_ctx_t* ctx = (test_ctx_t*)arg;
+    __atomic_add_fetch(&ctx->runs[band], 1, __ATOMIC_RELAXED);
+    ctx->who[band] = pthread_self();
+    // 前面的条带慢, 让后面的线程有机会来偷
+    if (band < 4)
+        usleep(2000);
+}
+
+int main(void)
+{
+    for (size_t workers = 0; workers <= 4; ++workers) {
+        band_pool_t* p = band_pool_init(workers);
+        assert(p && band_pool_threads(p) == workers + 1);
+        for (size_t count = 0; count <= 256; count += 1 + count / 3) {
+            test_ctx_t ctx;
+            memset(&ctx, 0, sizeof(ctx));
+            band_pool_run(p, count, test_band, &ctx);
+            for (size_t i = 0; i < 256; ++i)
+                assert(ctx.runs[i] == (i < count ? 1U : 0U));
+        }
+        band_pool_exit(p);
+    }
+
+    // 调用线程的前几个条带很慢, 它的后半段应该被工作线程偷走
+    band_pool_t* p = band_pool_init(1);
+    test_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    band_pool_run(p, 16, test_band, &ctx);
+    assert(!pthread_equal(ctx.who[7], pthread_self()));
+    band_pool_exit(p);
+
+    // NULL 时在调用线程中执行
+    memset(&ctx, 0, sizeof(ctx));
+    band_pool_run(NULL, 3, test_band, &ctx);
+    assert(ctx.runs[0] == 1 && ctx.runs[2] == 1 && pthread_equal(ctx.who[2], pthread_self()));
+    assert(band_pool_threads(NULL) == 1);
+
+    printf("band pool test pass\n");
+    return 0;
+}
+
+#endif //__XTEST__
@@ -0,0 +1,70 @@
+#ifndef __BAND_POOL_H__
+#define __BAND_POOL_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 功能: 常驻线程池, 把一次绘制按水平条带(band)分给多个线程并行执行.
+// 每个参与线程(含调用线程)先分到一段连续的条带序号, 从自己那段的开头取,
+// 做完后从其它线程那段的末尾偷取, 条带耗时不均时不会有线程空等.
+// band_pool_run 返回时所有条带都已完成. 条带之间写入的区域互不重叠时结果与执行顺序无关.
+//
+// example:
+//   band_pool_t* p = band_pool_init(3);
+//   band_pool_run(p, 16, draw_band, ctx);  // draw_band(ctx, 0..15)
+//   band_pool_exit(p);
+
+/**
+ * 执行一个条带。
+ *
+ * @param arg band_pool_run 传入的参数。
+ * @param band 条带序号。
+ */
+typedef void (*band_pool_fn)(void* arg, size_t band);
+
+struct band_pool_t;
+typedef struct band_pool_t band_pool_t;
+
+/**
+ * 创建线程池。
+ *
+ * @param workers 工作线程个数, 不含调用线程。
+ * @return 成功返回线程池指针，失败返回 NULL。
+ */
+band_pool_t* band_pool_init(size_t workers);
+
+/**
+ * 停止并释放线程池。
+ *
+ * @param p 指向线程池的指针。
+ */
+void band_pool_exit(band_pool_t* p);
+
+/**
+ * 获取参与执行的线程个数(工作线程 + 调用线程)。
+ *
+ * @param p 指向线程池的指针, NULL 返回 1。
+ * @return 线程个数。
+ */
+size_t band_pool_threads(const band_pool_t* p);
+
+/**
+ * 执行 count 个条带, 调用线程也参与执行, 全部完成后返回。
+ * 同一个线程池同时只能有一个调用者。
+ *
+ * @param p 指向线程池的指针, NULL 时在调用线程中依次执行。
+ * @param count 条带个数。
+ * @param fn 条带执行函数。
+ * @param arg 传给 fn 的参数。
+ */
+void band_pool_run(band_pool_t* p, size_t count, band_pool_fn fn, void* arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__BAND_POOL_H__
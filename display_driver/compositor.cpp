@@ -0,0 +1,358 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "compositor.h"
+#include "debug.h"
+
+typedef struct compositor_t {
+    size_t width;               // 屏幕宽度
+    size_t height;              // 屏幕高度
+    size_t count;               // 图层个数
+    compositor_layer_t* layers; // 图层链表, 按 z 从小到大
+} compositor_t;
+
+/**
+ * @brief 把图层按 z 插入链表, z 相同时放在最后
+ */
+static void compositor_link(compositor_t* c, compositor_layer_t* l)
+{
+    compositor_layer_t** pos = &c->layers;
+    while (*pos && (*pos)->z <= l->z)
+        pos = &(*pos)->next;
+    l->next = *pos;
+    *pos = l;
+}
+
+/**
+ * @brief 把图层从链表中摘下
+ */
+static void compositor_unlink(compositor_t* c, compositor_layer_t* l)
+{
+    for (compositor_layer_t** pos = &c->layers; *pos; pos = &(*pos)->next) {
+        if (*pos == l) {
+            *pos = l->next;
+            l->next = NULL;
+            return;
+        }
+    }
+}
+
+/**
+ * @brief 求两个矩形的交集, 结果为空时 w/h 为 0
+ */
+static inline void compositor_rect_intersect(frame_rect_t* dst, const frame_rect_t* r)
+{
+    uint32_t x0 = dst->x > r->x ? dst->x : r->x;
+    uint32_t y0 = dst->y > r->y ? dst->y : r->y;
+    uint32_t x1 = dst->x + dst->w < r->x + r->w ? dst->x + dst->w : r->x + r->w;
+    uint32_t y1 = dst->y + dst->h < r->y + r->h ? dst->y + dst->h : r->y + r->h;
+    dst->x = x0;
+    dst->y = y0;
+    dst->w = x1 > x0 ? x1 - x0 : 0;
+    dst->h = y1 > y0 ? y1 - y0 : 0;
+}
+
+/**
+ * 获取图层在屏幕上的可见区域。
+ *
+ * @param c 指向合成器的指针。
+ * @param l 指向图层的指针。
+ * @param r 输出图层矩形, 已裁剪到屏幕范围内。
+ */
+void compositor_layer_rect(compositor_t* c, const compositor_layer_t* l, frame_rect_t* r)
+{
+    assert(c && l && r && "arg failed!");
+    r->x = l->x;
+    r->y = l->y;
+    r->w = l->width;
+    r->h = l->height;
+    frame_rect_clip(r, c->width, c->height);
+}
+
+/**
+ * 添加图层, 默认显示。z 相同时后添加的在上面。
+ *
+ * @param c 指向合成器的指针。
+ * @param key 图层所属对象, 用于查找。
+ * @param x 图层在屏幕上的 x 位置。
+ * @param y 图层在屏幕上的 y 位置。
+ * @param width 图层宽。
+ * @param height 图层高。
+ * @param z 叠放次序。
+ * @param surface 外部离屏缓存, 为 NULL 时由合成器分配并清为黑色。
+ * @param stride 外部离屏缓存每行字节数, surface 为 NULL 时忽略。
+ * @return 成功返回图层指针，失败返回 NULL。
+ */
+compositor_layer_t* compositor_layer_add(compositor_t* c, const void* key, size_t x, size_t y,
+    size_t width, size_t height, int z, framebuffer_color_t* surface, size_t stride)
+{
+    if (!c || !width || !height)
+        return NULL;
+
+    compositor_layer_t* l = (compositor_layer_t*)malloc(sizeof(compositor_layer_t));
+    if (!l) {
+        LOG_ERR("fail to malloc layer");
+        return NULL;
+    }
+    memset(l, 0, sizeof(compositor_layer_t));
+    l->key = key;
+    l->z = z;
+    l->visible = 1;
+    l->x = x;
+    l->y = y;
+    l->width = width;
+    l->height = height;
+
+    if (surface) {
+        l->surface = surface;
+        l->stride = stride;
+    } else {
+        l->stride = width * COLOR_SIZE;
+        l->surface = (framebuffer_color_t*)calloc(width * height, COLOR_SIZE);
+        if (!l->surface) {
+            LOG_ERR("fail to malloc layer surface(%zux%zu)", width, height);
+            free(l);
+            return NULL;
+        }
+        l->own_surface = 1;
+    }
+
+    compositor_link(c, l);
+    c->count++;
+    LOG_DBG("compositor(%p) add layer(%p) (%zu, %zu, %zu, %zu) z(%d)",
+        c, l, x, y, width, height, z);
+
+    return l;
+}
+
+/**
+ * 删除图层, 释放合成器分配的离屏缓存。
+ *
+ * @param c 指向合成器的指针。
+ * @param l 指向图层的指针。
+ */
+void compositor_layer_remove(compositor_t* c, compositor_layer_t* l)
+{
+    if (!c || !l)
+        return;
+    compositor_unlink(c, l);
+    c->count--;
+    if (l->own_surface)
+        free(l->surface);
+    free(l);
+}
+
+/**
+ * 按所属对象查找图层。
+ *
+ * @param c 指向合成器的指针。
+ * @param key 图层所属对象。
+ * @return 找到返回图层指针，否则返回 NULL。
+ */
+compositor_layer_t* compositor_layer_find(compositor_t* c, const void* key)
+{
+    if (!c)
+        return NULL;
+    for (compositor_layer_t* l = c->layers; l; l = l->next) {
+        if (l->key == key)
+            return l;
+    }
+    return NULL;
+}
+
+/**
+ * 修改图层叠放次序。
+ *
+ * @param c 指向合成器的指针。
+ * @param l 指向图层的指针。
+ * @param z 新的叠放次序。
+ */
+void compositor_layer_set_z(compositor_t* c, compositor_layer_t* l, int z)
+{
+    if (!c || !l)
+        return;
+    compositor_unlink(c, l);
+    l->z = z;
+    compositor_link(c, l);
+}
+
+/**
+ * 获取图层个数。
+ *
+ * @param c 指向合成器的指针。
+ * @return 图层个数。
+ */
+size_t compositor_layer_count(compositor_t* c)
+{
+    return c ? c->count : 0;
+}
+
+/**
+ * 重新合成指定区域: 先拷贝底图, 再按 z 从小到大叠加可见图层。
+ * 底图与输出每行都是 width 个像素。
+ *
+ * @param c 指向合成器的指针。
+ * @param base 底图。
+ * @param out 合成输出。
+ * @param damage 需要重新合成的区域, 会被裁剪到屏幕范围内。
+ */
+void compositor_compose(compositor_t* c, const framebuffer_color_t* base,
+    framebuffer_color_t* out, const frame_rect_t* damage)
+{
+    if (!c || !base || !out || !damage)
+        return;
+
+    frame_rect_t d = *damage;
+    frame_rect_clip(&d, c->width, c->height);
+    if (frame_rect_empty(&d))
+        return;
+
+    for (uint32_t y = d.y; y < d.y + d.h && base != out; ++y) {
+        size_t offset = y * c->width + d.x;
+        memcpy(out + offset, base + offset, d.w * COLOR_SIZE);
+    }
+
+    for (compositor_layer_t* l = c->layers; l; l = l->next) {
+        if (!l->visible)
+            continue;
+        frame_rect_t r;
+        compositor_layer_rect(c, l, &r);
+        compositor_rect_intersect(&r, &d);
+        if (frame_rect_empty(&r))
+            continue;
+
+        const uint8_t* src = (const uint8_t*)l->surface
+            + (r.y - l->y) * l->stride + (r.x - l->x) * COLOR_SIZE;
+        for (uint32_t y = r.y; y < r.y + r.h; ++y, src += l->stride)
+            memcpy(out + y * c->width + r.x, src, r.w * COLOR_SIZE);
+    }
+}
+
+/**
+ * 释放合成器及其分配的所有离屏缓存。
+ *
+ * @param c 指向合成器的指针。
+ */
+void compositor_exit(compositor_t* c)
+{
+    if (!c)
+        return;
+    while (c->layers)
+        compositor_layer_remove(c, c->layers);
+    free(c);
+}
+
+/**
+ * 创建合成器。
+ *
+ * @param width 屏幕宽度。
+ * @param height 屏幕高度。
+ * @return 成功返回合成器指针，失败返回 NULL。
+ */
+compositor_t* compositor_init(size_t width, size_t height)
+{
+    assert(width && height && "arg failed!");
+
+    compositor_t* c = (compositor_t*)malloc(sizeof(compositor_t));
+    if (!c) {
+        LOG_ERR("fail to malloc compositor");
+        return NULL;
+    }
+    memset(c, 0, sizeof(compositor_t));
+    c->width = width;
+    c->height = height;
+
+    return c;
+}
+
+#ifdef __XTEST__
+
+char g_dbg_enable = 1;
+
+#define TEST_W (64)
+#define TEST_H (32)
+
+static void test_fill(compositor_layer_t* l, framebuffer_color_t color)
+{
+    for (size_t y = 0; y < l->height; ++y)
+        for (size_t x = 0; x < l->width; ++x)
+            *(framebuffer_color_t*)((uint8_t*)l->surface + y * l->stride + x * COLOR_SIZE) = color;
+}
+
+int main(void)
+{
+    framebuffer_color_t base[TEST_W * TEST_H];
+    framebuffer_color_t out[TEST_W * TEST_H];
+    for (int i = 0; i < TEST_W * TEST_H; ++i)
+        base[i] = (framebuffer_color_t)i;
+    memset(out, 0, sizeof(out));
+
+    compositor_t* c = compositor_init(TEST_W, TEST_H);
+    assert(c);
+    frame_rect_t full = { 0, 0, TEST_W, TEST_H };
+
+    // 没有图层时就是底图
+    compositor_compose(c, base, out, &full);
+    assert(0 == memcmp(out, base, sizeof(base)));
+
+    // 两个重叠图层, 后一个伸出屏幕右下角需要裁剪
+    int key_a = 0, key_b = 0;
+    compositor_layer_t* a = compositor_layer_add(c, &key_a, 10, 5, 20, 10, 2, NULL, 0);
+    compositor_layer_t* b = compositor_layer_add(c, &key_b, 20, 10, 60, 40, 1, NULL, 0);
+    assert(a && b && compositor_layer_count(c) == 2);
+    assert(compositor_layer_find(c, &key_b) == b);
+    test_fill(a, COLOR_WHITE);
+    test_fill(b, COLOR_GREY);
+
+    frame_rect_t r;
+    compositor_layer_rect(c, b, &r);
+    assert(r.x == 20 && r.y == 10 && r.w == TEST_W - 20 && r.h == TEST_H - 10);
+
+    compositor_compose(c, base, out, &full);
+    assert(out[0] == base[0]);
+    assert(out[7 * TEST_W + 12] == COLOR_WHITE);
+    assert(out[12 * TEST_W + 25] == COLOR_WHITE);  // a 的 z 大, 在 b 上面
+    assert(out[12 * TEST_W + 35] == COLOR_GREY);
+    assert(out[(TEST_H - 1) * TEST_W + TEST_W - 1] == COLOR_GREY);
+
+    compositor_layer_set_z(c, a, 0);
+    compositor_compose(c, base, out, &full);
+    assert(out[12 * TEST_W + 25] == COLOR_GREY);
+    assert(out[7 * TEST_W + 12] == COLOR_WHITE);
+
+    // 只重新合成被修改区域, 区域外保持不变
+    a->visible = 0;
+    frame_rect_t damage = { 10, 5, 5, 2 };
+    compositor_compose(c, base, out, &damage);
+    assert(out[5 * TEST_W + 10] == base[5 * TEST_W + 10]);
+    assert(out[7 * TEST_W + 12] == COLOR_WHITE);
+
+    // 隐藏图层后露出底图, 底图不需要重绘
+    compositor_layer_rect(c, a, &r);
+    compositor_compose(c, base, out, &r);
+    assert(out[7 * TEST_W + 12] == base[7 * TEST_W + 12]);
+
+    // 外部离屏缓存
+    framebuffer_color_t ext[4 * 8];
+    for (int i = 0; i < 4 * 8; ++i)
+        ext[i] = 0x1234;
+    int key_c = 0;
+    compositor_layer_t* l = compositor_layer_add(c, &key_c, 0, 0, 3, 2, 9, ext, 8 * COLOR_SIZE);
+    assert(l && !l->own_surface);
+    compositor_compose(c, base, out, &full);
+    assert(out[0] == 0x1234 && out[TEST_W + 2] == 0x1234 && out[3] == base[3]);
+
+    compositor_layer_remove(c, b);
+    assert(compositor_layer_count(c) == 2 && !compositor_layer_find(c, &key_b));
+    compositor_compose(c, base, out, &full);
+    assert(out[12 * TEST_W + 35] == base[12 * TEST_W + 35]);
+
+    compositor_exit(c);
+
+    printf("compositor test pass\n");
+    return 0;
+}
+
+#endif //__XTEST__
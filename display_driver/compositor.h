@@ -0,0 +1,134 @@
+#ifndef __COMPOSITOR_H__
+#define __COMPOSITOR_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "frame_delta.h"
+#include "framebuffer.h"
+
+// 功能: 多图层合成. 底图为显示缓存, 其上按 z 从小到大叠加若干不透明图层,
+// 每个图层有自己的离屏缓存(surface), 合成时裁剪到图层矩形和屏幕范围内,
+// 只重新合成被修改的区域, 图层显示/隐藏不需要重新绘制下面的内容.
+//
+// example:
+//   compositor_t* c = compositor_init(240, 240);
+//   compositor_layer_t* l = compositor_layer_add(c, key, 20, 20, 200, 64, 1, NULL, 0);
+//   ... 往 l->surface 绘制 ...
+//   frame_rect_t damage = { 20, 20, 200, 64 };
+//   compositor_compose(c, cache, frame, &damage);
+//   compositor_exit(c);
+
+typedef struct compositor_layer_t {
+    const void* key;                     // 图层所属对象, 如视图指针
+    int z;                               // 叠放次序, 越大越靠上
+    int visible;                         // 是否显示
+    size_t x;                            // 图层在屏幕上的 x 位置
+    size_t y;                            // 图层在屏幕上的 y 位置
+    size_t width;                        // 图层宽
+    size_t height;                       // 图层高
+    framebuffer_color_t* surface;        // 离屏缓存, RGB565
+    size_t stride;                       // 离屏缓存每行字节数
+    int own_surface;                     // 离屏缓存是否由合成器分配
+    struct compositor_layer_t* next;     // 按 z 从小到大排列的下一个图层
+} compositor_layer_t;
+
+struct compositor_t;
+
+/**
+ * 创建合成器。
+ *
+ * @param width 屏幕宽度。
+ * @param height 屏幕高度。
+ * @return 成功返回合成器指针，失败返回 NULL。
+ */
+compositor_t* compositor_init(size_t width, size_t height);
+
+/**
+ * 释放合成器及其分配的所有离屏缓存。
+ *
+ * @param c 指向合成器的指针。
+ */
+void compositor_exit(compositor_t* c);
+
+/**
+ * 添加图层, 默认显示。z 相同时后添加的在上面。
+ *
+ * @param c 指向合成器的指针。
+ * @param key 图层所属对象, 用于查找。
+ * @param x 图层在屏幕上的 x 位置。
+ * @param y 图层在屏幕上的 y 位置。
+ * @param width 图层宽。
+ * @param height 图层高。
+ * @param z 叠放次序。
+ * @param surface 外部离屏缓存, 为 NULL 时由合成器分配并清为黑色。
+ * @param stride 外部离屏缓存每行字节数, surface 为 NULL 时忽略。
+ * @return 成功返回图层指针，失败返回 NULL。
+ */
+compositor_layer_t* compositor_layer_add(compositor_t* c, const void* key, size_t x, size_t y,
+    size_t width, size_t height, int z, framebuffer_color_t* surface, size_t stride);
+
+/**
+ * 删除图层, 释放合成器分配的离屏缓存。
+ *
+ * @param c 指向合成器的指针。
+ * @param l 指向图层的指针。
+ */
+void compositor_layer_remove(compositor_t* c, compositor_layer_t* l);
+
+/**
+ * 按所属对象查找图层。
+ *
+ * @param c 指向合成器的指针。
+ * @param key 图层所属对象。
+ * @return 找到返回图层指针，否则返回 NULL。
+ */
+compositor_layer_t* compositor_layer_find(compositor_t* c, const void* key);
+
+/**
+ * 修改图层叠放次序。
+ *
+ * @param c 指向合成器的指针。
+ * @param l 指向图层的指针。
+ * @param z 新的叠放次序。
+ */
+void compositor_layer_set_z(compositor_t* c, compositor_layer_t* l, int z);
+
+/**
+ * 获取图层在屏幕上的可见区域。
+ *
+ * @param c 指向合成器的指针。
+ * @param l 指向图层的指针。
+ * @param r 输出图层矩形, 已裁剪到屏幕范围内。
+ */
+void compositor_layer_rect(compositor_t* c, const compositor_layer_t* l, frame_rect_t* r);
+
+/**
+ * 获取图层个数。
+ *
+ * @param c 指向合成器的指针。
+ * @return 图层个数。
+ */
+size_t compositor_layer_count(compositor_t* c);
+
+/**
+ * 重新合成指定区域: 先拷贝底图, 再按 z 从小到大叠加可见图层。
+ * 底图与输出每行都是 width 个像素。
+ *
+ * @param c 指向合成器的指针。
+ * @param base 底图, 可以与 out 相同, 此时区域内已经是底图内容。
+ * @param out 合成输出。
+ * @param damage 需要重新合成的区域, 会被裁剪到屏幕范围内。
+ */
+void compositor_compose(compositor_t* c, const framebuffer_color_t* base,
+    framebuffer_color_t* out, const frame_rect_t* damage);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__COMPOSITOR_H__
@@ -1,12 +1,28 @@
 #include <assert.h>
 #include <ctype.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "animator.h"
+#include "arena.h"
+#include "band_pool.h"
+#include "compositor.h"
 #include "debug.h"
 #include "display.h"
+#include "display_server.h"
+#include "fb_copy.h"
 #include "font_bitmap.h"
+#include "frame_mirror.h"
+#include "frame_recorder.h"
+#include "glyph_blend.h"
+#include "image.h"
+#include "meter.h"
+#include "shadow.h"
+#include "sprite_cache.h"
+#include "text_style.h"
+#include "view_text.h"
 
 /*
  * @ Display
@@ -24,20 +40,107 @@
  * */
 
 #define DISPLAY_TABS_OF_SPACE (2)
-#define DISPLAY_SPACE_WIDTH_BIT (ASCII_WORD_SIZE)
-#define DISPLAY_SPACE_HEIGHT_BIT (FONT_HEIGHT_WORD_SIZE)
+#define DISPLAY_MAX_THREADS (16)              // 条带绘制最多线程数
+#define DISPLAY_BANDS_PER_THREAD (4)          // 每个线程平均分到的条带数, 多分一些便于互相偷取
+#define DISPLAY_BAND_MIN_PIXELS (64 * 1024)   // 绘制的像素数少于此值时不分条带, 直接在调用线程绘制
+#define DISPLAY_GLYPH_MAX_WIDTH (32 * FONT_SCALE_MAX) // 放大后的最大字宽
 
 char g_dbg_enable = 1;
 
+typedef struct display_font_t {
+    const font_face_t* face;    // 字体
+    size_t scale;               // 放大倍数
+    size_t height;              // 字高, 也是行高(已放大)
+    size_t ascii_width;         // ASCII 字宽, 也是空格宽(已放大)
+    size_t zh_width;            // 中文字宽(已放大)
+    int aa;                     // 是否使用抗锯齿字形
+} display_font_t;
+
 typedef struct display_t {
-    size_t cache_size;       // 显示缓存大小
-    size_t conv_gb2312_size; // 字体转码缓存大小
+    size_t cache_size;       // RGB565 显示缓存大小, 也是合成画面的大小
     font_bitmap_t* font;     // 字体内存
     framebuffer_t* fb_info;  // fb内存
-    uint8_t* cache;          // 显示缓存地址
-    char* conv_gb2312_cache; // 字体转码缓存地址
+    uint8_t* cache;          // 显示缓存地址, 使用紧凑显示缓存时为 NULL
+    arena_t* arena;          // 单次打印的临时内存(转码输出等), 每次打印开始时回收
+    iconv_t conv;            // 缓存的转码句柄, (iconv_t)-1 表示未打开
+    char conv_code[32];      // 缓存的转码句柄对应的来源编码
+    size_t dirty_x0;         // 自上次刷新以来被修改区域 左上角 x
+    size_t dirty_y0;         // 自上次刷新以来被修改区域 左上角 y
+    size_t dirty_x1;         // 自上次刷新以来被修改区域 右下角 x(不含), 0 表示无修改
+    size_t dirty_y1;         // 自上次刷新以来被修改区域 右下角 y(不含)
+    frame_recorder_t* recorder; // 刷新录像, NULL 表示未开启
+    frame_mirror_t* mirror;     // 画面镜像服务, NULL 表示未开启
+    compositor_t* comp;         // 图层合成器, 第一次附加图层时创建
+    framebuffer_color_t* frame; // 合成后的画面, 有图层时才使用
+    compositor_layer_t* target; // 当前绘制的视图图层, NULL 表示绘制到显示缓存
+    view_text_t* texts;         // 保留文字内容的视图, 第一次 display_view_set_text 时加入
+    int ansi;                   // 打印时是否解析 ANSI SGR 颜色转义
+    text_style_t style;         // 当前绘制样式
+    const fb_copy_kernel_t* flush_copy; // 刷新到屏幕使用的拷贝内核, 初始化时测速选择
+    band_pool_t* pool;          // 条带绘制线程池, NULL 表示在调用线程绘制
+    pthread_mutex_t lock;       // 保护显示缓存、修改区域、图层和刷新, 电平控件线程也会绘制和刷新, 可重入
+    struct display_meter_t* meters; // 绑定到视图的电平控件
+    display_server_t* server;   // 显示服务, NULL 表示未开启
+    shadow_t* shadow;           // 紧凑显示缓存(1 位/4 位调色板下标), NULL 表示使用 RGB565 显示缓存
+    display_font_t view_font;   // 当前打印的视图使用的字体, 打印开始时按视图字号选择, 条带线程只读
+    int antialias;              // 有抗锯齿字体时是否使用
+    const glyph_blend_t* view_blend; // 本次打印最近使用的混合表, 在 arena 中, 颜色不变的字符共用
+    sprite_cache_t* sprites;    // 字符串精灵缓存, NULL 表示未开启
+    animator_t* animator;       // 动画调度器, 第一次启动动画时创建
+    struct display_anim_t* anims; // 正在运行的动画
 } display_t;
 
+typedef struct display_meter_t {
+    display_t* d;               // 所属显示
+    view_t* v;                  // 绑定的视图, 控件存在期间必须有效
+    meter_t* meter;             // 电平控件
+    struct display_meter_t* next;
+} display_meter_t;
+
+struct display_anim_t {
+    display_t* d;               // 所属显示
+    view_t* v;                  // 动画的视图, 动画存在期间必须有效
+    animator_task_t* task;      // 调度器中的动画
+    display_anim_fn fn;         // 回调动画的回调, NULL 表示文字帧动画
+    void* arg;                  // 传给 fn 的参数
+    const char* code;           // 文字帧的编码
+    const char** frames;        // 每一帧的文字, 与结构体一起分配
+    size_t* lens;               // 每一帧的文字长度
+    size_t count;               // 帧数
+    size_t shown;               // 正在显示的帧, count 表示还没有显示
+    struct display_anim_t* next;
+};
+
+struct display_glyph_t;
+struct display_band_t;
+typedef void (*display_raster_fn)(display_t* d, view_t* v, const struct display_glyph_t* g,
+    struct display_band_t* b);
+
+typedef struct display_glyph_t {
+    const uint8_t* bitmap;      // 字体位图, 每行 cols 字节, 抗锯齿字形每个像素 4 位
+    display_raster_fn raster;   // 绘制函数, 排版时按字符大小和是否换行选择
+    const glyph_blend_t* blend; // 抗锯齿字形的前景/背景混合表, NULL 表示点阵字形
+    size_t x;                   // 绘制开始 x
+    size_t y;                   // 绘制开始 y
+    framebuffer_color_t fg;     // 前景色
+    framebuffer_color_t bg;     // 背景色
+    uint8_t fg_index;           // 前景色在紧凑显示缓存调色板中的下标
+    uint8_t bg_index;           // 背景色在紧凑显示缓存调色板中的下标
+    uint8_t cols;               // 位图每行字节数
+    uint8_t width;              // 字宽(字体像素, 未放大)
+    uint8_t zh;                 // 是否中文, 中文的前半个字按中文宽度判断换行
+    uint16_t span;              // 从开始行算起可能绘制到的行数(不含回到视图开头的部分)
+} display_glyph_t;
+
+typedef struct display_band_t {
+    size_t y0;                  // 条带开始行
+    size_t y1;                  // 条带结束行(不含)
+    size_t dirty_x0;            // 条带内被修改区域, dirty_x1 为 0 表示无修改
+    size_t dirty_y0;
+    size_t dirty_x1;
+    size_t dirty_y1;
+} display_band_t;
+
 /**
  * @brief 增加视图的 x 坐标值。
  *
@@ -78,6 +181,76 @@ void display_set_debug(char enable)
     g_dbg_enable = enable;
 }
 
+/**
+ * @brief 设置打印时是否解析 ANSI SGR 颜色转义
+ *
+ * 开启后 display_view_print/display_view_set_text 的字符串中可以内嵌
+ * `ESC [ ... m` 修改前景色/背景色/反显, 支持的参数见 text_style.h,
+ * 每次打印开始时恢复为视图默认样式(font_color 前景, 黑色背景)。
+ * 关闭时转义字符按不可见字符跳过。
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param enable 1 开启, 0 关闭。
+ */
+void display_set_ansi(display_t* d, int enable)
+{
+    if (!d)
+        return;
+    d->ansi = !!enable;
+}
+
+/**
+ * @brief 设置是否使用抗锯齿字体
+ *
+ * 字体目录中有当前字号的抗锯齿字体时, 字形按 4 位覆盖度混合前景色和背景色,
+ * 每种颜色组合的 16 级颜色在排版时查一次表算好, 绘制时整行查表。
+ * 紧凑显示缓存的调色板放不下中间色, 仍使用点阵字体。
+ * 开关变化后 display_view_set_text 会整个重新绘制保留的文字。
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param enable 1 开启, 0 关闭。
+ */
+void display_set_antialias(display_t* d, int enable)
+{
+    if (!d)
+        return;
+    pthread_mutex_lock(&d->lock);
+    d->antialias = !!enable;
+    pthread_mutex_unlock(&d->lock);
+}
+
+/**
+ * @brief 设置条带绘制的线程数
+ *
+ * 大视图的文字绘制和清空按水平条带分给常驻线程池并行执行, 结果与单线程绘制完全一致。
+ * 绘制的像素数较少时仍在调用线程直接绘制。
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param threads 参与绘制的线程数(含调用线程), 0 或 1 表示只在调用线程绘制,
+ *                最多 DISPLAY_MAX_THREADS。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int display_set_threads(display_t* d, size_t threads)
+{
+    if (!d)
+        return -1;
+
+    threads = threads > DISPLAY_MAX_THREADS ? DISPLAY_MAX_THREADS : threads;
+    if (band_pool_threads(d->pool) == (threads ? threads : 1))
+        return 0;
+    band_pool_exit(d->pool);
+    d->pool = NULL;
+    if (threads <= 1)
+        return 0;
+
+    d->pool = band_pool_init(threads - 1);
+    if (!d->pool) {
+        LOG_ERR("fail to start %zu render threads.", threads);
+        return -1;
+    }
+    return 0;
+}
+
 /**
  * @brief 计算并返回在显示缓存中给定坐标 (x, y) 的偏移量。
  *
@@ -89,7 +262,51 @@ void display_set_debug(char enable)
 static inline size_t display_cul_cache_offset(display_t* d, size_t x, size_t y)
 {
     size_t offset = (y * d->fb_info->width + x) * COLOR_SIZE;
-    return offset < (d->cache_size - COLOR_SIZE - 1) ? offset : 0;
+    return offset + COLOR_SIZE <= d->cache_size ? offset : 0;
+}
+
+/**
+ * @brief 标记显示缓存中被修改的区域
+ *
+ * 被标记的区域会在下次刷新时交给录像等刷新后处理。
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param x 区域左上角 x 坐标。
+ * @param y 区域左上角 y 坐标。
+ * @param w 区域宽度。
+ * @param h 区域高度。
+ */
+static inline void display_add_dirty(display_t* d, size_t x, size_t y, size_t w, size_t h)
+{
+    if (!w || !h)
+        return;
+    if (!d->dirty_x1) {
+        d->dirty_x0 = x;
+        d->dirty_y0 = y;
+        d->dirty_x1 = x + w;
+        d->dirty_y1 = y + h;
+        return;
+    }
+    d->dirty_x0 = x < d->dirty_x0 ? x : d->dirty_x0;
+    d->dirty_y0 = y < d->dirty_y0 ? y : d->dirty_y0;
+    d->dirty_x1 = x + w > d->dirty_x1 ? x + w : d->dirty_x1;
+    d->dirty_y1 = y + h > d->dirty_y1 ? y + h : d->dirty_y1;
+}
+
+/**
+ * @brief 取出并清空被修改的区域
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param r 输出被修改的区域, 已裁剪到屏幕范围内。
+ */
+static inline void display_take_dirty(display_t* d, frame_rect_t* r)
+{
+    r->x = d->dirty_x0;
+    r->y = d->dirty_y0;
+    r->w = d->dirty_x1 > d->dirty_x0 ? d->dirty_x1 - d->dirty_x0 : 0;
+    r->h = d->dirty_y1 > d->dirty_y0 ? d->dirty_y1 - d->dirty_y0 : 0;
+    frame_rect_clip(r, d->fb_info->width, d->fb_info->height);
+    d->dirty_x0 = d->dirty_y0 = d->dirty_x1 = d->dirty_y1 = 0;
 }
 
 /**
@@ -102,368 +319,2242 @@ static inline size_t display_cul_cache_offset(display_t* d, size_t x, size_t y)
  * @param y 指定的 y 坐标，表示需要设置颜色的位置。
  * @param color 要设置的颜色
  */
-inline void display_set_cache_color(display_t* d, size_t x, size_t y, framebuffer_color_t color)
+void display_set_cache_color(display_t* d, size_t x, size_t y, framebuffer_color_t color)
 {
     if (!d)
         return;
-    *(framebuffer_color_t*)&d->cache[display_cul_cache_offset(d, x, y)] = color;
+    pthread_mutex_lock(&d->lock);
+    if (!d->shadow)
+        *(framebuffer_color_t*)&d->cache[display_cul_cache_offset(d, x, y)] = color;
+    else if (x < d->fb_info->width && y < d->fb_info->height)
+        shadow_set(d->shadow, x, y, shadow_index(d->shadow, color));
+    display_add_dirty(d, x, y, 1, 1);
+    pthread_mutex_unlock(&d->lock);
 }
 
 /**
- * @brief 刷新显示缓冲区
+ * @brief 获取刷新到屏幕的画面
  *
- * 此函数用于刷新指定显示设备的缓冲区，确保所有待显示的内容立即输出到显示屏。
+ * 有图层时为合成后的画面, 否则直接使用显示缓存。
+ * 使用紧凑显示缓存时只有分配了合成画面才有完整的 RGB565 画面, 否则返回 NULL。
  *
- * @param d 指向 display_t 结构的指针，表示要刷新的显示设备。
+ * @param d 指向 display_t 结构的指针。
+ * @return 画面地址。
  */
-inline void display_fflush(display_t* d)
+static inline const framebuffer_color_t* display_output(display_t* d)
 {
-    if (!d)
-        return;
-    memcpy(d->fb_info->screen, d->cache, d->fb_info->screen_size);
+    if (d->frame && (d->shadow || compositor_layer_count(d->comp)))
+        return d->frame;
+    return (const framebuffer_color_t*)d->cache;
 }
 
 /**
- * @brief 根据输入的字符类型，计算下一个绘制开始位置
+ * @brief 分配合成画面, 调用者需持有 d->lock
  *
- * @param d 指向 display_t 类型的指针，表示显示设备的相关信息。
- * @param v 指向 view_t 类型的指针，表示当前视图的信息。
- * @param x 指向 size_t 类型的指针，表示当前行的起始 x 坐标。
- * @param y 指向 size_t 类型的指针，表示当前行的起始 y 坐标。
- * @param type gb2312_word_type_t 类型的枚举值，表示要显示的字符类型（例如，中文字符、英文字符等）。
+ * 使用紧凑显示缓存时合成、录像和镜像都需要完整的 RGB565 画面, 分配时展开整屏,
+ * 之后每次刷新把变化区域展开到合成画面; 不需要时刷新直接展开到屏幕, 不占这块内存。
  *
- * @return 返回值为 int 类型，通常用于指示函数执行的状态。 0 正常， 非0 异常
+ * @param d 指向 display_t 结构的指针。
+ * @return 成功返回 0，失败返回 -1。
  */
-static inline int display_cul_next_line(display_t* d, view_t* v, size_t* x, size_t* y, gb2312_word_type_t type)
+static int display_frame_alloc(display_t* d)
 {
-    size_t next_x = *x;
-    size_t next_y = *y;
-    size_t space = (type == GB2312_CHINESE ? ZH_WORD_SIZE : ASCII_WORD_SIZE);
+    if (d->frame)
+        return 0;
+    d->frame = (framebuffer_color_t*)malloc(d->cache_size);
+    if (!d->frame) {
+        LOG_ERR("fail to malloc compose frame.");
+        return -1;
+    }
+    if (d->shadow) {
+        frame_rect_t full = { 0, 0, (uint32_t)d->fb_info->width, (uint32_t)d->fb_info->height };
+        shadow_expand(d->shadow, &full, d->frame, d->fb_info->width * COLOR_SIZE);
+        if (compositor_layer_count(d->comp))
+            compositor_compose(d->comp, d->frame, d->frame, &full);
+    }
+    return 0;
+}
 
-    size_t real_width = (v->start_x + v->width) >= d->fb_info->width ? 
-        d->fb_info->width : v->start_x + v->width;
+/**
+ * @brief 计算一次绘制分成的条带数
+ *
+ * 没有线程池或者绘制的像素太少时不分条带, 在调用线程直接绘制。
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param pixels 要绘制的像素数。
+ * @param rows 绘制区域的行数。
+ * @param min_rows 每个条带至少的行数。
+ * @return 条带数, 1 表示不分条带。
+ */
+static size_t display_band_count(display_t* d, size_t pixels, size_t rows, size_t min_rows)
+{
+    if (!d->pool || pixels < DISPLAY_BAND_MIN_PIXELS || rows < 2 * min_rows)
+        return 1;
+    size_t count = band_pool_threads(d->pool) * DISPLAY_BANDS_PER_THREAD;
+    return count < rows / min_rows ? count : rows / min_rows;
+}
 
-    assert(real_width && "width fail!");
+/**
+ * @brief 标记条带内被修改的区域, 绘制结束后再合并到显示的修改区域
+ */
+static inline void display_band_add_dirty(display_band_t* b, size_t x, size_t y)
+{
+    if (!b->dirty_x1) {
+        b->dirty_x0 = x;
+        b->dirty_y0 = y;
+        b->dirty_x1 = x + 1;
+        b->dirty_y1 = y + 1;
+        return;
+    }
+    b->dirty_x0 = x < b->dirty_x0 ? x : b->dirty_x0;
+    b->dirty_y0 = y < b->dirty_y0 ? y : b->dirty_y0;
+    b->dirty_x1 = x + 1 > b->dirty_x1 ? x + 1 : b->dirty_x1;
+    b->dirty_y1 = y + 1 > b->dirty_y1 ? y + 1 : b->dirty_y1;
+}
 
-#if DETAIL_LOG_ENABLE
-    LOG_DBG("nx(%zu), ny(%zu), real_width(%zu), v->start_x: %zu, "
-        "v->width: %zu, d->fb_info->width: %zu",
-        next_x, next_y, real_width, v->start_x, v->width, d->fb_info->width);
-#endif // DETAIL_LOG_ENABLE
+/**
+ * @brief 在当前绘制目标上设置指定位置的颜色, 只写入条带内的行
+ *
+ * 绘制目标为视图图层时写入图层离屏缓存, 超出图层范围的像素被裁剪掉;
+ * 否则写入显示缓存。
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param b 当前条带。
+ * @param x 屏幕 x 坐标。
+ * @param y 屏幕 y 坐标。
+ * @param color 要设置的颜色
+ * @param index 颜色在紧凑显示缓存调色板中的下标
+ */
+static inline void display_band_draw(display_t* d, display_band_t* b, size_t x, size_t y,
+    framebuffer_color_t color, uint8_t index)
+{
+    if (y < b->y0 || y >= b->y1)
+        return;
 
-    if (next_x >= real_width || next_x + space >= real_width) {
-        next_y += FONT_HEIGHT_WORD_SIZE;
-        next_x = v->start_x; // 右侧剩余空间不够了
-        display_cul_next_line(d, v, &next_x, &next_y, type);
+    compositor_layer_t* l = d->target;
+    if (!l) {
+        if (!d->shadow)
+            *(framebuffer_color_t*)&d->cache[display_cul_cache_offset(d, x, y)] = color;
+        else if (x < d->fb_info->width && y < d->fb_info->height)
+            shadow_set(d->shadow, x, y, index);
+        display_band_add_dirty(b, x, y);
+        return;
     }
+    if (x < l->x || y < l->y || x - l->x >= l->width || y - l->y >= l->height)
+        return;
+    *(framebuffer_color_t*)((uint8_t*)l->surface + (y - l->y) * l->stride + (x - l->x) * COLOR_SIZE) = color;
+    if (l->visible)
+        display_band_add_dirty(b, x, y);
+}
 
-    size_t real_height = (v->start_y + v->height) >= d->fb_info->height ? 
-        d->fb_info->height : v->start_y + v->height;
+/**
+ * @brief 在当前绘制目标上写入一行连续的颜色, 只写入条带内的行
+ *
+ * 与逐像素调用 display_band_draw 结果相同, 整行拷贝; 紧凑显示缓存有下标时直接写下标,
+ * 否则按颜色量化写入, 会分配调色板, 不能在条带线程中使用。调用者保证写入显示缓存时整行在屏幕内。
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param b 当前条带。
+ * @param x 屏幕 x 坐标。
+ * @param y 屏幕 y 坐标。
+ * @param colors 颜色。
+ * @param index 颜色在紧凑显示缓存调色板中的下标, 可以为 NULL。
+ * @param n 像素数。
+ */
+static inline void display_band_draw_row(display_t* d, display_band_t* b, size_t x, size_t y,
+    const framebuffer_color_t* colors, const uint8_t* index, size_t n)
+{
+    if (y < b->y0 || y >= b->y1 || !n)
+        return;
 
-    assert(real_height && "height fail!");
+    compositor_layer_t* l = d->target;
+    if (!l) {
+        if (!d->shadow) {
+            memcpy(&d->cache[display_cul_cache_offset(d, x, y)], colors, n * COLOR_SIZE);
+        } else if (index) {
+            for (size_t i = 0; i < n; ++i)
+                shadow_set(d->shadow, x + i, y, index[i]);
+        } else {
+            shadow_pack_row(d->shadow, x, y, colors, n);
+        }
+        display_band_add_dirty(b, x, y);
+        display_band_add_dirty(b, x + n - 1, y);
+        return;
+    }
+    if (y < l->y || y - l->y >= l->height || x >= l->x + l->width || x + n <= l->x)
+        return;
+    size_t skip = x < l->x ? l->x - x : 0;
+    size_t end = x + n > l->x + l->width ? l->x + l->width - x : n;
+    memcpy((uint8_t*)l->surface + (y - l->y) * l->stride + (x + skip - l->x) * COLOR_SIZE,
+        colors + skip, (end - skip) * COLOR_SIZE);
+    if (l->visible) {
+        display_band_add_dirty(b, x + skip, y);
+        display_band_add_dirty(b, x + end - 1, y);
+    }
+}
 
-#if DETAIL_LOG_ENABLE
-    LOG_DBG("nx(%zu), ny(%zu), real_height(%zu), v->start_y: %zu, "
-        "v->height: %zu, d->fb_info->height: %zu",
-        next_x, next_y, real_height, v->start_y, v->height, d->fb_info->height);
-#endif // DETAIL_LOG_ENABLE
+typedef struct display_fill_t {
+    uint8_t* base;   // 第一行地址
+    size_t stride;   // 每行字节数
+    size_t bytes;    // 每行清空的字节数
+    size_t rows;     // 行数
+    size_t count;    // 条带数
+} display_fill_t;
 
-    if (next_y >= real_height) {
-        next_y = v->start_y;
-        display_cul_next_line(d, v, &next_x, &next_y, type);
-    }
+static void display_fill_band(void* arg, size_t band)
+{
+    display_fill_t* f = (display_fill_t*)arg;
+    size_t r1 = f->rows * (band + 1) / f->count;
+    for (size_t r = f->rows * band / f->count; r < r1; ++r)
+        memset(f->base + r * f->stride, COLOR_BLACK, f->bytes);
+}
 
-    *x = next_x;
-    *y = next_y;
-    return 0;
+/**
+ * @brief 把若干行清为黑色, 区域大时分条带并行清空
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param base 第一行地址。
+ * @param stride 每行字节数。
+ * @param bytes 每行清空的字节数。
+ * @param rows 行数。
+ */
+static void display_fill_rows(display_t* d, uint8_t* base, size_t stride, size_t bytes, size_t rows)
+{
+    display_fill_t f = { base, stride, bytes, rows, 1 };
+    f.count = display_band_count(d, bytes / COLOR_SIZE * rows, rows, BIT_SIZE);
+    band_pool_run(f.count > 1 ? d->pool : NULL, f.count, display_fill_band, &f);
 }
 
 /**
- * @brief 绘制空格
+ * @brief 把指定区域清为黑色
  *
- * @param d 指向 display_t 结构的指针，表示当前显示的状态和属性。
- * @param v 指向 view_t 结构的指针，表示当前视图的设置和参数。
+ * 绘制目标为视图图层时清空图层离屏缓存, 否则清空显示缓存, 区域超出部分被裁剪掉。
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param x 区域左上角屏幕 x 坐标。
+ * @param y 区域左上角屏幕 y 坐标。
+ * @param w 区域宽度。
+ * @param h 区域高度。
  */
-static void display_draw_space_word(display_t* d, view_t* v)
+static void display_fill_black(display_t* d, size_t x, size_t y, size_t w, size_t h)
 {
-    size_t next_x = view_add_x(v, ASCII_WORD_SIZE);
-    size_t next_y = v->now_y;
-    int ret = display_cul_next_line(d, v, &next_x, &next_y, GB2312_ASCII);
-    if (ret < 0) {
-        LOG_DBG("display over flow! cx(%zu) y(%zu)", next_x, next_y);
+    compositor_layer_t* l = d->target;
+    size_t x0 = l ? l->x : 0;
+    size_t y0 = l ? l->y : 0;
+    size_t x1 = l ? l->x + l->width : d->fb_info->width;
+    size_t y1 = l ? l->y + l->height : d->fb_info->height;
+
+    x0 = x > x0 ? x : x0;
+    y0 = y > y0 ? y : y0;
+    x1 = x + w < x1 ? x + w : x1;
+    y1 = y + h < y1 ? y + h : y1;
+    if (x0 >= x1 || y0 >= y1)
         return;
+
+    if (l)
+        display_fill_rows(d, (uint8_t*)l->surface + (y0 - l->y) * l->stride + (x0 - l->x) * COLOR_SIZE,
+            l->stride, (x1 - x0) * COLOR_SIZE, y1 - y0);
+    else if (d->shadow)
+        shadow_fill(d->shadow, x0, y0, x1 - x0, y1 - y0, 0);
+    else
+        display_fill_rows(d, d->cache + (y0 * d->fb_info->width + x0) * COLOR_SIZE,
+            d->fb_info->width * COLOR_SIZE, (x1 - x0) * COLOR_SIZE, y1 - y0);
+    if (!l || l->visible)
+        display_add_dirty(d, x0, y0, x1 - x0, y1 - y0);
+}
+
+/**
+ * @brief 设置显示缓存格式
+ *
+ * 紧凑格式每个像素只存 1 位或 4 位调色板下标, 文字和清空只写下标,
+ * 刷新时只把变化区域展开为 RGB565, 显示缓存内存减少为 1/16 或 1/4。
+ * 切换时保留当前内容, 4 位格式超过 16 种颜色时取最接近的已有颜色,
+ * 1 位格式非黑色都显示为调色板的第二个颜色。
+ * 开启录像或镜像时切换到紧凑格式会分配合成画面提供完整的 RGB565 画面, 分配失败时不切换。
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param format DISPLAY_CACHE_RGB565、DISPLAY_CACHE_INDEX4 或 DISPLAY_CACHE_MONO。
+ * @param palette 预设调色板, 第一个颜色固定为黑色, NULL 使用默认调色板。
+ * @param colors 预设颜色数。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int display_set_cache_format(display_t* d, int format, const framebuffer_color_t* palette, size_t colors)
+{
+    if (!d || (format != DISPLAY_CACHE_RGB565 && format != DISPLAY_CACHE_INDEX4 && format != DISPLAY_CACHE_MONO))
+        return -1;
+
+    pthread_mutex_lock(&d->lock);
+    size_t width = d->fb_info->width;
+    size_t height = d->fb_info->height;
+    frame_rect_t full = { 0, 0, (uint32_t)width, (uint32_t)height };
+    int ret = 0;
+    if (format == DISPLAY_CACHE_RGB565) {
+        uint8_t* cache = d->shadow ? (uint8_t*)malloc(d->cache_size) : NULL;
+        if (d->shadow && !cache) {
+            LOG_ERR("fail to malloc display.");
+            ret = -1;
+        } else if (cache) {
+            shadow_expand(d->shadow, &full, (framebuffer_color_t*)cache, width * COLOR_SIZE);
+            shadow_exit(d->shadow);
+            d->shadow = NULL;
+            d->cache = cache;
+        }
+    } else {
+        shadow_t* s = shadow_init(width, height, format, palette, colors);
+        arena_reset(d->arena);
+        framebuffer_color_t* line = (framebuffer_color_t*)arena_alloc(d->arena, width * COLOR_SIZE);
+        // 录像和镜像需要完整的 RGB565 画面, 没有显示缓存后由合成画面提供, 分配失败时不切换
+        framebuffer_color_t* frame = NULL;
+        int need_frame = !d->frame && (d->recorder || d->mirror);
+        if (need_frame)
+            frame = (framebuffer_color_t*)malloc(d->cache_size);
+        if (!s || !line || (need_frame && !frame)) {
+            LOG_ERR("fail to malloc display cache(%d).", format);
+            shadow_exit(s);
+            free(frame);
+            ret = -1;
+        } else {
+            // 逐行量化当前内容
+            for (size_t y = 0; y < height; ++y) {
+                if (d->shadow)
+                    shadow_unpack_row(d->shadow, 0, y, line, width);
+                else
+                    memcpy(line, d->cache + y * width * COLOR_SIZE, width * COLOR_SIZE);
+                shadow_pack_row(s, 0, y, line, width);
+            }
+            shadow_exit(d->shadow);
+            free(d->cache);
+            d->cache = NULL;
+            d->shadow = s;
+            if (frame)
+                d->frame = frame;
+            // 合成画面可能是切换前留下的, 按新内容重新展开
+            if (d->frame) {
+                shadow_expand(d->shadow, &full, d->frame, width * COLOR_SIZE);
+                if (compositor_layer_count(d->comp))
+                    compositor_compose(d->comp, d->frame, d->frame, &full);
+            }
+        }
     }
-    v->now_x = next_x;
-    v->now_y = next_y;
+    if (!ret) {
+        LOG_DBG("display(%p) cache format %d", d, format);
+        display_add_dirty(d, 0, 0, width, height);
+    }
+    pthread_mutex_unlock(&d->lock);
+    return ret;
 }
 
 /**
- * @brief 绘制TAB制表符
+ * @brief 获取显示缓存地址
  *
- * @param d 指向 display_t 结构的指针，表示当前显示的状态和属性。
- * @param v 指向 view_t 结构的指针，表示当前视图的设置和参数。
+ * 缓存为 RGB565 格式, 每行 display_get_cache_stride 字节, 可直接批量写入,
+ * 写入后需调用 display_mark_dirty 标记修改区域, 再 display_fflush 刷新。
+ * 使用紧凑显示缓存时没有 RGB565 显示缓存, 返回 NULL。
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @return 显示缓存地址, 失败返回 NULL。
  */
-static inline void display_draw_tabs_word(display_t* d, view_t* v)
+framebuffer_color_t* display_get_cache(display_t* d)
 {
-    for (size_t i = 0; i < DISPLAY_TABS_OF_SPACE; ++i)
-        display_draw_space_word(d, v);
+    if (!d)
+        return NULL;
+    return (framebuffer_color_t*)d->cache;
 }
 
 /**
- * @brief 绘制换行
+ * @brief 获取显示缓存每行字节数
  *
- * @param d 指向 display_t 结构的指针，表示当前显示的状态和属性。
- * @param v 指向 view_t 结构的指针，表示当前视图的设置和参数。
+ * @param d 指向 display_t 结构的指针。
+ * @return 每行字节数, 失败返回 0。
  */
-static inline void display_draw_endl_word(display_t* d, view_t* v)
+size_t display_get_cache_stride(display_t* d)
 {
-    size_t next_x = 0;
-    size_t next_y = view_add_y(v, FONT_HEIGHT_WORD_SIZE);
-    int ret = display_cul_next_line(d, v, &next_x, &next_y, GB2312_ASCII);
-    if (ret < 0) {
-        LOG_ERR("fail to draw endl, x(%zu) y(%zu) to nx(%zu), ny(%zu)",
-            v->now_x, v->now_y, next_x, next_y);
+    if (!d || !d->cache)
+        return 0;
+    return d->fb_info->width * COLOR_SIZE;
+}
+
+/**
+ * @brief 标记显示缓存中被外部直接修改的区域
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param x 区域左上角 x 坐标。
+ * @param y 区域左上角 y 坐标。
+ * @param w 区域宽度。
+ * @param h 区域高度。
+ */
+void display_mark_dirty(display_t* d, size_t x, size_t y, size_t w, size_t h)
+{
+    if (!d || x >= d->fb_info->width || y >= d->fb_info->height)
         return;
+    w = x + w > d->fb_info->width ? d->fb_info->width - x : w;
+    h = y + h > d->fb_info->height ? d->fb_info->height - y : h;
+    pthread_mutex_lock(&d->lock);
+    display_add_dirty(d, x, y, w, h);
+    pthread_mutex_unlock(&d->lock);
+}
+
+/**
+ * @brief 刷新指定区域, 调用者需持有 d->lock
+ *
+ * 不改动其它待刷新的区域, 供只刷新自己区域的电平控件线程使用。
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param dirty 要刷新的区域, 已裁剪到屏幕范围内。
+ */
+static void display_fflush_rect_locked(display_t* d, frame_rect_t dirty)
+{
+    size_t row_bytes = d->fb_info->width * COLOR_SIZE;
+    if (d->shadow && !frame_rect_empty(&dirty)) {
+        if (d->frame)
+            shadow_expand(d->shadow, &dirty, d->frame, row_bytes);
+        else
+            shadow_expand(d->shadow, &dirty, (framebuffer_color_t*)d->fb_info->screen, d->fb_info->line_length);
     }
-    v->now_x = next_x;
-    v->now_y = next_y;
+    if (compositor_layer_count(d->comp)) {
+        const framebuffer_color_t* base = d->shadow ? d->frame : (const framebuffer_color_t*)d->cache;
+        compositor_compose(d->comp, base, d->frame, &dirty);
+    }
+
+    const framebuffer_color_t* frame = display_output(d);
+    if (dirty.w && dirty.h) {
+        // 写合并内存按整行连续写入比只写修改的几列更快, 所以拷贝修改区域的整行
+        if (frame)
+            fb_copy_rows(d->flush_copy, (uint8_t*)d->fb_info->screen + dirty.y * d->fb_info->line_length,
+                d->fb_info->line_length, (const uint8_t*)frame + dirty.y * row_bytes, row_bytes,
+                row_bytes, dirty.h);
+        framebuffer_damage(d->fb_info, dirty.x, dirty.y, dirty.w, dirty.h);
+    }
+    if (d->recorder)
+        frame_recorder_push(d->recorder, frame, &dirty);
+    if (d->mirror)
+        frame_mirror_push(d->mirror, frame, &dirty);
 }
 
 /**
- * @brief 绘制ASCII字符
+ * @brief 刷新显示缓冲区
  *
- * @param d 指向 display_t 结构的指针，表示当前显示的状态和属性。
- * @param v 指向 view_t 结构的指针，表示当前视图的设置和参数。
- * @param wb ASCII字体位图
+ * 此函数用于刷新指定显示设备的缓冲区，确保所有待显示的内容立即输出到显示屏。
+ * 只拷贝本次被修改区域所在的整行, 屏幕每行有填充字节时按行拷贝;
+ * 使用紧凑显示缓存时只把被修改区域展开为 RGB565, 不需要合成画面时直接展开到屏幕;
+ * 有图层时先把本次被修改的区域重新合成, 区域外的合成结果保持不变;
+ * 开启录像时, 本次被修改的区域会以差分形式写入录像文件;
+ * 开启镜像时, 本次被修改的区域会发送给镜像客户端;
+ * 作为显示服务客户端时, 本次被修改的区域会提交给服务端合成。
+ *
+ * @param d 指向 display_t 结构的指针，表示要刷新的显示设备。
  */
-static inline void display_draw_ascii_word(display_t* d, view_t* v, word_bitmap_t* wb)
+inline void display_fflush(display_t* d)
 {
-    assert(d && v && wb && "arg failed!");
+    if (!d)
+        return;
 
-    const uint8_t* buffer = (const uint8_t*)wb->ascii;
-    static unsigned char key[BIT_SIZE] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
-    size_t next_x = v->now_x;
-    size_t next_y = v->now_y;
-    int success = 0;
-
-    for (int k = 0; k < FONT_HEIGHT_WORD_SIZE; ++k, next_y += 1) {
-        for (int i = 0; i < BIT_SIZE; ++i, next_x += 1) {
-            success = 0;
-            int ret = display_cul_next_line(d, v, &next_x, &next_y, GB2312_ASCII);
-            if (ret < 0) {
-                LOG_ERR("fail to draw ascii nx(%zu) ny(%zu) next line.", next_x, next_y);
-                return;
-            }
+    pthread_mutex_lock(&d->lock);
+    frame_rect_t dirty;
+    display_take_dirty(d, &dirty);
+    display_fflush_rect_locked(d, dirty);
+    pthread_mutex_unlock(&d->lock);
+}
 
-            int flag = buffer[k * 1] & key[i];
-            display_set_cache_color(d, next_x, next_y, flag ? v->font_color : COLOR_BLACK);
+/**
+ * @brief 标记图层所在区域需要重新合成
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param l 指向图层的指针。
+ */
+static inline void display_layer_damage(display_t* d, compositor_layer_t* l)
+{
+    frame_rect_t r;
+    compositor_layer_rect(d->comp, l, &r);
+    display_add_dirty(d, r.x, r.y, r.w, r.h);
+}
 
-#if DETAIL_LOG_ENABLE
-            if (flag)
-                LOG_DBG("set %04x in (%zu, %zu) of display(%p) done",
-                    v->font_color, next_x, next_y, d);
-#endif // DETAIL_LOG_ENABLE
+/**
+ * @brief 加入图层并标记需要合成的区域, 第一次使用时创建合成器, 调用者需持有 d->lock
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param key 图层标识。
+ * @param x 图层在屏幕上的 x。
+ * @param y 图层在屏幕上的 y。
+ * @param w 图层宽。
+ * @param h 图层高。
+ * @param z 叠放次序。
+ * @param surface 外部离屏缓存, NULL 表示由合成器分配。
+ * @param stride 外部离屏缓存每行字节数。
+ * @return 成功返回图层指针，失败返回 NULL。
+ */
+static compositor_layer_t* display_layer_add_locked(display_t* d, const void* key, size_t x, size_t y,
+    size_t w, size_t h, int z, framebuffer_color_t* surface, size_t stride)
+{
+    if (!d->comp) {
+        d->comp = compositor_init(d->fb_info->width, d->fb_info->height);
+        if (!d->comp)
+            return NULL;
+    }
+    if (display_frame_alloc(d) < 0)
+        return NULL;
 
-            success = 1;
-        }
-        if (success)
-            next_x = v->now_x;
+    // 没有图层期间合成画面没有更新, 第一个图层需要整屏合成一次
+    int first = !compositor_layer_count(d->comp);
+    compositor_layer_t* l = compositor_layer_add(d->comp, key, x, y, w, h, z, surface, stride);
+    if (!l) {
+        LOG_ERR("fail to add layer(%p).", key);
+        return NULL;
+    }
+    if (first)
+        display_add_dirty(d, 0, 0, d->fb_info->width, d->fb_info->height);
+    else
+        display_layer_damage(d, l);
+
+    return l;
+}
+
+/**
+ * @brief display_view_attach 的实现, 调用者需持有 d->lock
+ */
+static int display_view_attach_locked(display_t* d, view_t* v, int z)
+{
+    compositor_layer_t* l = compositor_layer_find(d->comp, v);
+    if (l) {
+        compositor_layer_set_z(d->comp, l, z);
+        display_layer_damage(d, l);
+        return 0;
+    }
+
+    return display_layer_add_locked(d, v, v->start_x, v->start_y, v->width, v->height, z, NULL, 0) ? 0 : -1;
+}
+
+/**
+ * @brief 把视图附加为图层
+ *
+ * 视图拥有独立的离屏缓存, 之后对该视图的打印/清空只修改离屏缓存,
+ * 刷新时按叠放次序合成到显示缓存之上, 显示/隐藏不需要重绘下面的内容。
+ * 视图已经是图层时只修改叠放次序。
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param v 指向视图的指针, 图层存在期间必须有效。
+ * @param z 叠放次序, 越大越靠上, 显示缓存始终在最下面。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int display_view_attach(display_t* d, view_t* v, int z)
+{
+    if (!d || !v || !v->width || !v->height)
+        return -1;
+
+    pthread_mutex_lock(&d->lock);
+    int ret = display_view_attach_locked(d, v, z);
+    pthread_mutex_unlock(&d->lock);
+    return ret;
+}
+
+/**
+ * @brief 取消视图的图层, 释放离屏缓存
+ *
+ * 之后该视图重新直接绘制到显示缓存。
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param v 指向视图的指针。
+ */
+void display_view_detach(display_t* d, view_t* v)
+{
+    if (!d || !v)
+        return;
+    pthread_mutex_lock(&d->lock);
+    compositor_layer_t* l = compositor_layer_find(d->comp, v);
+    if (l) {
+        display_layer_damage(d, l);
+        compositor_layer_remove(d->comp, l);
+    }
+    pthread_mutex_unlock(&d->lock);
+}
+
+/**
+ * @brief 显示或隐藏视图图层
+ *
+ * 隐藏期间仍可往视图打印, 内容保留在离屏缓存中。
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param v 指向视图的指针。
+ * @param visible 1 显示, 0 隐藏。
+ * @return 成功返回 0，视图不是图层返回 -1。
+ */
+int display_view_show(display_t* d, view_t* v, int visible)
+{
+    if (!d || !v)
+        return -1;
+    pthread_mutex_lock(&d->lock);
+    compositor_layer_t* l = compositor_layer_find(d->comp, v);
+    visible = !!visible;
+    if (l && l->visible != visible) {
+        l->visible = visible;
+        display_layer_damage(d, l);
+    }
+    pthread_mutex_unlock(&d->lock);
+    return l ? 0 : -1;
+}
+
+/**
+ * @brief 开始录制刷新画面
+ *
+ * 之后每次 display_fflush 都会把变化区域以 XOR/RLE 差分追加到录像文件,
+ * 编码开销与变化面积成正比, 落盘由后台线程完成.
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param path 录像文件路径。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int display_record_start(display_t* d, const char* path)
+{
+    if (!d || !path)
+        return -1;
+
+    pthread_mutex_lock(&d->lock);
+    display_record_stop(d);
+    if (d->shadow && display_frame_alloc(d) < 0) {
+        pthread_mutex_unlock(&d->lock);
+        return -1;
+    }
+    d->recorder = frame_recorder_init(path, d->fb_info->width, d->fb_info->height, 0);
+    if (!d->recorder) {
+        pthread_mutex_unlock(&d->lock);
+        LOG_ERR("fail to start record: %s", path);
+        return -1;
+    }
+    // 第一帧需要完整记录当前画面
+    frame_rect_t full = { 0, 0, (uint32_t)d->fb_info->width, (uint32_t)d->fb_info->height };
+    frame_recorder_push(d->recorder, display_output(d), &full);
+    pthread_mutex_unlock(&d->lock);
+
+    return 0;
+}
+
+/**
+ * @brief 停止录制刷新画面
+ *
+ * @param d 指向 display_t 结构的指针。
+ */
+void display_record_stop(display_t* d)
+{
+    if (!d)
+        return;
+    pthread_mutex_lock(&d->lock);
+    frame_recorder_exit(d->recorder);
+    d->recorder = NULL;
+    pthread_mutex_unlock(&d->lock);
+}
+
+/**
+ * @brief 开启画面镜像服务
+ *
+ * 客户端连接后先收到完整画面, 之后每次 display_fflush 只发送变化区域,
+ * 客户端接收慢时合并中间帧, 不会阻塞刷新.
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param addr 监听地址, `unix:/path` 或 `tcp:[host:]port`。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int display_mirror_start(display_t* d, const char* addr)
+{
+    if (!d || !addr)
+        return -1;
+
+    pthread_mutex_lock(&d->lock);
+    display_mirror_stop(d);
+    if (d->shadow && display_frame_alloc(d) < 0) {
+        pthread_mutex_unlock(&d->lock);
+        return -1;
+    }
+    d->mirror = frame_mirror_init(addr, display_output(d),
+        d->fb_info->width, d->fb_info->height);
+    pthread_mutex_unlock(&d->lock);
+    if (!d->mirror) {
+        LOG_ERR("fail to start mirror: %s", addr);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief 关闭画面镜像服务
+ *
+ * @param d 指向 display_t 结构的指针。
+ */
+void display_mirror_stop(display_t* d)
+{
+    if (!d)
+        return;
+    pthread_mutex_lock(&d->lock);
+    frame_mirror_exit(d->mirror);
+    d->mirror = NULL;
+    pthread_mutex_unlock(&d->lock);
+}
+
+/**
+ * @brief 显示服务回调: 客户端的共享内存作为图层加入合成
+ */
+static int display_server_attach(void* arg, const void* key, const frame_rect_t* r, int z,
+    framebuffer_color_t* surface, size_t stride)
+{
+    display_t* d = (display_t*)arg;
+    pthread_mutex_lock(&d->lock);
+    compositor_layer_t* l = display_layer_add_locked(d, key, r->x, r->y, r->w, r->h, z, surface, stride);
+    pthread_mutex_unlock(&d->lock);
+    return l ? 0 : -1;
+}
+
+/**
+ * @brief 显示服务回调: 客户端断开, 删除图层
+ */
+static void display_server_detach(void* arg, const void* key)
+{
+    display_t* d = (display_t*)arg;
+    pthread_mutex_lock(&d->lock);
+    compositor_layer_t* l = compositor_layer_find(d->comp, key);
+    if (l) {
+        display_layer_damage(d, l);
+        compositor_layer_remove(d->comp, l);
+    }
+    pthread_mutex_unlock(&d->lock);
+}
+
+/**
+ * @brief 显示服务回调: 客户端提交的变化区域, 下次刷新时重新合成
+ */
+static void display_server_damage(void* arg, const void* key, const frame_rect_t* r)
+{
+    (void)key;
+    display_t* d = (display_t*)arg;
+    pthread_mutex_lock(&d->lock);
+    display_add_dirty(d, r->x, r->y, r->w, r->h);
+    pthread_mutex_unlock(&d->lock);
+}
+
+/**
+ * @brief 显示服务回调: 一轮消息处理完后刷新
+ */
+static void display_server_flush(void* arg)
+{
+    display_fflush((display_t*)arg);
+}
+
+/**
+ * @brief 开启显示服务
+ *
+ * 其它进程用 framebuffer_init("client:PATH@X,Y,WxH,Z") 连接后得到一块共享内存图层,
+ * 在本地绘制并提交变化区域, 由服务线程合成到本显示并刷新, 客户端断开后图层自动删除。
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param path Unix 套接字路径。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int display_server_start(display_t* d, const char* path)
+{
+    static const display_server_ops_t ops = {
+        display_server_attach, display_server_detach, display_server_damage, display_server_flush
+    };
+
+    if (!d || !path)
+        return -1;
+
+    display_server_stop(d);
+    display_server_t* s = display_server_init(path, d->fb_info->width, d->fb_info->height, &ops, d);
+    if (!s)
+        return -1;
+    pthread_mutex_lock(&d->lock);
+    d->server = s;
+    pthread_mutex_unlock(&d->lock);
+    return 0;
+}
+
+/**
+ * @brief 关闭显示服务, 断开所有客户端并删除它们的图层
+ *
+ * @param d 指向 display_t 结构的指针。
+ */
+void display_server_stop(display_t* d)
+{
+    if (!d)
+        return;
+
+    // 服务线程的回调需要 d->lock, 在锁外等待线程退出
+    pthread_mutex_lock(&d->lock);
+    display_server_t* s = d->server;
+    d->server = NULL;
+    pthread_mutex_unlock(&d->lock);
+    display_server_exit(s);
+}
+
+/**
+ * @brief 根据输入的字符类型，计算下一个绘制开始位置
+ *
+ * @param d 指向 display_t 类型的指针，表示显示设备的相关信息。
+ * @param v 指向 view_t 类型的指针，表示当前视图的信息。
+ * @param x 指向 size_t 类型的指针，表示当前行的起始 x 坐标。
+ * @param y 指向 size_t 类型的指针，表示当前行的起始 y 坐标。
+ * @param type gb2312_word_type_t 类型的枚举值，表示要显示的字符类型（例如，中文字符、英文字符等）。
+ *
+ * @return 返回值为 int 类型，通常用于指示函数执行的状态。 0 正常， 非0 异常
+ */
+static inline int display_cul_next_line(display_t* d, view_t* v, size_t* x, size_t* y, gb2312_word_type_t type)
+{
+    size_t next_x = *x;
+    size_t next_y = *y;
+    size_t space = (type == GB2312_CHINESE ? d->view_font.zh_width : d->view_font.ascii_width);
+
+    size_t real_width = (v->start_x + v->width) >= d->fb_info->width ? 
+        d->fb_info->width : v->start_x + v->width;
+
+    assert(real_width && "width fail!");
+
+#if DETAIL_LOG_ENABLE
+    LOG_DBG("nx(%zu), ny(%zu), real_width(%zu), v->start_x: %zu, "
+        "v->width: %zu, d->fb_info->width: %zu",
+        next_x, next_y, real_width, v->start_x, v->width, d->fb_info->width);
+#endif // DETAIL_LOG_ENABLE
+
+    if (next_x >= real_width || next_x + space >= real_width) {
+        next_y += d->view_font.height;
+        next_x = v->start_x; // 右侧剩余空间不够了
+        display_cul_next_line(d, v, &next_x, &next_y, type);
+    }
+
+    size_t real_height = (v->start_y + v->height) >= d->fb_info->height ? 
+        d->fb_info->height : v->start_y + v->height;
+
+    assert(real_height && "height fail!");
+
+#if DETAIL_LOG_ENABLE
+    LOG_DBG("nx(%zu), ny(%zu), real_height(%zu), v->start_y: %zu, "
+        "v->height: %zu, d->fb_info->height: %zu",
+        next_x, next_y, real_height, v->start_y, v->height, d->fb_info->height);
+#endif // DETAIL_LOG_ENABLE
+
+    if (next_y >= real_height) {
+        next_y = v->start_y;
+        display_cul_next_line(d, v, &next_x, &next_y, type);
+    }
+
+    *x = next_x;
+    *y = next_y;
+    return 0;
+}
+
+/**
+ * @brief 绘制空格
+ *
+ * @param d 指向 display_t 结构的指针，表示当前显示的状态和属性。
+ * @param v 指向 view_t 结构的指针，表示当前视图的设置和参数。
+ */
+static void display_draw_space_word(display_t* d, view_t* v)
+{
+    size_t next_x = view_add_x(v, d->view_font.ascii_width);
+    size_t next_y = v->now_y;
+    int ret = display_cul_next_line(d, v, &next_x, &next_y, GB2312_ASCII);
+    if (ret < 0) {
+        LOG_DBG("display over flow! cx(%zu) y(%zu)", next_x, next_y);
+        return;
+    }
+    v->now_x = next_x;
+    v->now_y = next_y;
+}
+
+/**
+ * @brief 绘制TAB制表符
+ *
+ * @param d 指向 display_t 结构的指针，表示当前显示的状态和属性。
+ * @param v 指向 view_t 结构的指针，表示当前视图的设置和参数。
+ */
+static inline void display_draw_tabs_word(display_t* d, view_t* v)
+{
+    for (size_t i = 0; i < DISPLAY_TABS_OF_SPACE; ++i)
+        display_draw_space_word(d, v);
+}
+
+/**
+ * @brief 绘制换行
+ *
+ * @param d 指向 display_t 结构的指针，表示当前显示的状态和属性。
+ * @param v 指向 view_t 结构的指针，表示当前视图的设置和参数。
+ */
+static inline void display_draw_endl_word(display_t* d, view_t* v)
+{
+    size_t next_x = 0;
+    size_t next_y = view_add_y(v, d->view_font.height);
+    int ret = display_cul_next_line(d, v, &next_x, &next_y, GB2312_ASCII);
+    if (ret < 0) {
+        LOG_ERR("fail to draw endl, x(%zu) y(%zu) to nx(%zu), ny(%zu)",
+            v->now_x, v->now_y, next_x, next_y);
+        return;
+    }
+    v->now_x = next_x;
+    v->now_y = next_y;
+}
+
+/**
+ * @brief 按视图的字号选择本次打印使用的字体
+ *
+ * @param d 指向 display_t 结构的指针，表示当前显示的状态和属性。
+ * @param v 指向 view_t 结构的指针，表示当前视图的设置和参数。
+ */
+static void display_select_font(display_t* d, view_t* v)
+{
+    display_font_t* f = &d->view_font;
+    size_t scale = 1;
+    f->face = font_bitmap_face(d->font, v->font_size, &scale);
+    if (!f->face) {
+        // 默认字号总是存在
+        LOG_ERR("no font for size %u, use default size %d", v->font_size, FONT_SIZE_DEFAULT);
+        f->face = font_bitmap_face(d->font, 0, &scale);
+    }
+    f->scale = scale * (v->font_scale ? v->font_scale : 1);
+    if (f->scale > FONT_SCALE_MAX)
+        f->scale = FONT_SCALE_MAX;
+    f->height = f->face->size * f->scale;
+    f->ascii_width = f->face->ascii_width * f->scale;
+    f->zh_width = f->face->zh_width * f->scale;
+    f->aa = d->antialias && !d->shadow && f->face->ascii_aa && f->face->zh_aa;
+}
+
+/**
+ * @brief 当前字体的标识, 字号、放大倍数或是否抗锯齿不同时不同, 用于判断保留的文字是否仍然有效
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @return 字体标识, 不为 0。
+ */
+static inline size_t display_font_key(display_t* d)
+{
+    return d->view_font.face->size << 8 | (size_t)d->view_font.aa << 7 | d->view_font.scale;
+}
+
+/**
+ * @brief 绘制一个可能换行的字符落在条带内的部分
+ *
+ * 逐像素计算位置, 超出视图右侧时换行, 超出底部时回到视图开头。
+ * 抗锯齿字形逐像素查混合表。
+ *
+ * @param d 指向 display_t 结构的指针，表示当前显示的状态和属性。
+ * @param v 指向 view_t 结构的指针，表示当前视图的设置和参数。
+ * @param g 字符的绘制信息。
+ * @param b 当前条带。
+ */
+static void display_raster_word(display_t* d, view_t* v, const display_glyph_t* g, display_band_t* b)
+{
+    static const unsigned char key[BIT_SIZE] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+    size_t scale = d->view_font.scale;
+    size_t width = g->width * scale;
+    size_t next_x = g->x;
+    size_t next_y = g->y;
+
+    for (size_t k = 0; k < d->view_font.height; ++k, next_y += 1) {
+        const uint8_t* row = g->bitmap + k / scale * g->cols;
+        for (size_t i = 0; i < width; ++i, next_x += 1) {
+            // 中文的后半个字边界有可能又越界
+            gb2312_word_type_t break_line = (g->zh && i < width / 2 ? GB2312_CHINESE : GB2312_ASCII);
+            display_cul_next_line(d, v, &next_x, &next_y, break_line);
+            size_t bit = i / scale;
+            if (d->view_font.aa) {
+                if (g->blend)
+                    display_band_draw(d, b, next_x, next_y, g->blend->color[glyph_coverage(row, bit)], 0);
+                continue;
+            }
+            int flag = row[bit / BIT_SIZE] & key[bit % BIT_SIZE];
+            display_band_draw(d, b, next_x, next_y, flag ? g->fg : g->bg, flag ? g->fg_index : g->bg_index);
+
+#if DETAIL_LOG_ENABLE
+            if (flag)
+                LOG_DBG("set %04x in (%zu, %zu) of display(%p) done",
+                    g->fg, next_x, next_y, d);
+#endif // DETAIL_LOG_ENABLE
+        }
+        next_x = g->x;
+    }
+}
+
+/**
+ * @brief 绘制一个不换行的字符落在条带内的部分
+ *
+ * 字符整行都在视图内, 只需要处理超出底部回到视图开头, 不用逐像素计算位置。
+ * 每行位图展开成颜色和调色板下标后整行写入, 放大时相邻的几行只展开一次。
+ * 按字宽 W、字高 H、放大倍数 S 特化, 常用字号的循环次数是编译期常量, 内层循环可以展开;
+ * 模板参数为 0 时从字符和当前字体读取, 用于其它字号。
+ *
+ * @param d 指向 display_t 结构的指针，表示当前显示的状态和属性。
+ * @param v 指向 view_t 结构的指针，表示当前视图的设置和参数。
+ * @param g 字符的绘制信息。
+ * @param b 当前条带。
+ */
+template <size_t W, size_t H, size_t S>
+static void display_raster_fit(display_t* d, view_t* v, const display_glyph_t* g, display_band_t* b)
+{
+    const size_t width = W ? W : g->width;
+    const size_t height = H ? H : d->view_font.face->size;
+    const size_t scale = S ? S : d->view_font.scale;
+    const size_t cols = FONT_ROW_BYTES(width);
+    size_t real_height = (v->start_y + v->height) >= d->fb_info->height ?
+        d->fb_info->height : v->start_y + v->height;
+    framebuffer_color_t line[DISPLAY_GLYPH_MAX_WIDTH];
+    uint8_t index[DISPLAY_GLYPH_MAX_WIDTH];
+    size_t last = (size_t)-1;
+
+    for (size_t k = 0; k < height * scale; ++k) {
+        size_t y = g->y + k;
+        if (y >= real_height)
+            y = v->start_y + (y - real_height);
+        if (y < b->y0 || y >= b->y1)
+            continue;
+        if (k / scale != last) {
+            last = k / scale;
+            const uint8_t* row = g->bitmap + last * cols;
+            for (size_t i = 0, x = 0; i < width; ++i) {
+                int flag = row[i / BIT_SIZE] & (0x80 >> (i % BIT_SIZE));
+                framebuffer_color_t color = flag ? g->fg : g->bg;
+                uint8_t idx = flag ? g->fg_index : g->bg_index;
+                for (size_t j = 0; j < scale; ++j, ++x) {
+                    line[x] = color;
+                    index[x] = idx;
+                }
+            }
+        }
+        display_band_draw_row(d, b, g->x, y, line, d->shadow ? index : NULL, width * scale);
+    }
+}
+
+/**
+ * @brief 绘制一个不换行的抗锯齿字符落在条带内的部分
+ *
+ * 每行覆盖度整行查混合表转换成颜色, 放大时横向复制, 再整行写入。
+ * 模板参数与 display_raster_fit 相同。
+ *
+ * @param d 指向 display_t 结构的指针，表示当前显示的状态和属性。
+ * @param v 指向 view_t 结构的指针，表示当前视图的设置和参数。
+ * @param g 字符的绘制信息。
+ * @param b 当前条带。
+ */
+template <size_t W, size_t H, size_t S>
+static void display_raster_aa(display_t* d, view_t* v, const display_glyph_t* g, display_band_t* b)
+{
+    const size_t width = W ? W : g->width;
+    const size_t height = H ? H : d->view_font.face->size;
+    const size_t scale = S ? S : d->view_font.scale;
+    const size_t cols = FONT_AA_ROW_BYTES(width);
+    size_t real_height = (v->start_y + v->height) >= d->fb_info->height ?
+        d->fb_info->height : v->start_y + v->height;
+    framebuffer_color_t line[DISPLAY_GLYPH_MAX_WIDTH];
+    framebuffer_color_t wide[DISPLAY_GLYPH_MAX_WIDTH];
+    size_t last = (size_t)-1;
+    if (!g->blend)
+        return;
+
+    for (size_t k = 0; k < height * scale; ++k) {
+        size_t y = g->y + k;
+        if (y >= real_height)
+            y = v->start_y + (y - real_height);
+        if (y < b->y0 || y >= b->y1)
+            continue;
+        // 放大时相邻的几行是同一行字形, 只转换一次
+        if (k / scale != last) {
+            last = k / scale;
+            glyph_blend_row(g->blend, g->bitmap + last * cols, width, line);
+            for (size_t i = 0; scale > 1 && i < width * scale; ++i)
+                wide[i] = line[i / scale];
+        }
+        display_band_draw_row(d, b, g->x, y, scale > 1 ? wide : line, NULL, width * scale);
+    }
+}
+
+/**
+ * @brief 选择不换行字符的绘制函数, 常用字号使用特化的版本
+ *
+ * @param width 字宽(字体像素)。
+ * @param height 字高(字体像素)。
+ * @param scale 放大倍数。
+ * @param aa 是否抗锯齿字形。
+ * @return 绘制函数。
+ */
+static display_raster_fn display_raster_fit_fn(size_t width, size_t height, size_t scale, int aa)
+{
+#define DISPLAY_RASTER_FIT(w, h, s) \
+    if (width == (w) && height == (h) && scale == (s)) \
+        return aa ? display_raster_aa<w, h, s> : display_raster_fit<w, h, s>;
+
+    DISPLAY_RASTER_FIT(8, 16, 1)
+    DISPLAY_RASTER_FIT(16, 16, 1)
+    DISPLAY_RASTER_FIT(8, 16, 2)
+    DISPLAY_RASTER_FIT(16, 16, 2)
+    DISPLAY_RASTER_FIT(6, 12, 1)
+    DISPLAY_RASTER_FIT(12, 12, 1)
+    DISPLAY_RASTER_FIT(12, 24, 1)
+    DISPLAY_RASTER_FIT(24, 24, 1)
+    DISPLAY_RASTER_FIT(16, 32, 1)
+    DISPLAY_RASTER_FIT(32, 32, 1)
+#undef DISPLAY_RASTER_FIT
+
+    return aa ? display_raster_aa<0, 0, 0> : display_raster_fit<0, 0, 0>;
+}
+
+/**
+ * @brief 获取前景/背景组合的混合表
+ *
+ * 混合表在本次打印的 arena 中, 连续的字符颜色通常相同, 只和上一个比较。
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param fg 前景色。
+ * @param bg 背景色。
+ * @return 混合表, 内存不足时返回 NULL, 字符不绘制。
+ */
+static const glyph_blend_t* display_get_blend(display_t* d, framebuffer_color_t fg, framebuffer_color_t bg)
+{
+    if (d->view_blend && d->view_blend->fg == fg && d->view_blend->bg == bg)
+        return d->view_blend;
+    glyph_blend_t* t = (glyph_blend_t*)arena_alloc(d->arena, sizeof(glyph_blend_t));
+    if (t)
+        glyph_blend_init(t, fg, bg);
+    d->view_blend = t;
+    return t;
+}
+
+/**
+ * @brief 排版一个字符: 记录绘制位置和颜色, 光标移到下一个字符
+ *
+ * 只确定位置不绘制, 排版完成后由 display_raster 统一绘制。
+ *
+ * @param d 指向 display_t 结构的指针，表示当前显示的状态和属性。
+ * @param v 指向 view_t 结构的指针，表示当前视图的设置和参数。
+ * @param g 输出字符的绘制信息。
+ * @param bitmap 当前字体中的字位图, 使用抗锯齿字体时为 4 位覆盖度字形
+ * @param type 字符类型
+ */
+static inline void display_layout_word(display_t* d, view_t* v, display_glyph_t* g, const uint8_t* bitmap,
+    gb2312_word_type_t type)
+{
+    assert(d && v && g && bitmap && "arg failed!");
+
+    const display_font_t* f = &d->view_font;
+    g->bitmap = bitmap;
+    g->x = v->now_x;
+    g->y = v->now_y;
+    g->fg = text_style_fg(&d->style);
+    g->bg = text_style_bg(&d->style);
+    // 调色板只在排版时分配, 条带线程绘制时只读
+    g->fg_index = d->shadow ? shadow_index(d->shadow, g->fg) : 0;
+    g->bg_index = d->shadow ? shadow_index(d->shadow, g->bg) : 0;
+    g->zh = type == GB2312_CHINESE;
+    g->width = g->zh ? f->face->zh_width : f->face->ascii_width;
+    g->cols = f->aa ? FONT_AA_ROW_BYTES(g->width) : FONT_ROW_BYTES(g->width);
+    g->blend = f->aa ? display_get_blend(d, g->fg, g->bg) : NULL;
+
+    // 字符在行尾放不下时每一行绘制到一半都会换行, 之后的每一行都比上一行多往下一行
+    size_t real_width = (v->start_x + v->width) >= d->fb_info->width ?
+        d->fb_info->width : v->start_x + v->width;
+    size_t real_height = (v->start_y + v->height) >= d->fb_info->height ?
+        d->fb_info->height : v->start_y + v->height;
+    size_t width = g->width * f->scale;
+    int wrap = g->x + width - 1 + f->ascii_width >= real_width;
+    if (g->zh)
+        wrap |= g->x + width / 2 - 1 + f->zh_width >= real_width;
+    g->span = wrap ? f->height * (f->height + 1) : f->height;
+    // 超出底部时最多回到视图开头一次才能按行直接绘制
+    if (wrap || g->y >= real_height || real_height < v->start_y + f->height)
+        g->raster = display_raster_word;
+    else
+        g->raster = display_raster_fit_fn(g->width, f->face->size, f->scale, f->aa);
+
+    v->now_x += g->zh ? f->zh_width : f->ascii_width;
+    display_cul_next_line(d, v, &v->now_x, &v->now_y, type);
+}
+
+typedef struct display_raster_t {
+    display_t* d;                   // 显示
+    view_t* v;                      // 视图
+    const display_glyph_t* glyphs;  // 排版好的字符
+    size_t count;                   // 字符个数
+    size_t real_height;             // 视图在屏幕内的底部
+    display_band_t* bands;          // 条带
+} display_raster_t;
+
+static void display_raster_band(void* arg, size_t band)
+{
+    display_raster_t* r = (display_raster_t*)arg;
+    display_band_t* b = &r->bands[band];
+    for (size_t i = 0; i < r->count; ++i) {
+        const display_glyph_t* g = &r->glyphs[i];
+        // 超出视图底部的部分回到视图开头继续绘制
+        int hit = g->y < b->y1 && g->y + g->span > b->y0;
+        if (!hit && g->y + g->span > r->real_height)
+            hit = r->v->start_y < b->y1 && r->v->start_y + g->span > b->y0;
+        if (hit)
+            g->raster(r->d, r->v, g, b);
+    }
+}
+
+/**
+ * @brief 绘制排版好的字符
+ *
+ * 字符多时按水平条带分给线程池, 每个条带按顺序绘制全部字符落在本条带内的行,
+ * 后面的字符覆盖前面的字符, 结果与条带数和执行顺序无关。
+ *
+ * @param d 指向 display_t 结构的指针，表示当前显示的状态和属性。
+ * @param v 指向 view_t 结构的指针，表示当前视图的设置和参数。
+ * @param glyphs 排版好的字符。
+ * @param count 字符个数。
+ */
+static void display_raster(display_t* d, view_t* v, const display_glyph_t* glyphs, size_t count)
+{
+    if (!count)
+        return;
+
+    display_band_t bands[DISPLAY_MAX_THREADS * DISPLAY_BANDS_PER_THREAD];
+    size_t real_height = (v->start_y + v->height) >= d->fb_info->height ?
+        d->fb_info->height : v->start_y + v->height;
+    size_t real_width = (v->start_x + v->width) >= d->fb_info->width ?
+        d->fb_info->width : v->start_x + v->width;
+    size_t rows = real_height > v->start_y ? real_height - v->start_y : 0;
+    size_t band_count = display_band_count(d, count * d->view_font.height * d->view_font.ascii_width,
+        rows, d->view_font.height);
+    // 视图太窄时一个字符的一行内可能换行多次, 无法估计影响的行, 不分条带
+    if (real_width < v->start_x + 2 * d->view_font.zh_width)
+        band_count = 1;
+
+    memset(bands, 0, band_count * sizeof(display_band_t));
+    if (band_count == 1) {
+        bands[0].y1 = d->fb_info->height;
+    } else {
+        for (size_t i = 0; i < band_count; ++i) {
+            bands[i].y0 = v->start_y + rows * i / band_count;
+            bands[i].y1 = v->start_y + rows * (i + 1) / band_count;
+        }
+    }
+
+    display_raster_t r = { d, v, glyphs, count, real_height, bands };
+    band_pool_run(band_count > 1 ? d->pool : NULL, band_count, display_raster_band, &r);
+
+    for (size_t i = 0; i < band_count; ++i) {
+        display_band_t* b = &bands[i];
+        if (b->dirty_x1)
+            display_add_dirty(d, b->dirty_x0, b->dirty_y0, b->dirty_x1 - b->dirty_x0, b->dirty_y1 - b->dirty_y0);
+    }
+}
+
+/**
+ * @brief 查找视图保留的文字
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param v 指向视图的指针。
+ * @return 找到返回视图文字, 视图没有保留文字返回 NULL。
+ */
+static inline view_text_t* display_find_text(display_t* d, view_t* v)
+{
+    for (view_text_t* t = d->texts; t; t = t->next) {
+        if (t->key == v)
+            return t;
+    }
+    return NULL;
+}
+
+/**
+ * @brief 往显示上打印 GB2312中文 + ASCII字符串
+ *
+ * 先排版确定每个字符的位置和颜色, 再统一绘制。
+ *
+ * @param d 指向 display_t 结构的指针，表示当前显示的状态和属性。
+ * @param v 指向 view_t 结构的指针，表示当前视图的设置和参数。
+ * @param str 被打印的GB2312中文字符串
+ * @param str_len 被打印的GB2312中文字符串长度
+ * @param style 开始打印时的样式, NULL 使用视图默认样式
+ * @param target 绘制目标图层, NULL 绘制到显示缓存
+ * 
+ * @return 成功返回 0 失败返回 非0
+ */
+static int display_view_print_gb2312(display_t* d, view_t* v, const char* str, size_t str_len,
+    const text_style_t* style, compositor_layer_t* target)
+{
+    if (!d || !str || !str_len) {
+        return 0;
+    }
+
+    // 每个字符至少占 1 字节
+    display_glyph_t* glyphs = (display_glyph_t*)arena_alloc(d->arena, str_len * sizeof(display_glyph_t));
+    if (!glyphs)
+        return -1;
+    size_t count = 0;
+
+    const text_style_t def = { v->font_color, COLOR_BLACK, 0 };
+    d->style = style ? *style : def;
+    d->target = target;
+    d->view_blend = NULL;
+    display_select_font(d, v);
+    view_text_t* t = display_find_text(d, v);
+    if (t && t->font != display_font_key(d))
+        t->font = t->count ? 0 : display_font_key(d);
+    for (size_t i = 0; i < str_len; i) {
+        // 有个字符是结束标志故判断没关系.
+        const uint8_t* gb = (const uint8_t*)str + i;
+        if (t)
+            view_text_mark(t, i, v->now_x, v->now_y, &d->style);
+        // 颜色转义和字符分类在同一次扫描中处理
+        if (d->ansi && *gb == TEXT_STYLE_ESC) {
+            size_t n = text_style_parse_sgr(&d->style, &def, str + i, str_len - i);
+            if (n) {
+                i += n;
+                continue;
+            }
+        }
+        const uint8_t* bitmap = d->view_font.aa ? font_face_glyph_aa(d->view_font.face, gb)
+                                                : font_face_glyph(d->view_font.face, gb);
+        gb2312_word_type_t type = get_gb2312_word_type(gb);
+        switch (type) {
+        case GB2312_ASCII:
+            switch (*gb) {
+            case '\n':
+                LOG_DBG("try draw: `\\n`");
+                display_draw_endl_word(d, v);
+                break;
+            case '\t':
+                LOG_DBG("try draw: `\\t`");
+                display_draw_tabs_word(d, v);
+                break;
+            case ' ':
+                LOG_DBG("try draw: ` `");
+                display_draw_space_word(d, v);
+                break;
+            default:
+                if (isgraph(*gb) && bitmap) {
+                    LOG_DBG("try draw ascii: %c", str[i]);
+                    display_layout_word(d, v, &glyphs[count++], bitmap, GB2312_ASCII);
+                } else {
+                    LOG_DBG("unknow ch: 0x%02x", str[i]);
+                }
+                break;
+            }
+
+            i += GB2312_ASCII_BIT;
+            continue;
+        case GB2312_CHINESE:
+            LOG_DBG("try draw zh(0x%x, 0x%x) ", str[i], str[i + 1]);
+            // 字库中没有的字跳过
+            if (bitmap)
+                display_layout_word(d, v, &glyphs[count++], bitmap, GB2312_CHINESE);
+            i += GB2312_ZH_BIT;
+            continue;
+            ;
+        default:
+            i += sizeof(char);
+            continue;
+        }
+    }
+    display_raster(d, v, glyphs, count);
+    d->target = NULL;
+    if (t)
+        view_text_append(t, str, str_len, v->now_x, v->now_y, &d->style);
+
+    return 0;
+}
+
+/**
+ * @brief 获取来源编码到 GB2312 的转码句柄, 来源编码不变时复用上一次打开的句柄
+ *
+ * @param d 指向 display_t 结构的指针，表示当前显示的状态和属性。
+ * @param from_code 字符编码
+ * 
+ * @return 成功返回 转码句柄 失败返回 (iconv_t)-1
+ */
+static iconv_t display_get_conv(display_t* d, const char* from_code)
+{
+    if (d->conv != (iconv_t)-1 && 0 == strcasecmp(d->conv_code, from_code))
+        return d->conv;
+
+    if (d->conv != (iconv_t)-1) {
+        iconv_close(d->conv);
+        d->conv = (iconv_t)-1;
+    }
+    if (strlen(from_code) >= sizeof(d->conv_code)) {
+        LOG_ERR("from_code(%s) too long", from_code);
+        return (iconv_t)-1;
+    }
+    d->conv = iconv_open("GB2312", from_code);
+    if (d->conv == (iconv_t)-1) {
+        LOG_ERR("fail to iconv open %s to GB2312", from_code);
+        return (iconv_t)-1;
+    }
+    strcpy(d->conv_code, from_code);
+    return d->conv;
+}
+
+/**
+ * @brief 显示视图信息
+ *
+ * @param v 指向 view_t 结构的指针，表示当前视图的设置和参数。
+ */
+static inline void display_show_view_info(view_t* v)
+{
+    LOG_DBG("  start_x: %zu, start_y: %zu, width: %zu, height: %zu, "
+            "now_x: %zu, now_y: %zu, start_x: %zu, start_y: %zu, font_color: %hu",
+        v->start_x, v->start_y, v->width, v->height, v->now_x,
+        v->now_y, v->start_x, v->start_y, v->font_color);
+}
+
+/**
+ * @brief 把字符串转换为 GB2312 编码
+ *
+ * @param d 指向 display_t 结构的指针，表示当前显示的状态和属性。
+ * @param from_code 字符编码
+ * @param str 被转换的字符
+ * @param str_len 被转换的字符长度
+ * @param out 输出 GB2312 字符串, 为 GB2312 编码时直接指向 str, 否则指向临时内存池,
+ *            下次 arena_reset 前有效
+ * 
+ * @return 成功返回 GB2312 字符串长度 失败返回 -1
+ */
+static int display_conv_gb2312(display_t* d, const char* from_code, const char* str, size_t str_len,
+    const char** out)
+{
+    *out = str;
+    if (!str_len || 0 == strcasecmp("GB2312", from_code))
+        return str_len;
+
+    iconv_t cd = display_get_conv(d, from_code);
+    if (cd == (iconv_t)-1)
+        return -1;
+
+    // GB2312 每个字符最多 2 字节, 来源编码每个字符至少 1 字节
+    size_t size = str_len * 2;
+    char* buf = (char*)arena_alloc(d->arena, size);
+    if (!buf) {
+        LOG_DBG("STR TOO LONG! ");
+        return -1;
+    }
+    // 将编码转换为gb2312
+    int len = str_conv_gb2312(cd, str_len, str, size, buf);
+    if (len < 0) {
+        LOG_DBG("fail to conv %s to GB2312", from_code);
+        return -1;
+    }
+    *out = buf;
+    return len;
+}
+
+/**
+ * @brief 排版一遍单行文字, 不绘制, 得到打印时绘制的列和不换行需要的右侧空间
+ *
+ * 与 display_view_print_gb2312 的排版一致: 空格和制表符只移动光标, 颜色转义和
+ * 不认识的字符不占位置。从 x = 0 开始, 每一步换行判断用到的最远位置就是需要的右侧空间,
+ * 开始位置加上它小于视图右侧时排版不会换行, 绘制结果只和开始位置差一个平移。
+ *
+ * @param d 指向 display_t 结构的指针, 已选择字体。
+ * @param str GB2312 文字。
+ * @param str_len 文字字节数。
+ * @param spans 输出绘制的列, 至少 str_len 个。
+ * @param span_count 输出列段数。
+ * @param advance 输出光标前进的宽度。
+ * @param reach 输出需要的右侧空间。
+ * @return 可以缓存返回 0, 有换行或没有绘制任何字符返回 -1。
+ */
+static int display_sprite_measure(display_t* d, const char* str, size_t str_len, sprite_span_t* spans,
+    size_t* span_count, size_t* advance, size_t* reach)
+{
+    const display_font_t* f = &d->view_font;
+    const text_style_t def = { COLOR_WHITE, COLOR_BLACK, 0 };
+    text_style_t st = def;
+    size_t x = 0;
+    size_t far = 0;
+    size_t count = 0;
+    for (size_t i = 0; i < str_len;) {
+        const uint8_t* gb = (const uint8_t*)str + i;
+        if (d->ansi && *gb == TEXT_STYLE_ESC) {
+            size_t n = text_style_parse_sgr(&st, &def, str + i, str_len - i);
+            if (n) {
+                i += n;
+                continue;
+            }
+        }
+        gb2312_word_type_t type = get_gb2312_word_type(gb);
+        size_t step = type == GB2312_CHINESE ? GB2312_ZH_BIT : GB2312_ASCII_BIT;
+        if (type == GB2312_ASCII && (*gb == '\n' || *gb == '\t' || *gb == ' ')) {
+            if (*gb == '\n')
+                return -1;
+            for (size_t n = *gb == '\t' ? DISPLAY_TABS_OF_SPACE : 1; n > 0; --n) {
+                x += f->ascii_width;
+                far = x + f->ascii_width > far ? x + f->ascii_width : far;
+            }
+        } else if (type != GB2312_UNDEFINE && (type == GB2312_CHINESE || isgraph(*gb))
+            && (f->aa ? font_face_glyph_aa(f->face, gb) : font_face_glyph(f->face, gb))) {
+            size_t width = type == GB2312_CHINESE ? f->zh_width : f->ascii_width;
+            if (count && spans[count - 1].x + spans[count - 1].width == x)
+                spans[count - 1].width += width;
+            else
+                spans[count++] = { (uint16_t)x, (uint16_t)width };
+            // 逐像素绘制时中文前半个字按中文宽度判断换行, 光标移动后按本字符宽度判断
+            if (type == GB2312_CHINESE && x + width / 2 - 1 + f->zh_width > far)
+                far = x + width / 2 - 1 + f->zh_width;
+            x += width;
+            far = x + width > far ? x + width : far;
+        }
+        i += step;
+    }
+    if (!count)
+        return -1;
+    *span_count = count;
+    *advance = x;
+    *reach = far;
+    return 0;
+}
+
+/**
+ * @brief 生成视图字体和颜色下的精灵键: 字体、颜色、是否解析转义、来源编码、原始文字
+ *
+ * @return 键的字节数, 内存不足返回 0。
+ */
+static size_t display_sprite_key(display_t* d, view_t* v, const char* from_code, const char* str, size_t str_len,
+    const uint8_t** key)
+{
+    size_t head[] = { display_font_key(d), v->font_color, COLOR_BLACK, (size_t)d->ansi };
+    size_t code_len = strlen(from_code) + 1;
+    size_t len = sizeof(head) + code_len + str_len;
+    uint8_t* buf = (uint8_t*)arena_alloc(d->arena, len);
+    if (!buf)
+        return 0;
+    memcpy(buf, head, sizeof(head));
+    memcpy(buf + sizeof(head), from_code, code_len);
+    memcpy(buf + sizeof(head) + code_len, str, str_len);
+    *key = buf;
+    return len;
+}
+
+/**
+ * @brief 把文字绘制成精灵加入缓存
+ *
+ * 在屏幕大小的临时视图左上角排版, 绘制到以精灵像素为离屏缓存的临时图层上,
+ * 绘制过程与直接打印完全相同。
+ *
+ * @param d 指向 display_t 结构的指针, 已按视图选择字体。
+ * @param v 视图, 使用其字号和颜色。
+ * @param key 精灵键。
+ * @param key_len 键的字节数。
+ * @param str GB2312 文字。
+ * @param str_len 文字字节数。
+ * @param pinned 是否固定。
+ * @return 成功返回精灵, 文字不能缓存或放不下返回 NULL。
+ */
+static sprite_t* display_sprite_make(display_t* d, view_t* v, const uint8_t* key, size_t key_len,
+    const char* str, size_t str_len, int pinned)
+{
+    sprite_span_t* spans = (sprite_span_t*)arena_alloc(d->arena, str_len * sizeof(sprite_span_t));
+    size_t span_count = 0, advance = 0, reach = 0;
+    if (!spans || display_sprite_measure(d, str, str_len, spans, &span_count, &advance, &reach) < 0)
+        return NULL;
+    size_t width = spans[span_count - 1].x + spans[span_count - 1].width;
+    if (reach >= d->fb_info->width || d->view_font.height > d->fb_info->height)
+        return NULL;
+
+    sprite_t* s = sprite_cache_insert(d->sprites, key, key_len, width, d->view_font.height, span_count, pinned);
+    if (!s)
+        return NULL;
+    memcpy(s->spans, spans, span_count * sizeof(sprite_span_t));
+    s->advance = advance;
+    s->reach = reach;
+
+    compositor_layer_t l;
+    memset(&l, 0, sizeof(l));
+    l.width = s->width;
+    l.height = s->height;
+    l.surface = s->pixels;
+    l.stride = s->width * COLOR_SIZE;
+    view_t sv = { 0, 0, d->fb_info->width, d->fb_info->height, 0, 0, v->font_color, v->font_size, v->font_scale };
+    if (display_view_print_gb2312(d, &sv, str, str_len, NULL, &l) < 0 || sv.now_x != advance || sv.now_y) {
+        LOG_ERR("fail to render sprite, now(%zu, %zu) advance(%zu)", sv.now_x, sv.now_y, advance);
+        sprite_cache_remove(d->sprites, s);
+        return NULL;
+    }
+    LOG_DBG("make sprite %zux%zu, %zu spans, reach %zu", s->width, s->height, s->span_count, s->reach);
+    return s;
+}
+
+/**
+ * @brief 在视图当前光标位置绘制精灵, 光标前进
+ *
+ * @return 排版会换行(右侧或底部放不下)不能使用精灵返回 -1, 成功返回 0。
+ */
+static int display_sprite_draw(display_t* d, view_t* v, const sprite_t* s)
+{
+    size_t real_width = (v->start_x + v->width) >= d->fb_info->width ?
+        d->fb_info->width : v->start_x + v->width;
+    size_t real_height = (v->start_y + v->height) >= d->fb_info->height ?
+        d->fb_info->height : v->start_y + v->height;
+    if (v->now_x + s->reach >= real_width || v->now_y + s->height > real_height)
+        return -1;
+
+    display_band_t b;
+    memset(&b, 0, sizeof(b));
+    b.y1 = d->fb_info->height;
+    d->target = compositor_layer_find(d->comp, v);
+    for (size_t k = 0; k < s->height; ++k) {
+        const framebuffer_color_t* row = s->pixels + k * s->width;
+        for (size_t i = 0; i < s->span_count; ++i)
+            display_band_draw_row(d, &b, v->now_x + s->spans[i].x, v->now_y + k, row + s->spans[i].x, NULL,
+                s->spans[i].width);
+    }
+    d->target = NULL;
+    if (b.dirty_x1)
+        display_add_dirty(d, b.dirty_x0, b.dirty_y0, b.dirty_x1 - b.dirty_x0, b.dirty_y1 - b.dirty_y0);
+    v->now_x += s->advance;
+    return 0;
+}
+
+/**
+ * @brief 使用精灵缓存打印文字
+ *
+ * 命中时直接绘制精灵, 不转码不排版; 最近未命中过的文字转码后绘制成精灵加入缓存。
+ * 保留文字内容的视图(display_view_set_text)需要记录每个字符, 不使用精灵。
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param v 视图。
+ * @param from_code 字符编码。
+ * @param str 文字。
+ * @param str_len 文字字节数。
+ * @param gb 输出转码结果, 没有转码时不修改。
+ * @param gb_len 输出转码结果的字节数, 转码失败为负数。
+ * @return 已用精灵绘制返回 0, 需要正常打印返回 -1。
+ */
+static int display_sprite_print(display_t* d, view_t* v, const char* from_code, const char* str, size_t str_len,
+    const char** gb, int* gb_len)
+{
+    if (!d->sprites || display_find_text(d, v))
+        return -1;
+
+    display_select_font(d, v);
+    const uint8_t* key = NULL;
+    size_t key_len = display_sprite_key(d, v, from_code, str, str_len, &key);
+    if (!key_len)
+        return -1;
+    int admit = 0;
+    sprite_t* s = sprite_cache_find(d->sprites, key, key_len, &admit);
+    if (!s && admit) {
+        *gb_len = display_conv_gb2312(d, from_code, str, str_len, gb);
+        if (*gb_len > 0)
+            s = display_sprite_make(d, v, key, key_len, *gb, *gb_len, 0);
+    }
+    return s ? display_sprite_draw(d, v, s) : -1;
+}
+
+/**
+ * @brief 开启字符串精灵缓存
+ *
+ * 反复打印的相同文字(视图字号、颜色、编码都相同)第二次打印时绘制成精灵缓存起来,
+ * 之后在任何不换行的位置打印都直接拷贝像素。只有 display_view_print 使用,
+ * 按最近使用顺序淘汰, 总内存不超过上限, 固定的精灵不淘汰。
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param max_bytes 内存上限, 0 关闭并释放全部精灵。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int display_set_sprite_cache(display_t* d, size_t max_bytes)
+{
+    if (!d)
+        return -1;
+
+    int ret = 0;
+    pthread_mutex_lock(&d->lock);
+    if (!max_bytes) {
+        sprite_cache_exit(d->sprites);
+        d->sprites = NULL;
+    } else if (d->sprites) {
+        sprite_cache_set_limit(d->sprites, max_bytes);
+    } else {
+        d->sprites = sprite_cache_init(max_bytes);
+        ret = d->sprites ? 0 : -1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return ret;
+}
+
+/**
+ * @brief 预先绘制并固定一个精灵, 用于界面上固定的标签
+ *
+ * 按视图的字号和颜色绘制, 之后在该字号和颜色的视图上打印相同文字直接命中。
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param v 视图, 只使用字号和颜色。
+ * @param from_code 字符编码。
+ * @param str 文字。
+ * @param str_len 文字字节数。
+ * @return 成功返回 0, 没有开启缓存、文字有换行、超过内存上限等返回 -1。
+ */
+int display_sprite_pin(display_t* d, view_t* v, const char* from_code, const char* str, size_t str_len)
+{
+    if (!d || !v || !from_code || !str || !str_len)
+        return -1;
+
+    int ret = -1;
+    pthread_mutex_lock(&d->lock);
+    if (d->sprites) {
+        arena_reset(d->arena);
+        display_select_font(d, v);
+        const uint8_t* key = NULL;
+        const char* gb = NULL;
+        size_t key_len = display_sprite_key(d, v, from_code, str, str_len, &key);
+        int len = key_len ? display_conv_gb2312(d, from_code, str, str_len, &gb) : -1;
+        if (len > 0 && display_sprite_make(d, v, key, key_len, gb, len, 1))
+            ret = 0;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return ret;
+}
+
+/**
+ * @brief 往显示上打印文字(支持中文)
+ *
+ * @param d 指向 display_t 结构的指针，表示当前显示的状态和属性。
+ * @param v 指向 view_t 结构的指针，表示当前视图的设置和参数。
+ * @param from_code 字符编码
+ * @param str 被打印的字符
+ * @param str_len 被打印的字符长度
+ * 
+ * @return 成功返回 0 失败返回 非0
+ */
+int display_view_print(display_t* d, view_t* v, const char* from_code, const char* str, size_t str_len)
+{
+    if (!d || !v || !from_code || !str || !str_len) {
+        LOG_DBG("arg failed: d(%p) v(%p) from_code(%p) str(%p) str_len(%zu) ",
+            d, v, from_code, str, str_len);
+        return -1;
+    }
+    LOG_DBG("display(%p) try print.", d);
+    display_show_view_info(v);
+
+    pthread_mutex_lock(&d->lock);
+    arena_reset(d->arena);
+    const char* gb = NULL;
+    int len = 0;
+    int ret = 0;
+    if (display_sprite_print(d, v, from_code, str, str_len, &gb, &len) < 0) {
+        if (!gb)
+            len = display_conv_gb2312(d, from_code, str, str_len, &gb);
+        ret = len < 0 ? -1 : display_view_print_gb2312(d, v, gb, len, NULL, compositor_layer_find(d->comp, v));
+    }
+    pthread_mutex_unlock(&d->lock);
+    return ret;
+}
+
+/**
+ * @brief display_view_set_text 的实现, 调用者需持有 d->lock
+ */
+static int display_view_set_text_locked(display_t* d, view_t* v, const char* from_code, const char* str, size_t str_len)
+{
+    arena_reset(d->arena);
+    const char* gb = NULL;
+    int len = display_conv_gb2312(d, from_code, str, str_len, &gb);
+    if (len < 0)
+        return -1;
+
+    display_select_font(d, v);
+    view_text_t* t = display_find_text(d, v);
+    if (!t) {
+        t = view_text_init(v);
+        if (!t)
+            return -1;
+        t->next = d->texts;
+        d->texts = t;
+        // 之前的内容未知, 整个视图重新绘制
+        display_view_clear(d, v);
+    } else if (t->wrapped || t->font != display_font_key(d)) {
+        // 回绕覆盖过或者字体变了, 保留的位置都不能用
+        display_view_clear(d, v);
+    }
+
+    size_t glyph = view_text_diff(t, gb, len);
+    if (glyph == t->count && (size_t)len == t->len)
+        return 0;
+
+    if (glyph < t->count) {
+        // 清掉旧文字从变化字符开始的部分: 当前行剩余部分 + 下面到旧文字末尾的行
+        size_t old_end_y = t->end_y;
+        view_text_truncate(t, glyph);
+        d->target = compositor_layer_find(d->comp, v);
+        size_t x = t->end_x > v->start_x ? t->end_x : v->start_x;
+        if (x < v->start_x + v->width)
+            display_fill_black(d, x, t->end_y, v->start_x + v->width - x, d->view_font.height);
+        if (old_end_y > t->end_y)
+            display_fill_black(d, v->start_x, t->end_y + d->view_font.height,
+                v->width, old_end_y - t->end_y);
+        d->target = NULL;
+    }
+    LOG_DBG("view(%p) redraw from glyph %zu/%zu", v, glyph, t->count);
+
+    v->now_x = t->end_x;
+    v->now_y = t->end_y;
+    return display_view_print_gb2312(d, v, gb + t->len, len - t->len, t->len ? &t->end_style : NULL,
+        compositor_layer_find(d->comp, v));
+}
+
+/**
+ * @brief 设置视图的全部文字
+ *
+ * 视图保留上一次的文字内容, 与新文字比较后只从第一个变化的字符开始重新绘制,
+ * 只修改结尾状态提示等少量文字时只需要绘制几个字符。
+ * 第一次调用或者旧文字超出视图发生过回绕时整个视图重新绘制。
+ * 之后对该视图的 display_view_print 视为追加文字, display_view_clear 清空文字。
+ *
+ * @param d 指向 display_t 结构的指针，表示当前显示的状态和属性。
+ * @param v 指向 view_t 结构的指针，表示当前视图的设置和参数。
+ * @param from_code 字符编码
+ * @param str 新的文字
+ * @param str_len 新的文字长度, 为 0 时清空视图
+ * 
+ * @return 成功返回 0 失败返回 非0
+ */
+int display_view_set_text(display_t* d, view_t* v, const char* from_code, const char* str, size_t str_len)
+{
+    if (!d || !v || !from_code || (!str && str_len)) {
+        LOG_DBG("arg failed: d(%p) v(%p) from_code(%p) str(%p) str_len(%zu) ",
+            d, v, from_code, str, str_len);
+        return -1;
+    }
+
+    pthread_mutex_lock(&d->lock);
+    int ret = display_view_set_text_locked(d, v, from_code, str, str_len);
+    pthread_mutex_unlock(&d->lock);
+    return ret;
+}
+
+/**
+ * @brief 把视图内的矩形裁剪到视图和屏幕(图层视图为图层)范围内
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param v 指向视图的指针。
+ * @param l 视图的图层, NULL 表示绘制到显示缓存。
+ * @param x 矩形左上角在屏幕上的 x
+ * @param y 矩形左上角在屏幕上的 y
+ * @param w 矩形宽
+ * @param h 矩形高
+ * @param r 输出裁剪后的区域
+ *
+ * @return 裁剪后不为空返回 1, 否则返回 0
+ */
+static inline int display_clip_view(display_t* d, view_t* v, compositor_layer_t* l,
+    size_t x, size_t y, size_t w, size_t h, frame_rect_t* r)
+{
+    size_t x0 = l ? l->x : 0;
+    size_t y0 = l ? l->y : 0;
+    size_t x1 = l ? l->x + l->width : d->fb_info->width;
+    size_t y1 = l ? l->y + l->height : d->fb_info->height;
+    x1 = v->start_x + v->width < x1 ? v->start_x + v->width : x1;
+    y1 = v->start_y + v->height < y1 ? v->start_y + v->height : y1;
+    x1 = x + w < x1 ? x + w : x1;
+    y1 = y + h < y1 ? y + h : y1;
+    x0 = x > x0 ? x : x0;
+    y0 = y > y0 ? y : y0;
+    if (x0 >= x1 || y0 >= y1)
+        return 0;
+    r->x = x0;
+    r->y = y0;
+    r->w = x1 - x0;
+    r->h = y1 - y0;
+    return 1;
+}
+
+/**
+ * @brief 获取屏幕上 (x, y) 在绘制目标(图层离屏缓存或显示缓存)中的地址
+ */
+static inline framebuffer_color_t* display_target_pixel(display_t* d, compositor_layer_t* l, size_t x, size_t y)
+{
+    if (l)
+        return (framebuffer_color_t*)((uint8_t*)l->surface + (y - l->y) * l->stride + (x - l->x) * COLOR_SIZE);
+    return (framebuffer_color_t*)(d->cache + (y * d->fb_info->width + x) * COLOR_SIZE);
+}
+
+/**
+ * @brief 在视图上绘制图片
+ *
+ * 逐行采样为 RGBA8888, 需要时与原内容混合, 再转换为 RGB565 直接写入显示缓存或视图图层。
+ * 图片位置相对视图, 超出视图和屏幕的部分被裁剪掉, 只标记图片所在区域为修改区域。
+ *
+ * @param d 指向 display_t 结构的指针，表示当前显示的状态和属性。
+ * @param v 指向 view_t 结构的指针，表示当前视图的设置和参数。
+ * @param x 图片左上角相对视图的 x
+ * @param y 图片左上角相对视图的 y
+ * @param w 绘制宽度, 0 为图片宽度, 与图片宽度不同时缩放
+ * @param h 绘制高度, 0 为图片高度, 与图片高度不同时缩放
+ * @param pixels 图片像素
+ * @param img_w 图片宽
+ * @param img_h 图片高
+ * @param stride 图片每行字节数, 0 为紧密排列
+ * @param format 像素格式, IMAGE_FORMAT_RGB888 或 IMAGE_FORMAT_RGBA8888
+ * @param flags DISPLAY_IMAGE_* 的组合
+ * 
+ * @return 成功返回 0 失败返回 -1
+ */
+int display_draw_image(display_t* d, view_t* v, size_t x, size_t y, size_t w, size_t h,
+    const uint8_t* pixels, size_t img_w, size_t img_h, size_t stride, int format, int flags)
+{
+    if (!d || !v || !pixels || !img_w || !img_h
+        || (format != IMAGE_FORMAT_RGB888 && format != IMAGE_FORMAT_RGBA8888)) {
+        LOG_DBG("arg failed: d(%p) v(%p) pixels(%p) img(%zux%zu) format(%d)",
+            d, v, pixels, img_w, img_h, format);
+        return -1;
+    }
+    w = w ? w : img_w;
+    h = h ? h : img_h;
+    stride = stride ? stride : img_w * IMAGE_FORMAT_BPP(format);
+
+    pthread_mutex_lock(&d->lock);
+    // 图片在屏幕上的位置
+    compositor_layer_t* l = compositor_layer_find(d->comp, v);
+    size_t img_x = v->start_x + x;
+    size_t img_y = v->start_y + y;
+    frame_rect_t r;
+    if (!display_clip_view(d, v, l, img_x, img_y, w, h, &r)) {
+        pthread_mutex_unlock(&d->lock);
+        return 0;
+    }
+
+    // 紧凑显示缓存先转换到一行 RGB565 再量化写入
+    int packed = d->shadow && !l;
+    arena_reset(d->arena);
+    uint8_t* rgba = (uint8_t*)arena_alloc(d->arena, r.w * 4);
+    framebuffer_color_t* line = packed ? (framebuffer_color_t*)arena_alloc(d->arena, r.w * COLOR_SIZE) : NULL;
+    if (!rgba || (packed && !line)) {
+        pthread_mutex_unlock(&d->lock);
+        return -1;
+    }
+
+    image_scale_t scale = flags & DISPLAY_IMAGE_BILINEAR ? IMAGE_SCALE_BILINEAR : IMAGE_SCALE_NEAREST;
+    int blend = (flags & DISPLAY_IMAGE_ALPHA) && format == IMAGE_FORMAT_RGBA8888;
+    for (size_t row = r.y; row < r.y + r.h; ++row) {
+        framebuffer_color_t* dst = packed ? line : display_target_pixel(d, l, r.x, row);
+        image_scale_row(pixels, img_w, img_h, stride, (image_format_t)format, w, h,
+            row - img_y, r.x - img_x, r.x + r.w - img_x, scale, rgba);
+        if (blend) {
+            if (packed)
+                shadow_unpack_row(d->shadow, r.x, row, line, r.w);
+            image_blend_row(rgba, dst, r.w);
+        }
+        image_rgba_to_rgb565(rgba, r.w, r.x, row, flags & DISPLAY_IMAGE_DITHER, dst);
+        if (packed)
+            shadow_pack_row(d->shadow, r.x, row, line, r.w);
+    }
+    if (!l || l->visible)
+        display_add_dirty(d, r.x, r.y, r.w, r.h);
+    pthread_mutex_unlock(&d->lock);
+
+    return 0;
+}
+
+/**
+ * @brief 在视图上绘制 PPM(P6) 图片文件
+ *
+ * @param d 指向 display_t 结构的指针，表示当前显示的状态和属性。
+ * @param v 指向 view_t 结构的指针，表示当前视图的设置和参数。
+ * @param x 图片左上角相对视图的 x
+ * @param y 图片左上角相对视图的 y
+ * @param w 绘制宽度, 0 为图片宽度
+ * @param h 绘制高度, 0 为图片高度
+ * @param path 图片路径
+ * @param flags DISPLAY_IMAGE_* 的组合
+ * 
+ * @return 成功返回 0 失败返回 -1
+ */
+int display_draw_ppm(display_t* d, view_t* v, size_t x, size_t y, size_t w, size_t h,
+    const char* path, int flags)
+{
+    if (!d || !v || !path)
+        return -1;
+
+    image_t* img = image_load_ppm(path);
+    if (!img)
+        return -1;
+    int ret = display_draw_image(d, v, x, y, w, h, img->data, img->width, img->height,
+        img->stride, img->format, flags);
+    image_exit(img);
+    return ret;
+}
+
+/**
+ * @brief 电平控件输出回调: 把控件画面拷贝到视图并刷新, 在控件线程中执行
+ *
+ * @param arg 指向 display_meter_t 的指针
+ * @param pixels 控件画面
+ * @param w 宽
+ * @param h 高
+ */
+static void display_meter_draw(void* arg, const framebuffer_color_t* pixels, size_t w, size_t h)
+{
+    display_meter_t* dm = (display_meter_t*)arg;
+    display_t* d = dm->d;
+    view_t* v = dm->v;
+
+    pthread_mutex_lock(&d->lock);
+    compositor_layer_t* l = compositor_layer_find(d->comp, v);
+    frame_rect_t r;
+    if (display_clip_view(d, v, l, v->start_x, v->start_y, w, h, &r)) {
+        for (size_t row = r.y; row < r.y + r.h; ++row) {
+            const framebuffer_color_t* src = pixels + (row - v->start_y) * w + (r.x - v->start_x);
+            if (d->shadow && !l)
+                shadow_pack_row(d->shadow, r.x, row, src, r.w);
+            else
+                memcpy(display_target_pixel(d, l, r.x, row), src, r.w * COLOR_SIZE);
+        }
+        // 只刷新控件区域, 其它线程标记的区域留给它们自己的 display_fflush
+        if (!l || l->visible) {
+            frame_rect_clip(&r, d->fb_info->width, d->fb_info->height);
+            display_fflush_rect_locked(d, r);
+        }
+    }
+    pthread_mutex_unlock(&d->lock);
+}
+
+/**
+ * @brief 在视图上启动电平控件
+ *
+ * 控件占满整个视图, 由独立线程按帧率上限只重画并刷新这个视图的区域,
+ * PCM 或电平通过 meter_push_pcm/meter_push_level 送入, 不需要调用者循环重画。
+ * 控件线程与调用线程通过 display 内部的锁互斥, 期间其它接口仍可正常使用。
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param v 指向视图的指针, 控件存在期间必须有效。
+ * @param style 显示样式, meter_style_t。
+ * @param fps 帧率上限, 0 使用默认值。
+ * @param window 每个电平的采样数, 0 使用默认值。
+ *
+ * @return 成功返回控件指针, 失败返回 NULL
+ */
+meter_t* display_meter_start(display_t* d, view_t* v, int style, size_t fps, size_t window)
+{
+    if (!d || !v || !v->width || !v->height)
+        return NULL;
+
+    display_meter_t* dm = (display_meter_t*)malloc(sizeof(display_meter_t));
+    if (!dm) {
+        LOG_ERR("fail to malloc meter.");
+        return NULL;
     }
-    if (success) {
-        v->now_x += ASCII_WORD_SIZE;
-        display_cul_next_line(d, v, &v->now_x, &v->now_y, GB2312_ASCII);
+    dm->d = d;
+    dm->v = v;
+    dm->meter = meter_init(v->width, v->height, style, fps, window, display_meter_draw, dm);
+    if (!dm->meter) {
+        free(dm);
+        return NULL;
     }
+    meter_set_color(dm->meter, v->font_color, COLOR_BLACK);
+
+    pthread_mutex_lock(&d->lock);
+    dm->next = d->meters;
+    d->meters = dm;
+    pthread_mutex_unlock(&d->lock);
+
+    return dm->meter;
 }
 
 /**
- * @brief 绘制GB2312中文字符
+ * @brief 停止电平控件, 视图保留最后一帧画面
  *
- * @param d 指向 display_t 结构的指针，表示当前显示的状态和属性。
- * @param v 指向 view_t 结构的指针，表示当前视图的设置和参数。
- * @param wb GB2312中文字体位图
+ * @param d 指向 display_t 结构的指针。
+ * @param m display_meter_start 返回的控件指针。
  */
-static inline void display_draw_zh_word(display_t* d, view_t* v, word_bitmap_t* wb)
+void display_meter_stop(display_t* d, meter_t* m)
 {
-    assert(d && v && wb && "arg failed!");
-
-    const uint8_t* buffer = (const uint8_t*)wb->zh;
-    static unsigned char key[BIT_SIZE] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
-    size_t next_x = v->now_x;
-    size_t next_y = v->now_y;
-    int success = 0;
-
-    for (int k = 0; k < FONT_HEIGHT_WORD_SIZE; ++k, next_y += 1) {
-        for (int j = 0; j < GB2312_ZH_BIT; ++j) {
-            success = 0;
-            for (int i = 0; i < BIT_SIZE; ++i, next_x += 1) {
-                // 第二边界有可能又越界
-                gb2312_word_type_t break_line = (j == 0 ? GB2312_CHINESE : GB2312_ASCII);
-                int ret = display_cul_next_line(d, v, &next_x, &next_y, break_line);
-                if (ret < 0) {
-                    LOG_ERR("fail to draw zh nx(%zu) ny(%zu) next line.", next_x, next_y);
-                    return;
-                }
-                int flag = buffer[k * 2 + j] & key[i];
-                display_set_cache_color(d, next_x, next_y, flag ? v->font_color : COLOR_BLACK);
-
-#if DETAIL_LOG_ENABLE
-                if (flag)
-                    LOG_DBG("set %04x in (%zu, %zu) of display(%p) done",
-                        v->font_color, next_x, next_y, d);
-#endif // DETAIL_LOG_ENABLE
+    if (!d || !m)
+        return;
 
-                success = 1;
-            }
+    pthread_mutex_lock(&d->lock);
+    display_meter_t* dm = NULL;
+    for (display_meter_t** p = &d->meters; *p; p = &(*p)->next) {
+        if ((*p)->meter == m) {
+            dm = *p;
+            *p = dm->next;
+            break;
         }
-        if (success) { }
-        next_x = v->now_x;
     }
-    if (success) {
-        v->now_x += ZH_WORD_SIZE;
-        display_cul_next_line(d, v, &v->now_x, &v->now_y, GB2312_CHINESE);
+    pthread_mutex_unlock(&d->lock);
+
+    // 控件线程可能正在等锁绘制, 需要在锁外等它退出
+    if (dm) {
+        meter_exit(dm->meter);
+        free(dm);
     }
 }
 
-
 /**
- * @brief 往显示上打印 GB2312中文 + ASCII字符串
+ * @brief 动画到期: 文字帧动画切换到这一帧的文字, 只重画变化的字符; 回调动画调用回调. 在动画线程中执行
  *
- * @param d 指向 display_t 结构的指针，表示当前显示的状态和属性。
- * @param v 指向 view_t 结构的指针，表示当前视图的设置和参数。
- * @param str 被打印的GB2312中文字符串
- * @param str_len 被打印的GB2312中文字符串长度
- * 
- * @return 成功返回 0 失败返回 非0
+ * @param arg 指向 display_anim_t 的指针
+ * @param frame 帧号
+ * @return 画面有修改返回 1
  */
-static int display_view_print_gb2312(display_t* d, view_t* v, const char* str, size_t str_len)
+static int display_anim_tick(void* arg, size_t frame)
 {
-    if (!d || !str || !str_len) {
-        return 0;
+    display_anim_t* a = (display_anim_t*)arg;
+    display_t* d = a->d;
+    int changed = 0;
+
+    pthread_mutex_lock(&d->lock);
+    if (a->fn) {
+        changed = a->fn(d, a->v, frame, a->arg);
+    } else if (frame % a->count != a->shown) {
+        a->shown = frame % a->count;
+        changed = !display_view_set_text_locked(d, a->v, a->code, a->frames[a->shown], a->lens[a->shown]);
     }
+    pthread_mutex_unlock(&d->lock);
+    return changed;
+}
 
-    for (size_t i = 0; i < str_len; i) {
-        // 有个字符是结束标志故判断没关系.
-        const uint8_t* gb = (const uint8_t*)str + i;
-        word_bitmap_t* wb = gb2312_to_word_bitmap(d->font, gb);
-        gb2312_word_type_t type = get_gb2312_word_type(gb);
-        switch (type) {
-        case GB2312_ASCII:
-            switch (*gb) {
-            case '\n':
-                LOG_DBG("try draw: `\\n`");
-                display_draw_endl_word(d, v);
-                break;
-            case '\t':
-                LOG_DBG("try draw: `\\t`");
-                display_draw_tabs_word(d, v);
-                break;
-            case ' ':
-                LOG_DBG("try draw: ` `");
-                display_draw_space_word(d, v);
-                break;
-            default:
-                if (isgraph(*gb)) {
-                    LOG_DBG("try draw ascii: %c", str[i]);
-                    display_draw_ascii_word(d, v, wb);
-                } else {
-                    LOG_DBG("unknow ch: 0x%02x", str[i]);
-                }
-                break;
-            }
+/**
+ * @brief 同一次唤醒的动画都绘制完后刷新一次, 调用者之前的修改也一起刷新. 在动画线程中执行
+ *
+ * @param arg 指向 display_t 的指针
+ */
+static void display_anim_flush(void* arg)
+{
+    display_fflush((display_t*)arg);
+}
 
-            i += GB2312_ASCII_BIT;
-            continue;
-        case GB2312_CHINESE:
-            LOG_DBG("try draw zh(0x%x, 0x%x) ", str[i], str[i + 1]);
-            display_draw_zh_word(d, v, wb);
-            i += GB2312_ZH_BIT;
-            continue;
-            ;
-        default:
-            i += sizeof(char);
-            continue;
-        }
+/**
+ * @brief 把动画交给调度器并记录到显示, 失败时释放动画
+ *
+ * @return 成功返回动画指针, 失败返回 NULL
+ */
+static display_anim_t* display_anim_add(display_t* d, display_anim_t* a, size_t period_ms)
+{
+    pthread_mutex_lock(&d->lock);
+    if (!d->animator)
+        d->animator = animator_init(display_anim_flush, d);
+    animator_t* animator = d->animator;
+    pthread_mutex_unlock(&d->lock);
+
+    // 动画线程会在 tick 中获取 d->lock, 需要在锁外加入
+    a->task = animator ? animator_add(animator, period_ms, display_anim_tick, a) : NULL;
+    if (!a->task) {
+        free(a);
+        return NULL;
     }
 
-    return 0;
+    pthread_mutex_lock(&d->lock);
+    a->next = d->anims;
+    d->anims = a;
+    pthread_mutex_unlock(&d->lock);
+
+    LOG_DBG("view(%p) start animation(%p) %zu frames, period(%zu ms)", a->v, a, a->count, period_ms);
+    return a;
 }
 
 /**
- * @brief 拓展字体缓存
+ * @brief 在视图上启动文字帧动画
  *
- * @param d 指向 display_t 结构的指针，表示当前显示的状态和属性。
- * @param new_size 新拓展内存大小
- * 
- * @return 成功返回 0 失败返回 非0
+ * 所有动画由一个定时器线程按各自的帧间隔切换, 每帧按 display_view_set_text 只重画变化的字符,
+ * 同一次唤醒中到期的动画只刷新一次, 调用者没有刷新的修改也一起刷新出去。
+ * 开始时清空视图, 动画期间视图由动画线程使用, 调用者不要再打印这个视图。
+ *
+ * @param d 指向 display_t 结构的指针。
+ * @param v 指向视图的指针, 动画存在期间必须有效。
+ * @param from_code 文字的编码。
+ * @param frames 每一帧的文字, 以 '\0' 结尾, 开始时拷贝。
+ * @param count 帧数。
+ * @param period_ms 帧间隔, 毫秒。
+ *
+ * @return 成功返回动画指针, 失败返回 NULL
  */
-static int display_extern_conv_cache(display_t* d, size_t new_size)
+display_anim_t* display_anim_start(display_t* d, view_t* v, const char* from_code, const char* const* frames,
+    size_t count, size_t period_ms)
 {
-    assert(new_size && "new_size fail!");
-    char* new_buffer = (char*)malloc(new_size);
-    if (!new_buffer) {
-        LOG_ERR("fail to extern conv cache");
-        return -1;
+    if (!d || !v || !from_code || !frames || !count || !period_ms) {
+        LOG_DBG("arg failed: d(%p) v(%p) from_code(%p) frames(%p) count(%zu) period(%zu)",
+            d, v, from_code, frames, count, period_ms);
+        return NULL;
     }
-    char* old_cache = d->conv_gb2312_cache;
-    d->conv_gb2312_cache = new_buffer;
-    free(old_cache);
 
-    return 0;
+    // 动画、帧指针、帧长度、编码和文字一次分配
+    size_t code_len = strlen(from_code) + 1;
+    size_t bytes = sizeof(display_anim_t) + count * (sizeof(char*) + sizeof(size_t)) + code_len;
+    for (size_t i = 0; i < count; ++i) {
+        if (!frames[i])
+            return NULL;
+        bytes += strlen(frames[i]) + 1;
+    }
+    display_anim_t* a = (display_anim_t*)malloc(bytes);
+    if (!a) {
+        LOG_ERR("fail to malloc animation(%zu bytes).", bytes);
+        return NULL;
+    }
+    memset(a, 0, sizeof(display_anim_t));
+    a->d = d;
+    a->v = v;
+    a->frames = (const char**)(a + 1);
+    a->lens = (size_t*)(a->frames + count);
+    char* p = (char*)(a->lens + count);
+    memcpy(p, from_code, code_len);
+    a->code = p;
+    p += code_len;
+    for (size_t i = 0; i < count; ++i) {
+        a->lens[i] = strlen(frames[i]);
+        memcpy(p, frames[i], a->lens[i] + 1);
+        a->frames[i] = p;
+        p += a->lens[i] + 1;
+    }
+    a->count = count;
+    a->shown = count;
+
+    // 视图之前的内容可能被重叠的视图清掉或覆盖过, 第一帧整个重画
+    display_view_clear(d, v);
+    return display_anim_add(d, a, period_ms);
 }
 
 /**
- * @brief 显示视图信息
+ * @brief 在视图上启动回调动画, 每帧在动画线程中持有 d->lock 调用 fn 绘制
  *
- * @param v 指向 view_t 结构的指针，表示当前视图的设置和参数。
+ * @param d 指向 display_t 结构的指针。
+ * @param v 指向视图的指针, 动画存在期间必须有效。
+ * @param period_ms 帧间隔, 毫秒。
+ * @param fn 动画回调。
+ * @param arg 传给 fn 的参数。
+ *
+ * @return 成功返回动画指针, 失败返回 NULL
  */
-static inline void display_show_view_info(view_t* v)
+display_anim_t* display_anim_start_fn(display_t* d, view_t* v, size_t period_ms, display_anim_fn fn, void* arg)
 {
-    LOG_DBG("  start_x: %zu, start_y: %zu, width: %zu, height: %zu, "
-            "now_x: %zu, now_y: %zu, start_x: %zu, start_y: %zu, font_color: %hu",
-        v->start_x, v->start_y, v->width, v->height, v->now_x,
-        v->now_y, v->start_x, v->start_y, v->font_color);
+    if (!d || !v || !period_ms || !fn)
+        return NULL;
+
+    display_anim_t* a = (display_anim_t*)malloc(sizeof(display_anim_t));
+    if (!a) {
+        LOG_ERR("fail to malloc animation.");
+        return NULL;
+    }
+    memset(a, 0, sizeof(display_anim_t));
+    a->d = d;
+    a->v = v;
+    a->fn = fn;
+    a->arg = arg;
+
+    return display_anim_add(d, a, period_ms);
 }
 
 /**
- * @brief 往显示上打印文字(支持中文)
+ * @brief 停止动画, 视图保留最后一帧画面
  *
- * @param d 指向 display_t 结构的指针，表示当前显示的状态和属性。
- * @param v 指向 view_t 结构的指针，表示当前视图的设置和参数。
- * @param from_code 字符编码
- * @param str 被打印的字符
- * @param str_len 被打印的字符长度
- * 
- * @return 成功返回 0 失败返回 非0
+ * @param d 指向 display_t 结构的指针。
+ * @param a display_anim_start/display_anim_start_fn 返回的动画指针。
  */
-int display_view_print(display_t* d, view_t* v, const char* from_code, const char* str, size_t str_len)
+void display_anim_stop(display_t* d, display_anim_t* a)
 {
-    if (!d || !v || !from_code || !str || !str_len) {
-        LOG_DBG("arg failed: d(%p) v(%p) from_code(%p) str(%p) str_len(%zu) ",
-            d, v, from_code, str, str_len);
-        return -1;
-    }
-    LOG_DBG("display(%p) try print.", d);
-    display_show_view_info(v);
-    // 如果不是GB2312编码，则进行编码转换
-    if (0 != strcasecmp("GB2312", from_code)) {
-        // 如果转换编码的缓存不够，则拓展缓存
-        if (str_len > d->conv_gb2312_size) {
-            int ret = display_extern_conv_cache(d, str_len);
-            if (ret < 0) {
-                LOG_DBG("STR TOO LONG! ");
-                return -1;
-            }
-        }
-        // 将编码转换为gb2312
-        int len = str_to_gb2312(from_code, str_len, str, 
-            d->conv_gb2312_size, d->conv_gb2312_cache);
-        if (len < 0) {
-            LOG_DBG("fail to conv %s to GB2312", from_code);
-            return -1;
+    if (!d || !a)
+        return;
+
+    pthread_mutex_lock(&d->lock);
+    display_anim_t* found = NULL;
+    for (display_anim_t** p = &d->anims; *p; p = &(*p)->next) {
+        if (*p == a) {
+            found = a;
+            *p = a->next;
+            break;
         }
-        return display_view_print_gb2312(d, v, d->conv_gb2312_cache, len);
     }
-    return display_view_print_gb2312(d, v, str, str_len);
+    pthread_mutex_unlock(&d->lock);
+
+    // 动画线程可能正在等锁绘制, 需要在锁外删除, 返回后不会再执行这个动画
+    if (found) {
+        animator_remove(d->animator, found->task);
+        free(found);
+    }
 }
 
 /**
@@ -477,18 +2568,33 @@ void display_view_clear(display_t* d, view_t* v)
     if (!d || !v)
         return;
 
+    pthread_mutex_lock(&d->lock);
     size_t start_offset = 0;
     size_t real_width = (v->start_x + v->width) >= d->fb_info->width ? 
         d->fb_info->width : v->start_x + v->width;
     size_t real_height = (v->start_y + v->height) >= d->fb_info->height ? 
         d->fb_info->height : v->start_y + v->height;
 
-    for (size_t y = v->start_y; y < real_height; ++y) {
-        start_offset = display_cul_cache_offset(d, v->start_x, y);
-        memset(d->cache + start_offset, COLOR_BLACK, real_width * COLOR_SIZE);
+    compositor_layer_t* l = compositor_layer_find(d->comp, v);
+    if (l) {
+        // 图层视图只清空离屏缓存, 下面的内容不受影响
+        display_fill_rows(d, (uint8_t*)l->surface, l->stride, l->width * COLOR_SIZE, l->height);
+        if (l->visible)
+            display_layer_damage(d, l);
+    } else if (v->start_x < real_width && v->start_y < real_height) {
+        if (d->shadow) {
+            shadow_fill(d->shadow, v->start_x, v->start_y, real_width - v->start_x, real_height - v->start_y, 0);
+        } else {
+            start_offset = display_cul_cache_offset(d, v->start_x, v->start_y);
+            display_fill_rows(d, d->cache + start_offset, d->fb_info->width * COLOR_SIZE,
+                (real_width - v->start_x) * COLOR_SIZE, real_height - v->start_y);
+        }
+        display_add_dirty(d, v->start_x, v->start_y, real_width - v->start_x, real_height - v->start_y);
     }
     v->now_x = v->start_x;
     v->now_y = v->start_y;
+    view_text_reset(display_find_text(d, v), v->now_x, v->now_y);
+    pthread_mutex_unlock(&d->lock);
 }
 
 /**
@@ -501,13 +2607,45 @@ void display_exit(display_t* d)
     if (!d)
         return;
 
+    while (d->anims)
+        display_anim_stop(d, d->anims);
+    animator_exit(d->animator);
+    d->animator = NULL;
+    while (d->meters)
+        display_meter_stop(d, d->meters->meter);
+    display_server_stop(d);
+    display_record_stop(d);
+    display_mirror_stop(d);
+    if (d->pool) {
+        band_pool_exit(d->pool);
+        d->pool = NULL;
+    }
+    if (d->comp) {
+        compositor_exit(d->comp);
+        d->comp = NULL;
+    }
+    if (d->frame) {
+        free(d->frame);
+        d->frame = NULL;
+    }
+    sprite_cache_exit(d->sprites);
+    d->sprites = NULL;
+    while (d->texts) {
+        view_text_t* next = d->texts->next;
+        view_text_exit(d->texts);
+        d->texts = next;
+    }
     if (d->font) {
         font_bitmap_exit(d->font);
         d->font = NULL;
     }
-    if (d->conv_gb2312_cache) {
-        free(d->conv_gb2312_cache);
-        d->conv_gb2312_cache = NULL;
+    if (d->conv != (iconv_t)-1) {
+        iconv_close(d->conv);
+        d->conv = (iconv_t)-1;
+    }
+    if (d->arena) {
+        arena_exit(d->arena);
+        d->arena = NULL;
     }
     if (d->fb_info) {
         framebuffer_exit(d->fb_info);
@@ -518,6 +2656,11 @@ void display_exit(display_t* d)
         d->cache = NULL;
         d->cache_size = 0;
     }
+    if (d->shadow) {
+        shadow_exit(d->shadow);
+        d->shadow = NULL;
+    }
+    pthread_mutex_destroy(&d->lock);
     LOG_DBG("display(%p) clear success.", d);
 
     free(d);
@@ -531,7 +2674,11 @@ void display_exit(display_t* d)
 static inline void display_cache_clear(display_t* d)
 {
     assert(d && "arg failed.");
-    memset(d->cache, COLOR_BLACK, d->cache_size);
+    if (d->shadow)
+        memset(d->shadow->bits, 0, d->shadow->size);
+    else
+        memset(d->cache, COLOR_BLACK, d->cache_size);
+    display_add_dirty(d, 0, 0, d->fb_info->width, d->fb_info->height);
     display_fflush(d);
 }
 
@@ -559,7 +2706,7 @@ size_t display_get_height(display_t* d)
     return d->fb_info->height;
 }
 
-#define DEFUALT_SIZE (1024)  // 默认字体转码缓存大小
+#define DEFUALT_SIZE (1024)  // 默认临时内存池大小
 
 /**
  * @brief 初始化显示
@@ -577,6 +2724,13 @@ display_t* display_init(const char* fb_dev, const char* font_path)
         return NULL;
     }
     memset(d, 0, sizeof(display_t));
+    d->conv = (iconv_t)-1;
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&d->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
 
     d->font = font_bitmap_init(font_path);
     if (!d->font) {
@@ -584,12 +2738,11 @@ display_t* display_init(const char* fb_dev, const char* font_path)
         goto err;
     }
 
-    d->conv_gb2312_size = DEFUALT_SIZE;
-    d->conv_gb2312_cache = (char*)malloc(d->conv_gb2312_size);
-    if (!d->conv_gb2312_cache) {
+    d->arena = arena_init(DEFUALT_SIZE);
+    if (!d->arena) {
+        LOG_ERR("fail to init arena.");
         goto err;
     }
-    memset(d->conv_gb2312_cache, 0, d->conv_gb2312_size);
 
     d->fb_info = framebuffer_init(fb_dev);
     if (!d->fb_info) {
@@ -597,12 +2750,16 @@ display_t* display_init(const char* fb_dev, const char* font_path)
         goto err;
     }
 
-    d->cache_size = d->fb_info->screen_size;
+    d->cache_size = d->fb_info->width * d->fb_info->height * COLOR_SIZE;
     d->cache = (uint8_t*)malloc(d->cache_size);
     if (!d->cache) {
         LOG_ERR("fail to malloc display.");
         goto err;
     }
+    memset(d->cache, COLOR_BLACK, d->cache_size);
+    // 测速会把显示缓存写到屏幕, 先清成黑色
+    d->flush_copy = fb_copy_select(d->fb_info->screen, d->fb_info->line_length, d->cache,
+        d->fb_info->width * COLOR_SIZE, d->fb_info->width * COLOR_SIZE, d->fb_info->height);
     display_cache_clear(d);
 
     LOG_DBG("display(%p:%zu) create success.", d, d->cache_size);
@@ -696,7 +2853,9 @@ int main(void)
         .height = ROLE_USER_HEIGHT_START,
         .now_x = 0,
         .now_y = 0,
-        .font_color = COLOR_WHITE
+        .font_color = COLOR_WHITE,
+        .font_size = 0,
+        .font_scale = 0,
     };
     view_t uv = (view_t) {
         .start_x = 0,
@@ -706,6 +2865,8 @@ int main(void)
         .now_x = 0,
         .now_y = ROLE_USER_HEIGHT_START,
         .font_color = COLOR_WHITE,
+        .font_size = 0,
+        .font_scale = 0,
     };
 
     std::string input;
@@ -729,4 +2890,534 @@ int main(void)
     return 0;
 }
 
-#endif //__DISPLAY_XTEST__
\ No newline at end of file
+#endif //__DISPLAY_XTEST__
+#ifdef __DISPLAY_ALLOC_XTEST__
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 统计打印过程中的堆内存申请次数, 预热之后稳定状态下应该为 0
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t n, size_t size);
+extern "C" void* __libc_realloc(void* p, size_t size);
+extern "C" void __libc_free(void* p);
+
+static int s_alloc_counting = 0;
+static size_t s_alloc_count = 0;
+
+extern "C" void* malloc(size_t size)
+{
+    s_alloc_count += s_alloc_counting;
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t n, size_t size)
+{
+    s_alloc_count += s_alloc_counting;
+    return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* p, size_t size)
+{
+    s_alloc_count += s_alloc_counting;
+    return __libc_realloc(p, size);
+}
+
+extern "C" void free(void* p)
+{
+    __libc_free(p);
+}
+
+static void alloc_test_round(display_t* d, view_t* av, view_t* uv, int i)
+{
+    const char* zh = "你好，世界！这是一段比较长的中文回答, 用来测试转码缓存。";
+    const char* status[2] = { "\033[32mAI:\033[0m 正在思考...", "\033[32mAI:\033[0m 思考完成。" };
+
+    display_view_clear(d, uv);
+    display_view_print(d, uv, "UTF-8", "\033[36mUSER:\033[0m ", strlen("\033[36mUSER:\033[0m "));
+    display_view_print(d, uv, "UTF-8", zh, strlen(zh));
+    display_view_print(d, uv, "GB2312", "ascii only", strlen("ascii only"));
+    display_view_set_text(d, av, "UTF-8", status[i & 1], strlen(status[i & 1]));
+    display_fflush(d);
+}
+
+int main(void)
+{
+    display_t* d = display_init("mem:320x240", "display_driver/font");
+    if (!d) {
+        LOG_ERR("fail to init display.");
+        return -1;
+    }
+    display_set_ansi(d, 1);
+
+    view_t av = { 0, 0, display_get_width(d), 120, 0, 0, COLOR_WHITE, 0, 0 };
+    view_t uv = { 0, 120, display_get_width(d), 120, 0, 120, COLOR_WHITE, 0, 0 };
+
+    // 预热: 转码句柄, 临时内存池, 视图文字缓存
+    for (int i = 0; i < 4; ++i)
+        alloc_test_round(d, &av, &uv, i);
+
+    s_alloc_counting = 1;
+    for (int i = 0; i < 100; ++i)
+        alloc_test_round(d, &av, &uv, i);
+    s_alloc_counting = 0;
+
+    printf("allocations in steady state: %zu\n", s_alloc_count);
+    assert(s_alloc_count == 0);
+
+    // 4 位紧凑显示缓存: 颜色不超过 16 种时画面与 RGB565 完全一致, 稳定后同样不申请内存
+    size_t screen_size = d->fb_info->line_length * d->fb_info->height;
+    uint8_t* expect = (uint8_t*)malloc(screen_size);
+    assert(expect);
+    memcpy(expect, d->fb_info->screen, screen_size);
+    assert(0 == display_set_cache_format(d, DISPLAY_CACHE_INDEX4, NULL, 0));
+    assert(!display_get_cache(d));
+    alloc_test_round(d, &av, &uv, 99);
+    assert(0 == memcmp(expect, d->fb_info->screen, screen_size));
+
+    s_alloc_count = 0;
+    s_alloc_counting = 1;
+    for (int i = 0; i < 100; ++i)
+        alloc_test_round(d, &av, &uv, i);
+    s_alloc_counting = 0;
+    printf("allocations in steady state(index4): %zu\n", s_alloc_count);
+    assert(s_alloc_count == 0);
+    assert(0 == memcmp(expect, d->fb_info->screen, screen_size));
+
+    // 切回 RGB565 保留内容
+    assert(0 == display_set_cache_format(d, DISPLAY_CACHE_RGB565, NULL, 0));
+    display_fflush(d);
+    assert(0 == memcmp(expect, d->fb_info->screen, screen_size));
+
+    // 电平控件只刷新自己的区域, 其它视图待刷新的区域保持不变
+    display_view_clear(d, &av);
+    display_view_print(d, &av, "UTF-8", "pending", strlen("pending"));
+    view_t mv = { 0, 200, 64, 8, 0, 200, COLOR_WHITE, 0, 0 };
+    display_meter_t dm = { d, &mv, NULL, NULL };
+    framebuffer_color_t meter_pixels[64 * 8];
+    for (size_t i = 0; i < 64 * 8; ++i)
+        meter_pixels[i] = COLOR_WHITE;
+    display_meter_draw(&dm, meter_pixels, 64, 8);
+    const uint8_t* screen = (const uint8_t*)d->fb_info->screen;
+    assert(0 == memcmp(screen + 200 * d->fb_info->line_length, meter_pixels, 64 * COLOR_SIZE));
+    assert(0 == memcmp(expect, screen, 120 * d->fb_info->line_length));
+    assert(d->dirty_x1 && d->dirty_y1 <= 120);
+    display_fflush(d);
+    assert(0 != memcmp(expect, screen, 120 * d->fb_info->line_length));
+    free(expect);
+
+    // 录像中切换到紧凑格式, 录像和镜像仍然拿到完整的 RGB565 画面
+    const char* rec = "/tmp/display_alloc_test.rec";
+    size_t row_bytes = display_get_width(d) * COLOR_SIZE;
+    assert(0 == display_record_start(d, rec));
+    assert(0 == display_set_cache_format(d, DISPLAY_CACHE_MONO, NULL, 0));
+    alloc_test_round(d, &av, &uv, 1);
+    for (size_t y = 0; y < d->fb_info->height; ++y) {
+        assert(0 == memcmp((const uint8_t*)display_output(d) + y * row_bytes,
+            (const uint8_t*)d->fb_info->screen + y * d->fb_info->line_length, row_bytes));
+    }
+    assert(0 == display_mirror_start(d, "unix:/tmp/display_alloc_test.sock"));
+    assert(0 == display_set_cache_format(d, DISPLAY_CACHE_INDEX4, NULL, 0));
+    alloc_test_round(d, &av, &uv, 2);
+    assert(display_output(d));
+    display_mirror_stop(d);
+    display_record_stop(d);
+    struct stat st;
+    assert(0 == stat(rec, &st) && st.st_size > 0);
+    unlink(rec);
+
+    display_exit(d);
+    printf("display alloc test pass\n");
+    return 0;
+}
+
+#endif //__DISPLAY_ALLOC_XTEST__
+#ifdef __DISPLAY_FONT_XTEST__
+
+static framebuffer_color_t font_test_pixel(display_t* d, size_t x, size_t y)
+{
+    return *(framebuffer_color_t*)&d->cache[display_cul_cache_offset(d, x, y)];
+}
+
+/**
+ * 放大 scale 倍绘制的画面应该与 16 号字逐像素放大一致
+ */
+static void font_test_scale(display_t* base, display_t* d, uint8_t size, uint8_t scale, size_t factor)
+{
+    const char* str = "\033[33m你好\033[0m, Hi 世界";
+    view_t bv = { 0, 0, display_get_width(base), display_get_height(base), 0, 0, COLOR_WHITE, 0, 0 };
+    view_t v = { 0, 0, display_get_width(d), display_get_height(d), 0, 0, COLOR_WHITE, size, scale };
+    display_view_clear(base, &bv);
+    display_view_clear(d, &v);
+    display_view_print(base, &bv, "UTF-8", str, strlen(str));
+    display_view_print(d, &v, "UTF-8", str, strlen(str));
+    assert(v.now_x == bv.now_x * factor && v.now_y == bv.now_y * factor);
+    for (size_t y = 0; y < display_get_height(d); ++y) {
+        for (size_t x = 0; x < display_get_width(d); ++x)
+            assert(font_test_pixel(d, x, y) == font_test_pixel(base, x / factor, y / factor));
+    }
+}
+
+/**
+ * 把点阵字体转换为只有 0 和 15 两级覆盖度的抗锯齿字体, 绘制结果应该与点阵字体完全一致
+ */
+static void font_test_write_aa(const char* src, const char* dst, size_t width)
+{
+    FILE* in = fopen(src, "rb");
+    FILE* out = fopen(dst, "wb");
+    assert(in && out);
+    uint8_t row[FONT_ROW_BYTES(32)];
+    while (fread(row, 1, FONT_ROW_BYTES(width), in) == FONT_ROW_BYTES(width)) {
+        uint8_t aa[FONT_AA_ROW_BYTES(32)] = { 0 };
+        for (size_t i = 0; i < width; ++i) {
+            if (row[i / BIT_SIZE] & (0x80 >> (i % BIT_SIZE)))
+                aa[i / 2] |= i & 1 ? 0x0f : 0xf0;
+        }
+        fwrite(aa, 1, FONT_AA_ROW_BYTES(width), out);
+    }
+    fclose(in);
+    fclose(out);
+}
+
+/**
+ * 抗锯齿字体的整行绘制、逐像素换行绘制、图层绘制都应该与点阵字体一致, 中间覆盖度按混合表绘制
+ */
+static void font_test_antialias(void)
+{
+    char dir[] = "/tmp/font_aa_XXXXXX";
+    assert(mkdtemp(dir));
+    char cmd[256];
+    snprintf(cmd, sizeof(cmd), "cp display_driver/font/ascii_8x16 display_driver/font/gb2312_16x16 %s", dir);
+    assert(0 == system(cmd));
+    char src[64], dst[64];
+    snprintf(src, sizeof(src), "%s/ascii_8x16", dir);
+    snprintf(dst, sizeof(dst), "%s_aa", src);
+    font_test_write_aa(src, dst, 8);
+    snprintf(src, sizeof(src), "%s/gb2312_16x16", dir);
+    snprintf(dst, sizeof(dst), "%s_aa", src);
+    font_test_write_aa(src, dst, 16);
+
+    display_t* ref = display_init("mem:200x96", "display_driver/font");
+    display_t* aa = display_init("mem:200x96", dir);
+    assert(ref && aa);
+    display_set_ansi(ref, 1);
+    display_set_ansi(aa, 1);
+    display_set_antialias(aa, 1);
+    const char* str = "\033[33m你好\033[0m, Hi 世界\033[7m 抗锯齿 \033[0m wrap around the view";
+    view_t views[] = {
+        { 0, 0, 200, 96, 0, 0, COLOR_WHITE, 0, 0 },
+        { 4, 2, 150, 60, 0, 0, COLOR_WHITE, 0, 2 },
+        { 10, 8, 100, 40, 0, 0, COLOR_WHITE, 0, 3 },
+    };
+    for (size_t i = 0; i < sizeof(views) / sizeof(views[0]); ++i) {
+        view_t rv = views[i], av = views[i];
+        display_view_clear(ref, &rv);
+        display_view_clear(aa, &av);
+        display_view_print(ref, &rv, "UTF-8", str, strlen(str));
+        display_view_print(aa, &av, "UTF-8", str, strlen(str));
+        assert(aa->view_font.aa && !ref->view_font.aa);
+        assert(av.now_x == rv.now_x && av.now_y == rv.now_y);
+        assert(0 == memcmp(ref->cache, aa->cache, ref->cache_size));
+    }
+
+    // 绘制到图层
+    view_t rl = { 20, 20, 120, 40, 0, 0, COLOR_WHITE, 0, 0 }, al = rl;
+    assert(0 == display_view_attach(ref, &rl, 1) && 0 == display_view_attach(aa, &al, 1));
+    display_view_print(ref, &rl, "UTF-8", str, strlen(str));
+    display_view_print(aa, &al, "UTF-8", str, strlen(str));
+    display_fflush(ref);
+    display_fflush(aa);
+    assert(0 == memcmp(display_output(ref), display_output(aa), ref->cache_size));
+    display_view_detach(ref, &rl);
+    display_view_detach(aa, &al);
+    display_exit(ref);
+    // 释放后再修改字体文件, 避免按文件信息复用旧的字体
+    display_exit(aa);
+
+    // 中间覆盖度: 把 'A' 改为半覆盖, 白字黑底绘制为混合表的中间色
+    snprintf(dst, sizeof(dst), "%s/ascii_8x16_aa", dir);
+    FILE* fp = fopen(dst, "r+b");
+    assert(fp);
+    uint8_t half[FONT_AA_ROW_BYTES(8) * 16];
+    memset(half, 0x88, sizeof(half));
+    fseek(fp, 'A' * sizeof(half), SEEK_SET);
+    fwrite(half, 1, sizeof(half), fp);
+    fclose(fp);
+    display_t* mid = display_init("mem:64x16", dir);
+    assert(mid);
+    display_set_antialias(mid, 1);
+    view_t mv = { 0, 0, 64, 16, 0, 0, COLOR_WHITE, 0, 0 };
+    display_view_print(mid, &mv, "UTF-8", "A", 1);
+    glyph_blend_t t;
+    glyph_blend_init(&t, COLOR_WHITE, COLOR_BLACK);
+    for (size_t y = 0; y < 16; ++y) {
+        for (size_t x = 0; x < 8; ++x)
+            assert(font_test_pixel(mid, x, y) == t.color[8]);
+    }
+
+    // 关闭抗锯齿后保留的文字整个重新绘制, 与点阵字体一致
+    view_t tv = { 0, 0, 64, 16, 0, 0, COLOR_WHITE, 0, 0 };
+    display_view_set_text(mid, &tv, "UTF-8", "AB", 2);
+    display_set_antialias(mid, 0);
+    display_view_set_text(mid, &tv, "UTF-8", "AB", 2);
+    display_t* plain = display_init("mem:64x16", "display_driver/font");
+    assert(plain);
+    view_t pv = tv;
+    display_view_set_text(plain, &pv, "UTF-8", "AB", 2);
+    assert(0 == memcmp(plain->cache, mid->cache, plain->cache_size));
+
+    display_exit(plain);
+    display_exit(mid);
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    assert(0 == system(cmd));
+}
+
+int main(void)
+{
+    font_test_antialias();
+
+    display_t* base = display_init("mem:160x16", "display_driver/font");
+    display_t* d2 = display_init("mem:320x32", "display_driver/font");
+    display_t* d3 = display_init("mem:480x48", "display_driver/font");
+    assert(base && d2 && d3);
+    display_set_ansi(base, 1);
+    display_set_ansi(d2, 1);
+    display_set_ansi(d3, 1);
+
+    // 特化的 2 倍, 没有 32 号字体时由 16 号放大, 以及通用的 3 倍
+    font_test_scale(base, d2, 0, 2, 2);
+    font_test_scale(base, d2, 32, 0, 2);
+    font_test_scale(base, d3, 16, 3, 3);
+    font_test_scale(base, d3, 48, 1, 3);
+
+    // 放大后在行尾换行和回到视图开头时与不放大的行数一致
+    view_t v = { 0, 0, 200, 64, 0, 0, COLOR_WHITE, 32, 0 };
+    const char* longer = "这是一段比较长的文字, wrap around the view";
+    display_view_print(d2, &v, "UTF-8", longer, strlen(longer));
+    assert(v.now_x < 200 && v.now_y < 64 && v.now_y % 32 == 0);
+
+    // 保留文字的视图换字号后整个重新绘制, 与直接用新字号绘制一致
+    view_t a = { 0, 0, 320, 32, 0, 0, COLOR_WHITE, 0, 0 };
+    view_t b = { 0, 0, 320, 32, 0, 0, COLOR_WHITE, 0, 2 };
+    display_t* fresh = display_init("mem:320x32", "display_driver/font");
+    assert(fresh);
+    display_view_clear(d2, &a);
+    display_view_set_text(d2, &a, "UTF-8", "状态: ok", strlen("状态: ok"));
+    a.font_scale = 2;
+    display_view_set_text(d2, &a, "UTF-8", "状态: ok", strlen("状态: ok"));
+    display_view_set_text(fresh, &b, "UTF-8", "状态: ok", strlen("状态: ok"));
+    assert(0 == memcmp(d2->cache, fresh->cache, d2->cache_size));
+    assert(a.now_x == b.now_x && a.now_y == b.now_y);
+    display_exit(fresh);
+
+    display_exit(base);
+    display_exit(d2);
+    display_exit(d3);
+    printf("display font test pass\n");
+    return 0;
+}
+
+#endif //__DISPLAY_FONT_XTEST__
+
+#ifdef __DISPLAY_SPRITE_XTEST__
+
+/**
+ * 刷新后两块屏幕的内容应该完全一致
+ */
+static void sprite_test_compare(display_t* plain, display_t* cached)
+{
+    display_fflush(plain);
+    display_fflush(cached);
+    for (size_t y = 0; y < plain->fb_info->height; ++y) {
+        const uint8_t* a = (const uint8_t*)plain->fb_info->screen + y * plain->fb_info->line_length;
+        const uint8_t* b = (const uint8_t*)cached->fb_info->screen + y * cached->fb_info->line_length;
+        assert(0 == memcmp(a, b, plain->fb_info->width * COLOR_SIZE));
+    }
+}
+
+static void sprite_test_print(display_t* plain, display_t* cached, view_t* pv, view_t* cv, const char* str)
+{
+    assert(0 == display_view_print(plain, pv, "UTF-8", str, strlen(str)));
+    assert(0 == display_view_print(cached, cv, "UTF-8", str, strlen(str)));
+    assert(pv->now_x == cv->now_x && pv->now_y == cv->now_y);
+}
+
+/**
+ * 同样的打印序列在开启精灵缓存和不开启时画面和光标都一致, 包括换行回退、图层、紧凑显示缓存
+ */
+static void sprite_test_format(int format)
+{
+    const char* labels[] = {
+        "\033[36mUSER:\033[0m (Listening...)",
+        "\033[32mAI:\033[0m ",
+        "(voice recognition...)",
+        " 中文\t标签 ",
+        "\033[7m反显\033[0m ok",
+        "line\nbreak",
+    };
+    const size_t count = sizeof(labels) / sizeof(labels[0]);
+    display_t* plain = display_init("mem:240x100", "display_driver/font");
+    display_t* cached = display_init("mem:240x100", "display_driver/font");
+    assert(plain && cached);
+    display_set_ansi(plain, 1);
+    display_set_ansi(cached, 1);
+    assert(0 == display_set_cache_format(plain, format, NULL, 0));
+    assert(0 == display_set_cache_format(cached, format, NULL, 0));
+    assert(0 == display_set_sprite_cache(cached, 64 * 1024));
+
+    view_t pv = { 0, 0, 240, 60, 0, 0, COLOR_WHITE, 0, 0 };
+    view_t pn = { 30, 60, 130, 40, 30, 60, 0xf800, 0, 2 };
+    view_t pl = { 170, 64, 60, 30, 170, 64, 0x07e0, 0, 0 };
+    view_t cv = pv, cn = pn, cl = pl;
+    assert(0 == display_sprite_pin(cached, &cv, "UTF-8", labels[0], strlen(labels[0])));
+    assert(-1 == display_sprite_pin(cached, &cv, "UTF-8", labels[count - 1], strlen(labels[count - 1])));
+    assert(0 == display_view_attach(plain, &pl, 1) && 0 == display_view_attach(cached, &cl, 1));
+
+    for (size_t round = 0; round < 12; ++round) {
+        for (size_t i = 0; i < count; ++i) {
+            sprite_test_print(plain, cached, &pv, &cv, labels[(i + round) % count]);
+            sprite_test_print(plain, cached, &pn, &cn, labels[(i * 3 + round) % count]);
+            sprite_test_print(plain, cached, &pl, &cl, labels[i]);
+        }
+        sprite_test_compare(plain, cached);
+        if (round % 4 == 3) {
+            display_view_clear(plain, &pv);
+            display_view_clear(cached, &cv);
+        }
+    }
+
+    sprite_cache_stat_t stat;
+    sprite_cache_get_stat(cached->sprites, &stat);
+    assert(stat.hits > stat.misses && stat.pinned == 1 && stat.bytes <= 64 * 1024);
+
+    // 缩小上限后淘汰, 固定的精灵保留, 画面仍然一致
+    assert(0 == display_set_sprite_cache(cached, 8 * 1024));
+    for (size_t i = 0; i < 3 * count; ++i)
+        sprite_test_print(plain, cached, &pv, &cv, labels[i % count]);
+    sprite_test_compare(plain, cached);
+    sprite_cache_get_stat(cached->sprites, &stat);
+    assert(stat.evictions > 0 && stat.pinned == 1 && stat.bytes <= 8 * 1024);
+
+    // 保留文字的视图不使用精灵
+    size_t hits = stat.hits;
+    view_t pt = { 0, 0, 240, 20, 0, 0, COLOR_WHITE, 0, 0 }, ct = pt;
+    display_view_set_text(plain, &pt, "UTF-8", "x", 1);
+    display_view_set_text(cached, &ct, "UTF-8", "x", 1);
+    for (size_t i = 0; i < 3; ++i)
+        sprite_test_print(plain, cached, &pt, &ct, labels[0]);
+    sprite_test_compare(plain, cached);
+    sprite_cache_get_stat(cached->sprites, &stat);
+    assert(stat.hits == hits);
+
+    assert(0 == display_set_sprite_cache(cached, 0) && !cached->sprites);
+    display_exit(plain);
+    display_exit(cached);
+}
+
+int main(void)
+{
+    sprite_test_format(DISPLAY_CACHE_RGB565);
+    sprite_test_format(DISPLAY_CACHE_INDEX4);
+    sprite_test_format(DISPLAY_CACHE_MONO);
+    printf("display sprite test pass\n");
+    return 0;
+}
+
+#endif //__DISPLAY_SPRITE_XTEST__
+
+#ifdef __DISPLAY_ANIM_XTEST__
+
+#include <unistd.h>
+
+/**
+ * 两块屏幕的内容完全一致
+ */
+static int anim_test_same(display_t* a, display_t* b)
+{
+    display_fflush(a);
+    display_fflush(b);
+    for (size_t y = 0; y < a->fb_info->height; ++y) {
+        const uint8_t* pa = (const uint8_t*)a->fb_info->screen + y * a->fb_info->line_length;
+        const uint8_t* pb = (const uint8_t*)b->fb_info->screen + y * b->fb_info->line_length;
+        if (memcmp(pa, pb, a->fb_info->width * COLOR_SIZE))
+            return 0;
+    }
+    return 1;
+}
+
+typedef struct anim_test_cursor_t {
+    size_t calls;
+    size_t last;
+} anim_test_cursor_t;
+
+/**
+ * 闪烁光标: 偶数帧显示, 奇数帧隐藏
+ */
+static int anim_test_cursor(display_t* d, view_t* v, size_t frame, void* arg)
+{
+    anim_test_cursor_t* c = (anim_test_cursor_t*)arg;
+    c->calls++;
+    c->last = frame;
+    return !display_view_set_text(d, v, "UTF-8", frame & 1 ? "" : "_", frame & 1 ? 0 : 1);
+}
+
+int main(void)
+{
+    const char* dots[] = { "USER: (Listening)", "USER: (Listening.)", "USER: (Listening..)", "USER: (Listening...)" };
+    const char* spin[] = { "|", "/", "-", "\\" };
+    display_t* d = display_init("mem:240x100", "display_driver/font");
+    display_t* ref = display_init("mem:240x100", "display_driver/font");
+    assert(d && ref);
+    assert(!display_anim_start(d, NULL, "UTF-8", dots, 4, 20));
+    view_t bad = { 0, 0, 240, 20, 0, 0, COLOR_WHITE, 0, 0 };
+    assert(!display_anim_start(d, &bad, "UTF-8", dots, 0, 20) && !display_anim_start(d, &bad, "UTF-8", dots, 4, 0));
+
+    // 动画外的内容不受影响
+    view_t sv = { 0, 60, 240, 20, 0, 60, 0x07e0, 0, 0 }, rsv = sv;
+    display_view_print(d, &sv, "UTF-8", "static label", 12);
+    display_view_print(ref, &rsv, "UTF-8", "static label", 12);
+
+    view_t lv = { 0, 0, 240, 20, 0, 0, COLOR_WHITE, 0, 0 }, rlv = lv;
+    view_t cv = { 200, 30, 16, 16, 200, 30, 0xf800, 0, 0 }, rcv = cv;
+    view_t uv = { 100, 30, 16, 16, 100, 30, COLOR_WHITE, 0, 0 }, ruv = uv;
+    anim_test_cursor_t cursor = { 0, 0 };
+    display_anim_t* la = display_anim_start(d, &lv, "UTF-8", dots, 4, 20);
+    display_anim_t* ca = display_anim_start(d, &cv, "UTF-8", spin, 4, 30);
+    display_anim_t* ua = display_anim_start_fn(d, &uv, 40, anim_test_cursor, &cursor);
+    assert(la && ca && ua);
+    usleep(250 * 1000);
+    display_anim_stop(d, la);
+    display_anim_stop(d, ca);
+    display_anim_stop(d, ua);
+    display_anim_stop(d, ua);
+    assert(!d->anims);
+
+    // 每个动画都切换过多帧, 同时到期的合并刷新
+    size_t ticks = 0, flushes = 0;
+    animator_get_stat(d->animator, &ticks, &flushes);
+    printf("animation: %zu ticks, %zu flushes, cursor %zu calls\n", ticks, flushes, cursor.calls);
+    assert(cursor.calls >= 4 && cursor.last >= 4 && ticks >= 12 && flushes < ticks);
+
+    // 停止后画面是各自某一帧的文字, 和直接设置文字的结果一致
+    display_view_set_text(ref, &ruv, "UTF-8", cursor.last & 1 ? "" : "_", cursor.last & 1 ? 0 : 1);
+    int found = 0;
+    for (size_t i = 0; i < 4 && !found; ++i) {
+        for (size_t j = 0; j < 4 && !found; ++j) {
+            display_view_set_text(ref, &rlv, "UTF-8", dots[i], strlen(dots[i]));
+            display_view_set_text(ref, &rcv, "UTF-8", spin[j], strlen(spin[j]));
+            found = anim_test_same(d, ref);
+        }
+    }
+    assert(found);
+
+    // 退出时还在运行的动画一起停止
+    assert(display_anim_start(d, &lv, "UTF-8", spin, 4, 10));
+    usleep(30 * 1000);
+    display_exit(d);
+    display_exit(ref);
+    printf("display anim test pass\n");
+    return 0;
+}
+
+#endif //__DISPLAY_ANIM_XTEST__
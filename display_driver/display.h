@@ -6,6 +6,8 @@ extern "C" {
 #endif
 
 #include "framebuffer.h"
+#include "image.h"
+#include "meter.h"
 
 
 /*
@@ -45,6 +47,8 @@ typedef struct view_t {
     size_t now_x;                    // 当前绘制x位置
     size_t now_y;                    // 当前绘制y位置
     framebuffer_color_t font_color;  // 绘制颜色
+    uint8_t font_size;               // 字号(字高), 0 为默认 16 号; 字体目录中没有的字号由能整除它的字号放大, 都不能整除时打印错误并使用默认字号
+    uint8_t font_scale;              // 在字号基础上再放大的整数倍数, 0 和 1 都不放大
 } view_t;
 
 /**
@@ -70,6 +74,79 @@ display_t *display_init(const char *fb_dev, const char *font_path);
  */
 void display_set_debug(char enable);
 
+/**
+ * 设置打印时是否解析 ANSI SGR 颜色转义(ESC [ ... m)。
+ * 开启后一次打印调用中可以内嵌前景色/背景色/反显/恢复默认, 支持的参数见 text_style.h,
+ * 每次打印开始时恢复为视图默认样式。
+ *
+ * @param d 指向显示设备的指针。
+ * @param enable 1 开启, 0 关闭。
+ */
+void display_set_ansi(display_t* d, int enable);
+
+/**
+ * 设置是否使用抗锯齿字体。字体目录中有对应字号的抗锯齿字体(*_aa)时,
+ * 字形边缘按 4 位覆盖度与背景色混合; 没有抗锯齿字体或使用紧凑显示缓存时仍用点阵字体。
+ *
+ * @param d 指向显示设备的指针。
+ * @param enable 1 开启, 0 关闭。
+ */
+void display_set_antialias(display_t* d, int enable);
+
+/**
+ * 设置字符串精灵缓存的内存上限。开启后 display_view_print 打印过两次的相同文字
+ * (视图字号、颜色、编码都相同, 单行)会绘制成精灵缓存起来, 之后在不换行的位置打印直接拷贝像素,
+ * 按最近使用顺序淘汰。使用 display_view_set_text 的视图不使用精灵。
+ *
+ * @param d 指向显示设备的指针。
+ * @param max_bytes 内存上限, 0 关闭并释放全部精灵。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int display_set_sprite_cache(display_t* d, size_t max_bytes);
+
+/**
+ * 按视图的字号和颜色预先绘制一段文字并固定在精灵缓存中, 不会被淘汰, 用于固定的界面标签。
+ * 需要先开启精灵缓存。
+ *
+ * @param d 指向显示设备的指针。
+ * @param v 视图, 只使用字号和颜色。
+ * @param from_code 字符编码。
+ * @param str 文字。
+ * @param str_len 文字字节数。
+ * @return 成功返回 0，失败(未开启缓存、文字有换行、超过内存上限)返回 -1。
+ */
+int display_sprite_pin(display_t* d, view_t* v, const char* from_code, const char* str, size_t str_len);
+
+/**
+ * 设置条带绘制的线程数。大视图的文字绘制和清空按水平条带并行执行,
+ * 结果与单线程绘制完全一致, 绘制的像素数较少时仍在调用线程直接绘制。
+ *
+ * @param d 指向显示设备的指针。
+ * @param threads 参与绘制的线程数(含调用线程), 0 或 1 表示只在调用线程绘制, 最多 16。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int display_set_threads(display_t* d, size_t threads);
+
+#define DISPLAY_CACHE_RGB565 (16)  // 显示缓存格式: RGB565, 默认
+#define DISPLAY_CACHE_INDEX4 (4)   // 显示缓存格式: 4 位调色板下标, 16 色
+#define DISPLAY_CACHE_MONO (1)     // 显示缓存格式: 1 位, 黑色和一种前景色
+
+/**
+ * 设置显示缓存格式。紧凑格式每个像素只存调色板下标, 文字和清空只写下标,
+ * 刷新时只把变化区域展开为 RGB565, 显示缓存内存减少为 1/4(4 位)或 1/16(1 位)。
+ * 切换时保留当前内容, 4 位格式超过 16 种颜色时取最接近的已有颜色,
+ * 1 位格式非黑色都显示为调色板的第二个颜色(默认白色)。
+ * 紧凑格式下 display_get_cache 返回 NULL。
+ * 开启录像或镜像时切换到紧凑格式会分配合成画面提供完整的 RGB565 画面, 分配失败时不切换。
+ *
+ * @param d 指向显示设备的指针。
+ * @param format DISPLAY_CACHE_RGB565、DISPLAY_CACHE_INDEX4 或 DISPLAY_CACHE_MONO。
+ * @param palette 预设调色板, 第一个颜色固定为黑色, NULL 使用默认调色板。
+ * @param colors 预设颜色数。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int display_set_cache_format(display_t* d, int format, const framebuffer_color_t* palette, size_t colors);
+
 /**
  * 获取显示设备的宽度。
  *
@@ -111,6 +188,35 @@ void display_view_clear(display_t* d, view_t* v);
  */
 void display_set_cache_color(display_t* d, size_t x, size_t y, framebuffer_color_t color);
 
+/**
+ * 获取显示缓存地址, 用于批量直接写入像素。
+ * 缓存为 RGB565 格式, 共 display_get_height 行, 每行 display_get_cache_stride 字节,
+ * 写入后需调用 display_mark_dirty 标记修改区域。
+ *
+ * @param d 指向显示设备的指针。
+ * @return 显示缓存地址, 失败返回 NULL。
+ */
+framebuffer_color_t* display_get_cache(display_t* d);
+
+/**
+ * 获取显示缓存每行字节数。
+ *
+ * @param d 指向显示设备的指针。
+ * @return 每行字节数, 失败返回 0。
+ */
+size_t display_get_cache_stride(display_t* d);
+
+/**
+ * 标记显示缓存中被直接修改的区域, 下次刷新时交给录像/镜像等处理。
+ *
+ * @param d 指向显示设备的指针。
+ * @param x 区域左上角 x 坐标。
+ * @param y 区域左上角 y 坐标。
+ * @param w 区域宽度。
+ * @param h 区域高度。
+ */
+void display_mark_dirty(display_t* d, size_t x, size_t y, size_t w, size_t h);
+
 /**
  * 在视图上打印字符串。(支持中文)
  *
@@ -123,6 +229,213 @@ void display_set_cache_color(display_t* d, size_t x, size_t y, framebuffer_color
  */
 int display_view_print(display_t* d, view_t *v, const char *from_code, const char* str, size_t str_len);
 
+/**
+ * 设置视图的全部文字。视图保留上一次的文字内容, 只从第一个变化的字符开始重新绘制。
+ * 之后对该视图的 display_view_print 视为追加文字, display_view_clear 清空文字。
+ *
+ * @param d 指向显示设备的指针。
+ * @param v 指向视图的指针。
+ * @param from_code 字符串的编码格式。
+ * @param str 新的文字。
+ * @param str_len 新的文字长度, 为 0 时清空视图。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int display_view_set_text(display_t* d, view_t* v, const char* from_code, const char* str, size_t str_len);
+
+#define DISPLAY_IMAGE_BILINEAR (1 << 0)  // 双线性缩放, 默认最近邻
+#define DISPLAY_IMAGE_ALPHA (1 << 1)     // RGBA 图片按 alpha 与原内容混合, 默认忽略 alpha
+#define DISPLAY_IMAGE_DITHER (1 << 2)    // 转换为 RGB565 时使用 4x4 有序抖动
+
+/**
+ * 在视图上绘制图片, 超出视图和屏幕的部分被裁剪掉, 只标记图片所在区域为修改区域。
+ *
+ * @param d 指向显示设备的指针。
+ * @param v 指向视图的指针。
+ * @param x 图片左上角相对视图的 x。
+ * @param y 图片左上角相对视图的 y。
+ * @param w 绘制宽度, 0 为图片宽度, 与图片宽度不同时缩放。
+ * @param h 绘制高度, 0 为图片高度, 与图片高度不同时缩放。
+ * @param pixels 图片像素。
+ * @param img_w 图片宽。
+ * @param img_h 图片高。
+ * @param stride 图片每行字节数, 0 为紧密排列。
+ * @param format 像素格式, IMAGE_FORMAT_RGB888 或 IMAGE_FORMAT_RGBA8888。
+ * @param flags DISPLAY_IMAGE_* 的组合。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int display_draw_image(display_t* d, view_t* v, size_t x, size_t y, size_t w, size_t h,
+    const uint8_t* pixels, size_t img_w, size_t img_h, size_t stride, int format, int flags);
+
+/**
+ * 在视图上绘制 PPM(P6) 图片文件, 参数同 display_draw_image。
+ *
+ * @param d 指向显示设备的指针。
+ * @param v 指向视图的指针。
+ * @param x 图片左上角相对视图的 x。
+ * @param y 图片左上角相对视图的 y。
+ * @param w 绘制宽度, 0 为图片宽度。
+ * @param h 绘制高度, 0 为图片高度。
+ * @param path 图片路径。
+ * @param flags DISPLAY_IMAGE_* 的组合。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int display_draw_ppm(display_t* d, view_t* v, size_t x, size_t y, size_t w, size_t h,
+    const char* path, int flags);
+
+/**
+ * 在视图上启动电平控件, 由独立线程按帧率上限只重画并刷新这个视图的区域。
+ * PCM 或电平通过 meter_push_pcm/meter_push_level 送入, meter_push_pcm 也可以作为
+ * audio_capture_set_tap 的回调直接接在采集线程上。
+ *
+ * @param d 指向显示设备的指针。
+ * @param v 指向视图的指针, 控件存在期间必须有效。
+ * @param style 显示样式, METER_STYLE_BAR 或 METER_STYLE_WAVE。
+ * @param fps 帧率上限, 0 使用默认值。
+ * @param window 每个电平的采样数, 0 使用默认值。
+ * @return 成功返回控件指针，失败返回 NULL。
+ */
+meter_t* display_meter_start(display_t* d, view_t* v, int style, size_t fps, size_t window);
+
+/**
+ * 停止电平控件, 视图保留最后一帧画面。
+ *
+ * @param d 指向显示设备的指针。
+ * @param m display_meter_start 返回的控件指针。
+ */
+void display_meter_stop(display_t* d, meter_t* m);
+
+struct display_anim_t;
+typedef struct display_anim_t display_anim_t;
+
+/**
+ * 动画回调, 在动画线程中持有显示的锁调用, 可以使用 display_view_* 等接口绘制视图, 不需要刷新。
+ *
+ * @param d 指向显示设备的指针。
+ * @param v 动画的视图。
+ * @param frame 帧号, 开始时为 0, 之后为开始以来经过的帧间隔数, 绘制来不及时会跳过。
+ * @param arg display_anim_start_fn 传入的参数。
+ * @return 画面有修改返回 1, 否则返回 0。
+ */
+typedef int (*display_anim_fn)(display_t* d, view_t* v, size_t frame, void* arg);
+
+/**
+ * 在视图上启动文字帧动画, 如 "(Listening.)" "(Listening..)" 或旋转符号、闪烁光标。
+ * 所有动画由一个定时器线程按各自的帧间隔切换, 只重画变化的字符并刷新这个视图的区域,
+ * 同时到期的动画合并为一次刷新。开始时清空视图, 动画期间视图由动画线程使用, 调用者不要再打印这个视图。
+ *
+ * @param d 指向显示设备的指针。
+ * @param v 指向视图的指针, 动画存在期间必须有效。
+ * @param from_code 文字的编码。
+ * @param frames 每一帧的文字, 以 '\0' 结尾, 开始时拷贝。
+ * @param count 帧数。
+ * @param period_ms 帧间隔, 毫秒。
+ * @return 成功返回动画指针，失败返回 NULL。
+ */
+display_anim_t* display_anim_start(display_t* d, view_t* v, const char* from_code, const char* const* frames,
+    size_t count, size_t period_ms);
+
+/**
+ * 在视图上启动回调动画, 每帧调用 fn 绘制, 其它同 display_anim_start。
+ *
+ * @param d 指向显示设备的指针。
+ * @param v 指向视图的指针, 动画存在期间必须有效。
+ * @param period_ms 帧间隔, 毫秒。
+ * @param fn 动画回调。
+ * @param arg 传给 fn 的参数。
+ * @return 成功返回动画指针，失败返回 NULL。
+ */
+display_anim_t* display_anim_start_fn(display_t* d, view_t* v, size_t period_ms, display_anim_fn fn, void* arg);
+
+/**
+ * 停止动画, 视图保留最后一帧画面, 返回后不会再绘制。不能在动画回调中调用。
+ *
+ * @param d 指向显示设备的指针。
+ * @param a display_anim_start/display_anim_start_fn 返回的动画指针。
+ */
+void display_anim_stop(display_t* d, display_anim_t* a);
+
+/**
+ * 把视图附加为图层。视图拥有独立的离屏缓存, 之后对该视图的打印/清空只修改离屏缓存,
+ * 刷新时只重新合成被修改的区域, 弹窗显示/隐藏不需要重绘下面的内容。
+ * 视图已经是图层时只修改叠放次序。
+ *
+ * @param d 指向显示设备的指针。
+ * @param v 指向视图的指针, 图层存在期间必须有效。
+ * @param z 叠放次序, 越大越靠上, 没有附加的视图始终在最下面。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int display_view_attach(display_t* d, view_t* v, int z);
+
+/**
+ * 取消视图的图层, 释放离屏缓存, 之后该视图重新直接绘制到显示缓存。
+ *
+ * @param d 指向显示设备的指针。
+ * @param v 指向视图的指针。
+ */
+void display_view_detach(display_t* d, view_t* v);
+
+/**
+ * 显示或隐藏视图图层, 隐藏期间仍可往视图打印。
+ *
+ * @param d 指向显示设备的指针。
+ * @param v 指向视图的指针。
+ * @param visible 1 显示, 0 隐藏。
+ * @return 成功返回 0，视图不是图层返回 -1。
+ */
+int display_view_show(display_t* d, view_t* v, int visible);
+
+/**
+ * 开始录制刷新画面, 之后每次 display_fflush 把变化区域以差分形式追加到录像文件。
+ * 录像可用 tools/frame_replay 回放或导出为 PPM。
+ *
+ * @param d 指向显示设备的指针。
+ * @param path 录像文件路径。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int display_record_start(display_t* d, const char* path);
+
+/**
+ * 停止录制刷新画面。
+ *
+ * @param d 指向显示设备的指针。
+ */
+void display_record_stop(display_t* d);
+
+/**
+ * 开启画面镜像服务, 客户端连接后先收到完整画面, 之后每次 display_fflush 只发送变化区域。
+ * 参考客户端见 tools/mirror_client。
+ *
+ * @param d 指向显示设备的指针。
+ * @param addr 监听地址, `unix:/path` 或 `tcp:[host:]port`。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int display_mirror_start(display_t* d, const char* addr);
+
+/**
+ * 关闭画面镜像服务。
+ *
+ * @param d 指向显示设备的指针。
+ */
+void display_mirror_stop(display_t* d);
+
+/**
+ * 开启显示服务, 本进程独占屏幕, 其它进程用 `client:PATH@X,Y,WxH,Z` 作为帧缓冲设备
+ * 调用 display_init, 得到一块共享内存图层, 打印后 display_fflush 只提交变化区域,
+ * 由服务线程合成并刷新, 客户端断开后图层自动删除。守护进程见 tools/display_daemon。
+ *
+ * @param d 指向显示设备的指针。
+ * @param path Unix 套接字路径。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int display_server_start(display_t* d, const char* path);
+
+/**
+ * 关闭显示服务, 断开所有客户端。
+ *
+ * @param d 指向显示设备的指针。
+ */
+void display_server_stop(display_t* d);
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,623 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "display_server.h"
+
+#define DISPLAY_SERVER_BACKLOG (4)
+
+typedef struct display_server_client_t {
+    int fd;                        // 客户端套接字, -1 为空闲
+    int attached;                  // 是否已完成握手并加入合成
+    frame_rect_t rect;             // 图层在屏幕上的区域
+    framebuffer_color_t* surface;  // 共享内存映射
+    size_t size;                   // 共享内存大小
+} display_server_client_t;
+
+struct display_server_t {
+    int listen_fd;                 // 监听套接字
+    int event_fd;                  // 通知服务线程退出
+    pthread_t thread;              // 服务线程
+    int thread_running;            // 服务线程是否已启动
+    int stop;                      // 通知服务线程退出
+    char path[sizeof(((struct sockaddr_un*)0)->sun_path)]; // 套接字路径, 退出时删除
+    size_t width;                  // 屏幕宽
+    size_t height;                 // 屏幕高
+    display_server_ops_t ops;      // 事件回调
+    void* arg;                     // 传给回调的参数
+    size_t count;                  // 客户端个数
+    display_server_client_t clients[DISPLAY_SERVER_MAX_CLIENTS]; // 客户端
+};
+
+/**
+ * @brief 断开客户端, 已加入合成的先删除图层再释放共享内存
+ */
+static void display_server_client_close(display_server_t* s, display_server_client_t* c)
+{
+    if (c->attached) {
+        s->ops.detach(s->arg, c);
+        c->attached = 0;
+    }
+    if (c->surface) {
+        munmap(c->surface, c->size);
+        c->surface = NULL;
+        c->size = 0;
+    }
+    if (c->fd >= 0) {
+        LOG_DBG("display server client %d disconnected", c->fd);
+        close(c->fd);
+        c->fd = -1;
+        __atomic_sub_fetch(&s->count, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief 发送握手应答, 成功时附带共享内存描述符
+ */
+static int display_server_send_welcome(int fd, const display_server_welcome_t* w, int memfd)
+{
+    struct iovec iov = { (void*)w, sizeof(*w) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    char control[CMSG_SPACE(sizeof(int))];
+    if (memfd >= 0) {
+        memset(control, 0, sizeof(control));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &memfd, sizeof(int));
+    }
+
+    return sendmsg(fd, &msg, MSG_NOSIGNAL) == (ssize_t)sizeof(*w) ? 0 : -1;
+}
+
+/**
+ * @brief 处理握手: 裁剪图层区域, 创建共享内存并加入合成
+ */
+static int display_server_hello(display_server_t* s, display_server_client_t* c, const display_server_hello_t* h)
+{
+    display_server_welcome_t w;
+    memset(&w, 0, sizeof(w));
+    memcpy(w.magic, DISPLAY_SERVER_MAGIC, sizeof(w.magic));
+    w.status = -1;
+
+    if (memcmp(h->magic, DISPLAY_SERVER_MAGIC, sizeof(h->magic)) || h->x >= s->width || h->y >= s->height) {
+        LOG_ERR("bad hello from client %d", c->fd);
+        display_server_send_welcome(c->fd, &w, -1);
+        return -1;
+    }
+
+    frame_rect_t r = { h->x, h->y, h->width ? h->width : (uint32_t)s->width,
+        h->height ? h->height : (uint32_t)s->height };
+    frame_rect_clip(&r, s->width, s->height);
+    if (frame_rect_empty(&r) || !frame_rect_inside(&r, s->width, s->height)) {
+        LOG_ERR("bad layer from client %d", c->fd);
+        display_server_send_welcome(c->fd, &w, -1);
+        return -1;
+    }
+    size_t stride = r.w * COLOR_SIZE;
+    size_t size = stride * r.h;
+
+    int memfd = memfd_create("aimi-display-client", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memfd < 0 || ftruncate(memfd, size) < 0) {
+        LOG_ERR("fail to create client surface(%zu): %s", size, strerror(errno));
+        goto err;
+    }
+    // 客户端截短共享内存后服务端合成时会 SIGBUS, 发送前封住大小
+    if (fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+        LOG_ERR("fail to seal client surface: %s", strerror(errno));
+        goto err;
+    }
+    c->surface = (framebuffer_color_t*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (MAP_FAILED == c->surface) {
+        c->surface = NULL;
+        LOG_ERR("fail to map client surface: %s", strerror(errno));
+        goto err;
+    }
+    c->size = size;
+    c->rect = r;
+
+    if (s->ops.attach(s->arg, c, &r, h->z, c->surface, stride) < 0)
+        goto err;
+    c->attached = 1;
+
+    w.status = 0;
+    w.x = r.x;
+    w.y = r.y;
+    w.width = r.w;
+    w.height = r.h;
+    w.stride = stride;
+    if (display_server_send_welcome(c->fd, &w, memfd) < 0) {
+        close(memfd);
+        return -1;
+    }
+    close(memfd);
+    LOG_DBG("display server client %d: (%u, %u, %u, %u) z(%d)", c->fd, r.x, r.y, r.w, r.h, h->z);
+
+    return 0;
+err:
+    if (memfd >= 0)
+        close(memfd);
+    display_server_send_welcome(c->fd, &w, -1);
+    return -1;
+}
+
+/**
+ * @brief 读取客户端的所有消息, 变化区域合并后一次提交
+ *
+ * @return 需要刷新返回 1, 客户端断开返回 -1
+ */
+static int display_server_client_read(display_server_t* s, display_server_client_t* c)
+{
+    frame_rect_t damage = { 0, 0, 0, 0 };
+    for (;;) {
+        union {
+            display_server_hello_t hello;
+            display_server_damage_t damage;
+        } msg;
+        ssize_t ret = recv(c->fd, &msg, sizeof(msg), MSG_DONTWAIT);
+        if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            break;
+        if (ret <= 0)
+            return -1;
+
+        if (!c->attached) {
+            if (ret != sizeof(msg.hello) || display_server_hello(s, c, &msg.hello) < 0)
+                return -1;
+            continue;
+        }
+        if (ret != sizeof(msg.damage) || msg.damage.type != DISPLAY_SERVER_MSG_DAMAGE)
+            return -1;
+
+        // 客户端已裁剪过, 超出图层说明客户端有问题, 按 64 位比较防止坐标加宽高回绕
+        frame_rect_t r = msg.damage.rect;
+        if (!frame_rect_inside(&r, c->rect.w, c->rect.h)) {
+            LOG_ERR("bad damage (%u, %u, %u, %u) from client %d", r.x, r.y, r.w, r.h, c->fd);
+            return -1;
+        }
+        if (frame_rect_empty(&r))
+            continue;
+        r.x += c->rect.x;
+        r.y += c->rect.y;
+        frame_rect_union(&damage, &r);
+    }
+
+    if (frame_rect_empty(&damage))
+        return 0;
+    s->ops.damage(s->arg, c, &damage);
+    return 1;
+}
+
+/**
+ * @brief 接受新客户端, 握手在收到 hello 后完成
+ */
+static void display_server_accept(display_server_t* s)
+{
+    int fd = accept4(s->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    for (size_t i = 0; i < DISPLAY_SERVER_MAX_CLIENTS; ++i) {
+        display_server_client_t* c = &s->clients[i];
+        if (c->fd < 0) {
+            c->fd = fd;
+            __atomic_add_fetch(&s->count, 1, __ATOMIC_RELAXED);
+            LOG_DBG("display server client %d connected", fd);
+            return;
+        }
+    }
+    LOG_ERR("too many display clients, drop new one");
+    close(fd);
+}
+
+/**
+ * @brief 服务线程: 接受客户端, 收集变化区域并刷新
+ *
+ * @param arg 指向显示服务的指针
+ */
+static void* display_server_thread(void* arg)
+{
+    display_server_t* s = (display_server_t*)arg;
+    struct pollfd pfds[2 + DISPLAY_SERVER_MAX_CLIENTS];
+
+    while (!__atomic_load_n(&s->stop, __ATOMIC_ACQUIRE)) {
+        size_t n = 0;
+        pfds[n++] = (struct pollfd) { s->listen_fd, POLLIN, 0 };
+        pfds[n++] = (struct pollfd) { s->event_fd, POLLIN, 0 };
+        for (size_t i = 0; i < DISPLAY_SERVER_MAX_CLIENTS; ++i)
+            pfds[n++] = (struct pollfd) { s->clients[i].fd, POLLIN, 0 };
+
+        if (poll(pfds, n, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            LOG_ERR("display server poll fail: %s", strerror(errno));
+            break;
+        }
+        if (pfds[1].revents & POLLIN)
+            continue;
+
+        int dirty = 0;
+        for (size_t i = 0; i < DISPLAY_SERVER_MAX_CLIENTS; ++i) {
+            display_server_client_t* c = &s->clients[i];
+            if (c->fd < 0 || c->fd != pfds[2 + i].fd || !pfds[2 + i].revents)
+                continue;
+            int ret = display_server_client_read(s, c);
+            if (ret < 0) {
+                // 删除图层也会露出下面的内容, 需要刷新
+                dirty |= c->attached;
+                display_server_client_close(s, c);
+            } else {
+                dirty |= ret;
+            }
+        }
+        if (dirty)
+            s->ops.flush(s->arg);
+
+        if (pfds[0].revents & POLLIN)
+            display_server_accept(s);
+    }
+
+    return NULL;
+}
+
+/**
+ * 获取当前客户端个数。
+ *
+ * @param s 指向服务的指针。
+ * @return 客户端个数。
+ */
+size_t display_server_clients(const display_server_t* s)
+{
+    return s ? __atomic_load_n(&s->count, __ATOMIC_RELAXED) : 0;
+}
+
+/**
+ * 停止服务线程, 断开所有客户端(依次回调 detach)并释放服务。
+ *
+ * @param s 指向服务的指针。
+ */
+void display_server_exit(display_server_t* s)
+{
+    if (!s)
+        return;
+
+    if (s->thread_running) {
+        __atomic_store_n(&s->stop, 1, __ATOMIC_RELEASE);
+        uint64_t one = 1;
+        write(s->event_fd, &one, sizeof(one));
+        pthread_join(s->thread, NULL);
+        s->thread_running = 0;
+    }
+    int dirty = 0;
+    for (size_t i = 0; i < DISPLAY_SERVER_MAX_CLIENTS; ++i) {
+        dirty |= s->clients[i].attached;
+        display_server_client_close(s, &s->clients[i]);
+    }
+    if (dirty)
+        s->ops.flush(s->arg);
+    if (s->listen_fd >= 0) {
+        close(s->listen_fd);
+        s->listen_fd = -1;
+    }
+    if (s->path[0]) {
+        unlink(s->path);
+        s->path[0] = '\0';
+    }
+    if (s->event_fd >= 0) {
+        close(s->event_fd);
+        s->event_fd = -1;
+    }
+    free(s);
+}
+
+/**
+ * 创建显示服务并启动服务线程。
+ *
+ * @param path Unix 套接字路径, 已存在则替换。
+ * @param width 屏幕宽。
+ * @param height 屏幕高。
+ * @param ops 事件回调。
+ * @param arg 传给回调的参数。
+ * @return 成功返回服务指针，失败返回 NULL。
+ */
+display_server_t* display_server_init(const char* path, size_t width, size_t height,
+    const display_server_ops_t* ops, void* arg)
+{
+    assert(path && width && height && ops && "arg failed!");
+    assert(ops->attach && ops->detach && ops->damage && ops->flush && "arg failed!");
+
+    struct sockaddr_un sa;
+    memset(&sa, 0, sizeof(sa));
+    if (!*path || strlen(path) >= sizeof(sa.sun_path)) {
+        LOG_ERR("bad display server path: %s", path);
+        return NULL;
+    }
+    sa.sun_family = AF_UNIX;
+    strcpy(sa.sun_path, path);
+
+    display_server_t* s = (display_server_t*)malloc(sizeof(display_server_t));
+    if (!s) {
+        LOG_ERR("fail to malloc display server");
+        return NULL;
+    }
+    memset(s, 0, sizeof(display_server_t));
+    s->listen_fd = -1;
+    s->event_fd = -1;
+    s->width = width;
+    s->height = height;
+    s->ops = *ops;
+    s->arg = arg;
+    for (size_t i = 0; i < DISPLAY_SERVER_MAX_CLIENTS; ++i)
+        s->clients[i].fd = -1;
+
+    s->listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (s->listen_fd < 0) {
+        LOG_ERR("fail to create display server socket: %s", strerror(errno));
+        goto err;
+    }
+    unlink(path);
+    if (bind(s->listen_fd, (struct sockaddr*)&sa, sizeof(sa)) < 0
+        || listen(s->listen_fd, DISPLAY_SERVER_BACKLOG) < 0) {
+        LOG_ERR("fail to listen %s: %s", path, strerror(errno));
+        goto err;
+    }
+    strcpy(s->path, path);
+
+    s->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (s->event_fd < 0) {
+        LOG_ERR("fail to create eventfd: %s", strerror(errno));
+        goto err;
+    }
+
+    if (pthread_create(&s->thread, NULL, display_server_thread, s)) {
+        LOG_ERR("fail to create display server thread");
+        goto err;
+    }
+    s->thread_running = 1;
+
+    LOG_DBG("display server(%p) %zux%zu listen on %s", s, width, height, path);
+
+    return s;
+err:
+    display_server_exit(s);
+    return NULL;
+}
+
+#ifdef __DISPLAY_SERVER_XTEST__
+
+char g_dbg_enable = 1;
+
+#define TEST_W (64)
+#define TEST_H (32)
+
+typedef struct test_ctx_t {
+    pthread_mutex_t lock;
+    const void* key;
+    frame_rect_t rect;
+    framebuffer_color_t* surface;
+    size_t stride;
+    frame_rect_t damage;
+    framebuffer_color_t seen;  // 收到变化时共享内存中 (1, 1) 的颜色
+    size_t flushes;
+    int detached;
+} test_ctx_t;
+
+static int test_attach(void* arg, const void* key, const frame_rect_t* r, int z,
+    framebuffer_color_t* surface, size_t stride)
+{
+    test_ctx_t* ctx = (test_ctx_t*)arg;
+    pthread_mutex_lock(&ctx->lock);
+    assert(z == 3);
+    ctx->key = key;
+    ctx->rect = *r;
+    ctx->surface = surface;
+    ctx->stride = stride;
+    pthread_mutex_unlock(&ctx->lock);
+    return 0;
+}
+
+static void test_detach(void* arg, const void* key)
+{
+    test_ctx_t* ctx = (test_ctx_t*)arg;
+    pthread_mutex_lock(&ctx->lock);
+    assert(key == ctx->key);
+    ctx->detached = 1;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+static void test_damage(void* arg, const void* key, const frame_rect_t* r)
+{
+    test_ctx_t* ctx = (test_ctx_t*)arg;
+    pthread_mutex_lock(&ctx->lock);
+    assert(key == ctx->key);
+    frame_rect_union(&ctx->damage, r);
+    ctx->seen = *(framebuffer_color_t*)((uint8_t*)ctx->surface + ctx->stride + COLOR_SIZE);
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+static void test_flush(void* arg)
+{
+    test_ctx_t* ctx = (test_ctx_t*)arg;
+    pthread_mutex_lock(&ctx->lock);
+    ctx->flushes++;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/**
+ * @brief 等待服务线程处理完, 最多 1 秒
+ */
+static int test_wait(test_ctx_t* ctx, size_t flushes)
+{
+    for (int i = 0; i < 200; ++i) {
+        pthread_mutex_lock(&ctx->lock);
+        int ok = ctx->flushes >= flushes;
+        pthread_mutex_unlock(&ctx->lock);
+        if (ok)
+            return 1;
+        usleep(5000);
+    }
+    return 0;
+}
+
+/**
+ * @brief 不经过 framebuffer_init 直接握手, 拿到服务端发来的 memfd
+ *
+ * @param x 请求的图层 x
+ * @param width 请求的图层宽, 不做任何检查
+ * @return 成功返回套接字, memfd 输出共享内存描述符
+ */
+static int test_raw_client(const char* path, uint32_t x, uint32_t width, int* memfd)
+{
+    struct sockaddr_un sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strncpy(sa.sun_path, path, sizeof(sa.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    assert(fd >= 0 && 0 == connect(fd, (struct sockaddr*)&sa, sizeof(sa)));
+
+    display_server_hello_t hello;
+    memset(&hello, 0, sizeof(hello));
+    memcpy(hello.magic, DISPLAY_SERVER_MAGIC, sizeof(hello.magic));
+    hello.x = x;
+    hello.width = width;
+    hello.z = 3;
+    assert(send(fd, &hello, sizeof(hello), MSG_NOSIGNAL) == (ssize_t)sizeof(hello));
+
+    display_server_welcome_t welcome;
+    char control[CMSG_SPACE(sizeof(int))];
+    struct iovec iov = { &welcome, sizeof(welcome) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    assert(recvmsg(fd, &msg, MSG_CMSG_CLOEXEC) == (ssize_t)sizeof(welcome) && 0 == welcome.status);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    assert(cmsg && cmsg->cmsg_type == SCM_RIGHTS);
+    memcpy(memfd, CMSG_DATA(cmsg), sizeof(int));
+    return fd;
+}
+
+int main(void)
+{
+    const char* path = "/tmp/display_server_test.sock";
+    test_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    pthread_mutex_init(&ctx.lock, NULL);
+    display_server_ops_t ops = { test_attach, test_detach, test_damage, test_flush };
+
+    display_server_t* s = display_server_init(path, TEST_W, TEST_H, &ops, &ctx);
+    assert(s);
+
+    // 客户端图层超出屏幕的部分被裁掉
+    framebuffer_t* fb = framebuffer_init("client:/tmp/display_server_test.sock@40,8,100x16,3");
+    assert(fb && fb->width == TEST_W - 40 && fb->height == 16);
+    assert(display_server_clients(s) == 1);
+    pthread_mutex_lock(&ctx.lock);
+    assert(ctx.rect.x == 40 && ctx.rect.y == 8 && ctx.rect.w == TEST_W - 40 && ctx.rect.h == 16);
+    pthread_mutex_unlock(&ctx.lock);
+
+    // 客户端写共享内存, 提交两次变化, 服务端看到合并后的屏幕坐标区域和写入的像素
+    *(framebuffer_color_t*)((uint8_t*)fb->screen + fb->line_length + COLOR_SIZE) = COLOR_GREY;
+    assert(0 == framebuffer_damage(fb, 1, 1, 2, 1));
+    assert(0 == framebuffer_damage(fb, 4, 3, 100, 1));
+    assert(test_wait(&ctx, 1));
+    usleep(20000);
+    pthread_mutex_lock(&ctx.lock);
+    printf("damage (%u, %u, %u, %u) after %zu flushes\n",
+        ctx.damage.x, ctx.damage.y, ctx.damage.w, ctx.damage.h, ctx.flushes);
+    assert(ctx.seen == COLOR_GREY);
+    assert(ctx.damage.x == 41 && ctx.damage.y == 9 && ctx.damage.w == TEST_W - 41 && ctx.damage.h == 3);
+    size_t flushes = ctx.flushes;
+    pthread_mutex_unlock(&ctx.lock);
+
+    // 断开后删除图层并刷新
+    framebuffer_exit(fb);
+    assert(test_wait(&ctx, flushes + 1));
+    pthread_mutex_lock(&ctx.lock);
+    assert(ctx.detached);
+    pthread_mutex_unlock(&ctx.lock);
+    assert(display_server_clients(s) == 0);
+
+    // 客户端不能截短或加长共享内存, 服务端之后读取不会 SIGBUS
+    int memfd = -1;
+    int raw = test_raw_client(path, 0, 0, &memfd);
+    assert(memfd >= 0);
+    int seals = fcntl(memfd, F_GET_SEALS);
+    assert((seals & (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)) == (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL));
+    assert(ftruncate(memfd, 0) < 0 && errno == EPERM);
+    assert(ftruncate(memfd, TEST_W * TEST_H * COLOR_SIZE * 2) < 0 && errno == EPERM);
+    assert(fcntl(memfd, F_ADD_SEALS, F_SEAL_WRITE) < 0);
+    pthread_mutex_lock(&ctx.lock);
+    flushes = ctx.flushes;
+    ctx.seen = COLOR_BLACK;
+    pthread_mutex_unlock(&ctx.lock);
+    framebuffer_color_t* shared = (framebuffer_color_t*)mmap(NULL, TEST_W * TEST_H * COLOR_SIZE,
+        PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    assert(MAP_FAILED != shared);
+    shared[TEST_W + 1] = COLOR_GREY;
+    display_server_damage_t dmg = { DISPLAY_SERVER_MSG_DAMAGE, { 0, 0, TEST_W, TEST_H } };
+    assert(send(raw, &dmg, sizeof(dmg), MSG_NOSIGNAL) == (ssize_t)sizeof(dmg));
+    assert(test_wait(&ctx, flushes + 1));
+    pthread_mutex_lock(&ctx.lock);
+    assert(ctx.seen == COLOR_GREY);
+    flushes = ctx.flushes;
+    pthread_mutex_unlock(&ctx.lock);
+    munmap(shared, TEST_W * TEST_H * COLOR_SIZE);
+    close(memfd);
+    close(raw);
+    assert(test_wait(&ctx, flushes + 1));
+
+    // 坐标加宽高按 32 位回绕的图层被裁剪到屏幕内, 这样的变化区域被拒绝并断开客户端
+    pthread_mutex_lock(&ctx.lock);
+    flushes = ctx.flushes;
+    ctx.detached = 0;
+    pthread_mutex_unlock(&ctx.lock);
+    raw = test_raw_client(path, 50, 0xfffffff0, &memfd);
+    close(memfd);
+    pthread_mutex_lock(&ctx.lock);
+    assert(ctx.rect.x == 50 && ctx.rect.y == 0 && ctx.rect.w == TEST_W - 50 && ctx.rect.h == TEST_H);
+    memset(&ctx.damage, 0, sizeof(ctx.damage));
+    pthread_mutex_unlock(&ctx.lock);
+    display_server_damage_t hostile = { DISPLAY_SERVER_MSG_DAMAGE, { 10, 0, 0xfffffff0, 10 } };
+    assert(send(raw, &hostile, sizeof(hostile), MSG_NOSIGNAL) == (ssize_t)sizeof(hostile));
+    assert(test_wait(&ctx, flushes + 1));
+    char eof;
+    assert(0 == recv(raw, &eof, sizeof(eof), 0));
+    pthread_mutex_lock(&ctx.lock);
+    assert(ctx.detached && frame_rect_empty(&ctx.damage));
+    pthread_mutex_unlock(&ctx.lock);
+    assert(display_server_clients(s) == 0);
+    close(raw);
+
+    // 本地帧缓冲区提交变化区域什么都不做
+    fb = framebuffer_init("mem:8x8");
+    assert(fb && 0 == framebuffer_damage(fb, 0, 0, 8, 8));
+    framebuffer_exit(fb);
+
+    display_server_exit(s);
+    assert(access(path, F_OK) < 0);
+    pthread_mutex_destroy(&ctx.lock);
+    printf("display server test pass\n");
+    return 0;
+}
+
+#endif //__DISPLAY_SERVER_XTEST__
@@ -0,0 +1,128 @@
+#ifndef __DISPLAY_SERVER_H__
+#define __DISPLAY_SERVER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "frame_delta.h"
+#include "framebuffer.h"
+
+// 功能: 显示服务. 独占帧缓冲区的进程通过 Unix 域套接字(SOCK_SEQPACKET)接受其它进程连接,
+// 为每个客户端创建一块 memfd 共享内存作为图层离屏缓存, 客户端在本地绘制后只提交变化区域,
+// 服务端把变化区域重新合成并刷新到屏幕. 像素不经过套接字, 只传递一次文件描述符.
+// 客户端用 framebuffer_init("client:...") 打开, 见 framebuffer.h.
+//
+// 协议(本机字节序, 每条消息一个数据报):
+//   客户端 -> 服务端  display_server_hello_t
+//   服务端 -> 客户端  display_server_welcome_t, status 为 0 时附带 memfd(SCM_RIGHTS)
+//   客户端 -> 服务端  display_server_damage_t * N, 坐标相对客户端图层, 超出图层的区域视为非法消息
+// 客户端断开后图层被删除, 下面的内容重新显示.
+//
+// example:
+//   display_server_t* s = display_server_init("/run/aimi-display.sock", 240, 240, &ops, d);
+//   ...
+//   display_server_exit(s);
+
+#define DISPLAY_SERVER_MAGIC "AIMIDSP1"     // 握手魔数
+#define DISPLAY_SERVER_MAX_CLIENTS (8)      // 最大客户端数
+#define DISPLAY_SERVER_MSG_DAMAGE (1)       // 消息类型: 提交变化区域
+
+typedef struct display_server_hello_t {
+    char magic[8];     // DISPLAY_SERVER_MAGIC
+    uint32_t x;        // 图层在屏幕上的 x
+    uint32_t y;        // 图层在屏幕上的 y
+    uint32_t width;    // 图层宽, 0 为到屏幕右边
+    uint32_t height;   // 图层高, 0 为到屏幕下边
+    int32_t z;         // 叠放次序, 越大越靠上
+    uint32_t reserved; // 保留
+} display_server_hello_t;
+
+typedef struct display_server_welcome_t {
+    char magic[8];     // DISPLAY_SERVER_MAGIC
+    int32_t status;    // 0 成功, 其它失败
+    uint32_t x;        // 实际图层位置, 已裁剪到屏幕范围内
+    uint32_t y;
+    uint32_t width;    // 实际图层宽
+    uint32_t height;   // 实际图层高
+    uint32_t stride;   // 共享内存每行字节数
+} display_server_welcome_t;
+
+typedef struct display_server_damage_t {
+    uint32_t type;     // DISPLAY_SERVER_MSG_DAMAGE
+    frame_rect_t rect; // 变化区域, 相对客户端图层
+} display_server_damage_t;
+
+/**
+ * 服务端事件回调, 都在服务线程中调用。
+ */
+typedef struct display_server_ops_t {
+    /**
+     * 新客户端: 把共享内存作为图层加入合成。
+     *
+     * @param arg display_server_init 传入的参数。
+     * @param key 客户端标识, 之后的回调用它找到图层。
+     * @param r 图层在屏幕上的区域。
+     * @param z 叠放次序。
+     * @param surface 共享内存。
+     * @param stride 共享内存每行字节数。
+     * @return 成功返回 0，失败返回 -1。
+     */
+    int (*attach)(void* arg, const void* key, const frame_rect_t* r, int z,
+        framebuffer_color_t* surface, size_t stride);
+
+    /**
+     * 客户端断开: 删除图层, 返回后共享内存被释放。
+     */
+    void (*detach)(void* arg, const void* key);
+
+    /**
+     * 客户端提交变化区域, 屏幕坐标, 已裁剪到图层范围内。
+     */
+    void (*damage)(void* arg, const void* key, const frame_rect_t* r);
+
+    /**
+     * 一轮消息处理完, 把累积的变化刷新到屏幕。
+     */
+    void (*flush)(void* arg);
+} display_server_ops_t;
+
+struct display_server_t;
+typedef struct display_server_t display_server_t;
+
+/**
+ * 创建显示服务并启动服务线程。
+ *
+ * @param path Unix 套接字路径, 已存在则替换。
+ * @param width 屏幕宽。
+ * @param height 屏幕高。
+ * @param ops 事件回调。
+ * @param arg 传给回调的参数。
+ * @return 成功返回服务指针，失败返回 NULL。
+ */
+display_server_t* display_server_init(const char* path, size_t width, size_t height,
+    const display_server_ops_t* ops, void* arg);
+
+/**
+ * 停止服务线程, 断开所有客户端(依次回调 detach)并释放服务。
+ *
+ * @param s 指向服务的指针。
+ */
+void display_server_exit(display_server_t* s);
+
+/**
+ * 获取当前客户端个数。
+ *
+ * @param s 指向服务的指针。
+ * @return 客户端个数。
+ */
+size_t display_server_clients(const display_server_t* s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__DISPLAY_SERVER_H__
@@ -0,0 +1,294 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "debug.h"
+#include "fb_copy.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define FB_COPY_HAVE_STREAM (1)
+#elif defined(__aarch64__)
+#define FB_COPY_HAVE_STREAM (1)
+#endif
+
+#define FB_COPY_BENCH_ROUNDS (3)  // 初始化测速时每个内核的测量次数
+
+// 拷贝内核是刷新的热点, 不随整体编译选项(默认不优化)变化
+#define FB_COPY_KERNEL __attribute__((optimize("O2")))
+
+/**
+ * @brief 目标地址对齐到缓存行之前需要单独拷贝的字节数
+ */
+FB_COPY_KERNEL static inline size_t fb_copy_head(const void* dst, size_t n)
+{
+    size_t head = (size_t)(-(uintptr_t)dst) & (FB_COPY_LINE - 1);
+    return head < n ? head : n;
+}
+
+/**
+ * @brief libc memcpy
+ */
+static void fb_copy_memcpy(void* dst, const void* src, size_t n)
+{
+    memcpy(dst, src, n);
+}
+
+/**
+ * @brief 目标对齐到缓存行后按整行读入再写出, 写合并内存一次填满一行
+ */
+FB_COPY_KERNEL static void fb_copy_burst(void* dst, const void* src, size_t n)
+{
+    uint8_t* d = (uint8_t*)dst;
+    const uint8_t* s = (const uint8_t*)src;
+
+    size_t head = fb_copy_head(d, n);
+    memcpy(d, s, head);
+    d += head;
+    s += head;
+    n -= head;
+
+    for (; n >= FB_COPY_LINE; n -= FB_COPY_LINE, d += FB_COPY_LINE, s += FB_COPY_LINE) {
+        uint64_t line[FB_COPY_LINE / sizeof(uint64_t)];
+        memcpy(line, s, FB_COPY_LINE);
+        memcpy(d, line, FB_COPY_LINE);
+    }
+    memcpy(d, s, n);
+}
+
+#ifdef FB_COPY_HAVE_STREAM
+/**
+ * @brief 同 burst, 整行部分使用非临时写, 不占用缓存也不读目标
+ */
+FB_COPY_KERNEL static void fb_copy_stream(void* dst, const void* src, size_t n)
+{
+    uint8_t* d = (uint8_t*)dst;
+    const uint8_t* s = (const uint8_t*)src;
+
+    size_t head = fb_copy_head(d, n);
+    memcpy(d, s, head);
+    d += head;
+    s += head;
+    n -= head;
+
+    for (; n >= FB_COPY_LINE; n -= FB_COPY_LINE, d += FB_COPY_LINE, s += FB_COPY_LINE) {
+#if defined(__SSE2__)
+        __m128i a = _mm_loadu_si128((const __m128i*)s);
+        __m128i b = _mm_loadu_si128((const __m128i*)(s + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(s + 32));
+        __m128i e = _mm_loadu_si128((const __m128i*)(s + 48));
+        _mm_stream_si128((__m128i*)d, a);
+        _mm_stream_si128((__m128i*)(d + 16), b);
+        _mm_stream_si128((__m128i*)(d + 32), c);
+        _mm_stream_si128((__m128i*)(d + 48), e);
+#else
+        __asm__ volatile("ldp q0, q1, [%1]\n"
+                         "ldp q2, q3, [%1, #32]\n"
+                         "stnp q0, q1, [%0]\n"
+                         "stnp q2, q3, [%0, #32]\n"
+                         :
+                         : "r"(d), "r"(s)
+                         : "v0", "v1", "v2", "v3", "memory");
+#endif
+    }
+    memcpy(d, s, n);
+
+    // 非临时写是弱序的, 结束前保证全部写出
+#if defined(__SSE2__)
+    _mm_sfence();
+#else
+    __asm__ volatile("dmb ishst" ::: "memory");
+#endif
+}
+#endif // FB_COPY_HAVE_STREAM
+
+static const fb_copy_kernel_t s_fb_copy_kernels[] = {
+    { "memcpy", fb_copy_memcpy },
+    { "burst", fb_copy_burst },
+#ifdef FB_COPY_HAVE_STREAM
+    { "stream", fb_copy_stream },
+#endif
+};
+
+/**
+ * 获取当前平台可用的全部拷贝内核。
+ *
+ * @param count 输出内核个数。
+ * @return 内核数组, 第一个为 memcpy。
+ */
+const fb_copy_kernel_t* fb_copy_kernels(size_t* count)
+{
+    if (count)
+        *count = sizeof(s_fb_copy_kernels) / sizeof(s_fb_copy_kernels[0]);
+    return s_fb_copy_kernels;
+}
+
+/**
+ * 按名称查找拷贝内核。
+ *
+ * @param name 内核名称。
+ * @return 找到返回内核，否则返回 NULL。
+ */
+const fb_copy_kernel_t* fb_copy_find(const char* name)
+{
+    size_t count = 0;
+    const fb_copy_kernel_t* ks = fb_copy_kernels(&count);
+    for (size_t i = 0; name && i < count; ++i) {
+        if (0 == strcmp(ks[i].name, name))
+            return &ks[i];
+    }
+    return NULL;
+}
+
+/**
+ * 按行拷贝矩形区域, 两边每行字节数都等于 row_bytes 时合并成一次连续拷贝。
+ *
+ * @param k 拷贝内核。
+ * @param dst 目标第一行地址。
+ * @param dst_stride 目标每行字节数。
+ * @param src 来源第一行地址。
+ * @param src_stride 来源每行字节数。
+ * @param row_bytes 每行拷贝字节数。
+ * @param rows 行数。
+ */
+void fb_copy_rows(const fb_copy_kernel_t* k, void* dst, size_t dst_stride,
+    const void* src, size_t src_stride, size_t row_bytes, size_t rows)
+{
+    assert(k && dst && src && "arg failed!");
+    if (!row_bytes || !rows)
+        return;
+
+    if (dst_stride == row_bytes && src_stride == row_bytes) {
+        k->copy(dst, src, row_bytes * rows);
+        return;
+    }
+    uint8_t* d = (uint8_t*)dst;
+    const uint8_t* s = (const uint8_t*)src;
+    for (size_t i = 0; i < rows; ++i, d += dst_stride, s += src_stride)
+        k->copy(d, s, row_bytes);
+}
+
+/**
+ * 测量一个内核拷贝整个区域的耗时, 取多次中最快的一次。
+ *
+ * @param k 拷贝内核。
+ * @param dst 目标地址, 参数同 fb_copy_rows。
+ * @param dst_stride 目标每行字节数。
+ * @param src 来源地址。
+ * @param src_stride 来源每行字节数。
+ * @param row_bytes 每行拷贝字节数。
+ * @param rows 行数。
+ * @param rounds 测量次数。
+ * @return 耗时, 纳秒。
+ */
+uint64_t fb_copy_bench(const fb_copy_kernel_t* k, void* dst, size_t dst_stride,
+    const void* src, size_t src_stride, size_t row_bytes, size_t rows, int rounds)
+{
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < rounds; ++i) {
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        fb_copy_rows(k, dst, dst_stride, src, src_stride, row_bytes, rows);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        uint64_t ns = (uint64_t)(t1.tv_sec - t0.tv_sec) * 1000000000ULL + t1.tv_nsec - t0.tv_nsec;
+        best = ns < best ? ns : best;
+    }
+    return best;
+}
+
+/**
+ * 对每个内核测速, 选择最快的一个。测速会把来源内容写入目标。
+ *
+ * @param dst 目标地址, 一般为帧缓冲区。
+ * @param dst_stride 目标每行字节数。
+ * @param src 来源地址, 一般为显示缓存。
+ * @param src_stride 来源每行字节数。
+ * @param row_bytes 每行拷贝字节数。
+ * @param rows 行数。
+ * @return 最快的内核。
+ */
+const fb_copy_kernel_t* fb_copy_select(void* dst, size_t dst_stride,
+    const void* src, size_t src_stride, size_t row_bytes, size_t rows)
+{
+    size_t count = 0;
+    const fb_copy_kernel_t* ks = fb_copy_kernels(&count);
+    const fb_copy_kernel_t* best = &ks[0];
+    uint64_t best_ns = UINT64_MAX;
+
+    // 先拷贝一次, 排除缺页等首次访问的开销
+    fb_copy_rows(&ks[0], dst, dst_stride, src, src_stride, row_bytes, rows);
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t ns = fb_copy_bench(&ks[i], dst, dst_stride, src, src_stride,
+            row_bytes, rows, FB_COPY_BENCH_ROUNDS);
+        LOG_DBG("fb copy %s: %zu bytes in %llu ns (%.1f MB/s)", ks[i].name, row_bytes * rows,
+            (unsigned long long)ns, ns ? row_bytes * rows * 1000.0 / ns : 0.0);
+        if (ns < best_ns) {
+            best_ns = ns;
+            best = &ks[i];
+        }
+    }
+    LOG_DBG("fb copy select %s", best->name);
+    return best;
+}
+
+#ifdef __XTEST__
+
+#include <stdlib.h>
+
+char g_dbg_enable = 1;
+
+int main(void)
+{
+    size_t count = 0;
+    const fb_copy_kernel_t* ks = fb_copy_kernels(&count);
+    assert(count >= 2 && fb_copy_find("memcpy") == &ks[0] && !fb_copy_find("none"));
+
+    // 各种对齐和长度下与参考结果一致, 不越界
+    uint8_t src[512], dst[512], ref[512];
+    for (size_t i = 0; i < sizeof(src); ++i)
+        src[i] = (uint8_t)(i * 7 + 3);
+    for (size_t k = 0; k < count; ++k) {
+        for (size_t off = 0; off < FB_COPY_LINE + 3; ++off) {
+            for (size_t n = 0; n < 300; n += 1 + n / 16) {
+                memset(dst, 0xee, sizeof(dst));
+                memset(ref, 0xee, sizeof(ref));
+                memcpy(ref + off, src + 5, n);
+                ks[k].copy(dst + off, src + 5, n);
+                assert(0 == memcmp(dst, ref, sizeof(dst)));
+            }
+        }
+    }
+
+    // 按行拷贝, 目标行尾的填充字节不被修改
+    const size_t row_bytes = 100, rows = 4, dst_stride = 128;
+    for (size_t k = 0; k < count; ++k) {
+        memset(dst, 0xee, sizeof(dst));
+        fb_copy_rows(&ks[k], dst, dst_stride, src, row_bytes, row_bytes, rows);
+        for (size_t y = 0; y < rows; ++y) {
+            assert(0 == memcmp(dst + y * dst_stride, src + y * row_bytes, row_bytes));
+            for (size_t x = row_bytes; x < dst_stride; ++x)
+                assert(dst[y * dst_stride + x] == 0xee);
+        }
+    }
+
+    // 测速选择, 同时输出各内核速度
+    const size_t sizes[][2] = { { 240, 240 }, { 800, 480 }, { 1920, 1080 } };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        size_t row = sizes[i][0] * 2, h = sizes[i][1];
+        uint8_t* a = (uint8_t*)malloc(row * h);
+        uint8_t* b = (uint8_t*)malloc(row * h);
+        assert(a && b);
+        memset(a, 0x5a, row * h);
+        printf("%zux%zu:\n", sizes[i][0], h);
+        const fb_copy_kernel_t* k = fb_copy_select(b, row, a, row, row, h);
+        assert(k && 0 == memcmp(a, b, row * h));
+        free(a);
+        free(b);
+    }
+
+    printf("fb copy test pass\n");
+    return 0;
+}
+
+#endif //__XTEST__
@@ -0,0 +1,103 @@
+#ifndef __FB_COPY_H__
+#define __FB_COPY_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 功能: 显示缓存到帧缓冲区的拷贝内核.
+// 帧缓冲区映射一般是不带缓存或写合并(write-combined)的内存, 读很慢, 写最好按
+// 完整的缓存行连续写入. 这里提供几种拷贝方式:
+//   memcpy  libc 默认实现
+//   burst   目标地址对齐到缓存行后按整行(64 字节)读入再写出
+//   stream  在 burst 基础上使用不经过缓存的非临时写(x86 SSE2 movntdq / ARM64 stnp)
+// 不同平台和驱动下哪种最快不确定, fb_copy_select 在初始化时对实际的帧缓冲区测速选择.
+//
+// example:
+//   const fb_copy_kernel_t* k = fb_copy_select(screen, line_length, cache, stride, row_bytes, height);
+//   fb_copy_rows(k, screen + y * line_length, line_length, cache + y * stride, stride, row_bytes, rows);
+
+#define FB_COPY_LINE (64)  // 缓存行大小, 写入按此对齐
+
+/**
+ * 拷贝连续内存。
+ *
+ * @param dst 目标地址。
+ * @param src 来源地址。
+ * @param n 字节数。
+ */
+typedef void (*fb_copy_fn)(void* dst, const void* src, size_t n);
+
+typedef struct fb_copy_kernel_t {
+    const char* name;  // 名称
+    fb_copy_fn copy;   // 拷贝函数
+} fb_copy_kernel_t;
+
+/**
+ * 获取当前平台可用的全部拷贝内核。
+ *
+ * @param count 输出内核个数。
+ * @return 内核数组, 第一个为 memcpy。
+ */
+const fb_copy_kernel_t* fb_copy_kernels(size_t* count);
+
+/**
+ * 按名称查找拷贝内核。
+ *
+ * @param name 内核名称。
+ * @return 找到返回内核，否则返回 NULL。
+ */
+const fb_copy_kernel_t* fb_copy_find(const char* name);
+
+/**
+ * 按行拷贝矩形区域, 两边每行字节数都等于 row_bytes 时合并成一次连续拷贝。
+ *
+ * @param k 拷贝内核。
+ * @param dst 目标第一行地址。
+ * @param dst_stride 目标每行字节数。
+ * @param src 来源第一行地址。
+ * @param src_stride 来源每行字节数。
+ * @param row_bytes 每行拷贝字节数。
+ * @param rows 行数。
+ */
+void fb_copy_rows(const fb_copy_kernel_t* k, void* dst, size_t dst_stride,
+    const void* src, size_t src_stride, size_t row_bytes, size_t rows);
+
+/**
+ * 测量一个内核拷贝整个区域的耗时, 取多次中最快的一次。
+ *
+ * @param k 拷贝内核。
+ * @param dst 目标地址, 参数同 fb_copy_rows。
+ * @param dst_stride 目标每行字节数。
+ * @param src 来源地址。
+ * @param src_stride 来源每行字节数。
+ * @param row_bytes 每行拷贝字节数。
+ * @param rows 行数。
+ * @param rounds 测量次数。
+ * @return 耗时, 纳秒。
+ */
+uint64_t fb_copy_bench(const fb_copy_kernel_t* k, void* dst, size_t dst_stride,
+    const void* src, size_t src_stride, size_t row_bytes, size_t rows, int rounds);
+
+/**
+ * 对每个内核测速, 选择最快的一个。测速会把来源内容写入目标。
+ *
+ * @param dst 目标地址, 一般为帧缓冲区。
+ * @param dst_stride 目标每行字节数。
+ * @param src 来源地址, 一般为显示缓存。
+ * @param src_stride 来源每行字节数。
+ * @param row_bytes 每行拷贝字节数。
+ * @param rows 行数。
+ * @return 最快的内核。
+ */
+const fb_copy_kernel_t* fb_copy_select(void* dst, size_t dst_stride,
+    const void* src, size_t src_stride, size_t row_bytes, size_t rows);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__FB_COPY_H__
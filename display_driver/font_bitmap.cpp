@@ -2,8 +2,10 @@
 #include <cstdint>
 #include <cstring>
 #include <iconv.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 
 #include <string>
@@ -13,12 +15,55 @@
 
 #define WORD_ASCII_MAX_SIZE (5 * 1024LU)     // ASCII 字体最大大小
 #define WORD_ZH_MAP_MAX_SIZE (257 * 1024LU)  // 中文字体 最大大小
+#define GB2312_ZH_START (0xa0)               // GB2312 中文区位码起始
+#define GB2312_ZONE_CODE_ZH_SIZE (94)        // GB2312 每个区的字数
+
+// 各字号字体的尺寸, 字体文件名为 ascii_{宽}x{高} 和 gb2312_{宽}x{高}, 抗锯齿字体再加 _aa 后缀
+static const struct {
+    size_t size;
+    size_t ascii_width;
+    size_t zh_width;
+} s_font_faces[FONT_FACE_COUNT] = {
+    { 12, 6, 12 },
+    { 16, 8, 16 },
+    { 24, 12, 24 },
+    { 32, 16, 32 },
+};
 
 typedef struct font_data_t {
     size_t size;     // 字体数据大小
     uint8_t data[0]; // 字体数据
 } font_data_t;
 
+// 每个字号的字体文件
+enum {
+    FONT_FILE_ASCII = 0,  // ascii 点阵
+    FONT_FILE_ZH,         // gb2312 点阵
+    FONT_FILE_ASCII_AA,   // ascii 抗锯齿
+    FONT_FILE_ZH_AA,      // gb2312 抗锯齿
+    FONT_FILE_COUNT,
+};
+
+typedef struct font_file_stat_t {
+    dev_t dev;              // 所在设备
+    ino_t ino;              // inode
+    off_t size;             // 文件大小
+    struct timespec mtime;  // 修改时间
+} font_file_stat_t;
+
+// 进程内共享的字体, 按路径和内容哈希查找
+typedef struct font_entry_t {
+    font_bitmap_t font;         // 共享的字体, 必须放第一个
+    int refs;                   // 引用计数
+    uint64_t hash;              // 字体内容哈希
+    char* path;                 // 字体目录
+    font_file_stat_t st[FONT_FACE_COUNT][FONT_FILE_COUNT]; // 加载时各字号字体文件信息, 没有的文件全为 0
+    struct font_entry_t* next;  // 下一个字体
+} font_entry_t;
+
+static pthread_mutex_t s_font_lock = PTHREAD_MUTEX_INITIALIZER;
+static font_entry_t* s_font_entries = NULL;
+
 /**
  * 判断是否为 GB2312 编码的中文字符。
  *
@@ -82,13 +127,14 @@ font_data_t* load_font(const char* filename, size_t max_data_size)
     FILE* fphzk = NULL;
     fphzk = fopen(filename, "rb");
     if (fphzk == NULL) {
-        fprintf(stderr, "error hzk16");
+        LOG_ERR("fail to open font: %s", filename);
         return NULL;
     }
     fseek(fphzk, 0, SEEK_END);
     long file_size = ftell(fphzk);
-    if (file_size + 1 > max_data_size) {
+    if (file_size < 0 || (size_t)file_size + 1 > max_data_size) {
         LOG_ERR("font file too long! %ld > %ld", file_size, max_data_size);
+        fclose(fphzk);
         return NULL;
     }
     fseek(fphzk, 0, SEEK_SET);
@@ -97,6 +143,7 @@ font_data_t* load_font(const char* filename, size_t max_data_size)
     font_data_t* map = (font_data_t*)malloc(map_size);
     if (!map) {
         LOG_ERR("fail to malloc size(%zu) word map. ", map_size);
+        fclose(fphzk);
         return NULL;
     }
     memset(map, 0, map_size);
@@ -105,6 +152,8 @@ font_data_t* load_font(const char* filename, size_t max_data_size)
     int ret = fread((char*)map->data, sizeof(char), file_size, fphzk);
     if (ret <= 0) {
         LOG_ERR("fail to read font: %d", ret);
+        fclose(fphzk);
+        free(map);
         return NULL;
     }
     fclose(fphzk);
@@ -113,7 +162,79 @@ font_data_t* load_font(const char* filename, size_t max_data_size)
 }
 
 /**
- * 释放字体位图所占用的内存空间。
+ * @brief 获取字体文件信息, 用于判断已加载的字体是否仍然有效
+ *
+ * @param filename 字体文件路径
+ * @param st 输出文件信息, 失败时全为 0
+ * 
+ * @return 成功返回 0 失败返回 -1
+ */
+static int font_file_stat(const char* filename, font_file_stat_t* st)
+{
+    struct stat sb;
+    memset(st, 0, sizeof(font_file_stat_t));
+    if (stat(filename, &sb) < 0)
+        return -1;
+    st->dev = sb.st_dev;
+    st->ino = sb.st_ino;
+    st->size = sb.st_size;
+    st->mtime = sb.st_mtim;
+    return 0;
+}
+
+static inline int font_file_stat_equal(const font_file_stat_t* a, const font_file_stat_t* b)
+{
+    return a->dev == b->dev && a->ino == b->ino && a->size == b->size
+        && a->mtime.tv_sec == b->mtime.tv_sec && a->mtime.tv_nsec == b->mtime.tv_nsec;
+}
+
+/**
+ * @brief 计算字体数据的 FNV-1a 哈希
+ *
+ * @param hash 初始哈希值
+ * @param map 字体数据
+ * 
+ * @return 哈希值
+ */
+static uint64_t font_data_hash(uint64_t hash, const font_data_t* map)
+{
+    const uint8_t* p = (const uint8_t*)&map->size;
+    for (size_t i = 0; i < sizeof(map->size); ++i)
+        hash = (hash ^ p[i]) * 0x100000001b3LU;
+    for (size_t i = 0; i < map->size - sizeof(font_data_t); ++i)
+        hash = (hash ^ map->data[i]) * 0x100000001b3LU;
+    return hash;
+}
+
+static inline int font_data_equal(const font_data_t* a, const font_data_t* b)
+{
+    if (!a || !b)
+        return a == b;
+    return a->size == b->size && 0 == memcmp(a->data, b->data, a->size - sizeof(font_data_t));
+}
+
+/**
+ * @brief 释放字体条目
+ *
+ * @param e 字体条目
+ */
+static void font_entry_free(font_entry_t* e)
+{
+    if (!e)
+        return;
+    // ascii/zh 指向默认字号的字体, 不单独释放
+    for (size_t i = 0; i < FONT_FACE_COUNT; ++i) {
+        unload_font(e->font.faces[i].ascii);
+        unload_font(e->font.faces[i].zh);
+        unload_font(e->font.faces[i].ascii_aa);
+        unload_font(e->font.faces[i].zh_aa);
+    }
+    free(e->path);
+    free(e);
+}
+
+/**
+ * 释放字体位图的引用, 最后一个引用释放时才释放字体内存。
  *
  * @param map 指向字体位图的指针。
  */
@@ -121,55 +242,239 @@ void font_bitmap_exit(font_bitmap_t* fb)
 {
     if (!fb)
         return;
-    if (fb->ascii) {
-        unload_font(fb->ascii);
-        fb->ascii = NULL;
+
+    font_entry_t* e = (font_entry_t*)fb;
+    pthread_mutex_lock(&s_font_lock);
+    if (--e->refs > 0) {
+        pthread_mutex_unlock(&s_font_lock);
+        return;
     }
-    if (fb->zh) {
-        unload_font(fb->zh);
-        fb->zh = NULL;
+    for (font_entry_t** pos = &s_font_entries; *pos; pos = &(*pos)->next) {
+        if (*pos == e) {
+            *pos = e->next;
+            break;
+        }
     }
+    pthread_mutex_unlock(&s_font_lock);
+
+    LOG_DBG("unload font %s", e->path);
+    font_entry_free(e);
 }
 
 /**
- * 初始化字体位图。
+ * 获取共享字体位图。
+ *
+ * 同一进程内字体按目录路径和内容哈希共享: 路径相同且文件未变化时直接增加引用,
+ * 不再读取文件; 路径不同但内容相同时加载后比较, 丢弃新加载的副本。
+ * 返回的字体只读, 使用完需调用 font_bitmap_exit 释放引用。
  *
  * @param font_path 字体文件的路径。
- * @return 指向初始化后的字体位图的指针。
+ * @return 指向字体位图的指针。
  */
 font_bitmap_t* font_bitmap_init(const char *font_path)
 {
     assert(font_path && "font path fail!");
-    font_bitmap_t* fb = (font_bitmap_t*)malloc(sizeof(font_bitmap_t));
-    if (!fb) {
+
+    std::string names[FONT_FACE_COUNT][FONT_FILE_COUNT];
+    font_file_stat_t st[FONT_FACE_COUNT][FONT_FILE_COUNT];
+    for (size_t i = 0; i < FONT_FACE_COUNT; ++i) {
+        names[i][FONT_FILE_ASCII] = std::string(font_path) + "/ascii_" + std::to_string(s_font_faces[i].ascii_width)
+            + "x" + std::to_string(s_font_faces[i].size);
+        names[i][FONT_FILE_ZH] = std::string(font_path) + "/gb2312_" + std::to_string(s_font_faces[i].zh_width)
+            + "x" + std::to_string(s_font_faces[i].size);
+        names[i][FONT_FILE_ASCII_AA] = names[i][FONT_FILE_ASCII] + "_aa";
+        names[i][FONT_FILE_ZH_AA] = names[i][FONT_FILE_ZH] + "_aa";
+        for (size_t j = 0; j < FONT_FILE_COUNT; ++j) {
+            // 只有默认字号的点阵字体必须存在
+            if (font_file_stat(names[i][j].c_str(), &st[i][j]) < 0 && s_font_faces[i].size == FONT_SIZE_DEFAULT
+                && j <= FONT_FILE_ZH) {
+                LOG_ERR("fail to stat font: %s", names[i][j].c_str());
+                return NULL;
+            }
+        }
+    }
+
+    pthread_mutex_lock(&s_font_lock);
+    font_entry_t* e = NULL;
+    for (e = s_font_entries; e; e = e->next) {
+        int same = 0 == strcmp(e->path, font_path);
+        for (size_t i = 0; same && i < FONT_FACE_COUNT; ++i) {
+            for (size_t j = 0; same && j < FONT_FILE_COUNT; ++j)
+                same = font_file_stat_equal(&e->st[i][j], &st[i][j]);
+        }
+        if (same) {
+            e->refs++;
+            pthread_mutex_unlock(&s_font_lock);
+            return &e->font;
+        }
+    }
+
+    e = (font_entry_t*)malloc(sizeof(font_entry_t));
+    if (!e) {
         LOG_ERR("fail to malloc font bitmap");
-        return NULL;
+        goto err;
+    }
+    memset(e, 0, sizeof(font_entry_t));
+    e->refs = 1;
+    memcpy(e->st, st, sizeof(st));
+    e->path = strdup(font_path);
+    if (!e->path) {
+        LOG_ERR("fail to malloc font path");
+        goto err;
     }
-    memset(fb, 0, sizeof(font_bitmap_t));
 
-    std::string font_name = font_path;
-    font_name += "/ascii_8x16";
+    e->hash = 0xcbf29ce484222325LU;
+    for (size_t i = 0; i < FONT_FACE_COUNT; ++i) {
+        font_face_t* f = &e->font.faces[i];
+        f->size = s_font_faces[i].size;
+        f->ascii_width = s_font_faces[i].ascii_width;
+        f->zh_width = s_font_faces[i].zh_width;
+        // 可选字号缺少任意一个文件时不使用
+        if (!st[i][FONT_FILE_ASCII].size || !st[i][FONT_FILE_ZH].size)
+            continue;
+
+        // 最大大小按每个字的字节数从 16 号字体的限制换算
+        size_t ascii_bytes = FONT_ROW_BYTES(f->ascii_width) * f->size;
+        size_t zh_bytes = FONT_ROW_BYTES(f->zh_width) * f->size;
+        f->ascii = load_font(names[i][FONT_FILE_ASCII].c_str(), WORD_ASCII_MAX_SIZE * ascii_bytes / FONT_HEIGHT_WORD_SIZE);
+        if (!f->ascii) {
+            LOG_ERR("fail to load ascii");
+            goto err;
+        }
+        LOG_DBG("load font %s", names[i][FONT_FILE_ASCII].c_str());
 
-    fb->ascii = load_font(font_name.c_str(), WORD_ASCII_MAX_SIZE);
-    if (!fb->ascii) {
-        LOG_ERR("fail to load ascii");
-        unload_font(fb->ascii);
-        return NULL;
+        f->zh = load_font(names[i][FONT_FILE_ZH].c_str(), WORD_ZH_MAP_MAX_SIZE * zh_bytes / (2 * FONT_HEIGHT_WORD_SIZE));
+        if (!f->zh) {
+            LOG_ERR("fail to load zh");
+            goto err;
+        }
+        LOG_DBG("load font %s", names[i][FONT_FILE_ZH].c_str());
+        e->hash = font_data_hash(font_data_hash(e->hash ^ f->size, f->ascii), f->zh);
+
+        // 抗锯齿字体可选, 两个文件都有时才使用
+        if (st[i][FONT_FILE_ASCII_AA].size && st[i][FONT_FILE_ZH_AA].size) {
+            size_t ascii_aa_bytes = FONT_AA_ROW_BYTES(f->ascii_width) * f->size;
+            size_t zh_aa_bytes = FONT_AA_ROW_BYTES(f->zh_width) * f->size;
+            f->ascii_aa = load_font(names[i][FONT_FILE_ASCII_AA].c_str(),
+                WORD_ASCII_MAX_SIZE * ascii_aa_bytes / FONT_HEIGHT_WORD_SIZE);
+            f->zh_aa = load_font(names[i][FONT_FILE_ZH_AA].c_str(),
+                WORD_ZH_MAP_MAX_SIZE * zh_aa_bytes / (2 * FONT_HEIGHT_WORD_SIZE));
+            if (!f->ascii_aa || !f->zh_aa) {
+                LOG_ERR("fail to load antialias font");
+                goto err;
+            }
+            LOG_DBG("load font %s", names[i][FONT_FILE_ZH_AA].c_str());
+            e->hash = font_data_hash(font_data_hash(e->hash ^ 0xaa, f->ascii_aa), f->zh_aa);
+        }
+
+        if (f->size == FONT_SIZE_DEFAULT) {
+            e->font.ascii = f->ascii;
+            e->font.zh = f->zh;
+        }
     }
-    LOG_DBG("load font %s", font_name.c_str());
-
-    font_name = font_path;
-    font_name += "/gb2312_16x16";
-    fb->zh = load_font(font_name.c_str(), WORD_ZH_MAP_MAX_SIZE);
-    if (!fb->zh) {
-        LOG_ERR("fail to load zh");
-        unload_font(fb->zh);
-        return NULL;
+
+    for (font_entry_t* same = s_font_entries; same; same = same->next) {
+        int equal = same->hash == e->hash;
+        for (size_t i = 0; equal && i < FONT_FACE_COUNT; ++i) {
+            const font_face_t* a = &same->font.faces[i];
+            const font_face_t* b = &e->font.faces[i];
+            equal = font_data_equal(a->ascii, b->ascii) && font_data_equal(a->zh, b->zh)
+                && font_data_equal(a->ascii_aa, b->ascii_aa) && font_data_equal(a->zh_aa, b->zh_aa);
+        }
+        if (equal) {
+            LOG_DBG("font %s same as %s, share it", font_path, same->path);
+            same->refs++;
+            pthread_mutex_unlock(&s_font_lock);
+            font_entry_free(e);
+            return &same->font;
+        }
     }
-    LOG_DBG("load font %s", font_name.c_str());
 
-    return fb;
+    e->next = s_font_entries;
+    s_font_entries = e;
+    pthread_mutex_unlock(&s_font_lock);
+
+    return &e->font;
 err:
+    pthread_mutex_unlock(&s_font_lock);
+    font_entry_free(e);
+    return NULL;
+}
+
+/**
+ * 按字号选择字体。有这个字号的字体时直接使用, 否则使用能整除它的最大字号放大,
+ * 放大倍数不超过 FONT_SCALE_MAX。
+ *
+ * @param map 指向字体位图的指针。
+ * @param size 字号, 0 为默认字号。
+ * @param scale 输出放大倍数。
+ * @return 字体, 字体目录中没有能得到这个字号的字体时返回 NULL。
+ */
+const font_face_t* font_bitmap_face(const font_bitmap_t* map, size_t size, size_t* scale)
+{
+    assert(map && scale && "arg is null");
+    if (!size)
+        size = FONT_SIZE_DEFAULT;
+    for (size_t i = FONT_FACE_COUNT; i-- > 0;) {
+        const font_face_t* f = &map->faces[i];
+        if (f->ascii && size % f->size == 0 && size / f->size <= FONT_SCALE_MAX) {
+            *scale = size / f->size;
+            return f;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 按 GB2312 编码在字体数据中查找字形
+ *
+ * @param map 字体数据, 可以为 NULL
+ * @param bytes 每个字形的字节数
+ * @param gb 指向 ASCII 或 GB2312 中文字符的指针
+ * 
+ * @return 字形, 字体数据中没有时返回 NULL
+ */
+static const uint8_t* font_data_glyph(const font_data_t* map, size_t bytes, const uint8_t* gb)
+{
+    size_t offset = is_gb2312_ascii(gb) ? gb[0] * bytes
+        : (GB2312_ZONE_CODE_ZH_SIZE * (size_t)(gb[0] - GB2312_ZH_START - 1) + (gb[1] - GB2312_ZH_START - 1)) * bytes;
+    if (!map || offset + bytes > map->size - sizeof(font_data_t))
+        return NULL;
+    return map->data + offset;
+}
+
+/**
+ * 获取 GB2312 编码字符在指定字号中的字位图。
+ *
+ * @param face 字体。
+ * @param gb 指向 GB2312 编码的字符的指针。
+ * @return 字位图, 每行 FONT_ROW_BYTES(字宽) 字节, 共 face->size 行, 字库中没有时返回 NULL。
+ */
+const uint8_t* font_face_glyph(const font_face_t* face, const uint8_t* gb)
+{
+    assert(face && gb && "arg is null");
+    if (is_gb2312_ascii(gb))
+        return font_data_glyph(face->ascii, FONT_ROW_BYTES(face->ascii_width) * face->size, gb);
+    if (is_gb2312_chinese(gb))
+        return font_data_glyph(face->zh, FONT_ROW_BYTES(face->zh_width) * face->size, gb);
+    return NULL;
+}
+
+/**
+ * 获取 GB2312 编码字符在指定字号中的抗锯齿字形。
+ *
+ * @param face 字体。
+ * @param gb 指向 GB2312 编码的字符的指针。
+ * @return 4 位覆盖度字形, 每行 FONT_AA_ROW_BYTES(字宽) 字节, 共 face->size 行,
+ *         没有抗锯齿字体或字库中没有时返回 NULL。
+ */
+const uint8_t* font_face_glyph_aa(const font_face_t* face, const uint8_t* gb)
+{
+    assert(face && gb && "arg is null");
+    if (is_gb2312_ascii(gb))
+        return font_data_glyph(face->ascii_aa, FONT_AA_ROW_BYTES(face->ascii_width) * face->size, gb);
+    if (is_gb2312_chinese(gb))
+        return font_data_glyph(face->zh_aa, FONT_AA_ROW_BYTES(face->zh_width) * face->size, gb);
     return NULL;
 }
 
@@ -210,9 +515,7 @@ word_bitmap_t* gb2312_zh_to_word_bitmap(const font_data_t* wm, const uint8_t* gb
     int offset = 0;
     word_bitmap_t* p_word = NULL;
 
-#define GB2312_ZH_START (0xa0)
 #define FONT_ZH_BITMAP_SIZE (32)
-#define GB2312_ZONE_CODE_ZH_SIZE (94)
 
     offset = (GB2312_ZONE_CODE_ZH_SIZE * (uint32_t)(gb[0] - GB2312_ZH_START - 1) 
         + (gb[1] - GB2312_ZH_START - 1)) * FONT_ZH_BITMAP_SIZE;
@@ -223,9 +526,7 @@ word_bitmap_t* gb2312_zh_to_word_bitmap(const font_data_t* wm, const uint8_t* gb
     }
     p_word = (word_bitmap_t*)(wm->data + offset);
 
-#undef GB2312_ZONE_CODE_ZH_SIZE
 #undef FONT_ZH_BITMAP_SIZE
-#undef GB2312_ZH_START
 
     return p_word;
 }
@@ -246,6 +547,39 @@ word_bitmap_t* gb2312_to_word_bitmap(const font_bitmap_t* wm, const uint8_t* gb)
     return NULL;
 }
 
+/*
+ * 使用已打开的转换句柄把任意编码转换为 GB2312, 句柄可重复使用.
+ * @param cd: iconv_open("GB2312", from_code) 得到的句柄
+ * @param src_size: 来源字符串长度
+ * @param str: 来源字符串
+ * @param dest_size: 目标缓冲区空间大小
+ * @param dest: 转换结果保存缓冲区
+ * @return:
+ *      失败返回 < 0
+ *      成功返回 使用的字符长度.
+ *
+ */
+int str_conv_gb2312(iconv_t cd, size_t src_size, const char* src, const size_t dest_size, char* dest)
+{
+    // 清除上一次转换遗留的状态
+    iconv(cd, NULL, NULL, NULL, NULL);
+
+    char* p_src = (char*)src;
+    char* p_dest = dest;
+    size_t leat_size = dest_size;
+    if (iconv(cd, &p_src, &src_size, &p_dest, &leat_size) == (size_t)-1) {
+        LOG_ERR("fail to iconv gb2312");
+        return -1;
+    }
+
+#if DETAIL_LOG_ENABLE
+    LOG_DBG("conv %s(%02x, %02x, %02x, %02x) to GB2312: %s(%02x, %02x)",
+        src, src[0], src[1], src[2], src[4], dest, dest[0], dest[1]);
+#endif // DETAIL_LOG_ENABLE
+
+    return dest_size - leat_size;
+}
+
 /*
  * 任意编码到 GB2312 的转换.
  * @param from_code: 来源编码
@@ -267,24 +601,12 @@ int str_to_gb2312(const char* from_code, size_t src_size, const char* src, const
         return -1;
     }
 
-    char* p_src = (char*)src;
-    char* p_dest = dest;
-    size_t leat_size = dest_size;
-    if (iconv(cd, &p_src, &src_size, &p_dest, &leat_size) == (size_t)-1) {
-        LOG_ERR("fail to iconv gb2312");
-        iconv_close(cd);
-        return -1;
-    }
+    int len = str_conv_gb2312(cd, src_size, src, dest_size, dest);
 
     // 关闭 iconv 转换句柄
     iconv_close(cd);
 
-#if DETAIL_LOG_ENABLE
-    LOG_DBG("conv %s: %s(%02x, %02x, %02x, %02x) to GB2312: %s(%02x, %02x)",
-        from_code, src, src[0], src[1], src[2], src[4], dest, dest[0], dest[1]);
-#endif // DETAIL_LOG_ENABLE
-
-    return dest_size - leat_size;
+    return len;
 }
 
 #ifdef __XTEST__
@@ -341,6 +663,160 @@ void display_zh_word(word_bitmap_t* p_word)
     printf("\n");
 }
 
+/**
+ * 把 16 号字体放大两倍写成 32 号字体文件, 用于检查多字号加载
+ */
+static void write_double_font(const font_data_t* src, size_t width, const char* filename)
+{
+    size_t cols = FONT_ROW_BYTES(width);
+    size_t count = (src->size - sizeof(font_data_t) - 1) / (cols * 16);
+    FILE* fp = fopen(filename, "wb");
+    assert(fp);
+    for (size_t n = 0; n < count; ++n) {
+        const uint8_t* g = src->data + n * cols * 16;
+        for (size_t k = 0; k < 32; ++k) {
+            uint8_t row[4] = { 0 };
+            for (size_t i = 0; i < 2 * width; ++i) {
+                if (g[k / 2 * cols + i / 2 / 8] & (0x80 >> (i / 2 % 8)))
+                    row[i / 8] |= 0x80 >> (i % 8);
+            }
+            fwrite(row, 1, 2 * cols, fp);
+        }
+    }
+    fclose(fp);
+}
+
+/**
+ * 把点阵字体写成只有 0 和 15 两级覆盖度的抗锯齿字体, 用于检查抗锯齿字体加载
+ */
+static void write_aa_font(const font_data_t* src, size_t width, const char* filename)
+{
+    size_t cols = FONT_ROW_BYTES(width);
+    size_t rows = (src->size - sizeof(font_data_t) - 1) / cols;
+    FILE* fp = fopen(filename, "wb");
+    assert(fp);
+    for (size_t k = 0; k < rows; ++k) {
+        uint8_t row[FONT_AA_ROW_BYTES(16)] = { 0 };
+        for (size_t i = 0; i < width; ++i) {
+            if (src->data[k * cols + i / 8] & (0x80 >> (i % 8)))
+                row[i / 2] |= i & 1 ? 0x0f : 0xf0;
+        }
+        fwrite(row, 1, FONT_AA_ROW_BYTES(width), fp);
+    }
+    fclose(fp);
+}
+
+static void test_font_faces(font_bitmap_t* wm)
+{
+    // 只有 16 号时其它字号由 16 号放大, 不能整除或放大倍数太大的没有字体
+    size_t scale = 0;
+    assert(font_bitmap_face(wm, 16, &scale) == &wm->faces[1] && scale == 1);
+    assert(font_bitmap_face(wm, 0, &scale) == &wm->faces[1] && scale == 1);
+    assert(font_bitmap_face(wm, 32, &scale) == &wm->faces[1] && scale == 2);
+    assert(font_bitmap_face(wm, 48, &scale) == &wm->faces[1] && scale == 3);
+    assert(!font_bitmap_face(wm, 12, &scale));
+    assert(!font_bitmap_face(wm, 24, &scale));
+    assert(!font_bitmap_face(wm, 128, &scale));
+    assert(!wm->faces[0].ascii && !wm->faces[2].ascii && !wm->faces[3].ascii);
+    const uint8_t zh[] = { 0xc4, 0xe3 };
+    assert(font_face_glyph(&wm->faces[1], zh) == (const uint8_t*)gb2312_to_word_bitmap(wm, zh));
+    assert(font_face_glyph(&wm->faces[1], (const uint8_t*)"A") == (const uint8_t*)gb2312_to_word_bitmap(wm, (const uint8_t*)"A"));
+    assert(!font_face_glyph(&wm->faces[0], zh));
+    assert(!font_face_glyph_aa(&wm->faces[1], zh));
+
+    // 加入 32 号字体后直接使用, 64 号由 32 号放大
+    char dir[] = "/tmp/font_faces_XXXXXX";
+    assert(mkdtemp(dir));
+    std::string base = dir;
+    std::string cmd = "cp display_driver/font/ascii_8x16 display_driver/font/gb2312_16x16 " + base;
+    assert(0 == system(cmd.c_str()));
+    write_double_font(wm->ascii, 8, (base + "/ascii_16x32").c_str());
+    write_double_font(wm->zh, 16, (base + "/gb2312_32x32").c_str());
+    font_bitmap_t* big = font_bitmap_init(dir);
+    assert(big && big != wm);
+    assert(font_bitmap_face(big, 32, &scale) == &big->faces[3] && scale == 1);
+    assert(font_bitmap_face(big, 64, &scale) == &big->faces[3] && scale == 2);
+    assert(font_bitmap_face(big, 48, &scale) == &big->faces[1] && scale == 3);
+    const uint8_t* g16 = font_face_glyph(&big->faces[1], zh);
+    const uint8_t* g32 = font_face_glyph(&big->faces[3], zh);
+    assert(g16 && g32);
+    for (size_t k = 0; k < 32; ++k) {
+        for (size_t i = 0; i < 32; ++i)
+            assert(!(g32[k * 4 + i / 8] & (0x80 >> (i % 8))) == !(g16[k / 2 * 2 + i / 16] & (0x80 >> (i / 2 % 8))));
+    }
+    assert(!font_face_glyph_aa(&big->faces[1], zh) && !font_face_glyph_aa(&big->faces[3], zh));
+
+    // 加入 16 号抗锯齿字体, 覆盖度与点阵一致, 文件变化后不复用之前加载的字体
+    write_aa_font(wm->ascii, 8, (base + "/ascii_8x16_aa").c_str());
+    write_aa_font(wm->zh, 16, (base + "/gb2312_16x16_aa").c_str());
+    font_bitmap_t* aa = font_bitmap_init(dir);
+    assert(aa && aa != big && aa != wm);
+    const uint8_t* a16 = font_face_glyph_aa(&aa->faces[1], zh);
+    const uint8_t* b16 = font_face_glyph(&aa->faces[1], zh);
+    assert(a16 && b16 && !font_face_glyph_aa(&aa->faces[3], zh));
+    for (size_t k = 0; k < 16; ++k) {
+        for (size_t i = 0; i < 16; ++i) {
+            uint8_t c = (a16[k * FONT_AA_ROW_BYTES(16) + i / 2] >> (i & 1 ? 0 : 4)) & 0x0f;
+            assert(c == (b16[k * 2 + i / 8] & (0x80 >> (i % 8)) ? 0x0f : 0));
+        }
+    }
+    assert(font_face_glyph_aa(&aa->faces[1], (const uint8_t*)"A"));
+    font_bitmap_exit(aa);
+    font_bitmap_exit(big);
+    cmd = "rm -rf " + base;
+    assert(0 == system(cmd.c_str()));
+}
+
+/**
+ * @brief 字体是否还在共享列表中
+ */
+static int test_font_listed(const font_bitmap_t* fb)
+{
+    int found = 0;
+    pthread_mutex_lock(&s_font_lock);
+    for (font_entry_t* e = s_font_entries; e; e = e->next)
+        found |= &e->font == fb;
+    pthread_mutex_unlock(&s_font_lock);
+    return found;
+}
+
+static void test_font_registry(void)
+{
+    // 两个使用者打开同一字体得到同一个实例, 字号也是同一个
+    char dir[] = "/tmp/font_registry_XXXXXX";
+    assert(mkdtemp(dir));
+    std::string base = dir;
+    std::string cmd = "cp display_driver/font/ascii_8x16 display_driver/font/gb2312_16x16 " + base;
+    assert(0 == system(cmd.c_str()));
+    // 内容与 display_driver/font 相同, 先改掉一个字节, 避免和 main 中的字体共享
+    FILE* fp = fopen((base + "/ascii_8x16").c_str(), "r+b");
+    assert(fp && 0 == fseek(fp, 0, SEEK_SET) && EOF != fputc(0x5a, fp));
+    fclose(fp);
+
+    font_bitmap_t* a = font_bitmap_init(dir);
+    font_bitmap_t* b = font_bitmap_init(dir);
+    assert(a && a == b && ((font_entry_t*)a)->refs == 2);
+    size_t sa = 0, sb = 0;
+    assert(font_bitmap_face(a, 16, &sa) == font_bitmap_face(b, 16, &sb) && sa == sb);
+
+    // 释放一个引用后另一个仍可使用
+    const uint8_t zh[] = { 0xc4, 0xe3 };
+    font_bitmap_exit(a);
+    assert(test_font_listed(b) && ((font_entry_t*)b)->refs == 1);
+    assert(font_face_glyph(font_bitmap_face(b, 16, &sb), zh));
+
+    // 最后一个引用释放后从共享列表移除, 再次打开重新加载
+    font_bitmap_exit(b);
+    assert(!test_font_listed(b));
+    font_bitmap_t* c = font_bitmap_init(dir);
+    assert(c && test_font_listed(c) && ((font_entry_t*)c)->refs == 1);
+    font_bitmap_exit(c);
+    assert(!test_font_listed(c));
+
+    cmd = "rm -rf " + base;
+    assert(0 == system(cmd.c_str()));
+}
+
 void display_word(word_bitmap_t* p_word, gb2312_word_type_t type)
 {
     if (type == GB2312_ASCII)
@@ -362,6 +838,16 @@ int main(void)
         return -1;
     }
 
+    // 相同路径直接共享, 不同路径相同内容也共享
+    font_bitmap_t* same_path = font_bitmap_init("display_driver/font");
+    font_bitmap_t* same_data = font_bitmap_init("display_driver/./font");
+    assert(same_path == wm && same_data == wm);
+    font_bitmap_exit(same_path);
+    font_bitmap_exit(same_data);
+    assert(!font_bitmap_init("display_driver/no_font"));
+    test_font_faces(wm);
+    test_font_registry();
+
     for (size_t i = 0; i < input.length(); i) {
         // 有个字符是结束标志故判断没关系.
         const uint8_t* gb = (const uint8_t*)(input.c_str() + i);
@@ -5,9 +5,16 @@
 extern "C" {
 #endif
 
+#include <iconv.h>
 #include <stdint.h>
 
 // 功能: 读取GB2312点阵字体资源文件, 转化为点阵字结构
+// 字体在进程内按路径和内容哈希共享, 多个显示设备不会重复加载
+// 字体目录里除了必须的 16 号字体 ascii_8x16/gb2312_16x16, 还可以放 12/24/32 号字体
+// (ascii_6x12/gb2312_12x12, ascii_12x24/gb2312_24x24, ascii_16x32/gb2312_32x32),
+// 每个字一行占 (字宽 + 7) / 8 字节, 高位在左. 没有的字号用能整除它的字号整数倍放大.
+// 每个字号还可以带抗锯齿字体(文件名加 _aa 后缀, 如 gb2312_16x16_aa), 每个像素 4 位覆盖度,
+// 一行占 (字宽 + 1) / 2 字节, 高 4 位在左, 由 tools/font_aa 从两倍大小的点阵字体生成.
 // example: font_bitmap.c::main()
 
 #include "framebuffer.h"
@@ -20,15 +27,32 @@ struct font_data_t;
 #define ZH_WORD_SIZE (GB2312_ZH_BIT * BIT_SIZE)       // 16 * FRAMEBUFFER==2 中文字体 BIT 大小
 #define ASCII_WORD_SIZE (GB2312_ASCII_BIT * BIT_SIZE) // ASCII 字体 BIT 大小
 #define FONT_HEIGHT_WORD_SIZE (16)                    // 字体高度
+#define FONT_ROW_BYTES(width) (((width) + BIT_SIZE - 1) / BIT_SIZE) // 字宽对应的每行字节数
+#define FONT_AA_ROW_BYTES(width) (((width) + 1) / 2)  // 抗锯齿字体字宽对应的每行字节数
+
+#define FONT_FACE_COUNT (4)                           // 支持的字号个数: 12, 16, 24, 32
+#define FONT_SIZE_DEFAULT (FONT_HEIGHT_WORD_SIZE)     // 默认字号, 字体目录中必须有
+#define FONT_SCALE_MAX (4)                            // 最大放大倍数
 
 typedef union {
     uint8_t zh[ZH_WORD_SIZE];        // width-16bit, height-16bit
     uint8_t ascii[ASCII_WORD_SIZE];  // width-8bit, height-16bit
 } word_bitmap_t;
 
+typedef struct font_face_t {
+    size_t size;         // 字号, 即字高
+    size_t ascii_width;  // ASCII 字宽
+    size_t zh_width;     // 中文字宽
+    font_data_t* ascii;  // ascii 的字体, NULL 表示没有这个字号
+    font_data_t* zh;     // gb2312 的字体, NULL 表示没有这个字号
+    font_data_t* ascii_aa; // ascii 的抗锯齿字体, NULL 表示没有
+    font_data_t* zh_aa;    // gb2312 的抗锯齿字体, NULL 表示没有
+} font_face_t;
+
 typedef struct font_bitmap_t {
-    font_data_t* ascii;  // ascii 的字体
-    font_data_t* zh;     // gb2312 的字体
+    font_data_t* ascii;  // ascii 的字体, 即默认字号的字体
+    font_data_t* zh;     // gb2312 的字体, 即默认字号的字体
+    font_face_t faces[FONT_FACE_COUNT]; // 各字号的字体, 按字号从小到大
 } font_bitmap_t;
 
 typedef enum gb2312_word_type_t {
@@ -38,20 +62,51 @@ typedef enum gb2312_word_type_t {
 } gb2312_word_type_t;
 
 /**
- * 释放字体位图所占用的内存空间。
+ * 释放字体位图的引用, 最后一个引用释放时才释放字体内存。
  *
  * @param map 指向字体位图的指针。
  */
 void font_bitmap_exit(font_bitmap_t* map);
 
 /**
- * 初始化字体位图。
+ * 获取共享字体位图。同一进程内相同路径或相同内容的字体只加载一份,
+ * 以引用计数共享, 返回的字体只读。
  *
  * @param font_path 字体文件的路径。
- * @return 指向初始化后的字体位图的指针。
+ * @return 指向字体位图的指针, 失败返回 NULL。
  */
 font_bitmap_t* font_bitmap_init(const char* font_path);
 
+/**
+ * 按字号选择字体。有这个字号的字体时直接使用, 否则使用能整除它的最大字号放大,
+ * 放大倍数不超过 FONT_SCALE_MAX。
+ *
+ * @param map 指向字体位图的指针。
+ * @param size 字号, 0 为默认字号。
+ * @param scale 输出放大倍数。
+ * @return 字体, 字体目录中没有能得到这个字号的字体时返回 NULL。
+ */
+const font_face_t* font_bitmap_face(const font_bitmap_t* map, size_t size, size_t* scale);
+
+/**
+ * 获取 GB2312 编码字符在指定字号中的字位图。
+ *
+ * @param face 字体。
+ * @param gb 指向 GB2312 编码的字符的指针。
+ * @return 字位图, 每行 FONT_ROW_BYTES(字宽) 字节, 共 face->size 行, 字库中没有时返回 NULL。
+ */
+const uint8_t* font_face_glyph(const font_face_t* face, const uint8_t* gb);
+
+/**
+ * 获取 GB2312 编码字符在指定字号中的抗锯齿字形。
+ *
+ * @param face 字体。
+ * @param gb 指向 GB2312 编码的字符的指针。
+ * @return 4 位覆盖度字形, 每行 FONT_AA_ROW_BYTES(字宽) 字节, 共 face->size 行,
+ *         没有抗锯齿字体或字库中没有时返回 NULL。
+ */
+const uint8_t* font_face_glyph_aa(const font_face_t* face, const uint8_t* gb);
+
 /**
  * 获取 GB2312 编码字符的类型。
  *
@@ -117,6 +172,20 @@ word_bitmap_t* gb2312_to_word_bitmap(const font_bitmap_t* wm, const uint8_t* gb)
  */
 int str_to_gb2312(const char* from_code, size_t src_size, const char* src, const size_t dest_size, char* dest);
 
+/*
+ * 使用已打开的转换句柄把任意编码转换为 GB2312, 句柄可重复使用, 避免每次打开.
+ * @param cd: iconv_open("GB2312", from_code) 得到的句柄
+ * @param src_size: 来源字符串长度
+ * @param str: 来源字符串
+ * @param dest_size: 目标缓冲区空间大小
+ * @param dest: 转换结果保存缓冲区
+ * @return:
+ *      失败返回 < 0
+ *      成功返回 使用的字符长度.
+ *
+ */
+int str_conv_gb2312(iconv_t cd, size_t src_size, const char* src, const size_t dest_size, char* dest);
+
 #ifdef __cplusplus
 }
 #endif
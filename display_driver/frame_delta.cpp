@@ -0,0 +1,334 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "frame_delta.h"
+
+#define FRAME_DELTA_LITERAL_MAX (31) // 单个 literal token 最多像素数, 保证 header 只占 1 字节
+
+typedef struct frame_delta_writer_t {
+    uint8_t* out;                                 // 输出位置
+    uint8_t* end;                                 // 输出结束位置
+    int overflow;                                 // 是否溢出
+    size_t lit_count;                             // 待输出 literal 个数
+    framebuffer_color_t lit[FRAME_DELTA_LITERAL_MAX]; // 待输出 literal 值
+} frame_delta_writer_t;
+
+/**
+ * 把矩形 r 合并到 dst 中, 结果为两者的包围盒。
+ *
+ * @param dst 被合并的矩形。
+ * @param r 要合并进来的矩形。
+ */
+void frame_rect_union(frame_rect_t* dst, const frame_rect_t* r)
+{
+    if (frame_rect_empty(r))
+        return;
+    if (frame_rect_empty(dst)) {
+        *dst = *r;
+        return;
+    }
+    // 按 64 位计算右下角, 超出 32 位的宽高截到最大值, 之后由裁剪处理
+    uint64_t x1 = (uint64_t)dst->x + dst->w > (uint64_t)r->x + r->w ? (uint64_t)dst->x + dst->w : (uint64_t)r->x + r->w;
+    uint64_t y1 = (uint64_t)dst->y + dst->h > (uint64_t)r->y + r->h ? (uint64_t)dst->y + dst->h : (uint64_t)r->y + r->h;
+    dst->x = dst->x < r->x ? dst->x : r->x;
+    dst->y = dst->y < r->y ? dst->y : r->y;
+    dst->w = x1 - dst->x > UINT32_MAX ? UINT32_MAX : (uint32_t)(x1 - dst->x);
+    dst->h = y1 - dst->y > UINT32_MAX ? UINT32_MAX : (uint32_t)(y1 - dst->y);
+}
+
+/**
+ * 把矩形裁剪到 width x height 的范围内, 只缩小宽高, 起点在范围外时为空矩形。
+ *
+ * @param r 要裁剪的矩形。
+ * @param width 范围宽度。
+ * @param height 范围高度。
+ */
+void frame_rect_clip(frame_rect_t* r, size_t width, size_t height)
+{
+    if (r->x >= width || r->y >= height) {
+        r->w = r->h = 0;
+        return;
+    }
+    // 宽高来自客户端或文件时可能很大, 32 位相加会回绕
+    if ((uint64_t)r->x + r->w > width)
+        r->w = width - r->x;
+    if ((uint64_t)r->y + r->h > height)
+        r->h = height - r->y;
+}
+
+/**
+ * 获取矩形编码结果的最大字节数。
+ *
+ * @param r 指向矩形的指针。
+ * @return 编码输出缓冲区至少需要的字节数。
+ */
+size_t frame_delta_bound(const frame_rect_t* r)
+{
+    size_t n = (size_t)r->w * r->h;
+    return n * COLOR_SIZE + n / FRAME_DELTA_LITERAL_MAX + 16;
+}
+
+/**
+ * @brief 写出一个 varint
+ */
+static inline void frame_delta_put_varint(frame_delta_writer_t* w, size_t v)
+{
+    do {
+        if (w->out >= w->end) {
+            w->overflow = 1;
+            return;
+        }
+        uint8_t byte = v & 0x7f;
+        v >>= 7;
+        *w->out++ = byte | (v ? 0x80 : 0);
+    } while (v);
+}
+
+/**
+ * @brief 写出一个像素值(小端)
+ */
+static inline void frame_delta_put_color(frame_delta_writer_t* w, framebuffer_color_t c)
+{
+    if (w->out + COLOR_SIZE > w->end) {
+        w->overflow = 1;
+        return;
+    }
+    *w->out++ = c & 0xff;
+    *w->out++ = c >> 8;
+}
+
+/**
+ * @brief 输出缓存的 literal token
+ */
+static void frame_delta_flush_literal(frame_delta_writer_t* w)
+{
+    if (!w->lit_count)
+        return;
+    frame_delta_put_varint(w, (w->lit_count << 2) | FRAME_DELTA_LITERAL);
+    for (size_t i = 0; i < w->lit_count; ++i)
+        frame_delta_put_color(w, w->lit[i]);
+    w->lit_count = 0;
+}
+
+/**
+ * @brief 输出一段相同值的游程
+ */
+static void frame_delta_put_run(frame_delta_writer_t* w, framebuffer_color_t v, size_t n)
+{
+    if (!v && n >= 2) {
+        frame_delta_flush_literal(w);
+        frame_delta_put_varint(w, (n << 2) | FRAME_DELTA_SKIP);
+        return;
+    }
+    if (v && n >= 3) {
+        frame_delta_flush_literal(w);
+        frame_delta_put_varint(w, (n << 2) | FRAME_DELTA_REPEAT);
+        frame_delta_put_color(w, v);
+        return;
+    }
+    while (n--) {
+        w->lit[w->lit_count++] = v;
+        if (w->lit_count == FRAME_DELTA_LITERAL_MAX)
+            frame_delta_flush_literal(w);
+    }
+}
+
+/**
+ * 对矩形区域做 XOR + 游程编码。
+ *
+ * @param cur 当前帧。
+ * @param ref 参考帧, 为 NULL 时按全黑帧处理。
+ * @param stride 帧每行像素个数。
+ * @param r 要编码的矩形。
+ * @param out 输出缓冲区。
+ * @param out_size 输出缓冲区大小。
+ * @return 成功返回编码后的字节数，失败返回 0。
+ */
+size_t frame_delta_encode(const framebuffer_color_t* cur, const framebuffer_color_t* ref,
+    size_t stride, const frame_rect_t* r, uint8_t* out, size_t out_size)
+{
+    assert(cur && r && out && "arg failed!");
+
+    frame_delta_writer_t w;
+    w.out = out;
+    w.end = out + out_size;
+    w.overflow = 0;
+    w.lit_count = 0;
+
+    framebuffer_color_t run_v = 0;
+    size_t run_n = 0;
+
+    for (uint32_t y = r->y; y < r->y + r->h; ++y) {
+        const framebuffer_color_t* c = cur + y * stride + r->x;
+        const framebuffer_color_t* p = ref ? ref + y * stride + r->x : NULL;
+        for (uint32_t x = 0; x < r->w; ++x) {
+            framebuffer_color_t v = p ? c[x] ^ p[x] : c[x];
+            if (run_n && v == run_v) {
+                ++run_n;
+                continue;
+            }
+            if (run_n)
+                frame_delta_put_run(&w, run_v, run_n);
+            run_v = v;
+            run_n = 1;
+        }
+        if (w.overflow)
+            return 0;
+    }
+    if (run_n)
+        frame_delta_put_run(&w, run_v, run_n);
+    frame_delta_flush_literal(&w);
+
+    if (w.overflow) {
+        LOG_ERR("delta overflow, out size(%zu)", out_size);
+        return 0;
+    }
+    return w.out - out;
+}
+
+/**
+ * @brief 读取一个 varint
+ *
+ * @return 成功返回 0，数据不足返回 -1
+ */
+static inline int frame_delta_get_varint(const uint8_t** in, const uint8_t* end, size_t* v)
+{
+    size_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (*in >= end)
+            return -1;
+        uint8_t byte = *(*in)++;
+        value |= (size_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *v = value;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * 把编码数据 XOR 回帧中的矩形区域。
+ *
+ * @param frame 要还原的帧, 内容应为编码时的参考帧。
+ * @param width 帧宽。
+ * @param height 帧高。
+ * @param stride 帧每行像素个数。
+ * @param r 编码时使用的矩形, 超出帧的范围视为数据损坏。
+ * @param in 编码数据。
+ * @param in_size 编码数据大小。
+ * @return 成功返回 0，数据损坏返回 -1。
+ */
+int frame_delta_apply(framebuffer_color_t* frame, size_t width, size_t height, size_t stride,
+    const frame_rect_t* r, const uint8_t* in, size_t in_size)
+{
+    assert(frame && r && (in || !in_size) && width <= stride && "arg failed!");
+    if (frame_rect_empty(r))
+        return in_size ? -1 : 0;
+    // 矩形来自文件或网络, 不可信
+    if (!frame_rect_inside(r, width, height)) {
+        LOG_ERR("delta rect(%u, %u, %u, %u) out of frame(%zux%zu)", r->x, r->y, r->w, r->h, width, height);
+        return -1;
+    }
+
+    const uint8_t* end = in + in_size;
+    size_t total = (size_t)r->w * r->h;
+    size_t pos = 0;
+    uint32_t col = 0;
+    framebuffer_color_t* row = frame + (size_t)r->y * stride + r->x;
+
+    while (in < end) {
+        size_t header = 0;
+        if (frame_delta_get_varint(&in, end, &header) < 0) {
+            LOG_ERR("bad delta header");
+            return -1;
+        }
+        size_t kind = header & 3;
+        size_t n = header >> 2;
+        if (n > total - pos) {
+            LOG_ERR("delta run overflow: %zu > %zu", n, total - pos);
+            return -1;
+        }
+
+        framebuffer_color_t v = 0;
+        if (kind == FRAME_DELTA_SKIP) {
+            pos += n;
+            col += n % r->w;
+            row += n / r->w * stride;
+            if (col >= r->w) {
+                col -= r->w;
+                row += stride;
+            }
+            continue;
+        }
+        if (kind == FRAME_DELTA_REPEAT) {
+            if (end - in < (ptrdiff_t)COLOR_SIZE)
+                return -1;
+            v = in[0] | (in[1] << 8);
+            in += COLOR_SIZE;
+        } else if (kind != FRAME_DELTA_LITERAL || (size_t)(end - in) < n * COLOR_SIZE) {
+            LOG_ERR("bad delta token kind(%zu) n(%zu)", kind, n);
+            return -1;
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            if (kind == FRAME_DELTA_LITERAL) {
+                v = in[0] | (in[1] << 8);
+                in += COLOR_SIZE;
+            }
+            row[col] ^= v;
+            if (++col == r->w) {
+                col = 0;
+                row += stride;
+            }
+        }
+        pos += n;
+    }
+
+    return pos == total ? 0 : -1;
+}
+
+/**
+ * 把 RGB565 帧保存为 PPM(P6) 图片。
+ *
+ * @param path 输出文件路径。
+ * @param frame 帧数据。
+ * @param width 帧宽。
+ * @param height 帧高。
+ * @param stride 帧每行像素个数。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int frame_write_ppm(const char* path, const framebuffer_color_t* frame,
+    size_t width, size_t height, size_t stride)
+{
+    FILE* fp = fopen(path, "wb");
+    if (!fp) {
+        LOG_ERR("fail to open %s", path);
+        return -1;
+    }
+    fprintf(fp, "P6\n%zu %zu\n255\n", width, height);
+
+    uint8_t* line = (uint8_t*)malloc(width * 3);
+    if (!line) {
+        fclose(fp);
+        return -1;
+    }
+    for (size_t y = 0; y < height; ++y) {
+        const framebuffer_color_t* src = frame + y * stride;
+        for (size_t x = 0; x < width; ++x) {
+            uint8_t r = (src[x] >> 11) & 0x1f;
+            uint8_t g = (src[x] >> 5) & 0x3f;
+            uint8_t b = src[x] & 0x1f;
+            line[x * 3 + 0] = (r << 3) | (r >> 2);
+            line[x * 3 + 1] = (g << 2) | (g >> 4);
+            line[x * 3 + 2] = (b << 3) | (b >> 2);
+        }
+        fwrite(line, 3, width, fp);
+    }
+    free(line);
+
+    return fclose(fp) ? -1 : 0;
+}
@@ -0,0 +1,128 @@
+#ifndef __FRAME_DELTA_H__
+#define __FRAME_DELTA_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "framebuffer.h"
+
+// 功能: 帧差分编解码, 把矩形区域内 当前帧 XOR 参考帧 的结果做游程编码.
+//
+// 编码流由若干 token 组成, 矩形内像素按行展开成一维序列:
+//   header = varint((count << 2) | kind)
+//   kind == FRAME_DELTA_SKIP    : count 个像素 XOR 为 0 (未变化), 无数据
+//   kind == FRAME_DELTA_LITERAL : 后跟 count 个 uint16 XOR 值
+//   kind == FRAME_DELTA_REPEAT  : 后跟 1 个 uint16 XOR 值, 重复 count 次
+// 参考帧为 NULL 时等价于与全黑帧做 XOR, 解码前先把矩形清零即可还原.
+
+#define FRAME_DELTA_SKIP (0)
+#define FRAME_DELTA_LITERAL (1)
+#define FRAME_DELTA_REPEAT (2)
+
+typedef struct frame_rect_t {
+    uint32_t x;  // 矩形左上角 x
+    uint32_t y;  // 矩形左上角 y
+    uint32_t w;  // 矩形宽
+    uint32_t h;  // 矩形高
+} frame_rect_t;
+
+/**
+ * 判断矩形是否为空。
+ *
+ * @param r 指向矩形的指针。
+ * @return 为空返回 1，否则返回 0。
+ */
+static inline int frame_rect_empty(const frame_rect_t* r)
+{
+    return !r->w || !r->h;
+}
+
+/**
+ * 判断矩形是否完全在 width x height 的范围内, 按 64 位计算, 宽高很大时不会回绕。
+ *
+ * @param r 指向矩形的指针。
+ * @param width 范围宽度。
+ * @param height 范围高度。
+ * @return 在范围内返回 1，否则返回 0。
+ */
+static inline int frame_rect_inside(const frame_rect_t* r, size_t width, size_t height)
+{
+    return (uint64_t)r->x + r->w <= width && (uint64_t)r->y + r->h <= height;
+}
+
+/**
+ * 把矩形 r 合并到 dst 中, 结果为两者的包围盒。
+ *
+ * @param dst 被合并的矩形。
+ * @param r 要合并进来的矩形。
+ */
+void frame_rect_union(frame_rect_t* dst, const frame_rect_t* r);
+
+/**
+ * 把矩形裁剪到 width x height 的范围内, 只缩小宽高, 起点在范围外时为空矩形。
+ *
+ * @param r 要裁剪的矩形。
+ * @param width 范围宽度。
+ * @param height 范围高度。
+ */
+void frame_rect_clip(frame_rect_t* r, size_t width, size_t height);
+
+/**
+ * 获取矩形编码结果的最大字节数。
+ *
+ * @param r 指向矩形的指针。
+ * @return 编码输出缓冲区至少需要的字节数。
+ */
+size_t frame_delta_bound(const frame_rect_t* r);
+
+/**
+ * 对矩形区域做 XOR + 游程编码。
+ *
+ * @param cur 当前帧。
+ * @param ref 参考帧, 为 NULL 时按全黑帧处理。
+ * @param stride 帧每行像素个数。
+ * @param r 要编码的矩形。
+ * @param out 输出缓冲区。
+ * @param out_size 输出缓冲区大小。
+ * @return 成功返回编码后的字节数，失败返回 0。
+ */
+size_t frame_delta_encode(const framebuffer_color_t* cur, const framebuffer_color_t* ref,
+    size_t stride, const frame_rect_t* r, uint8_t* out, size_t out_size);
+
+/**
+ * 把编码数据 XOR 回帧中的矩形区域。
+ *
+ * @param frame 要还原的帧, 内容应为编码时的参考帧。
+ * @param width 帧宽。
+ * @param height 帧高。
+ * @param stride 帧每行像素个数。
+ * @param r 编码时使用的矩形, 超出帧的范围视为数据损坏。
+ * @param in 编码数据。
+ * @param in_size 编码数据大小。
+ * @return 成功返回 0，数据损坏返回 -1。
+ */
+int frame_delta_apply(framebuffer_color_t* frame, size_t width, size_t height, size_t stride,
+    const frame_rect_t* r, const uint8_t* in, size_t in_size);
+
+/**
+ * 把 RGB565 帧保存为 PPM(P6) 图片。
+ *
+ * @param path 输出文件路径。
+ * @param frame 帧数据。
+ * @param width 帧宽。
+ * @param height 帧高。
+ * @param stride 帧每行像素个数。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int frame_write_ppm(const char* path, const framebuffer_color_t* frame,
+    size_t width, size_t height, size_t stride);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__FRAME_DELTA_H__
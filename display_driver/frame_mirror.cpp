@@ -0,0 +1,617 @@
+#include <arpa/inet.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "frame_mirror.h"
+
+#define FRAME_MIRROR_UNIX_PREFIX "unix:"
+#define FRAME_MIRROR_TCP_PREFIX "tcp:"
+#define FRAME_MIRROR_BACKLOG (4)
+
+typedef struct frame_mirror_client_t {
+    int fd;               // 客户端套接字, -1 为空闲
+    frame_rect_t damage;  // 客户端尚未收到的变化区域
+    uint8_t* out;         // 发送缓存
+    size_t out_len;       // 发送缓存中数据长度
+    size_t out_off;       // 已发送长度
+} frame_mirror_client_t;
+
+typedef struct frame_mirror_t {
+    int listen_fd;                // 监听套接字
+    int event_fd;                 // 通知服务线程有新变化
+    pthread_t thread;             // 服务线程
+    int thread_running;           // 服务线程是否已启动
+    int stop;                     // 通知服务线程退出
+    char unix_path[sizeof(((struct sockaddr_un*)0)->sun_path)]; // Unix 套接字路径, 退出时删除
+    size_t width;                 // 画面宽
+    size_t height;                // 画面高
+    size_t out_size;              // 每个客户端发送缓存大小
+    pthread_mutex_t lock;         // 保护 stage 和 damage, 两个线程都只在拷贝变化区域时持有
+    framebuffer_color_t* stage;   // 渲染线程提交的最新画面
+    frame_rect_t damage;          // 服务线程尚未取走的变化区域
+    framebuffer_color_t* frame;   // 服务线程编码用的画面, 只由服务线程访问
+    frame_mirror_client_t clients[FRAME_MIRROR_MAX_CLIENTS]; // 客户端
+} frame_mirror_t;
+
+/**
+ * @brief 解析地址并创建对应类型的套接字地址
+ *
+ * @param addr 地址字符串
+ * @param sa 输出套接字地址
+ * @param len 输出套接字地址长度
+ * @return 成功返回地址族，失败返回 -1
+ */
+static int frame_mirror_parse_addr(const char* addr, struct sockaddr_storage* sa, socklen_t* len)
+{
+    memset(sa, 0, sizeof(*sa));
+
+    if (0 == strncmp(addr, FRAME_MIRROR_UNIX_PREFIX, strlen(FRAME_MIRROR_UNIX_PREFIX))) {
+        struct sockaddr_un* un = (struct sockaddr_un*)sa;
+        const char* path = addr + strlen(FRAME_MIRROR_UNIX_PREFIX);
+        if (!*path || strlen(path) >= sizeof(un->sun_path)) {
+            LOG_ERR("bad unix socket path: %s", path);
+            return -1;
+        }
+        un->sun_family = AF_UNIX;
+        strcpy(un->sun_path, path);
+        *len = sizeof(struct sockaddr_un);
+        return AF_UNIX;
+    }
+
+    if (0 == strncmp(addr, FRAME_MIRROR_TCP_PREFIX, strlen(FRAME_MIRROR_TCP_PREFIX))) {
+        struct sockaddr_in* in = (struct sockaddr_in*)sa;
+        const char* host_port = addr + strlen(FRAME_MIRROR_TCP_PREFIX);
+        const char* colon = strrchr(host_port, ':');
+        char host[256] = "0.0.0.0";
+        const char* port = host_port;
+        if (colon) {
+            size_t host_len = colon - host_port;
+            if (host_len >= sizeof(host))
+                return -1;
+            memcpy(host, host_port, host_len);
+            host[host_len] = '\0';
+            port = colon + 1;
+        }
+        in->sin_family = AF_INET;
+        in->sin_port = htons((uint16_t)atoi(port));
+        if (1 != inet_pton(AF_INET, host, &in->sin_addr)) {
+            LOG_ERR("bad tcp host: %s", host);
+            return -1;
+        }
+        *len = sizeof(struct sockaddr_in);
+        return AF_INET;
+    }
+
+    LOG_ERR("unknow mirror addr: %s", addr);
+    return -1;
+}
+
+/**
+ * 按地址连接镜像服务, 供客户端使用。
+ *
+ * @param addr 服务地址, 格式同 frame_mirror_init。
+ * @return 成功返回套接字，失败返回 -1。
+ */
+int frame_mirror_connect(const char* addr)
+{
+    struct sockaddr_storage sa;
+    socklen_t len = 0;
+    int family = frame_mirror_parse_addr(addr, &sa, &len);
+    if (family < 0)
+        return -1;
+
+    int fd = socket(family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr*)&sa, len) < 0) {
+        LOG_ERR("fail to connect %s: %s", addr, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief 断开客户端
+ */
+static void frame_mirror_client_close(frame_mirror_client_t* c)
+{
+    if (c->fd >= 0) {
+        close(c->fd);
+        c->fd = -1;
+    }
+    free(c->out);
+    c->out = NULL;
+    c->out_len = c->out_off = 0;
+}
+
+/**
+ * @brief 按行拷贝画面中的一块区域
+ */
+static void frame_mirror_copy_rect(framebuffer_color_t* dst, const framebuffer_color_t* src, size_t width, const frame_rect_t* r)
+{
+    for (uint32_t y = r->y; y < r->y + r->h; ++y) {
+        size_t offset = y * width + r->x;
+        memcpy(dst + offset, src + offset, r->w * COLOR_SIZE);
+    }
+}
+
+/**
+ * @brief 接受新客户端, 首帧发送完整画面
+ */
+static void frame_mirror_accept(frame_mirror_t* m)
+{
+    int fd = accept4(m->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    frame_mirror_client_t* c = NULL;
+    for (size_t i = 0; i < FRAME_MIRROR_MAX_CLIENTS; ++i) {
+        if (m->clients[i].fd < 0) {
+            c = &m->clients[i];
+            break;
+        }
+    }
+    if (!c) {
+        LOG_ERR("too many mirror clients, drop new one");
+        close(fd);
+        return;
+    }
+
+    c->out = (uint8_t*)malloc(m->out_size);
+    if (!c->out) {
+        close(fd);
+        return;
+    }
+    c->fd = fd;
+
+    frame_record_file_t* hello = (frame_record_file_t*)c->out;
+    memset(hello, 0, sizeof(*hello));
+    memcpy(hello->magic, FRAME_MIRROR_MAGIC, sizeof(hello->magic));
+    hello->width = m->width;
+    hello->height = m->height;
+    hello->format = FRAME_RECORD_FORMAT_RGB565;
+    c->out_len = sizeof(*hello);
+    c->out_off = 0;
+
+    c->damage.x = c->damage.y = 0;
+    c->damage.w = m->width;
+    c->damage.h = m->height;
+
+    LOG_DBG("mirror(%p) client %d connected", m, fd);
+}
+
+/**
+ * @brief 把客户端积累的变化区域编码进发送缓存, 只在发送缓存为空时调用
+ */
+static void frame_mirror_client_encode(frame_mirror_t* m, frame_mirror_client_t* c)
+{
+    frame_record_hdr_t* hdr = (frame_record_hdr_t*)c->out;
+
+    size_t len = frame_delta_encode(m->frame, NULL, m->width, &c->damage,
+        c->out + sizeof(*hdr), m->out_size - sizeof(*hdr));
+    if (!len) {
+        frame_mirror_client_close(c);
+        return;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    hdr->magic = FRAME_RECORD_HDR_MAGIC;
+    hdr->size = len;
+    hdr->timestamp_us = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    hdr->rect = c->damage;
+    c->out_len = sizeof(*hdr) + len;
+    c->out_off = 0;
+    c->damage.w = c->damage.h = 0;
+}
+
+/**
+ * @brief 尽量发送客户端缓存中的数据, 不会阻塞
+ */
+static void frame_mirror_client_send(frame_mirror_t* m, frame_mirror_client_t* c)
+{
+    for (;;) {
+        if (c->out_off == c->out_len) {
+            c->out_len = c->out_off = 0;
+            if (frame_rect_empty(&c->damage))
+                return;
+            frame_mirror_client_encode(m, c);
+            if (c->fd < 0)
+                return;
+        }
+        ssize_t ret = send(c->fd, c->out + c->out_off, c->out_len - c->out_off, MSG_NOSIGNAL);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_DBG("mirror client %d closed: %s", c->fd, strerror(errno));
+                frame_mirror_client_close(c);
+            }
+            return;
+        }
+        c->out_off += ret;
+    }
+}
+
+/**
+ * @brief 服务线程: 接受客户端并发送变化区域
+ *
+ * @param arg 指向镜像服务的指针
+ */
+static void* frame_mirror_server(void* arg)
+{
+    frame_mirror_t* m = (frame_mirror_t*)arg;
+    struct pollfd pfds[2 + FRAME_MIRROR_MAX_CLIENTS];
+
+    while (!__atomic_load_n(&m->stop, __ATOMIC_ACQUIRE)) {
+        size_t n = 0;
+        pfds[n++] = (struct pollfd) { m->listen_fd, POLLIN, 0 };
+        pfds[n++] = (struct pollfd) { m->event_fd, POLLIN, 0 };
+        for (size_t i = 0; i < FRAME_MIRROR_MAX_CLIENTS; ++i) {
+            frame_mirror_client_t* c = &m->clients[i];
+            short events = POLLIN;
+            if (c->fd >= 0 && c->out_off < c->out_len)
+                events |= POLLOUT;
+            pfds[n++] = (struct pollfd) { c->fd, events, 0 };
+        }
+
+        if (poll(pfds, n, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            LOG_ERR("mirror poll fail: %s", strerror(errno));
+            break;
+        }
+
+        if (pfds[0].revents & POLLIN)
+            frame_mirror_accept(m);
+
+        if (pfds[1].revents & POLLIN) {
+            uint64_t count = 0;
+            read(m->event_fd, &count, sizeof(count));
+
+            // 取走渲染线程提交的变化区域, 编码期间不持锁
+            pthread_mutex_lock(&m->lock);
+            frame_rect_t damage = m->damage;
+            m->damage.w = m->damage.h = 0;
+            frame_mirror_copy_rect(m->frame, m->stage, m->width, &damage);
+            pthread_mutex_unlock(&m->lock);
+
+            for (size_t i = 0; i < FRAME_MIRROR_MAX_CLIENTS; ++i) {
+                if (m->clients[i].fd >= 0)
+                    frame_rect_union(&m->clients[i].damage, &damage);
+            }
+        }
+
+        for (size_t i = 0; i < FRAME_MIRROR_MAX_CLIENTS; ++i) {
+            frame_mirror_client_t* c = &m->clients[i];
+            short revents = pfds[2 + i].revents;
+            if (c->fd < 0 || c->fd != pfds[2 + i].fd)
+                continue;
+            if (revents & (POLLIN | POLLERR | POLLHUP)) {
+                // 客户端不应发送数据, 读到 EOF 或错误即断开
+                char drain[256];
+                ssize_t ret = recv(c->fd, drain, sizeof(drain), MSG_DONTWAIT);
+                if (ret == 0 || (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+                    LOG_DBG("mirror client %d disconnected", c->fd);
+                    frame_mirror_client_close(c);
+                    continue;
+                }
+            }
+            frame_mirror_client_send(m, c);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * 提交一帧的变化区域, 由服务线程异步发送给各客户端。
+ * 变化区域先拷贝到暂存画面, 服务线程编码时不持锁, 不会阻塞渲染线程。
+ *
+ * @param m 指向镜像服务的指针。
+ * @param frame 当前帧, 大小为 width * height。
+ * @param dirty 本次刷新变化的区域。
+ * @return 提交成功返回 0，无变化返回 1。
+ */
+int frame_mirror_push(frame_mirror_t* m, const framebuffer_color_t* frame, const frame_rect_t* dirty)
+{
+    assert(m && frame && dirty && "arg failed!");
+
+    frame_rect_t r = *dirty;
+    frame_rect_clip(&r, m->width, m->height);
+    if (frame_rect_empty(&r))
+        return 1;
+
+    pthread_mutex_lock(&m->lock);
+    frame_mirror_copy_rect(m->stage, frame, m->width, &r);
+    frame_rect_union(&m->damage, &r);
+    pthread_mutex_unlock(&m->lock);
+
+    uint64_t one = 1;
+    write(m->event_fd, &one, sizeof(one));
+
+    return 0;
+}
+
+/**
+ * 停止服务线程, 断开所有客户端并释放镜像服务。
+ *
+ * @param m 指向镜像服务的指针。
+ */
+void frame_mirror_exit(frame_mirror_t* m)
+{
+    if (!m)
+        return;
+
+    if (m->thread_running) {
+        __atomic_store_n(&m->stop, 1, __ATOMIC_RELEASE);
+        uint64_t one = 1;
+        write(m->event_fd, &one, sizeof(one));
+        pthread_join(m->thread, NULL);
+        m->thread_running = 0;
+    }
+    for (size_t i = 0; i < FRAME_MIRROR_MAX_CLIENTS; ++i)
+        frame_mirror_client_close(&m->clients[i]);
+    if (m->listen_fd >= 0) {
+        close(m->listen_fd);
+        m->listen_fd = -1;
+    }
+    if (m->unix_path[0])
+        unlink(m->unix_path);
+    if (m->event_fd >= 0) {
+        close(m->event_fd);
+        m->event_fd = -1;
+    }
+    pthread_mutex_destroy(&m->lock);
+    free(m->stage);
+    free(m->frame);
+    free(m);
+}
+
+/**
+ * 创建镜像服务并启动服务线程。
+ *
+ * @param addr 监听地址。
+ * @param frame 当前画面, 大小为 width * height, 作为新客户端的首帧。
+ * @param width 画面宽。
+ * @param height 画面高。
+ * @return 成功返回镜像服务指针，失败返回 NULL。
+ */
+frame_mirror_t* frame_mirror_init(const char* addr, const framebuffer_color_t* frame, size_t width, size_t height)
+{
+    assert(addr && frame && width && height && "arg failed!");
+
+    struct sockaddr_storage sa;
+    socklen_t sa_len = 0;
+    int family = frame_mirror_parse_addr(addr, &sa, &sa_len);
+    if (family < 0)
+        return NULL;
+
+    frame_mirror_t* m = (frame_mirror_t*)malloc(sizeof(frame_mirror_t));
+    if (!m) {
+        LOG_ERR("fail to malloc mirror");
+        return NULL;
+    }
+    memset(m, 0, sizeof(frame_mirror_t));
+    m->listen_fd = -1;
+    m->event_fd = -1;
+    m->width = width;
+    m->height = height;
+    pthread_mutex_init(&m->lock, NULL);
+    for (size_t i = 0; i < FRAME_MIRROR_MAX_CLIENTS; ++i)
+        m->clients[i].fd = -1;
+
+    frame_rect_t full = { 0, 0, (uint32_t)width, (uint32_t)height };
+    m->out_size = sizeof(frame_record_hdr_t) + frame_delta_bound(&full);
+    m->stage = (framebuffer_color_t*)malloc(width * height * COLOR_SIZE);
+    m->frame = (framebuffer_color_t*)malloc(width * height * COLOR_SIZE);
+    if (!m->stage || !m->frame) {
+        LOG_ERR("fail to malloc mirror frame");
+        goto err;
+    }
+    memcpy(m->stage, frame, width * height * COLOR_SIZE);
+    memcpy(m->frame, frame, width * height * COLOR_SIZE);
+
+    m->listen_fd = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m->listen_fd < 0) {
+        LOG_ERR("fail to create mirror socket: %s", strerror(errno));
+        goto err;
+    }
+    if (family == AF_UNIX) {
+        strcpy(m->unix_path, ((struct sockaddr_un*)&sa)->sun_path);
+        unlink(m->unix_path);
+    } else {
+        int on = 1;
+        setsockopt(m->listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    }
+    if (bind(m->listen_fd, (struct sockaddr*)&sa, sa_len) < 0
+        || listen(m->listen_fd, FRAME_MIRROR_BACKLOG) < 0) {
+        LOG_ERR("fail to listen %s: %s", addr, strerror(errno));
+        m->unix_path[0] = '\0';
+        goto err;
+    }
+
+    m->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m->event_fd < 0) {
+        LOG_ERR("fail to create eventfd: %s", strerror(errno));
+        goto err;
+    }
+
+    if (pthread_create(&m->thread, NULL, frame_mirror_server, m)) {
+        LOG_ERR("fail to create mirror server");
+        goto err;
+    }
+    m->thread_running = 1;
+
+    LOG_DBG("mirror(%p) %zux%zu listen on %s", m, width, height, addr);
+
+    return m;
+err:
+    frame_mirror_exit(m);
+    return NULL;
+}
+
+#ifdef __FRAME_MIRROR_XTEST__
+
+char g_dbg_enable = 1;
+
+#define TEST_W (64)
+#define TEST_H (32)
+
+static int test_read_full(int fd, void* buf, size_t len)
+{
+    uint8_t* p = (uint8_t*)buf;
+    while (len) {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 1000) <= 0)
+            return -1;
+        ssize_t ret = read(fd, p, len);
+        if (ret <= 0)
+            return -1;
+        p += ret;
+        len -= ret;
+    }
+    return 0;
+}
+
+/**
+ * 收一次更新并还原到内存帧缓冲区
+ */
+static int test_receive(int fd, framebuffer_t* fb, uint8_t* payload, size_t payload_size)
+{
+    frame_record_hdr_t hdr;
+    if (test_read_full(fd, &hdr, sizeof(hdr)) < 0)
+        return -1;
+    assert(hdr.magic == FRAME_RECORD_HDR_MAGIC && hdr.size <= payload_size);
+    assert(0 == test_read_full(fd, payload, hdr.size));
+
+    framebuffer_color_t* screen = (framebuffer_color_t*)fb->screen;
+    size_t stride = fb->line_length / COLOR_SIZE;
+    const frame_rect_t* r = &hdr.rect;
+    assert(r->x + r->w <= TEST_W && r->y + r->h <= TEST_H);
+    for (uint32_t y = r->y; y < r->y + r->h; ++y)
+        memset(screen + y * stride + r->x, 0, r->w * COLOR_SIZE);
+    assert(0 == frame_delta_apply(screen, fb->width, fb->height, stride, r, payload, hdr.size));
+    return 0;
+}
+
+static int test_same(const framebuffer_color_t* frame, const framebuffer_t* fb)
+{
+    for (size_t y = 0; y < TEST_H; ++y) {
+        if (memcmp(frame + y * TEST_W, (const uint8_t*)fb->screen + y * fb->line_length, TEST_W * COLOR_SIZE))
+            return 0;
+    }
+    return 1;
+}
+
+static void test_push(frame_mirror_t* m, const framebuffer_color_t* frame, uint32_t x, uint32_t y, uint32_t w, uint32_t h)
+{
+    frame_rect_t r = { x, y, w, h };
+    assert(0 == frame_mirror_push(m, frame, &r));
+}
+
+/**
+ * 收更新直到与最终画面一致, 中间的更新可能被合并
+ */
+static int test_receive_until_same(int fd, framebuffer_t* fb, uint8_t* payload, size_t payload_size, const framebuffer_color_t* frame)
+{
+    int same = 0;
+    while (!same && 0 == test_receive(fd, fb, payload, payload_size))
+        same = test_same(frame, fb);
+    return same;
+}
+
+/**
+ * 模拟服务线程正在取变化区域, 持锁一段时间后释放
+ */
+static int s_lock_held = 0;
+
+static void* test_hold_lock(void* arg)
+{
+    frame_mirror_t* m = (frame_mirror_t*)arg;
+    pthread_mutex_lock(&m->lock);
+    __atomic_store_n(&s_lock_held, 1, __ATOMIC_RELEASE);
+    usleep(50 * 1000);
+    pthread_mutex_unlock(&m->lock);
+    return NULL;
+}
+
+int main(void)
+{
+    const char* addr = "unix:/tmp/frame_mirror_test.sock";
+    framebuffer_color_t frame[TEST_W * TEST_H];
+    for (size_t i = 0; i < TEST_W * TEST_H; ++i)
+        frame[i] = (framebuffer_color_t)(i * 37);
+
+    frame_mirror_t* m = frame_mirror_init(addr, frame, TEST_W, TEST_H);
+    assert(m);
+    assert(frame_mirror_connect("bad:addr") < 0);
+    int fd = frame_mirror_connect(addr);
+    assert(fd >= 0);
+
+    frame_record_file_t hello;
+    assert(0 == test_read_full(fd, &hello, sizeof(hello)));
+    assert(0 == memcmp(hello.magic, FRAME_MIRROR_MAGIC, sizeof(hello.magic)));
+    assert(hello.width == TEST_W && hello.height == TEST_H && hello.format == FRAME_RECORD_FORMAT_RGB565);
+
+    framebuffer_t* fb = framebuffer_init("mem:64x32");
+    assert(fb && fb->width == TEST_W && fb->height == TEST_H);
+    frame_rect_t full = { 0, 0, TEST_W, TEST_H };
+    size_t payload_size = frame_delta_bound(&full);
+    uint8_t* payload = (uint8_t*)malloc(payload_size);
+    assert(payload);
+
+    // 首帧是完整画面
+    assert(0 == test_receive(fd, fb, payload, payload_size));
+    assert(test_same(frame, fb));
+
+    // 之后只发送变化区域, 没有变化不发送
+    frame_rect_t none = { 0, 0, 0, 0 };
+    assert(1 == frame_mirror_push(m, frame, &none));
+    for (int round = 0; round < 20; ++round) {
+        uint32_t x = round * 3 % (TEST_W - 8), y = round * 5 % (TEST_H - 4);
+        for (uint32_t j = y; j < y + 4; ++j)
+            for (uint32_t i = x; i < x + 8; ++i)
+                frame[j * TEST_W + i] ^= (framebuffer_color_t)(0x1234 + round);
+        test_push(m, frame, x, y, 8, 4);
+    }
+    assert(test_receive_until_same(fd, fb, payload, payload_size, frame));
+
+    // 最后一次提交时服务线程忙, 之后不再提交, 客户端也要收到最终画面
+    pthread_t holder;
+    assert(0 == pthread_create(&holder, NULL, test_hold_lock, m));
+    while (!__atomic_load_n(&s_lock_held, __ATOMIC_ACQUIRE))
+        usleep(1000);
+    for (size_t i = 0; i < TEST_W * 4; ++i)
+        frame[i] = (framebuffer_color_t)~frame[i];
+    test_push(m, frame, 0, 0, TEST_W, 4);
+    pthread_join(holder, NULL);
+    assert(test_receive_until_same(fd, fb, payload, payload_size, frame));
+
+    close(fd);
+    free(payload);
+    framebuffer_exit(fb);
+    frame_mirror_exit(m);
+    assert(access("/tmp/frame_mirror_test.sock", F_OK) < 0);
+
+    printf("frame mirror test pass\n");
+    return 0;
+}
+
+#endif //__FRAME_MIRROR_XTEST__
@@ -0,0 +1,74 @@
+#ifndef __FRAME_MIRROR_H__
+#define __FRAME_MIRROR_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "frame_delta.h"
+#include "frame_recorder.h"
+#include "framebuffer.h"
+
+// 功能: 通过 Unix 域套接字或 TCP 把刷新画面实时镜像给远端.
+// 每次刷新只发送变化区域, 客户端发送不完时合并后续变化区域, 中间帧被丢弃,
+// 渲染线程只做一次区域拷贝, 服务线程忙时连拷贝也推迟到下一次刷新, 从不阻塞.
+// 参考客户端见 tools/mirror_client.cpp
+//
+// 协议(小端):
+//   服务端连接后先发送 frame_record_file_t, magic 为 FRAME_MIRROR_MAGIC
+//   之后不断发送 { frame_record_hdr_t, payload[hdr.size] }
+// payload 为参考帧为 NULL 的 frame_delta 编码, 客户端先把 rect 清零再 XOR 还原.
+//
+// 地址格式:
+//   unix:/path/to/socket
+//   tcp:port 或 tcp:host:port
+
+#define FRAME_MIRROR_MAGIC "AIMIMIR1"      // 镜像流魔数
+#define FRAME_MIRROR_MAX_CLIENTS (4)       // 最大客户端数
+
+struct frame_mirror_t;
+
+/**
+ * 创建镜像服务并启动服务线程。
+ *
+ * @param addr 监听地址。
+ * @param frame 当前画面, 大小为 width * height, 作为新客户端的首帧。
+ * @param width 画面宽。
+ * @param height 画面高。
+ * @return 成功返回镜像服务指针，失败返回 NULL。
+ */
+frame_mirror_t* frame_mirror_init(const char* addr, const framebuffer_color_t* frame, size_t width, size_t height);
+
+/**
+ * 停止服务线程, 断开所有客户端并释放镜像服务。
+ *
+ * @param m 指向镜像服务的指针。
+ */
+void frame_mirror_exit(frame_mirror_t* m);
+
+/**
+ * 提交一帧的变化区域, 由服务线程异步发送给各客户端。
+ *
+ * @param m 指向镜像服务的指针。
+ * @param frame 当前帧, 大小为 width * height。
+ * @param dirty 本次刷新变化的区域。
+ * @return 提交成功返回 0，无变化返回 1。
+ */
+int frame_mirror_push(frame_mirror_t* m, const framebuffer_color_t* frame, const frame_rect_t* dirty);
+
+/**
+ * 按地址连接镜像服务, 供客户端使用。
+ *
+ * @param addr 服务地址, 格式同 frame_mirror_init。
+ * @return 成功返回套接字，失败返回 -1。
+ */
+int frame_mirror_connect(const char* addr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__FRAME_MIRROR_H__
@@ -0,0 +1,361 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "frame_recorder.h"
+
+#define FRAME_RECORDER_IDLE_MS (100) // 写线程空闲等待时间
+
+typedef struct frame_recorder_t {
+    int fd;                      // 录像文件
+    int event_fd;                // 通知写线程有新数据
+    pthread_t thread;            // 写线程
+    int thread_running;          // 写线程是否已启动
+    int stop;                    // 通知写线程退出
+    uint8_t* ring;               // 写缓冲(环形)
+    size_t ring_size;            // 写缓冲大小, 2 的幂
+    size_t head;                 // 生产位置, 只由渲染线程写
+    size_t tail;                 // 消费位置, 只由写线程写
+    size_t width;                // 画面宽
+    size_t height;               // 画面高
+    framebuffer_color_t* prev;   // 上一条记录还原出的画面
+    frame_rect_t pending;        // 尚未记录的变化区域
+    uint8_t* scratch;            // 编码缓存
+    size_t scratch_size;         // 编码缓存大小
+    size_t dropped;              // 丢帧数
+} frame_recorder_t;
+
+/**
+ * @brief 写线程: 把写缓冲中的数据落盘
+ *
+ * @param arg 指向录像器的指针
+ */
+static void* frame_recorder_writer(void* arg)
+{
+    frame_recorder_t* rec = (frame_recorder_t*)arg;
+    size_t mask = rec->ring_size - 1;
+
+    for (;;) {
+        size_t head = __atomic_load_n(&rec->head, __ATOMIC_ACQUIRE);
+        size_t tail = rec->tail;
+        if (head == tail) {
+            if (__atomic_load_n(&rec->stop, __ATOMIC_ACQUIRE))
+                break;
+            struct pollfd pfd = { rec->event_fd, POLLIN, 0 };
+            if (poll(&pfd, 1, FRAME_RECORDER_IDLE_MS) > 0) {
+                uint64_t count = 0;
+                read(rec->event_fd, &count, sizeof(count));
+            }
+            continue;
+        }
+
+        size_t off = tail & mask;
+        size_t len = head - tail;
+        if (len > rec->ring_size - off)
+            len = rec->ring_size - off;
+        ssize_t ret = write(rec->fd, rec->ring + off, len);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            LOG_ERR("fail to write record: %s", strerror(errno));
+            ret = len; // 丢弃, 避免卡死生产者
+        }
+        __atomic_store_n(&rec->tail, tail + ret, __ATOMIC_RELEASE);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief 把数据拷贝到写缓冲, 调用前需确认空间足够
+ */
+static inline void frame_recorder_copy_in(frame_recorder_t* rec, size_t pos, const void* data, size_t len)
+{
+    size_t off = pos & (rec->ring_size - 1);
+    size_t first = rec->ring_size - off < len ? rec->ring_size - off : len;
+    memcpy(rec->ring + off, data, first);
+    memcpy(rec->ring, (const uint8_t*)data + first, len - first);
+}
+
+/**
+ * 记录一帧, 只编码 dirty 区域(和之前丢帧累积的区域)。
+ *
+ * @param rec 指向录像器的指针。
+ * @param frame 当前帧, 大小为 width * height。
+ * @param dirty 本次刷新变化的区域。
+ * @return 记录成功返回 0，无变化返回 1，缓冲区满丢帧返回 -1。
+ */
+int frame_recorder_push(frame_recorder_t* rec, const framebuffer_color_t* frame, const frame_rect_t* dirty)
+{
+    assert(rec && frame && dirty && "arg failed!");
+
+    frame_rect_union(&rec->pending, dirty);
+    frame_rect_clip(&rec->pending, rec->width, rec->height);
+    if (frame_rect_empty(&rec->pending))
+        return 1;
+
+    const frame_rect_t* r = &rec->pending;
+    size_t len = frame_delta_encode(frame, rec->prev, rec->width, r, rec->scratch, rec->scratch_size);
+    if (!len) {
+        ++rec->dropped;
+        return -1;
+    }
+
+    size_t head = rec->head;
+    size_t used = head - __atomic_load_n(&rec->tail, __ATOMIC_ACQUIRE);
+    if (used + sizeof(frame_record_hdr_t) + len > rec->ring_size) {
+        // 写线程跟不上, 丢弃本帧, 变化区域留到下次一起记录
+        ++rec->dropped;
+        return -1;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    frame_record_hdr_t hdr;
+    hdr.magic = FRAME_RECORD_HDR_MAGIC;
+    hdr.size = len;
+    hdr.timestamp_us = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    hdr.rect = *r;
+
+    frame_recorder_copy_in(rec, head, &hdr, sizeof(hdr));
+    frame_recorder_copy_in(rec, head + sizeof(hdr), rec->scratch, len);
+    __atomic_store_n(&rec->head, head + sizeof(hdr) + len, __ATOMIC_RELEASE);
+
+    uint64_t one = 1;
+    write(rec->event_fd, &one, sizeof(one));
+
+    for (uint32_t y = r->y; y < r->y + r->h; ++y) {
+        size_t offset = y * rec->width + r->x;
+        memcpy(rec->prev + offset, frame + offset, r->w * COLOR_SIZE);
+    }
+    rec->pending.w = rec->pending.h = 0;
+
+    return 0;
+}
+
+/**
+ * 获取因写缓冲区满而丢弃的帧数。
+ *
+ * @param rec 指向录像器的指针。
+ * @return 丢帧数。
+ */
+size_t frame_recorder_dropped(const frame_recorder_t* rec)
+{
+    return rec ? rec->dropped : 0;
+}
+
+/**
+ * 停止后台写线程, 写完缓冲区中的数据后释放录像器。
+ *
+ * @param rec 指向录像器的指针。
+ */
+void frame_recorder_exit(frame_recorder_t* rec)
+{
+    if (!rec)
+        return;
+
+    if (rec->thread_running) {
+        __atomic_store_n(&rec->stop, 1, __ATOMIC_RELEASE);
+        uint64_t one = 1;
+        write(rec->event_fd, &one, sizeof(one));
+        pthread_join(rec->thread, NULL);
+        rec->thread_running = 0;
+    }
+    if (rec->dropped)
+        LOG_DBG("recorder(%p) dropped %zu frames", rec, rec->dropped);
+    if (rec->event_fd >= 0) {
+        close(rec->event_fd);
+        rec->event_fd = -1;
+    }
+    if (rec->fd >= 0) {
+        close(rec->fd);
+        rec->fd = -1;
+    }
+    free(rec->ring);
+    free(rec->prev);
+    free(rec->scratch);
+    free(rec);
+}
+
+/**
+ * 创建录像器并启动后台写线程。
+ *
+ * @param path 录像文件路径, 已存在则覆盖。
+ * @param width 画面宽。
+ * @param height 画面高。
+ * @param ring_size 写缓冲大小, 0 使用默认值。
+ * @return 成功返回录像器指针，失败返回 NULL。
+ */
+frame_recorder_t* frame_recorder_init(const char* path, size_t width, size_t height, size_t ring_size)
+{
+    assert(path && width && height && "arg failed!");
+
+    frame_recorder_t* rec = (frame_recorder_t*)malloc(sizeof(frame_recorder_t));
+    if (!rec) {
+        LOG_ERR("fail to malloc recorder");
+        return NULL;
+    }
+    memset(rec, 0, sizeof(frame_recorder_t));
+    rec->fd = -1;
+    rec->event_fd = -1;
+    rec->width = width;
+    rec->height = height;
+
+    // 环形缓冲按 2 的幂取整, 至少能放下一帧完整画面
+    frame_rect_t full = { 0, 0, (uint32_t)width, (uint32_t)height };
+    rec->scratch_size = frame_delta_bound(&full);
+    size_t need = ring_size ? ring_size : FRAME_RECORDER_RING_SIZE;
+    if (need < rec->scratch_size + sizeof(frame_record_hdr_t))
+        need = rec->scratch_size + sizeof(frame_record_hdr_t);
+    rec->ring_size = 1;
+    while (rec->ring_size < need)
+        rec->ring_size <<= 1;
+
+    rec->ring = (uint8_t*)malloc(rec->ring_size);
+    rec->scratch = (uint8_t*)malloc(rec->scratch_size);
+    rec->prev = (framebuffer_color_t*)calloc(width * height, COLOR_SIZE);
+    if (!rec->ring || !rec->scratch || !rec->prev) {
+        LOG_ERR("fail to malloc recorder buffer, ring size(%zu)", rec->ring_size);
+        goto err;
+    }
+    // 第一帧参考全黑帧, 需要完整记录
+    rec->pending = full;
+
+    rec->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (rec->fd < 0) {
+        LOG_ERR("fail to open %s: %s", path, strerror(errno));
+        goto err;
+    }
+
+    frame_record_file_t file_hdr;
+    memset(&file_hdr, 0, sizeof(file_hdr));
+    memcpy(file_hdr.magic, FRAME_RECORD_FILE_MAGIC, sizeof(file_hdr.magic));
+    file_hdr.width = width;
+    file_hdr.height = height;
+    file_hdr.format = FRAME_RECORD_FORMAT_RGB565;
+    if (write(rec->fd, &file_hdr, sizeof(file_hdr)) != sizeof(file_hdr)) {
+        LOG_ERR("fail to write record header");
+        goto err;
+    }
+
+    rec->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (rec->event_fd < 0) {
+        LOG_ERR("fail to create eventfd: %s", strerror(errno));
+        goto err;
+    }
+
+    if (pthread_create(&rec->thread, NULL, frame_recorder_writer, rec)) {
+        LOG_ERR("fail to create record writer");
+        goto err;
+    }
+    rec->thread_running = 1;
+
+    LOG_DBG("recorder(%p) %zux%zu -> %s, ring(%zu)", rec, width, height, path, rec->ring_size);
+
+    return rec;
+err:
+    frame_recorder_exit(rec);
+    return NULL;
+}
+
+#ifdef __XTEST__
+
+char g_dbg_enable = 1;
+
+#define TEST_W (64)
+#define TEST_H (32)
+
+int main(void)
+{
+    const char* path = "/tmp/frame_recorder_test.rec";
+    framebuffer_color_t frames[3][TEST_W * TEST_H];
+    memset(frames, 0, sizeof(frames));
+    for (int i = 0; i < 8; ++i)
+        frames[0][5 * TEST_W + 10 + i] = COLOR_WHITE;
+    memcpy(frames[1], frames[0], sizeof(frames[0]));
+    for (int y = 20; y < 30; ++y)
+        for (int x = 40; x < 60; ++x)
+            frames[1][y * TEST_W + x] = COLOR_GREY;
+    memcpy(frames[2], frames[1], sizeof(frames[1]));
+    frames[2][5 * TEST_W + 12] = COLOR_BLACK;
+
+    frame_recorder_t* rec = frame_recorder_init(path, TEST_W, TEST_H, 0);
+    assert(rec);
+    frame_rect_t full = { 0, 0, TEST_W, TEST_H };
+    frame_rect_t box = { 40, 20, 20, 10 };
+    frame_rect_t dot = { 12, 5, 1, 1 };
+    frame_rect_t none = { 0, 0, 0, 0 };
+    assert(0 == frame_recorder_push(rec, frames[0], &full));
+    assert(0 == frame_recorder_push(rec, frames[1], &box));
+    assert(1 == frame_recorder_push(rec, frames[1], &none));
+    assert(0 == frame_recorder_push(rec, frames[2], &dot));
+    frame_recorder_exit(rec);
+
+    // 回放并与原始帧比较
+    FILE* fp = fopen(path, "rb");
+    assert(fp);
+    frame_record_file_t file_hdr;
+    assert(1 == fread(&file_hdr, sizeof(file_hdr), 1, fp));
+    assert(0 == memcmp(file_hdr.magic, FRAME_RECORD_FILE_MAGIC, 8));
+    assert(file_hdr.width == TEST_W && file_hdr.height == TEST_H);
+
+    framebuffer_color_t replay[TEST_W * TEST_H];
+    memset(replay, 0, sizeof(replay));
+    uint8_t payload[TEST_W * TEST_H * 4];
+    for (int i = 0; i < 3; ++i) {
+        frame_record_hdr_t hdr;
+        assert(1 == fread(&hdr, sizeof(hdr), 1, fp));
+        assert(hdr.magic == FRAME_RECORD_HDR_MAGIC && hdr.size <= sizeof(payload));
+        assert(hdr.size == fread(payload, 1, hdr.size, fp));
+        assert(0 == frame_delta_apply(replay, TEST_W, TEST_H, TEST_W, &hdr.rect, payload, hdr.size));
+        assert(0 == memcmp(replay, frames[i], sizeof(replay)));
+        printf("frame %d: rect(%u, %u, %u, %u) size(%u)\n",
+            i, hdr.rect.x, hdr.rect.y, hdr.rect.w, hdr.rect.h, hdr.size);
+
+        // 损坏的记录头: 矩形超出帧或者坐标溢出, 不能写到帧外
+        frame_rect_t bad[] = {
+            { hdr.rect.x, hdr.rect.y, TEST_W - hdr.rect.x + 1, hdr.rect.h },
+            { hdr.rect.x, TEST_H, hdr.rect.w, 1 },
+            { 0xffffffffu, hdr.rect.y, 2, hdr.rect.h },
+            { hdr.rect.x, 0xfffffff0u, hdr.rect.w, 0x20 },
+        };
+        for (size_t k = 0; k < sizeof(bad) / sizeof(bad[0]); ++k)
+            assert(-1 == frame_delta_apply(replay, TEST_W, TEST_H, TEST_W, &bad[k], payload, hdr.size));
+        assert(0 == memcmp(replay, frames[i], sizeof(replay)));
+    }
+    fclose(fp);
+    unlink(path);
+
+    // 宽高很大时裁剪和合并不能回绕
+    frame_rect_t wrap = { 50, 0, 0xfffffff0u, 10 };
+    assert(!frame_rect_inside(&wrap, TEST_W, TEST_H));
+    frame_rect_clip(&wrap, TEST_W, TEST_H);
+    assert(wrap.x == 50 && wrap.w == TEST_W - 50 && wrap.h == 10 && frame_rect_inside(&wrap, TEST_W, TEST_H));
+    frame_rect_t tall = { 0, 5, 4, 0xffffffffu };
+    frame_rect_clip(&tall, TEST_W, TEST_H);
+    assert(tall.h == TEST_H - 5 && frame_rect_inside(&tall, TEST_W, TEST_H));
+    frame_rect_t outside = { TEST_W, 0, 4, 4 };
+    frame_rect_clip(&outside, TEST_W, TEST_H);
+    assert(frame_rect_empty(&outside));
+    frame_rect_t u = { 10, 10, 2, 2 };
+    frame_rect_t huge = { 0xfffffff0u, 0, 0x20, 1 };
+    frame_rect_union(&u, &huge);
+    assert(u.x == 10 && u.w == UINT32_MAX && u.y == 0 && u.h == 12);
+    frame_rect_clip(&u, TEST_W, TEST_H);
+    assert(u.w == TEST_W - 10 && frame_rect_inside(&u, TEST_W, TEST_H));
+
+    printf("frame recorder test pass\n");
+    return 0;
+}
+
+#endif //__XTEST__
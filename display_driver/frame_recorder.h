@@ -0,0 +1,85 @@
+#ifndef __FRAME_RECORDER_H__
+#define __FRAME_RECORDER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "frame_delta.h"
+#include "framebuffer.h"
+
+// 功能: 把每次刷新的画面以差分形式追加写入录像文件, 用于复现现场显示内容.
+// 渲染线程只做编码和拷贝到环形缓冲区, 落盘由后台线程完成, 缓冲区满时丢帧不阻塞.
+// 回放/导出见 tools/frame_replay.cpp
+//
+// 文件格式(小端):
+//   frame_record_file_t
+//   { frame_record_hdr_t, payload[hdr.size] } * N
+// payload 为 frame_delta 编码, 参考帧为上一条记录还原出来的画面, 第一条参考全黑帧.
+
+#define FRAME_RECORD_FILE_MAGIC "AIMIFRM1"      // 录像文件魔数
+#define FRAME_RECORD_HDR_MAGIC (0x4d524652U)    // "RFRM" 单帧记录魔数
+#define FRAME_RECORD_FORMAT_RGB565 (565)        // 像素格式
+#define FRAME_RECORDER_RING_SIZE (2 * 1024 * 1024LU) // 默认写缓冲大小
+
+typedef struct frame_record_file_t {
+    char magic[8];     // FRAME_RECORD_FILE_MAGIC
+    uint32_t width;    // 画面宽
+    uint32_t height;   // 画面高
+    uint32_t format;   // 像素格式
+    uint32_t reserved; // 保留
+} frame_record_file_t;
+
+typedef struct frame_record_hdr_t {
+    uint32_t magic;        // FRAME_RECORD_HDR_MAGIC
+    uint32_t size;         // payload 大小
+    uint64_t timestamp_us; // 刷新时间(CLOCK_REALTIME, 微秒)
+    frame_rect_t rect;     // 变化区域
+} frame_record_hdr_t;
+
+struct frame_recorder_t;
+
+/**
+ * 创建录像器并启动后台写线程。
+ *
+ * @param path 录像文件路径, 已存在则覆盖。
+ * @param width 画面宽。
+ * @param height 画面高。
+ * @param ring_size 写缓冲大小, 0 使用默认值。
+ * @return 成功返回录像器指针，失败返回 NULL。
+ */
+frame_recorder_t* frame_recorder_init(const char* path, size_t width, size_t height, size_t ring_size);
+
+/**
+ * 停止后台写线程, 写完缓冲区中的数据后释放录像器。
+ *
+ * @param rec 指向录像器的指针。
+ */
+void frame_recorder_exit(frame_recorder_t* rec);
+
+/**
+ * 记录一帧, 只编码 dirty 区域(和之前丢帧累积的区域)。
+ *
+ * @param rec 指向录像器的指针。
+ * @param frame 当前帧, 大小为 width * height。
+ * @param dirty 本次刷新变化的区域。
+ * @return 记录成功返回 0，无变化返回 1，缓冲区满丢帧返回 -1。
+ */
+int frame_recorder_push(frame_recorder_t* rec, const framebuffer_color_t* frame, const frame_rect_t* dirty);
+
+/**
+ * 获取因写缓冲区满而丢弃的帧数。
+ *
+ * @param rec 指向录像器的指针。
+ * @return 丢帧数。
+ */
+size_t frame_recorder_dropped(const frame_recorder_t* rec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__FRAME_RECORDER_H__
@@ -1,17 +1,21 @@
 
+#include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <unistd.h>
 #include <sys/ioctl.h> 
 #include <assert.h>
 
 #include "debug.h"
+#include "display_server.h"
 #include "framebuffer.h"
 
 /**
@@ -25,7 +29,10 @@ void framebuffer_exit(framebuffer_t* fb)
         return;
 
     if (fb->screen) {
-        munmap(fb->screen, fb->screen_size);
+        if (fb->dev_fb < 0 && fb->client_fd < 0)
+            free(fb->screen);
+        else
+            munmap(fb->screen, fb->screen_size);
         fb->screen = NULL;
         fb->screen_size = 0;
     }
@@ -33,13 +40,165 @@ void framebuffer_exit(framebuffer_t* fb)
         close(fb->dev_fb);
         fb->dev_fb = 0;
     }
+    if (fb->client_fd >= 0) {
+        close(fb->client_fd);
+        fb->client_fd = -1;
+    }
     free(fb);
 }
 
+/**
+ * 初始化内存帧缓冲区, 用于没有屏幕的调试和测试环境。
+ *
+ * @param fb_info 已清零的帧缓冲区信息。
+ * @param size 尺寸描述, 格式为 `WxH`, 如 `240x240`。
+ * @return 成功返回 0，失败返回 -1。
+ */
+static int framebuffer_init_mem(framebuffer_t* fb_info, const char* size)
+{
+    unsigned long width = 0, height = 0;
+    if (2 != sscanf(size, "%lux%lu", &width, &height) || !width || !height) {
+        LOG_ERR("fail to parse mem framebuffer size: %s", size);
+        return -1;
+    }
+    fb_info->dev_fb = -1;
+    fb_info->width = width;
+    fb_info->height = height;
+    fb_info->vinfo.xres = fb_info->vinfo.xres_virtual = width;
+    fb_info->vinfo.yres = fb_info->vinfo.yres_virtual = height;
+    fb_info->vinfo.bits_per_pixel = COLOR_SIZE * 8;
+    fb_info->line_length = fb_info->width * COLOR_SIZE;
+    fb_info->screen_size = fb_info->line_length * fb_info->height;
+
+    fb_info->screen = malloc(fb_info->screen_size);
+    if (!fb_info->screen) {
+        LOG_ERR("fail to malloc mem framebuffer");
+        return -1;
+    }
+    memset(fb_info->screen, 0, fb_info->screen_size);
+    LOG_DBG("mem framebuffer Width: %ld, Heigh: %ld", fb_info->width, fb_info->height);
+
+    return 0;
+}
+
+/**
+ * 连接显示服务, 映射服务端分配的共享图层作为屏幕内存。
+ *
+ * @param fb_info 已清零的帧缓冲区信息。
+ * @param spec 连接描述, 格式为 `PATH[@X,Y,WxH[,Z]]`, 省略区域时占满整个屏幕。
+ * @return 成功返回 0，失败返回 -1。
+ */
+static int framebuffer_init_client(framebuffer_t* fb_info, const char* spec)
+{
+    display_server_hello_t hello;
+    memset(&hello, 0, sizeof(hello));
+    memcpy(hello.magic, DISPLAY_SERVER_MAGIC, sizeof(hello.magic));
+
+    struct sockaddr_un sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    const char* at = strchr(spec, '@');
+    size_t len = at ? (size_t)(at - spec) : strlen(spec);
+    if (!len || len >= sizeof(sa.sun_path)) {
+        LOG_ERR("bad display server path: %s", spec);
+        return -1;
+    }
+    memcpy(sa.sun_path, spec, len);
+    if (at && sscanf(at + 1, "%u,%u,%ux%u,%d", &hello.x, &hello.y, &hello.width, &hello.height, &hello.z) < 4) {
+        LOG_ERR("fail to parse client layer: %s", at + 1);
+        return -1;
+    }
+
+    fb_info->dev_fb = -1;
+    fb_info->client_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fb_info->client_fd < 0 || connect(fb_info->client_fd, (struct sockaddr*)&sa, sizeof(sa)) < 0) {
+        LOG_ERR("fail to connect %s: %s", sa.sun_path, strerror(errno));
+        return -1;
+    }
+    if (send(fb_info->client_fd, &hello, sizeof(hello), MSG_NOSIGNAL) != (ssize_t)sizeof(hello)) {
+        LOG_ERR("fail to send hello: %s", strerror(errno));
+        return -1;
+    }
+
+    // 应答附带共享内存描述符
+    display_server_welcome_t welcome;
+    char control[CMSG_SPACE(sizeof(int))];
+    struct iovec iov = { &welcome, sizeof(welcome) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t ret = recvmsg(fb_info->client_fd, &msg, MSG_CMSG_CLOEXEC);
+    int memfd = -1;
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (ret > 0 && cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+        memcpy(&memfd, CMSG_DATA(cmsg), sizeof(int));
+    if (ret != (ssize_t)sizeof(welcome) || welcome.status || memfd < 0
+        || memcmp(welcome.magic, DISPLAY_SERVER_MAGIC, sizeof(welcome.magic))) {
+        LOG_ERR("display server refused client layer");
+        if (memfd >= 0)
+            close(memfd);
+        return -1;
+    }
+
+    fb_info->width = welcome.width;
+    fb_info->height = welcome.height;
+    fb_info->vinfo.xres = fb_info->vinfo.xres_virtual = welcome.width;
+    fb_info->vinfo.yres = fb_info->vinfo.yres_virtual = welcome.height;
+    fb_info->vinfo.bits_per_pixel = COLOR_SIZE * 8;
+    fb_info->line_length = welcome.stride;
+    fb_info->screen_size = fb_info->line_length * fb_info->height;
+    fb_info->screen = mmap(NULL, fb_info->screen_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    close(memfd);
+    if (MAP_FAILED == fb_info->screen) {
+        fb_info->screen = NULL;
+        LOG_ERR("fail to map client layer: %s", strerror(errno));
+        return -1;
+    }
+    LOG_DBG("client framebuffer (%u, %u) Width: %ld, Heigh: %ld",
+        welcome.x, welcome.y, fb_info->width, fb_info->height);
+
+    return 0;
+}
+
+/**
+ * 通知屏幕内容已变化。显示服务客户端把变化区域提交给服务端合成, 其它帧缓冲区直接返回。
+ * 变化区域先裁剪到屏幕范围内, 服务端拒绝超出图层的区域。
+ *
+ * @param fb 指向帧缓冲区的指针。
+ * @param x 变化区域 x。
+ * @param y 变化区域 y。
+ * @param w 变化区域宽。
+ * @param h 变化区域高。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int framebuffer_damage(framebuffer_t* fb, size_t x, size_t y, size_t w, size_t h)
+{
+    if (!fb || fb->client_fd < 0 || !w || !h || x >= fb->width || y >= fb->height)
+        return 0;
+    w = w > fb->width - x ? fb->width - x : w;
+    h = h > fb->height - y ? fb->height - y : h;
+
+    display_server_damage_t msg;
+    msg.type = DISPLAY_SERVER_MSG_DAMAGE;
+    msg.rect.x = x;
+    msg.rect.y = y;
+    msg.rect.w = w;
+    msg.rect.h = h;
+    if (send(fb->client_fd, &msg, sizeof(msg), MSG_NOSIGNAL) != (ssize_t)sizeof(msg)) {
+        LOG_ERR("fail to send damage: %s", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
 /**
  * 初始化帧缓冲区。
  *
- * @param dev_file 帧缓冲设备文件的路径。
+ * @param dev_file 帧缓冲设备文件的路径, 以 `mem:WxH` 开头时创建内存帧缓冲区,
+ *                 以 `client:` 开头时连接显示服务。
  * @return 指向初始化后的帧缓冲区的指针。
  */
 framebuffer_t* framebuffer_init(const char *dev_file)
@@ -50,6 +209,23 @@ framebuffer_t* framebuffer_init(const char *dev_file)
         return NULL;
     }
     memset(fb_info, 0, sizeof(framebuffer_t));
+    fb_info->client_fd = -1;
+
+    if (0 == strncmp(dev_file, FRAMEBUFFER_CLIENT_PREFIX, strlen(FRAMEBUFFER_CLIENT_PREFIX))) {
+        if (framebuffer_init_client(fb_info, dev_file + strlen(FRAMEBUFFER_CLIENT_PREFIX)) < 0) {
+            framebuffer_exit(fb_info);
+            return NULL;
+        }
+        return fb_info;
+    }
+
+    if (0 == strncmp(dev_file, FRAMEBUFFER_MEM_PREFIX, strlen(FRAMEBUFFER_MEM_PREFIX))) {
+        if (framebuffer_init_mem(fb_info, dev_file + strlen(FRAMEBUFFER_MEM_PREFIX)) < 0) {
+            framebuffer_exit(fb_info);
+            return NULL;
+        }
+        return fb_info;
+    }
 
     fb_info->dev_fb = open(dev_file, O_RDWR);
     if (-1 == fb_info->dev_fb) {
@@ -67,8 +243,15 @@ framebuffer_t* framebuffer_init(const char *dev_file)
     fb_info->width = fb_info->vinfo.xres_virtual;
     fb_info->height = fb_info->vinfo.yres_virtual;
 
-    fb_info->screen_size = fb_info->width * fb_info->height * COLOR_SIZE;
-    LOG_DBG("Width: %ld, Heigh: %ld", fb_info->width, fb_info->height);
+    // 驱动可能在每行末尾填充对齐字节, 以固定信息中的行长度为准
+    struct fb_fix_screeninfo finfo;
+    memset(&finfo, 0, sizeof(finfo));
+    fb_info->line_length = fb_info->width * COLOR_SIZE;
+    if (0 == ioctl(fb_info->dev_fb, FBIOGET_FSCREENINFO, &finfo) && finfo.line_length > fb_info->line_length)
+        fb_info->line_length = finfo.line_length;
+
+    fb_info->screen_size = fb_info->line_length * fb_info->height;
+    LOG_DBG("Width: %ld, Heigh: %ld, line: %zu", fb_info->width, fb_info->height, fb_info->line_length);
 
     fb_info->screen = mmap(NULL, fb_info->screen_size,
         PROT_READ | PROT_WRITE, MAP_SHARED, fb_info->dev_fb, 0);
@@ -88,7 +271,11 @@ char g_dbg_enable = 1;
 
 int main()
 {
-    framebuffer_t *fb = framebuffer_init("/dev/fb0");
+    framebuffer_t *fb = framebuffer_init("mem:32x16");
+    assert(fb && fb->width == 32 && fb->height == 16 && fb->line_length == 32 * COLOR_SIZE);
+    framebuffer_exit(fb);
+
+    fb = framebuffer_init("/dev/fb0");
     assert(fb);
     framebuffer_exit(fb);
 }
@@ -15,11 +15,16 @@ typedef uint16_t framebuffer_color_t;             // 颜色类型
 #define COLOR_WHITE (0xffffU)   // 白色
 #define COLOR_GREY (0xe73cU)    // 灰色
 
+#define FRAMEBUFFER_MEM_PREFIX "mem:"  // 内存帧缓冲区设备名前缀, 如 "mem:240x240"
+#define FRAMEBUFFER_CLIENT_PREFIX "client:"  // 显示服务客户端设备名前缀, 如 "client:/run/aimi-display.sock@0,200,240x40,1"
+
 typedef struct framebuffer_t {
     size_t screen_size;              // 屏幕占用内存大小
     size_t width;                    // 屏幕宽度
     size_t height;                   // 屏幕高度
-    int dev_fb;                      // 屏幕设备描述符
+    size_t line_length;              // 屏幕每行字节数, 可能大于 width * COLOR_SIZE
+    int dev_fb;                      // 屏幕设备描述符, 内存帧缓冲区为 -1
+    int client_fd;                   // 显示服务客户端套接字, 不是客户端为 -1
     struct fb_var_screeninfo vinfo;  // 屏幕信息
     void* screen;                    // 屏幕内存
 } framebuffer_t;
@@ -34,11 +39,25 @@ void framebuffer_exit(framebuffer_t* fb);
 /**
  * 初始化帧缓冲区。
  *
- * @param dev_file 帧缓冲设备文件的路径。
+ * @param dev_file 帧缓冲设备文件的路径, 或 `mem:WxH` 内存帧缓冲区,
+ *                 或 `client:PATH[@X,Y,WxH[,Z]]` 连接显示服务, 屏幕内存是服务端分配的共享图层。
  * @return 指向初始化后的帧缓冲区的指针。
  */
 framebuffer_t *framebuffer_init(const char *dev_file);
 
+/**
+ * 通知屏幕内容已变化。显示服务客户端把变化区域提交给服务端合成, 其它帧缓冲区直接返回。
+ * 变化区域先裁剪到屏幕范围内, 服务端拒绝超出图层的区域。
+ *
+ * @param fb 指向帧缓冲区的指针。
+ * @param x 变化区域 x。
+ * @param y 变化区域 y。
+ * @param w 变化区域宽。
+ * @param h 变化区域高。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int framebuffer_damage(framebuffer_t* fb, size_t x, size_t y, size_t w, size_t h);
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,123 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "debug.h"
+#include "glyph_blend.h"
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+/**
+ * @brief 按覆盖度混合一个颜色通道, 0 和 15 时精确等于背景和前景
+ */
+static inline int glyph_blend_channel(int fg, int bg, int a)
+{
+    return bg + (((fg - bg) * a * 17 + 128) >> 8);
+}
+
+/**
+ * 计算前景/背景组合的混合表, 覆盖度 0 为背景色, 15 为前景色。
+ *
+ * @param t 输出混合表。
+ * @param fg 前景色 RGB565。
+ * @param bg 背景色 RGB565。
+ */
+void glyph_blend_init(glyph_blend_t* t, uint16_t fg, uint16_t bg)
+{
+    assert(t && "arg failed!");
+    t->fg = fg;
+    t->bg = bg;
+    for (int a = 0; a < GLYPH_BLEND_LEVELS; ++a) {
+        int r = glyph_blend_channel(fg >> 11, bg >> 11, a);
+        int g = glyph_blend_channel((fg >> 5) & 0x3f, (bg >> 5) & 0x3f, a);
+        int b = glyph_blend_channel(fg & 0x1f, bg & 0x1f, a);
+        t->color[a] = (uint16_t)(r << 11 | g << 5 | b);
+        t->lo[a] = t->color[a] & 0xff;
+        t->hi[a] = t->color[a] >> 8;
+    }
+}
+
+/**
+ * 把一行 4 位覆盖度转换为 RGB565。
+ *
+ * @param t 混合表。
+ * @param coverage 覆盖度, 每字节两个像素, 高 4 位在左。
+ * @param n 像素数。
+ * @param out 输出 RGB565。
+ */
+void glyph_blend_row(const glyph_blend_t* t, const uint8_t* coverage, size_t n, uint16_t* out)
+{
+    size_t i = 0;
+#if defined(__SSSE3__)
+    // 8 字节覆盖度拆成 16 个下标, 高低字节分别查表后交错成 16 个 RGB565
+    const __m128i lo = _mm_loadu_si128((const __m128i*)t->lo);
+    const __m128i hi = _mm_loadu_si128((const __m128i*)t->hi);
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadl_epi64((const __m128i*)(coverage + i / 2));
+        __m128i idx = _mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(v, 4), mask), _mm_and_si128(v, mask));
+        __m128i l = _mm_shuffle_epi8(lo, idx);
+        __m128i h = _mm_shuffle_epi8(hi, idx);
+        _mm_storeu_si128((__m128i*)(out + i), _mm_unpacklo_epi8(l, h));
+        _mm_storeu_si128((__m128i*)(out + i + 8), _mm_unpackhi_epi8(l, h));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t lo = vld1q_u8(t->lo);
+    const uint8x16_t hi = vld1q_u8(t->hi);
+    for (; i + 16 <= n; i += 16) {
+        uint8x8_t v = vld1_u8(coverage + i / 2);
+        uint8x8x2_t z = vzip_u8(vshr_n_u8(v, 4), vand_u8(v, vdup_n_u8(0x0f)));
+        uint8x16_t idx = vcombine_u8(z.val[0], z.val[1]);
+        uint8x16x2_t c = { { vqtbl1q_u8(lo, idx), vqtbl1q_u8(hi, idx) } };
+        vst2q_u8((uint8_t*)(out + i), c);
+    }
+#endif
+    for (; i < n; ++i)
+        out[i] = t->color[glyph_coverage(coverage, i)];
+}
+
+#ifdef __XTEST__
+
+char g_dbg_enable = 1;
+
+int main(void)
+{
+    // 两端精确等于背景/前景, 中间单调
+    glyph_blend_t t;
+    const uint16_t colors[] = { 0x0000, 0xffff, 0xf800, 0x07e0, 0x001f, 0x8410, 0x1234, 0xfedc };
+    for (size_t f = 0; f < sizeof(colors) / sizeof(colors[0]); ++f) {
+        for (size_t b = 0; b < sizeof(colors) / sizeof(colors[0]); ++b) {
+            glyph_blend_init(&t, colors[f], colors[b]);
+            assert(t.color[0] == colors[b] && t.color[15] == colors[f]);
+            for (int a = 1; a < GLYPH_BLEND_LEVELS; ++a) {
+                int r0 = t.color[a - 1] >> 11, r1 = t.color[a] >> 11;
+                assert(colors[f] >> 11 >= colors[b] >> 11 ? r1 >= r0 : r1 <= r0);
+            }
+        }
+    }
+    glyph_blend_init(&t, 0xffff, 0x0000);
+    assert(t.color[8] == (16 << 11 | 33 << 5 | 16));
+
+    // 查表结果与逐像素一致, 包括各种长度的尾部
+    uint8_t coverage[64];
+    for (size_t i = 0; i < sizeof(coverage); ++i)
+        coverage[i] = (uint8_t)(i * 37 + 11);
+    glyph_blend_init(&t, 0xf81f, 0x0841);
+    for (size_t n = 0; n <= 2 * sizeof(coverage); ++n) {
+        uint16_t out[2 * sizeof(coverage) + 1];
+        out[n] = 0xabcd;
+        glyph_blend_row(&t, coverage, n, out);
+        for (size_t i = 0; i < n; ++i)
+            assert(out[i] == t.color[glyph_coverage(coverage, i)]);
+        assert(out[n] == 0xabcd);
+    }
+
+    printf("glyph blend test pass\n");
+    return 0;
+}
+
+#endif //__XTEST__
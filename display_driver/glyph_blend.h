@@ -0,0 +1,65 @@
+#ifndef __GLYPH_BLEND_H__
+#define __GLYPH_BLEND_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 功能: 抗锯齿字形的颜色混合. 字形每个像素是 4 位覆盖度(0 为背景, 15 为前景),
+// 每种前景/背景组合预先算好 16 个 RGB565 颜色, 绘制时查表, 不用逐像素做乘法.
+// 有 NEON/SSSE3 时一次查 16 个像素的表, 与 1 位字形逐像素绘制的代价相当.
+//
+// example:
+//   glyph_blend_t t;
+//   glyph_blend_init(&t, COLOR_WHITE, COLOR_BLACK);
+//   glyph_blend_row(&t, coverage, width, line);
+
+#define GLYPH_BLEND_LEVELS (16)  // 覆盖度级数
+
+typedef struct glyph_blend_t {
+    uint16_t fg;                          // 前景色
+    uint16_t bg;                          // 背景色
+    uint16_t color[GLYPH_BLEND_LEVELS];   // 覆盖度对应的颜色
+    uint8_t lo[GLYPH_BLEND_LEVELS];       // 颜色的低字节, 向量查表使用
+    uint8_t hi[GLYPH_BLEND_LEVELS];       // 颜色的高字节, 向量查表使用
+} glyph_blend_t;
+
+/**
+ * 计算前景/背景组合的混合表, 覆盖度 0 为背景色, 15 为前景色。
+ *
+ * @param t 输出混合表。
+ * @param fg 前景色 RGB565。
+ * @param bg 背景色 RGB565。
+ */
+void glyph_blend_init(glyph_blend_t* t, uint16_t fg, uint16_t bg);
+
+/**
+ * 把一行 4 位覆盖度转换为 RGB565。
+ *
+ * @param t 混合表。
+ * @param coverage 覆盖度, 每字节两个像素, 高 4 位在左。
+ * @param n 像素数。
+ * @param out 输出 RGB565。
+ */
+void glyph_blend_row(const glyph_blend_t* t, const uint8_t* coverage, size_t n, uint16_t* out);
+
+/**
+ * 获取一个像素的覆盖度。
+ *
+ * @param coverage 一行覆盖度。
+ * @param x 像素位置。
+ * @return 覆盖度 0~15。
+ */
+static inline uint8_t glyph_coverage(const uint8_t* coverage, size_t x)
+{
+    return (coverage[x >> 1] >> (x & 1 ? 0 : 4)) & 0x0f;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__GLYPH_BLEND_H__
@@ -0,0 +1,416 @@
+#include <assert.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "image.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define IMAGE_PPM_MAX_SIZE (8192)  // PPM 图片最大边长
+
+// 4x4 Bayer 矩阵
+static const uint8_t s_image_bayer[4][4] = {
+    { 0, 8, 2, 10 },
+    { 12, 4, 14, 6 },
+    { 3, 11, 1, 9 },
+    { 15, 7, 13, 5 },
+};
+
+/**
+ * @brief 读取 PPM 头部的一个数字, 跳过空白和 # 注释
+ *
+ * @return 成功返回 0, 失败返回 -1
+ */
+static int image_ppm_read_number(FILE* fp, size_t* value)
+{
+    int c = fgetc(fp);
+    for (;;) {
+        if (c == '#') {
+            while (c != EOF && c != '\n')
+                c = fgetc(fp);
+        } else if (c != EOF && isspace(c)) {
+            c = fgetc(fp);
+        } else {
+            break;
+        }
+    }
+    if (c == EOF || !isdigit(c))
+        return -1;
+
+    size_t v = 0;
+    while (c != EOF && isdigit(c) && v <= IMAGE_PPM_MAX_SIZE) {
+        v = v * 10 + (c - '0');
+        c = fgetc(fp);
+    }
+    // 数字后面必须是一个空白字符
+    if (c == EOF || !isspace(c))
+        return -1;
+    *value = v;
+    return 0;
+}
+
+/**
+ * 读取 PPM(P6, 最大值 255) 图片。
+ *
+ * @param path 文件路径。
+ * @return 成功返回 RGB888 图片，失败返回 NULL。
+ */
+image_t* image_load_ppm(const char* path)
+{
+    assert(path && "arg failed!");
+
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        LOG_ERR("fail to open %s", path);
+        return NULL;
+    }
+
+    image_t* img = NULL;
+    char magic[2] = { 0 };
+    size_t w = 0, h = 0, maxval = 0;
+    if (2 != fread(magic, 1, 2, fp) || magic[0] != 'P' || magic[1] != '6'
+        || image_ppm_read_number(fp, &w) < 0 || image_ppm_read_number(fp, &h) < 0
+        || image_ppm_read_number(fp, &maxval) < 0) {
+        LOG_ERR("%s: not a P6 ppm", path);
+        goto err;
+    }
+    if (!w || !h || w > IMAGE_PPM_MAX_SIZE || h > IMAGE_PPM_MAX_SIZE || maxval != 255) {
+        LOG_ERR("%s: unsupported ppm %zux%zu max %zu", path, w, h, maxval);
+        goto err;
+    }
+
+    img = (image_t*)malloc(sizeof(image_t));
+    if (!img) {
+        LOG_ERR("fail to malloc image");
+        goto err;
+    }
+    memset(img, 0, sizeof(image_t));
+    img->width = w;
+    img->height = h;
+    img->stride = w * 3;
+    img->format = IMAGE_FORMAT_RGB888;
+    img->data = (uint8_t*)malloc(img->stride * h);
+    if (!img->data) {
+        LOG_ERR("fail to malloc image %zux%zu", w, h);
+        goto err;
+    }
+    if (h != fread(img->data, img->stride, h, fp)) {
+        LOG_ERR("%s: truncated ppm", path);
+        goto err;
+    }
+    fclose(fp);
+
+    return img;
+err:
+    image_exit(img);
+    fclose(fp);
+    return NULL;
+}
+
+/**
+ * 释放图片。
+ *
+ * @param img 指向图片的指针。
+ */
+void image_exit(image_t* img)
+{
+    if (!img)
+        return;
+    if (img->data)
+        free(img->data);
+    free(img);
+}
+
+/**
+ * @brief 读取一个像素为 RGBA
+ */
+static inline void image_read_pixel(const uint8_t* p, image_format_t format, uint8_t* rgba)
+{
+    rgba[0] = p[0];
+    rgba[1] = p[1];
+    rgba[2] = p[2];
+    rgba[3] = format == IMAGE_FORMAT_RGBA8888 ? p[3] : 0xff;
+}
+
+/**
+ * @brief 计算双线性采样的源坐标, 像素中心对齐
+ *
+ * @param d 目标坐标
+ * @param src 源边长
+ * @param dst 目标边长
+ * @param i0 输出第一个采样点
+ * @param i1 输出第二个采样点
+ * @return 第二个采样点的权重, 0-256
+ */
+static inline uint32_t image_bilinear_pos(size_t d, size_t src, size_t dst, size_t* i0, size_t* i1)
+{
+    int64_t f = (int64_t)((2 * d + 1) * src * 256 / (2 * dst)) - 128;
+    f = f < 0 ? 0 : f;
+    *i0 = (size_t)(f >> 8);
+    if (*i0 >= src - 1) {
+        *i0 = *i1 = src - 1;
+        return 0;
+    }
+    *i1 = *i0 + 1;
+    return (uint32_t)(f & 0xff);
+}
+
+/**
+ * 把源图缩放到 dst_w x dst_h 后的第 dy 行中 [x0, x1) 列采样为 RGBA8888。
+ *
+ * @param src 源图像素。
+ * @param src_w 源图宽。
+ * @param src_h 源图高。
+ * @param stride 源图每行字节数。
+ * @param format 源图像素格式, RGB888 输出的 alpha 为 255。
+ * @param dst_w 缩放后的宽。
+ * @param dst_h 缩放后的高。
+ * @param dy 缩放后的行。
+ * @param x0 开始列。
+ * @param x1 结束列(不含)。
+ * @param scale 采样方式。
+ * @param rgba 输出, (x1 - x0) * 4 字节。
+ */
+void image_scale_row(const uint8_t* src, size_t src_w, size_t src_h, size_t stride, image_format_t format,
+    size_t dst_w, size_t dst_h, size_t dy, size_t x0, size_t x1, image_scale_t scale, uint8_t* rgba)
+{
+    assert(src && src_w && src_h && dst_w && dst_h && rgba && "arg failed!");
+    size_t bpp = IMAGE_FORMAT_BPP(format);
+
+    if (scale == IMAGE_SCALE_NEAREST || (src_w == dst_w && src_h == dst_h)) {
+        size_t sy = (2 * dy + 1) * src_h / (2 * dst_h);
+        const uint8_t* row = src + sy * stride;
+        for (size_t x = x0; x < x1; ++x, rgba += 4) {
+            size_t sx = (2 * x + 1) * src_w / (2 * dst_w);
+            image_read_pixel(row + sx * bpp, format, rgba);
+        }
+        return;
+    }
+
+    size_t sy0, sy1;
+    uint32_t wy = image_bilinear_pos(dy, src_h, dst_h, &sy0, &sy1);
+    const uint8_t* r0 = src + sy0 * stride;
+    const uint8_t* r1 = src + sy1 * stride;
+    for (size_t x = x0; x < x1; ++x, rgba += 4) {
+        size_t sx0, sx1;
+        uint32_t wx = image_bilinear_pos(x, src_w, dst_w, &sx0, &sx1);
+        uint8_t p00[4], p01[4], p10[4], p11[4];
+        image_read_pixel(r0 + sx0 * bpp, format, p00);
+        image_read_pixel(r0 + sx1 * bpp, format, p01);
+        image_read_pixel(r1 + sx0 * bpp, format, p10);
+        image_read_pixel(r1 + sx1 * bpp, format, p11);
+        for (int c = 0; c < 4; ++c) {
+            uint32_t top = p00[c] * (256 - wx) + p01[c] * wx;
+            uint32_t bottom = p10[c] * (256 - wx) + p11[c] * wx;
+            rgba[c] = (uint8_t)((top * (256 - wy) + bottom * wy + 32768) >> 16);
+        }
+    }
+}
+
+/**
+ * 按 alpha 把 RGBA8888 行与已有的 RGB565 内容混合, 结果写回 rgba(alpha 置为 255)。
+ *
+ * @param rgba RGBA8888 行。
+ * @param dst 已有内容。
+ * @param n 像素数。
+ */
+void image_blend_row(uint8_t* rgba, const uint16_t* dst, size_t n)
+{
+    for (size_t i = 0; i < n; ++i, rgba += 4) {
+        uint32_t a = rgba[3];
+        if (a == 0xff)
+            continue;
+        uint16_t c = dst[i];
+        uint32_t r = (c >> 11) & 0x1f, g = (c >> 5) & 0x3f, b = c & 0x1f;
+        uint32_t d[3] = { (r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2) };
+        for (int k = 0; k < 3; ++k)
+            rgba[k] = (uint8_t)((rgba[k] * a + d[k] * (255 - a) + 127) / 255);
+        rgba[3] = 0xff;
+    }
+}
+
+/**
+ * @brief 生成一行的抖动偏移, 4 个像素一组(R G B 0), 从屏幕 x 对齐
+ *
+ * 5 位通道量化步长为 8, 6 位通道为 4, 偏移为矩阵值 * 步长 / 16。
+ */
+static inline void image_dither_bias(size_t x, size_t y, uint8_t bias[16])
+{
+    const uint8_t* m = s_image_bayer[y & 3];
+    for (int i = 0; i < 4; ++i) {
+        uint8_t t = m[(x + i) & 3];
+        bias[i * 4 + 0] = t >> 1;
+        bias[i * 4 + 1] = t >> 2;
+        bias[i * 4 + 2] = t >> 1;
+        bias[i * 4 + 3] = 0;
+    }
+}
+
+/**
+ * @brief 单个像素转换为 RGB565, 用于向量化处理不了的部分
+ */
+static inline uint16_t image_pixel_to_rgb565(const uint8_t* p, const uint8_t* bias)
+{
+    uint32_t r = p[0] + bias[0], g = p[1] + bias[1], b = p[2] + bias[2];
+    r = r > 0xff ? 0xff : r;
+    g = g > 0xff ? 0xff : g;
+    b = b > 0xff ? 0xff : b;
+    return (uint16_t)(((r & 0xf8) << 8) | ((g & 0xfc) << 3) | (b >> 3));
+}
+
+/**
+ * RGBA8888 行转换为 RGB565, alpha 被忽略。
+ *
+ * @param rgba RGBA8888 行。
+ * @param n 像素数。
+ * @param x 第一个像素在屏幕上的 x, 用于对齐抖动矩阵。
+ * @param y 行在屏幕上的 y, 用于对齐抖动矩阵。
+ * @param dither 是否使用 4x4 Bayer 有序抖动。
+ * @param out 输出 RGB565。
+ */
+void image_rgba_to_rgb565(const uint8_t* rgba, size_t n, size_t x, size_t y, int dither, uint16_t* out)
+{
+    uint8_t bias[16] = { 0 };
+    if (dither)
+        image_dither_bias(x, y, bias);
+
+    size_t i = 0;
+#if defined(__SSE2__)
+    // 4 个像素一组, 抖动偏移以 4 像素为周期, 每组用同一个偏移向量
+    const __m128i vbias = _mm_loadu_si128((const __m128i*)bias);
+    const __m128i mask_r = _mm_set1_epi32(0xf8);
+    const __m128i mask_g = _mm_set1_epi32(0x7e0);
+    const __m128i mask_b = _mm_set1_epi32(0x1f);
+    for (; i + 8 <= n; i += 8) {
+        __m128i p[2];
+        for (int k = 0; k < 2; ++k) {
+            __m128i v = _mm_adds_epu8(_mm_loadu_si128((const __m128i*)(rgba + (i + k * 4) * 4)), vbias);
+            __m128i r = _mm_slli_epi32(_mm_and_si128(v, mask_r), 8);
+            __m128i g = _mm_and_si128(_mm_srli_epi32(v, 5), mask_g);
+            __m128i b = _mm_and_si128(_mm_srli_epi32(v, 19), mask_b);
+            __m128i c = _mm_or_si128(_mm_or_si128(r, g), b);
+            // 有符号饱和打包前先把低 16 位符号扩展, 打包后保持原值
+            p[k] = _mm_srai_epi32(_mm_slli_epi32(c, 16), 16);
+        }
+        _mm_storeu_si128((__m128i*)(out + i), _mm_packs_epi32(p[0], p[1]));
+    }
+#elif defined(__ARM_NEON)
+    // 8 个像素一组, 偏移向量为 4 像素周期重复两次
+    uint8_t br[8], bg[8], bb[8];
+    for (int k = 0; k < 8; ++k) {
+        br[k] = bias[(k & 3) * 4 + 0];
+        bg[k] = bias[(k & 3) * 4 + 1];
+        bb[k] = bias[(k & 3) * 4 + 2];
+    }
+    const uint8x8_t vbr = vld1_u8(br), vbg = vld1_u8(bg), vbb = vld1_u8(bb);
+    for (; i + 8 <= n; i += 8) {
+        uint8x8x4_t v = vld4_u8(rgba + i * 4);
+        uint16x8_t r = vshll_n_u8(vqadd_u8(v.val[0], vbr), 8);
+        uint16x8_t g = vshll_n_u8(vqadd_u8(v.val[1], vbg), 8);
+        uint16x8_t b = vshll_n_u8(vqadd_u8(v.val[2], vbb), 8);
+        uint16x8_t c = vsriq_n_u16(r, g, 5);
+        c = vsriq_n_u16(c, b, 11);
+        vst1q_u16(out + i, c);
+    }
+#endif
+    // 向量部分每次处理 8 个像素, 剩余像素的偏移从 i & 3 继续
+    for (; i < n; ++i)
+        out[i] = image_pixel_to_rgb565(rgba + i * 4, bias + (i & 3) * 4);
+}
+
+#ifdef __XTEST__
+
+char g_dbg_enable = 1;
+
+static uint16_t test_ref_565(const uint8_t* p)
+{
+    return (uint16_t)(((p[0] & 0xf8) << 8) | ((p[1] & 0xfc) << 3) | (p[2] >> 3));
+}
+
+int main(void)
+{
+    // 向量化转换与逐像素结果一致, 包括各种长度的尾部
+    uint8_t rgba[64 * 4];
+    uint16_t out[64];
+    for (size_t i = 0; i < sizeof(rgba); ++i)
+        rgba[i] = (uint8_t)(i * 37 + 11);
+    for (size_t n = 0; n <= 64; ++n) {
+        image_rgba_to_rgb565(rgba, n, 0, 0, 0, out);
+        for (size_t i = 0; i < n; ++i)
+            assert(out[i] == test_ref_565(rgba + i * 4));
+    }
+    // 白色和黑色不受抖动影响
+    uint8_t white[16 * 4], black[16 * 4];
+    memset(white, 0xff, sizeof(white));
+    memset(black, 0, sizeof(black));
+    image_rgba_to_rgb565(white, 16, 3, 1, 1, out);
+    for (int i = 0; i < 16; ++i)
+        assert(out[i] == 0xffff);
+    image_rgba_to_rgb565(black, 16, 3, 1, 1, out);
+    for (int i = 0; i < 16; ++i)
+        assert(out[i] == 0x0000);
+
+    // 抖动后 4x4 区域的平均值接近原始灰度
+    uint8_t gray[16 * 4];
+    for (int i = 0; i < 16; ++i) {
+        gray[i * 4] = gray[i * 4 + 1] = gray[i * 4 + 2] = 100;
+        gray[i * 4 + 3] = 0xff;
+    }
+    uint32_t sum = 0;
+    for (size_t y = 0; y < 4; ++y) {
+        image_rgba_to_rgb565(gray, 16, 0, y, 1, out);
+        for (int i = 0; i < 4; ++i) {
+            sum += (uint32_t)(out[i] >> 11) << 3;
+        }
+        // 向量部分和逐像素部分使用同一个偏移, 周期为 4
+        for (int i = 4; i < 16; ++i)
+            assert(out[i] == out[i & 3]);
+    }
+    assert(sum / 16 == 100);
+
+    // 缩放: 同尺寸为原图, 最近邻放大 2 倍每个像素重复两次, 双线性中间为平均值
+    const uint8_t src[2 * 2 * 3] = { 0, 0, 0, 200, 100, 50, 0, 0, 0, 200, 100, 50 };
+    uint8_t row[4 * 4];
+    image_scale_row(src, 2, 2, 6, IMAGE_FORMAT_RGB888, 2, 2, 0, 0, 2, IMAGE_SCALE_BILINEAR, row);
+    assert(row[4] == 200 && row[5] == 100 && row[6] == 50 && row[7] == 0xff && row[0] == 0);
+    image_scale_row(src, 2, 2, 6, IMAGE_FORMAT_RGB888, 4, 4, 1, 0, 4, IMAGE_SCALE_NEAREST, row);
+    assert(row[0] == 0 && row[4] == 0 && row[8] == 200 && row[12] == 200);
+    image_scale_row(src, 2, 2, 6, IMAGE_FORMAT_RGB888, 3, 1, 0, 1, 2, IMAGE_SCALE_BILINEAR, row);
+    assert(row[0] == 100 && row[1] == 50 && row[2] == 25);
+
+    // alpha 混合
+    uint8_t px[4] = { 255, 255, 255, 128 };
+    uint16_t under = 0x0000;
+    image_blend_row(px, &under, 1);
+    assert(px[0] == 128 && px[3] == 0xff);
+
+    // PPM 读取, 支持注释
+    const char* path = "/tmp/image_xtest.ppm";
+    FILE* fp = fopen(path, "wb");
+    assert(fp);
+    fprintf(fp, "P6\n# comment\n2 1\n255\n");
+    const uint8_t pix[6] = { 1, 2, 3, 4, 5, 6 };
+    fwrite(pix, 1, sizeof(pix), fp);
+    fclose(fp);
+    image_t* img = image_load_ppm(path);
+    assert(img && img->width == 2 && img->height == 1 && 0 == memcmp(img->data, pix, 6));
+    image_exit(img);
+    fp = fopen(path, "wb");
+    fprintf(fp, "P6 2 2 255\n");
+    fwrite(pix, 1, sizeof(pix), fp);
+    fclose(fp);
+    assert(!image_load_ppm(path));
+    remove(path);
+
+    printf("image test pass\n");
+    return 0;
+}
+
+#endif //__XTEST__
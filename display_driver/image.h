@@ -0,0 +1,101 @@
+#ifndef __IMAGE_H__
+#define __IMAGE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 功能: 图片缩放采样, RGB888/RGBA8888 到 RGB565 的转换(SSE2/NEON 向量化)以及 4x4 Bayer 有序抖动.
+// 绘制时逐行处理: 先把源图采样成目标宽度的 RGBA8888 行, 需要时与原内容按 alpha 混合,
+// 再整行转换为 RGB565.
+//
+// example:
+//   image_t* img = image_load_ppm("avatar.ppm");
+//   image_scale_row(img->data, img->width, img->height, img->stride, img->format,
+//       64, 64, y, 0, 64, IMAGE_SCALE_BILINEAR, rgba);
+//   image_rgba_to_rgb565(rgba, 64, 0, y, 1, row);
+//   image_exit(img);
+
+typedef enum image_format_t {
+    IMAGE_FORMAT_RGB888 = 0,  // 每像素 3 字节 R G B
+    IMAGE_FORMAT_RGBA8888,    // 每像素 4 字节 R G B A
+} image_format_t;
+
+typedef enum image_scale_t {
+    IMAGE_SCALE_NEAREST = 0,  // 最近邻
+    IMAGE_SCALE_BILINEAR,     // 双线性
+} image_scale_t;
+
+#define IMAGE_FORMAT_BPP(f) ((f) == IMAGE_FORMAT_RGBA8888 ? 4 : 3)  // 每像素字节数
+
+typedef struct image_t {
+    uint8_t* data;          // 像素
+    size_t width;           // 宽
+    size_t height;          // 高
+    size_t stride;          // 每行字节数
+    image_format_t format;  // 像素格式
+} image_t;
+
+/**
+ * 读取 PPM(P6, 最大值 255) 图片。
+ *
+ * @param path 文件路径。
+ * @return 成功返回 RGB888 图片，失败返回 NULL。
+ */
+image_t* image_load_ppm(const char* path);
+
+/**
+ * 释放图片。
+ *
+ * @param img 指向图片的指针。
+ */
+void image_exit(image_t* img);
+
+/**
+ * 把源图缩放到 dst_w x dst_h 后的第 dy 行中 [x0, x1) 列采样为 RGBA8888。
+ *
+ * @param src 源图像素。
+ * @param src_w 源图宽。
+ * @param src_h 源图高。
+ * @param stride 源图每行字节数。
+ * @param format 源图像素格式, RGB888 输出的 alpha 为 255。
+ * @param dst_w 缩放后的宽。
+ * @param dst_h 缩放后的高。
+ * @param dy 缩放后的行。
+ * @param x0 开始列。
+ * @param x1 结束列(不含)。
+ * @param scale 采样方式。
+ * @param rgba 输出, (x1 - x0) * 4 字节。
+ */
+void image_scale_row(const uint8_t* src, size_t src_w, size_t src_h, size_t stride, image_format_t format,
+    size_t dst_w, size_t dst_h, size_t dy, size_t x0, size_t x1, image_scale_t scale, uint8_t* rgba);
+
+/**
+ * 按 alpha 把 RGBA8888 行与已有的 RGB565 内容混合, 结果写回 rgba(alpha 置为 255)。
+ *
+ * @param rgba RGBA8888 行。
+ * @param dst 已有内容。
+ * @param n 像素数。
+ */
+void image_blend_row(uint8_t* rgba, const uint16_t* dst, size_t n);
+
+/**
+ * RGBA8888 行转换为 RGB565, alpha 被忽略。
+ *
+ * @param rgba RGBA8888 行。
+ * @param n 像素数。
+ * @param x 第一个像素在屏幕上的 x, 用于对齐抖动矩阵。
+ * @param y 行在屏幕上的 y, 用于对齐抖动矩阵。
+ * @param dither 是否使用 4x4 Bayer 有序抖动。
+ * @param out 输出 RGB565。
+ */
+void image_rgba_to_rgb565(const uint8_t* rgba, size_t n, size_t x, size_t y, int dither, uint16_t* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__IMAGE_H__
@@ -0,0 +1,579 @@
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "meter.h"
+
+#define METER_IDLE_MS (1000)          // 没有数据也没有动画时的等待时间
+#define METER_FLOOR_DB (-60.0f)       // 显示范围下限, 低于此值视为静音
+#define METER_FALL_MS (300)           // 电平条从满幅落到零的时间
+#define METER_PEAK_HOLD_MS (600)      // 峰值保持时间
+#define METER_PEAK_WIDTH (2)          // 峰值标记宽度
+#define METER_COLOR_FG (0x07e0U)      // 默认电平颜色, 绿色
+
+struct meter_t {
+    size_t width;                // 控件宽
+    size_t height;               // 控件高
+    int style;                   // 显示样式
+    uint64_t period_ns;          // 最短帧间隔
+    size_t window;               // 每个电平的采样数
+    uint32_t colors;             // 低 16 位电平颜色, 高 16 位背景色
+    meter_draw_fn draw;          // 输出回调
+    void* arg;                   // 传给 draw 的参数
+
+    int16_t* samples;            // PCM 队列(单声道)
+    size_t sample_head;          // 生产位置, 只由生产者写
+    size_t sample_tail;          // 消费位置, 只由控件线程写
+    uint16_t* levels;            // 电平队列, RMS 0 ~ 32767
+    size_t level_head;           // 生产位置, 只由生产者写
+    size_t level_tail;           // 消费位置, 只由控件线程写
+    size_t dropped;              // 丢弃个数
+    int waiting;                 // 控件线程是否在等待数据, 生产者据此决定是否唤醒
+
+    pthread_t thread;            // 控件线程
+    int thread_running;          // 控件线程是否已启动
+    int stop;                    // 通知控件线程退出
+    int event_fd;                // 唤醒控件线程
+
+    // 以下只由控件线程访问
+    uint64_t acc_sq;             // 当前窗口的平方和
+    size_t acc_n;                // 当前窗口的采样数
+    uint16_t* history;           // 波形: 每列的电平(像素高度), 环形
+    size_t history_pos;          // 波形: 最旧一列的位置
+    float bar;                   // 电平条: 当前长度, 0.0 ~ 1.0
+    float peak;                  // 电平条: 峰值位置, 0.0 ~ 1.0
+    uint64_t peak_time;          // 电平条: 峰值更新时间
+    size_t shown_bar;            // 上一帧电平条像素长度
+    size_t shown_peak;           // 上一帧峰值像素位置
+    uint32_t shown_colors;       // 上一帧颜色
+    size_t frames;               // 输出帧数
+    framebuffer_color_t* pixels; // 控件画面
+};
+
+static inline uint64_t meter_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief RMS 转换为显示比例, 按 dB 线性, METER_FLOOR_DB 以下为 0
+ */
+static inline float meter_level_frac(uint16_t rms)
+{
+    if (!rms)
+        return 0.0f;
+    float db = 20.0f * log10f(rms / 32767.0f);
+    if (db <= METER_FLOOR_DB)
+        return 0.0f;
+    return db >= 0.0f ? 1.0f : 1.0f - db / METER_FLOOR_DB;
+}
+
+/**
+ * @brief 生产者发布数据后, 控件线程在等待时唤醒它
+ */
+static inline void meter_wakeup(meter_t* m)
+{
+    if (__atomic_load_n(&m->waiting, __ATOMIC_SEQ_CST)) {
+        uint64_t one = 1;
+        write(m->event_fd, &one, sizeof(one));
+    }
+}
+
+/**
+ * 送入 PCM, 多声道时取平均。只能有一个线程送入, 队列满时丢弃多出的部分。
+ * 参数与 audio_capture_tap_fn 一致, 可以直接作为采集引擎的旁路回调。
+ *
+ * @param meter 指向控件的指针。
+ * @param pcm 交错存放的 16 位 PCM。
+ * @param frames 帧数。
+ * @param channels 声道数。
+ * @return 成功返回 0，有数据被丢弃返回 -1。
+ */
+int meter_push_pcm(void* meter, const int16_t* pcm, size_t frames, unsigned channels)
+{
+    meter_t* m = (meter_t*)meter;
+    if (!m || !pcm || !channels)
+        return -1;
+
+    size_t head = m->sample_head;
+    size_t space = METER_RING_SAMPLES - (head - __atomic_load_n(&m->sample_tail, __ATOMIC_ACQUIRE));
+    size_t n = frames < space ? frames : space;
+    for (size_t i = 0; i < n; ++i) {
+        int32_t sum = 0;
+        for (unsigned c = 0; c < channels; ++c)
+            sum += pcm[i * channels + c];
+        m->samples[(head + i) & (METER_RING_SAMPLES - 1)] = (int16_t)(sum / (int32_t)channels);
+    }
+    __atomic_store_n(&m->sample_head, head + n, __ATOMIC_SEQ_CST);
+    meter_wakeup(m);
+
+    if (n < frames) {
+        __atomic_add_fetch(&m->dropped, frames - n, __ATOMIC_RELAXED);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 送入一个已算好的电平, 相当于一个窗口的 RMS。只能有一个线程送入, 队列满时丢弃。
+ *
+ * @param m 指向控件的指针。
+ * @param level 电平, 0.0 ~ 1.0 对应 RMS 0 ~ 满幅。
+ * @return 成功返回 0，队列满返回 -1。
+ */
+int meter_push_level(meter_t* m, float level)
+{
+    if (!m)
+        return -1;
+
+    size_t head = m->level_head;
+    if (head - __atomic_load_n(&m->level_tail, __ATOMIC_ACQUIRE) >= METER_RING_LEVELS) {
+        __atomic_add_fetch(&m->dropped, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+    level = level < 0.0f ? 0.0f : level > 1.0f ? 1.0f : level;
+    m->levels[head & (METER_RING_LEVELS - 1)] = (uint16_t)(level * 32767.0f + 0.5f);
+    __atomic_store_n(&m->level_head, head + 1, __ATOMIC_SEQ_CST);
+    meter_wakeup(m);
+
+    return 0;
+}
+
+/**
+ * @brief 收到一个电平
+ *
+ * @return 画面需要更新返回 1
+ */
+static int meter_add_level(meter_t* m, uint16_t rms, uint64_t now)
+{
+    float frac = meter_level_frac(rms);
+    if (m->style == METER_STYLE_WAVE) {
+        m->history[m->history_pos] = (uint16_t)(frac * m->height + 0.5f);
+        m->history_pos = (m->history_pos + 1) % m->width;
+        return 1;
+    }
+
+    if (frac > m->bar)
+        m->bar = frac;
+    if (frac >= m->peak) {
+        m->peak = frac;
+        m->peak_time = now;
+    }
+    return 0;
+}
+
+/**
+ * @brief 取出队列中的所有数据
+ *
+ * @return 画面需要更新返回 1
+ */
+static int meter_consume(meter_t* m, uint64_t now)
+{
+    int changed = 0;
+
+    size_t tail = m->sample_tail;
+    size_t head = __atomic_load_n(&m->sample_head, __ATOMIC_ACQUIRE);
+    for (; tail != head; ++tail) {
+        int32_t s = m->samples[tail & (METER_RING_SAMPLES - 1)];
+        m->acc_sq += (uint64_t)(s * s);
+        if (++m->acc_n == m->window) {
+            changed |= meter_add_level(m, (uint16_t)sqrtf((float)(m->acc_sq / m->window)), now);
+            m->acc_sq = 0;
+            m->acc_n = 0;
+        }
+    }
+    __atomic_store_n(&m->sample_tail, tail, __ATOMIC_RELEASE);
+
+    tail = m->level_tail;
+    head = __atomic_load_n(&m->level_head, __ATOMIC_ACQUIRE);
+    for (; tail != head; ++tail)
+        changed |= meter_add_level(m, m->levels[tail & (METER_RING_LEVELS - 1)], now);
+    __atomic_store_n(&m->level_tail, tail, __ATOMIC_RELEASE);
+
+    return changed;
+}
+
+/**
+ * @brief 电平条随时间回落, 峰值保持一段时间后跟着回落
+ *
+ * @param elapsed 距上一帧的时间
+ */
+static void meter_decay(meter_t* m, uint64_t now, uint64_t elapsed)
+{
+    float fall = (float)elapsed / (METER_FALL_MS * 1000000.0f);
+    m->bar = m->bar > fall ? m->bar - fall : 0.0f;
+    if (now - m->peak_time > METER_PEAK_HOLD_MS * 1000000ULL)
+        m->peak = m->peak > fall ? m->peak - fall : 0.0f;
+    if (m->peak < m->bar)
+        m->peak = m->bar;
+}
+
+/**
+ * @brief 画出控件画面
+ */
+static void meter_render(meter_t* m, framebuffer_color_t fg, framebuffer_color_t bg)
+{
+    size_t w = m->width;
+    size_t h = m->height;
+    framebuffer_color_t* p = m->pixels;
+
+    if (m->style == METER_STYLE_WAVE) {
+        // 每列以中线为轴上下对称, 静音时留一条中线
+        for (size_t i = 0; i < w * h; ++i)
+            p[i] = bg;
+        for (size_t x = 0; x < w; ++x) {
+            size_t col = m->history[(m->history_pos + x) % w];
+            col = col ? col : 1;
+            size_t y0 = (h - col) / 2;
+            for (size_t y = y0; y < y0 + col; ++y)
+                p[y * w + x] = fg;
+        }
+        return;
+    }
+
+    // 电平条每行相同, 画第一行后复制
+    for (size_t x = 0; x < w; ++x)
+        p[x] = x < m->shown_bar ? fg : bg;
+    if (m->shown_peak) {
+        size_t x0 = m->shown_peak > METER_PEAK_WIDTH ? m->shown_peak - METER_PEAK_WIDTH : 0;
+        for (size_t x = x0; x < m->shown_peak; ++x)
+            p[x] = fg;
+    }
+    for (size_t y = 1; y < h; ++y)
+        memcpy(p + y * w, p, w * COLOR_SIZE);
+}
+
+/**
+ * @brief 控件线程: 取数据, 按帧率上限重画有变化的画面
+ *
+ * @param arg 指向控件的指针
+ */
+static void* meter_thread(void* arg)
+{
+    meter_t* m = (meter_t*)arg;
+    uint64_t last = meter_now_ns();
+    int animating = 0;
+    int first = 1;
+
+    while (!__atomic_load_n(&m->stop, __ATOMIC_ACQUIRE)) {
+        if (!animating && !first) {
+            // 先声明在等待再检查队列, 与生产者先发布再检查 waiting 配对, 不会漏掉唤醒
+            __atomic_store_n(&m->waiting, 1, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&m->sample_head, __ATOMIC_SEQ_CST) == m->sample_tail
+                && __atomic_load_n(&m->level_head, __ATOMIC_SEQ_CST) == m->level_tail
+                && !__atomic_load_n(&m->stop, __ATOMIC_ACQUIRE)) {
+                struct pollfd pfd = { m->event_fd, POLLIN, 0 };
+                poll(&pfd, 1, METER_IDLE_MS);
+            }
+            __atomic_store_n(&m->waiting, 0, __ATOMIC_RELAXED);
+            uint64_t count = 0;
+            read(m->event_fd, &count, sizeof(count));
+        }
+
+        // 帧率上限: 距上一帧不足一个间隔时等到下一帧, 期间到达的数据合并到这一帧
+        uint64_t deadline = last + m->period_ns;
+        uint64_t now = meter_now_ns();
+        if (now < deadline) {
+            struct timespec ts = { (time_t)(deadline / 1000000000ULL), (long)(deadline % 1000000000ULL) };
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+                ;
+            now = meter_now_ns();
+        }
+        if (__atomic_load_n(&m->stop, __ATOMIC_ACQUIRE))
+            break;
+
+        int changed = meter_consume(m, now) || first;
+        if (m->style == METER_STYLE_BAR) {
+            meter_decay(m, now, now - last);
+            size_t bar = (size_t)(m->bar * m->width + 0.5f);
+            size_t peak = (size_t)(m->peak * m->width + 0.5f);
+            changed |= bar != m->shown_bar || peak != m->shown_peak;
+            m->shown_bar = bar;
+            m->shown_peak = peak;
+            animating = m->bar > 0.0f || m->peak > 0.0f;
+        }
+        last = now;
+
+        uint32_t colors = __atomic_load_n(&m->colors, __ATOMIC_RELAXED);
+        if (!changed && colors == m->shown_colors)
+            continue;
+        m->shown_colors = colors;
+        meter_render(m, (framebuffer_color_t)colors, (framebuffer_color_t)(colors >> 16));
+        m->draw(m->arg, m->pixels, m->width, m->height);
+        __atomic_add_fetch(&m->frames, 1, __ATOMIC_RELAXED);
+        first = 0;
+    }
+
+    return NULL;
+}
+
+/**
+ * 设置颜色, 下一帧生效。
+ *
+ * @param m 指向控件的指针。
+ * @param fg 电平颜色。
+ * @param bg 背景色。
+ */
+void meter_set_color(meter_t* m, framebuffer_color_t fg, framebuffer_color_t bg)
+{
+    if (!m)
+        return;
+    __atomic_store_n(&m->colors, (uint32_t)bg << 16 | fg, __ATOMIC_RELAXED);
+    meter_wakeup(m);
+}
+
+/**
+ * 获取因队列满而丢弃的采样和电平个数。
+ *
+ * @param m 指向控件的指针。
+ * @return 丢弃个数。
+ */
+size_t meter_dropped(const meter_t* m)
+{
+    return m ? __atomic_load_n(&m->dropped, __ATOMIC_RELAXED) : 0;
+}
+
+/**
+ * 获取控件线程实际输出的帧数。
+ *
+ * @param m 指向控件的指针。
+ * @return 帧数。
+ */
+size_t meter_frames(const meter_t* m)
+{
+    return m ? __atomic_load_n(&m->frames, __ATOMIC_RELAXED) : 0;
+}
+
+/**
+ * 停止控件线程并释放控件, 返回后不会再调用 draw。
+ *
+ * @param m 指向控件的指针。
+ */
+void meter_exit(meter_t* m)
+{
+    if (!m)
+        return;
+
+    if (m->thread_running) {
+        __atomic_store_n(&m->stop, 1, __ATOMIC_RELEASE);
+        uint64_t one = 1;
+        write(m->event_fd, &one, sizeof(one));
+        pthread_join(m->thread, NULL);
+        m->thread_running = 0;
+    }
+    if (m->dropped)
+        LOG_DBG("meter(%p) dropped %zu", m, m->dropped);
+    if (m->event_fd >= 0) {
+        close(m->event_fd);
+        m->event_fd = -1;
+    }
+    free(m->samples);
+    free(m->levels);
+    free(m->history);
+    free(m->pixels);
+    free(m);
+}
+
+/**
+ * 创建电平控件并启动控件线程。
+ *
+ * @param w 控件宽。
+ * @param h 控件高。
+ * @param style 显示样式, meter_style_t。
+ * @param fps 帧率上限, 0 使用默认值。
+ * @param window 每个电平的采样数, 0 使用默认值。
+ * @param draw 输出回调。
+ * @param arg 传给 draw 的参数。
+ * @return 成功返回控件指针，失败返回 NULL。
+ */
+meter_t* meter_init(size_t w, size_t h, int style, size_t fps, size_t window, meter_draw_fn draw, void* arg)
+{
+    if (!w || !h || !draw || (style != METER_STYLE_BAR && style != METER_STYLE_WAVE)) {
+        LOG_DBG("arg failed: size(%zux%zu) style(%d) draw(%p)", w, h, style, draw);
+        return NULL;
+    }
+
+    meter_t* m = (meter_t*)malloc(sizeof(meter_t));
+    if (!m) {
+        LOG_ERR("fail to malloc meter");
+        return NULL;
+    }
+    memset(m, 0, sizeof(meter_t));
+    m->event_fd = -1;
+    m->width = w;
+    m->height = h;
+    m->style = style;
+    m->period_ns = 1000000000ULL / (fps ? fps : METER_FPS_DEFAULT);
+    m->window = window ? window : METER_WINDOW_DEFAULT;
+    m->colors = (uint32_t)COLOR_BLACK << 16 | METER_COLOR_FG;
+    m->draw = draw;
+    m->arg = arg;
+
+    m->samples = (int16_t*)malloc(METER_RING_SAMPLES * sizeof(int16_t));
+    m->levels = (uint16_t*)malloc(METER_RING_LEVELS * sizeof(uint16_t));
+    m->history = (uint16_t*)calloc(w, sizeof(uint16_t));
+    m->pixels = (framebuffer_color_t*)malloc(w * h * COLOR_SIZE);
+    if (!m->samples || !m->levels || !m->history || !m->pixels) {
+        LOG_ERR("fail to malloc meter buffer(%zux%zu)", w, h);
+        goto err;
+    }
+
+    m->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m->event_fd < 0) {
+        LOG_ERR("fail to create eventfd: %s", strerror(errno));
+        goto err;
+    }
+
+    if (pthread_create(&m->thread, NULL, meter_thread, m)) {
+        LOG_ERR("fail to create meter thread");
+        goto err;
+    }
+    m->thread_running = 1;
+
+    LOG_DBG("meter(%p) %zux%zu style(%d) period(%llu ns) window(%zu)", m, w, h, style,
+        (unsigned long long)m->period_ns, m->window);
+
+    return m;
+err:
+    meter_exit(m);
+    return NULL;
+}
+
+#ifdef __XTEST__
+
+char g_dbg_enable = 1;
+
+#define TEST_W (32)
+#define TEST_H (8)
+
+typedef struct test_ctx_t {
+    pthread_mutex_t lock;
+    framebuffer_color_t pixels[TEST_W * TEST_H];
+    size_t draws;
+} test_ctx_t;
+
+static void test_draw(void* arg, const framebuffer_color_t* pixels, size_t w, size_t h)
+{
+    test_ctx_t* ctx = (test_ctx_t*)arg;
+    assert(w == TEST_W && h == TEST_H);
+    pthread_mutex_lock(&ctx->lock);
+    memcpy(ctx->pixels, pixels, sizeof(ctx->pixels));
+    ctx->draws++;
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+/**
+ * @brief 等待 cond 成立, 最多 1 秒
+ */
+static int test_wait(test_ctx_t* ctx, int (*cond)(const framebuffer_color_t*))
+{
+    for (int i = 0; i < 200; ++i) {
+        pthread_mutex_lock(&ctx->lock);
+        int ok = ctx->draws && cond(ctx->pixels);
+        pthread_mutex_unlock(&ctx->lock);
+        if (ok)
+            return 1;
+        usleep(5000);
+    }
+    return 0;
+}
+
+static int test_bar_full(const framebuffer_color_t* p)
+{
+    return p[0] == METER_COLOR_FG && p[TEST_W - 1] == METER_COLOR_FG && p[(TEST_H - 1) * TEST_W] == METER_COLOR_FG;
+}
+
+static int test_bar_empty(const framebuffer_color_t* p)
+{
+    for (size_t i = 0; i < TEST_W * TEST_H; ++i)
+        if (p[i] != COLOR_BLACK)
+            return 0;
+    return 1;
+}
+
+static int test_wave_loud(const framebuffer_color_t* p)
+{
+    // 最新一列在最右边, 满幅时整列都是电平色
+    for (size_t y = 0; y < TEST_H; ++y)
+        if (p[y * TEST_W + TEST_W - 1] != METER_COLOR_FG)
+            return 0;
+    // 最左边仍是静音的中线
+    return p[(TEST_H - 1) / 2 * TEST_W] == METER_COLOR_FG && p[0] == COLOR_BLACK;
+}
+
+int main(void)
+{
+    assert(meter_level_frac(0) == 0.0f && meter_level_frac(32767) == 1.0f);
+    assert(meter_level_frac(32) == 0.0f);  // -60dB 以下
+    assert(fabsf(meter_level_frac(1036) - 0.5f) < 0.01f);  // -30dB
+
+    test_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    pthread_mutex_init(&ctx.lock, NULL);
+
+    // 电平条: 满幅后回落到零, 然后停止重画
+    meter_t* m = meter_init(TEST_W, TEST_H, METER_STYLE_BAR, 100, 0, test_draw, &ctx);
+    assert(m);
+    assert(0 == meter_push_level(m, 1.0f));
+    assert(test_wait(&ctx, test_bar_full));
+    assert(test_wait(&ctx, test_bar_empty));
+    usleep(50000);
+    size_t idle = meter_frames(m);
+    usleep(100000);
+    assert(meter_frames(m) == idle);
+    meter_exit(m);
+
+    // 帧率上限: 电平条一直在回落, 每帧都有变化, 帧数不超过上限
+    memset(ctx.pixels, 0, sizeof(ctx.pixels));
+    ctx.draws = 0;
+    m = meter_init(TEST_W, TEST_H, METER_STYLE_BAR, 20, 0, test_draw, &ctx);
+    assert(m);
+    uint64_t start = meter_now_ns();
+    for (int i = 0; i < 250; ++i) {
+        if (i % 50 == 0)
+            meter_push_level(m, 1.0f);
+        usleep(2000);
+    }
+    double secs = (meter_now_ns() - start) / 1e9;
+    size_t frames = meter_frames(m);
+    printf("bar: %zu frames in %.2fs at 20fps cap\n", frames, secs);
+    assert(frames > (size_t)(secs * 10) && frames <= (size_t)(secs * 20) + 2);
+    meter_exit(m);
+
+    // 波形: 静音后满幅方波, 最新一列在最右边
+    memset(ctx.pixels, 0, sizeof(ctx.pixels));
+    ctx.draws = 0;
+    m = meter_init(TEST_W, TEST_H, METER_STYLE_WAVE, 100, 4, test_draw, &ctx);
+    assert(m);
+    int16_t pcm[2 * 8];
+    memset(pcm, 0, sizeof(pcm));
+    assert(0 == meter_push_pcm(m, pcm, 8, 2));
+    for (int i = 0; i < 16; ++i)
+        pcm[i] = (i / 2) % 2 ? 32767 : -32767;
+    assert(0 == meter_push_pcm(m, pcm, 8, 2));
+    assert(test_wait(&ctx, test_wave_loud));
+
+    // 队列满时丢弃
+    static int16_t burst[METER_RING_SAMPLES * 2];
+    memset(burst, 0, sizeof(burst));
+    assert(-1 == meter_push_pcm(m, burst, METER_RING_SAMPLES * 2, 1));
+    assert(meter_dropped(m) >= METER_RING_SAMPLES);
+    meter_exit(m);
+
+    pthread_mutex_destroy(&ctx.lock);
+    printf("meter test pass\n");
+    return 0;
+}
+
+#endif //__XTEST__
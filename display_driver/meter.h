@@ -0,0 +1,116 @@
+#ifndef __METER_H__
+#define __METER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "framebuffer.h"
+
+// 功能: 录音电平/波形控件. 采集线程通过无锁单生产者环形队列送入 PCM 或已算好的电平,
+// 控件线程按窗口计算 RMS, 以不超过 fps 的帧率把控件区域画成 RGB565 交给 draw 回调,
+// 画面没有变化时不重画, 没有数据也没有衰减动画时不唤醒.
+//
+// example:
+//   meter_t* m = meter_init(160, 16, METER_STYLE_WAVE, 30, 320, draw_rect, ctx);
+//   meter_push_pcm(m, pcm, frames, 1);   // 采集线程
+//   meter_exit(m);
+
+#define METER_FPS_DEFAULT (30)          // 默认帧率上限
+#define METER_WINDOW_DEFAULT (320)      // 默认每个电平的采样数, 16kHz 下为 20ms
+#define METER_RING_SAMPLES (16 * 1024)  // PCM 队列长度(单声道采样)
+#define METER_RING_LEVELS (256)         // 电平队列长度
+
+typedef enum meter_style_t {
+    METER_STYLE_BAR = 0,  // 横向电平条, 带峰值保持
+    METER_STYLE_WAVE,     // 从右向左滚动的波形包络, 每列一个窗口
+} meter_style_t;
+
+/**
+ * 把控件画面输出到屏幕, 在控件线程中调用。
+ *
+ * @param arg meter_init 传入的参数。
+ * @param pixels 控件画面, RGB565, 每行 w 个像素。
+ * @param w 宽。
+ * @param h 高。
+ */
+typedef void (*meter_draw_fn)(void* arg, const framebuffer_color_t* pixels, size_t w, size_t h);
+
+struct meter_t;
+typedef struct meter_t meter_t;
+
+/**
+ * 创建电平控件并启动控件线程。
+ *
+ * @param w 控件宽。
+ * @param h 控件高。
+ * @param style 显示样式, meter_style_t。
+ * @param fps 帧率上限, 0 使用默认值。
+ * @param window 每个电平的采样数, 0 使用默认值。
+ * @param draw 输出回调。
+ * @param arg 传给 draw 的参数。
+ * @return 成功返回控件指针，失败返回 NULL。
+ */
+meter_t* meter_init(size_t w, size_t h, int style, size_t fps, size_t window, meter_draw_fn draw, void* arg);
+
+/**
+ * 停止控件线程并释放控件, 返回后不会再调用 draw。
+ *
+ * @param m 指向控件的指针。
+ */
+void meter_exit(meter_t* m);
+
+/**
+ * 设置颜色, 下一帧生效。
+ *
+ * @param m 指向控件的指针。
+ * @param fg 电平颜色。
+ * @param bg 背景色。
+ */
+void meter_set_color(meter_t* m, framebuffer_color_t fg, framebuffer_color_t bg);
+
+/**
+ * 送入 PCM, 多声道时取平均。只能有一个线程送入, 队列满时丢弃多出的部分。
+ * 参数与 audio_capture_tap_fn 一致, 可以直接作为采集引擎的旁路回调。
+ *
+ * @param meter 指向控件的指针。
+ * @param pcm 交错存放的 16 位 PCM。
+ * @param frames 帧数。
+ * @param channels 声道数。
+ * @return 成功返回 0，有数据被丢弃返回 -1。
+ */
+int meter_push_pcm(void* meter, const int16_t* pcm, size_t frames, unsigned channels);
+
+/**
+ * 送入一个已算好的电平, 相当于一个窗口的 RMS。只能有一个线程送入, 队列满时丢弃。
+ *
+ * @param m 指向控件的指针。
+ * @param level 电平, 0.0 ~ 1.0 对应 RMS 0 ~ 满幅。
+ * @return 成功返回 0，队列满返回 -1。
+ */
+int meter_push_level(meter_t* m, float level);
+
+/**
+ * 获取因队列满而丢弃的采样和电平个数。
+ *
+ * @param m 指向控件的指针。
+ * @return 丢弃个数。
+ */
+size_t meter_dropped(const meter_t* m);
+
+/**
+ * 获取控件线程实际输出的帧数。
+ *
+ * @param m 指向控件的指针。
+ * @return 帧数。
+ */
+size_t meter_frames(const meter_t* m);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__METER_H__
@@ -0,0 +1,348 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "shadow.h"
+
+/**
+ * @brief 调色板变化后重建展开表
+ */
+static void shadow_build_lut(shadow_t* s)
+{
+    for (size_t b = 0; b < 256; ++b) {
+        if (s->bpp == SHADOW_BPP_MONO) {
+            for (size_t i = 0; i < 8; ++i)
+                s->mono[b][i] = s->palette[(b >> (7 - i)) & 1];
+        } else {
+            s->pair[b][0] = s->palette[b >> 4];
+            s->pair[b][1] = s->palette[b & 0x0f];
+        }
+    }
+}
+
+/**
+ * @brief 两个 RGB565 颜色的距离, 各分量扩展到 8 位后计算平方和
+ */
+static inline uint32_t shadow_distance(framebuffer_color_t a, framebuffer_color_t b)
+{
+    int dr = ((a >> 11) & 0x1f) * 255 / 31 - ((b >> 11) & 0x1f) * 255 / 31;
+    int dg = ((a >> 5) & 0x3f) * 255 / 63 - ((b >> 5) & 0x3f) * 255 / 63;
+    int db = (a & 0x1f) * 255 / 31 - (b & 0x1f) * 255 / 31;
+    return dr * dr + dg * dg + db * db;
+}
+
+/**
+ * 获取颜色对应的调色板下标, 4 位时调色板没满会分配新下标, 不能与写入并发调用。
+ *
+ * @param s 指向缓存的指针。
+ * @param color 颜色。
+ * @return 调色板下标。
+ */
+uint8_t shadow_index(shadow_t* s, framebuffer_color_t color)
+{
+    if (s->bpp == SHADOW_BPP_MONO)
+        return color != s->palette[0];
+
+    for (size_t i = 0; i < s->colors; ++i) {
+        if (s->palette[i] == color)
+            return i;
+    }
+    if (s->colors < SHADOW_COLORS_MAX) {
+        s->palette[s->colors] = color;
+        shadow_build_lut(s);
+        return s->colors++;
+    }
+
+    uint8_t best = 0;
+    uint32_t best_distance = UINT32_MAX;
+    for (size_t i = 0; i < s->colors; ++i) {
+        uint32_t distance = shadow_distance(s->palette[i], color);
+        if (distance < best_distance) {
+            best = i;
+            best_distance = distance;
+        }
+    }
+    return best;
+}
+
+/**
+ * 把矩形区域设置为同一个下标, 超出范围的部分被裁剪掉。
+ *
+ * @param s 指向缓存的指针。
+ * @param x 区域 x。
+ * @param y 区域 y。
+ * @param w 区域宽。
+ * @param h 区域高。
+ * @param index 调色板下标。
+ */
+void shadow_fill(shadow_t* s, size_t x, size_t y, size_t w, size_t h, uint8_t index)
+{
+    if (x >= s->width || y >= s->height)
+        return;
+    size_t x1 = x + w < s->width ? x + w : s->width;
+    size_t y1 = y + h < s->height ? y + h : s->height;
+
+    // 每字节的像素数, 中间的整字节直接 memset, 两端逐像素
+    size_t per_byte = 8 / s->bpp;
+    uint8_t value = s->bpp == SHADOW_BPP_MONO ? (index ? 0xff : 0x00) : (index & 0x0f) * 0x11;
+    size_t head = (x + per_byte - 1) / per_byte * per_byte;
+    size_t tail = x1 / per_byte * per_byte;
+    for (size_t row = y; row < y1; ++row) {
+        if (head >= tail) {
+            for (size_t col = x; col < x1; ++col)
+                shadow_set(s, col, row, index);
+            continue;
+        }
+        for (size_t col = x; col < head; ++col)
+            shadow_set(s, col, row, index);
+        memset(s->bits + row * s->stride + head / per_byte, value, (tail - head) / per_byte);
+        for (size_t col = tail; col < x1; ++col)
+            shadow_set(s, col, row, index);
+    }
+}
+
+/**
+ * 把一行 RGB565 像素量化后写入, 超出范围的部分被裁剪掉。
+ *
+ * @param s 指向缓存的指针。
+ * @param x 起始 x。
+ * @param y 行。
+ * @param src 像素。
+ * @param n 像素个数。
+ */
+void shadow_pack_row(shadow_t* s, size_t x, size_t y, const framebuffer_color_t* src, size_t n)
+{
+    if (x >= s->width || y >= s->height)
+        return;
+    n = x + n < s->width ? n : s->width - x;
+
+    // 图片相邻像素常常相同, 记住上一个颜色省掉查找
+    framebuffer_color_t last = src[0];
+    uint8_t index = shadow_index(s, last);
+    for (size_t i = 0; i < n; ++i) {
+        if (src[i] != last) {
+            last = src[i];
+            index = shadow_index(s, last);
+        }
+        shadow_set(s, x + i, y, index);
+    }
+}
+
+/**
+ * 把一行展开为 RGB565, 调用者保证范围在缓存内。
+ *
+ * @param s 指向缓存的指针。
+ * @param x 起始 x。
+ * @param y 行。
+ * @param dst 输出像素。
+ * @param n 像素个数。
+ */
+void shadow_unpack_row(const shadow_t* s, size_t x, size_t y, framebuffer_color_t* dst, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        dst[i] = s->palette[shadow_get(s, x + i, y)];
+}
+
+/**
+ * 把区域展开为 RGB565。
+ *
+ * @param s 指向缓存的指针。
+ * @param r 区域, 调用者保证在缓存范围内。
+ * @param dst 目标画面 (0, 0) 的地址, 只写入区域内的像素。
+ * @param dst_stride 目标画面每行字节数。
+ */
+void shadow_expand(const shadow_t* s, const frame_rect_t* r, framebuffer_color_t* dst, size_t dst_stride)
+{
+    size_t x1 = r->x + r->w;
+    size_t per_byte = 8 / s->bpp;
+    size_t head = (r->x + per_byte - 1) / per_byte * per_byte;
+    size_t tail = x1 / per_byte * per_byte;
+    if (head > tail)
+        head = tail = x1;
+
+    for (size_t row = r->y; row < r->y + r->h; ++row) {
+        framebuffer_color_t* out = (framebuffer_color_t*)((uint8_t*)dst + row * dst_stride);
+        const uint8_t* in = s->bits + row * s->stride;
+        for (size_t col = r->x; col < head; ++col)
+            out[col] = s->palette[shadow_get(s, col, row)];
+        if (s->bpp == SHADOW_BPP_MONO) {
+            for (size_t col = head; col < tail; col += 8)
+                memcpy(out + col, s->mono[in[col >> 3]], sizeof(s->mono[0]));
+        } else {
+            for (size_t col = head; col < tail; col += 2)
+                memcpy(out + col, s->pair[in[col >> 1]], sizeof(s->pair[0]));
+        }
+        for (size_t col = tail; col < x1; ++col)
+            out[col] = s->palette[shadow_get(s, col, row)];
+    }
+}
+
+/**
+ * 释放紧凑显示缓存。
+ *
+ * @param s 指向缓存的指针。
+ */
+void shadow_exit(shadow_t* s)
+{
+    if (!s)
+        return;
+    if (s->bits) {
+        free(s->bits);
+        s->bits = NULL;
+    }
+    free(s);
+}
+
+/**
+ * 创建紧凑显示缓存, 内容为黑色。
+ *
+ * @param width 宽。
+ * @param height 高。
+ * @param bpp 每像素位数, SHADOW_BPP_MONO 或 SHADOW_BPP_INDEX4。
+ * @param palette 预设调色板, 第一个颜色被替换为黑色, NULL 时 1 位为黑/白, 4 位只有黑色。
+ * @param colors 预设颜色数。
+ * @return 成功返回缓存指针，失败返回 NULL。
+ */
+shadow_t* shadow_init(size_t width, size_t height, size_t bpp, const framebuffer_color_t* palette, size_t colors)
+{
+    if (!width || !height || (bpp != SHADOW_BPP_MONO && bpp != SHADOW_BPP_INDEX4)) {
+        LOG_ERR("bad shadow %zux%zu %zubpp", width, height, bpp);
+        return NULL;
+    }
+
+    shadow_t* s = (shadow_t*)malloc(sizeof(shadow_t));
+    if (!s) {
+        LOG_ERR("fail to malloc shadow");
+        return NULL;
+    }
+    memset(s, 0, sizeof(shadow_t));
+    s->width = width;
+    s->height = height;
+    s->bpp = bpp;
+    s->stride = (width * bpp + 7) / 8;
+    s->size = s->stride * height;
+    s->bits = (uint8_t*)malloc(s->size);
+    if (!s->bits) {
+        LOG_ERR("fail to malloc shadow bits(%zu)", s->size);
+        shadow_exit(s);
+        return NULL;
+    }
+    memset(s->bits, 0, s->size);
+
+    size_t max = bpp == SHADOW_BPP_MONO ? 2 : SHADOW_COLORS_MAX;
+    colors = palette ? (colors < max ? colors : max) : 0;
+    for (size_t i = 1; i < colors; ++i)
+        s->palette[i] = palette[i];
+    s->palette[0] = COLOR_BLACK;
+    s->colors = colors ? colors : 1;
+    if (bpp == SHADOW_BPP_MONO && s->colors < 2) {
+        s->palette[1] = COLOR_WHITE;
+        s->colors = 2;
+    }
+    shadow_build_lut(s);
+    LOG_DBG("shadow(%p) %zux%zu %zubpp, %zu bytes", s, width, height, bpp, s->size);
+
+    return s;
+}
+
+#ifdef __XTEST__
+
+char g_dbg_enable = 1;
+
+#define TEST_W (37)
+#define TEST_H (5)
+
+/**
+ * @brief 用逐像素的方式计算期望结果, 与展开结果比较
+ */
+static void test_check(const shadow_t* s, const framebuffer_color_t* expect)
+{
+    framebuffer_color_t out[TEST_W * TEST_H];
+    frame_rect_t full = { 0, 0, TEST_W, TEST_H };
+    shadow_expand(s, &full, out, TEST_W * COLOR_SIZE);
+    assert(0 == memcmp(out, expect, sizeof(out)));
+}
+
+static void test_format(size_t bpp)
+{
+    shadow_t* s = shadow_init(TEST_W, TEST_H, bpp, NULL, 0);
+    assert(s && s->stride == (TEST_W * bpp + 7) / 8);
+
+    framebuffer_color_t expect[TEST_W * TEST_H];
+    memset(expect, 0, sizeof(expect));
+    test_check(s, expect);
+
+    // 不对齐的填充, 两端逐像素, 中间整字节
+    uint8_t white = shadow_index(s, COLOR_WHITE);
+    shadow_fill(s, 3, 1, 30, 3, white);
+    for (size_t y = 1; y < 4; ++y)
+        for (size_t x = 3; x < 33; ++x)
+            expect[y * TEST_W + x] = COLOR_WHITE;
+    test_check(s, expect);
+
+    // 单个字节内的填充和越界裁剪
+    shadow_fill(s, 5, 2, 2, 1, 0);
+    expect[2 * TEST_W + 5] = expect[2 * TEST_W + 6] = COLOR_BLACK;
+    shadow_fill(s, TEST_W - 2, TEST_H - 1, 100, 100, white);
+    expect[(TEST_H - 1) * TEST_W + TEST_W - 2] = expect[(TEST_H - 1) * TEST_W + TEST_W - 1] = COLOR_WHITE;
+    test_check(s, expect);
+
+    // 量化写入一行, 1 位时非黑色都是前景色
+    framebuffer_color_t row[TEST_W];
+    for (size_t x = 0; x < TEST_W; ++x)
+        row[x] = x % 3 ? COLOR_GREY : COLOR_BLACK;
+    shadow_pack_row(s, 1, 0, row, TEST_W);
+    for (size_t x = 1; x < TEST_W; ++x) {
+        framebuffer_color_t c = row[x - 1];
+        expect[x] = bpp == SHADOW_BPP_MONO && c != COLOR_BLACK ? COLOR_WHITE : c;
+    }
+    test_check(s, expect);
+
+    framebuffer_color_t line[TEST_W];
+    shadow_unpack_row(s, 0, 0, line, TEST_W);
+    assert(0 == memcmp(line, expect, sizeof(line)));
+
+    // 展开只写区域内的像素
+    framebuffer_color_t out[TEST_W * TEST_H];
+    memset(out, 0x5a, sizeof(out));
+    frame_rect_t r = { 7, 1, 11, 2 };
+    shadow_expand(s, &r, out, TEST_W * COLOR_SIZE);
+    for (size_t y = 0; y < TEST_H; ++y)
+        for (size_t x = 0; x < TEST_W; ++x) {
+            int in = x >= r.x && x < r.x + r.w && y >= r.y && y < r.y + r.h;
+            assert(out[y * TEST_W + x] == (in ? expect[y * TEST_W + x] : 0x5a5a));
+        }
+
+    printf("%zubpp: %zu bytes for %zu pixels\n", bpp, s->size, (size_t)TEST_W * TEST_H);
+    shadow_exit(s);
+}
+
+int main(void)
+{
+    test_format(SHADOW_BPP_MONO);
+    test_format(SHADOW_BPP_INDEX4);
+
+    // 调色板满后取最接近的颜色
+    shadow_t* s = shadow_init(8, 1, SHADOW_BPP_INDEX4, NULL, 0);
+    assert(s && shadow_index(s, COLOR_BLACK) == 0);
+    for (framebuffer_color_t i = 1; i < SHADOW_COLORS_MAX; ++i)
+        assert(shadow_index(s, i << 11) == i);
+    assert(shadow_index(s, COLOR_WHITE) == 15);
+    assert(shadow_index(s, (2 << 11) | 1) == 2);
+    shadow_exit(s);
+
+    // 预设调色板, 第一个颜色固定为黑色
+    const framebuffer_color_t palette[] = { COLOR_WHITE, COLOR_GREY };
+    s = shadow_init(8, 1, SHADOW_BPP_MONO, palette, 2);
+    assert(s && s->palette[0] == COLOR_BLACK && s->palette[1] == COLOR_GREY);
+    assert(shadow_index(s, COLOR_WHITE) == 1);
+    shadow_exit(s);
+
+    assert(!shadow_init(8, 8, 2, NULL, 0));
+    printf("shadow test pass\n");
+    return 0;
+}
+
+#endif //__XTEST__
@@ -0,0 +1,155 @@
+#ifndef __SHADOW_H__
+#define __SHADOW_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "frame_delta.h"
+#include "framebuffer.h"
+
+// 功能: 紧凑显示缓存. 每个像素只存调色板下标(1 位或 4 位), 每行按字节对齐,
+// 不同行之间不共享字节, 可以按水平条带并行写入. 刷新时只把变化区域展开为 RGB565.
+// 1 位时下标 0 为背景色, 其它颜色都映射为下标 1, 适合单色文字界面;
+// 4 位时前 16 种颜色按出现顺序分配下标, 之后的颜色取最接近的已有颜色.
+// 下标 0 固定为黑色, 清空就是把字节清零.
+//
+// example:
+//   shadow_t* s = shadow_init(240, 240, SHADOW_BPP_INDEX4, NULL, 0);
+//   shadow_set(s, x, y, shadow_index(s, COLOR_WHITE));
+//   shadow_expand(s, &dirty, screen, line_length);
+//   shadow_exit(s);
+
+#define SHADOW_BPP_MONO (1)     // 1 位, 2 色
+#define SHADOW_BPP_INDEX4 (4)   // 4 位, 16 色
+#define SHADOW_COLORS_MAX (16)  // 调色板最大颜色数
+
+typedef struct shadow_t {
+    size_t width;                     // 宽
+    size_t height;                    // 高
+    size_t bpp;                       // 每像素位数, SHADOW_BPP_MONO 或 SHADOW_BPP_INDEX4
+    size_t stride;                    // 每行字节数
+    size_t size;                      // 缓存大小
+    uint8_t* bits;                    // 缓存, 每字节高位在左
+    size_t colors;                    // 已分配的调色板颜色数
+    framebuffer_color_t palette[SHADOW_COLORS_MAX]; // 调色板, 下标 0 为黑色
+    framebuffer_color_t pair[256][2]; // 4 位: 一个字节展开为两个像素
+    framebuffer_color_t mono[256][8]; // 1 位: 一个字节展开为八个像素
+} shadow_t;
+
+/**
+ * 创建紧凑显示缓存, 内容为黑色。
+ *
+ * @param width 宽。
+ * @param height 高。
+ * @param bpp 每像素位数, SHADOW_BPP_MONO 或 SHADOW_BPP_INDEX4。
+ * @param palette 预设调色板, 第一个颜色被替换为黑色, NULL 时 1 位为黑/白, 4 位只有黑色。
+ * @param colors 预设颜色数。
+ * @return 成功返回缓存指针，失败返回 NULL。
+ */
+shadow_t* shadow_init(size_t width, size_t height, size_t bpp, const framebuffer_color_t* palette, size_t colors);
+
+/**
+ * 释放紧凑显示缓存。
+ *
+ * @param s 指向缓存的指针。
+ */
+void shadow_exit(shadow_t* s);
+
+/**
+ * 获取颜色对应的调色板下标, 4 位时调色板没满会分配新下标, 不能与写入并发调用。
+ *
+ * @param s 指向缓存的指针。
+ * @param color 颜色。
+ * @return 调色板下标。
+ */
+uint8_t shadow_index(shadow_t* s, framebuffer_color_t color);
+
+/**
+ * 把矩形区域设置为同一个下标, 超出范围的部分被裁剪掉。
+ *
+ * @param s 指向缓存的指针。
+ * @param x 区域 x。
+ * @param y 区域 y。
+ * @param w 区域宽。
+ * @param h 区域高。
+ * @param index 调色板下标。
+ */
+void shadow_fill(shadow_t* s, size_t x, size_t y, size_t w, size_t h, uint8_t index);
+
+/**
+ * 把一行 RGB565 像素量化后写入, 超出范围的部分被裁剪掉。
+ *
+ * @param s 指向缓存的指针。
+ * @param x 起始 x。
+ * @param y 行。
+ * @param src 像素。
+ * @param n 像素个数。
+ */
+void shadow_pack_row(shadow_t* s, size_t x, size_t y, const framebuffer_color_t* src, size_t n);
+
+/**
+ * 把一行展开为 RGB565, 调用者保证范围在缓存内。
+ *
+ * @param s 指向缓存的指针。
+ * @param x 起始 x。
+ * @param y 行。
+ * @param dst 输出像素。
+ * @param n 像素个数。
+ */
+void shadow_unpack_row(const shadow_t* s, size_t x, size_t y, framebuffer_color_t* dst, size_t n);
+
+/**
+ * 把区域展开为 RGB565。
+ *
+ * @param s 指向缓存的指针。
+ * @param r 区域, 调用者保证在缓存范围内。
+ * @param dst 目标画面 (0, 0) 的地址, 只写入区域内的像素。
+ * @param dst_stride 目标画面每行字节数。
+ */
+void shadow_expand(const shadow_t* s, const frame_rect_t* r, framebuffer_color_t* dst, size_t dst_stride);
+
+/**
+ * 设置一个像素的下标, 调用者保证坐标在范围内。
+ *
+ * @param s 指向缓存的指针。
+ * @param x 像素 x。
+ * @param y 像素 y。
+ * @param index 调色板下标。
+ */
+static inline void shadow_set(shadow_t* s, size_t x, size_t y, uint8_t index)
+{
+    uint8_t* p = s->bits + y * s->stride;
+    if (s->bpp == SHADOW_BPP_MONO) {
+        uint8_t bit = 0x80 >> (x & 7);
+        p[x >> 3] = index ? p[x >> 3] | bit : p[x >> 3] & ~bit;
+    } else {
+        uint8_t shift = x & 1 ? 0 : 4;
+        p[x >> 1] = (p[x >> 1] & ~(0x0f << shift)) | (index & 0x0f) << shift;
+    }
+}
+
+/**
+ * 获取一个像素的下标, 调用者保证坐标在范围内。
+ *
+ * @param s 指向缓存的指针。
+ * @param x 像素 x。
+ * @param y 像素 y。
+ * @return 调色板下标。
+ */
+static inline uint8_t shadow_get(const shadow_t* s, size_t x, size_t y)
+{
+    const uint8_t* p = s->bits + y * s->stride;
+    if (s->bpp == SHADOW_BPP_MONO)
+        return (p[x >> 3] >> (7 - (x & 7))) & 1;
+    return (p[x >> 1] >> (x & 1 ? 0 : 4)) & 0x0f;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__SHADOW_H__
@@ -0,0 +1,306 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "sprite_cache.h"
+
+typedef struct sprite_cache_t {
+    size_t max_bytes;           // 内存上限
+    sprite_t* head;             // 精灵, 最近使用的在前
+    uint64_t ghosts[SPRITE_CACHE_GHOSTS]; // 最近未命中的键的哈希, 0 表示空
+    size_t ghost_pos;           // 下一个写入的位置
+    sprite_cache_stat_t stat;   // 统计
+} sprite_cache_t;
+
+/**
+ * @brief 计算键的 FNV-1a 哈希, 不为 0
+ */
+static uint64_t sprite_cache_hash(const void* key, size_t key_len)
+{
+    uint64_t hash = 0xcbf29ce484222325LU;
+    for (size_t i = 0; i < key_len; ++i)
+        hash = (hash ^ ((const uint8_t*)key)[i]) * 0x100000001b3LU;
+    return hash ? hash : 1;
+}
+
+/**
+ * @brief 从链表中摘下并释放精灵
+ */
+static void sprite_cache_unlink(sprite_cache_t* c, sprite_t* s)
+{
+    for (sprite_t** pos = &c->head; *pos; pos = &(*pos)->next) {
+        if (*pos == s) {
+            *pos = s->next;
+            break;
+        }
+    }
+    c->stat.count--;
+    c->stat.bytes -= s->bytes;
+    if (s->pinned)
+        c->stat.pinned--;
+    free(s);
+}
+
+/**
+ * @brief 淘汰最久没有使用的精灵, 直到能再放下 need 字节
+ *
+ * @return 能放下返回 0, 只剩固定的精灵仍放不下返回 -1
+ */
+static int sprite_cache_evict(sprite_cache_t* c, size_t need)
+{
+    while (c->stat.bytes + need > c->max_bytes) {
+        sprite_t* last = NULL;
+        for (sprite_t* s = c->head; s; s = s->next) {
+            if (!s->pinned)
+                last = s;
+        }
+        if (!last)
+            return -1;
+        LOG_DBG("evict sprite(%zux%zu, %zu bytes)", last->width, last->height, last->bytes);
+        sprite_cache_unlink(c, last);
+        c->stat.evictions++;
+    }
+    return 0;
+}
+
+/**
+ * 创建精灵缓存。
+ *
+ * @param max_bytes 内存上限。
+ * @return 成功返回缓存指针，失败返回 NULL。
+ */
+sprite_cache_t* sprite_cache_init(size_t max_bytes)
+{
+    sprite_cache_t* c = (sprite_cache_t*)malloc(sizeof(sprite_cache_t));
+    if (!c) {
+        LOG_ERR("fail to malloc sprite cache");
+        return NULL;
+    }
+    memset(c, 0, sizeof(sprite_cache_t));
+    c->max_bytes = max_bytes;
+    return c;
+}
+
+/**
+ * 释放精灵缓存和全部精灵。
+ *
+ * @param c 指向缓存的指针。
+ */
+void sprite_cache_exit(sprite_cache_t* c)
+{
+    if (!c)
+        return;
+    while (c->head) {
+        sprite_t* s = c->head;
+        c->head = s->next;
+        free(s);
+    }
+    free(c);
+}
+
+/**
+ * 修改内存上限, 超出时按最近使用顺序淘汰没有固定的精灵。
+ *
+ * @param c 指向缓存的指针。
+ * @param max_bytes 内存上限。
+ */
+void sprite_cache_set_limit(sprite_cache_t* c, size_t max_bytes)
+{
+    if (!c)
+        return;
+    c->max_bytes = max_bytes;
+    sprite_cache_evict(c, 0);
+}
+
+/**
+ * 查找精灵, 找到时移到最近使用。
+ *
+ * @param c 指向缓存的指针。
+ * @param key 键。
+ * @param key_len 键的字节数。
+ * @param admit 未找到时输出是否建议加入(最近未命中过), 可以为 NULL。
+ * @return 找到返回精灵, 否则返回 NULL。
+ */
+sprite_t* sprite_cache_find(sprite_cache_t* c, const void* key, size_t key_len, int* admit)
+{
+    assert(c && key && "arg failed!");
+    uint64_t hash = sprite_cache_hash(key, key_len);
+    for (sprite_t** pos = &c->head; *pos; pos = &(*pos)->next) {
+        sprite_t* s = *pos;
+        if (s->hash != hash || s->key_len != key_len || memcmp(s->key, key, key_len))
+            continue;
+        *pos = s->next;
+        s->next = c->head;
+        c->head = s;
+        c->stat.hits++;
+        return s;
+    }
+
+    c->stat.misses++;
+    int seen = 0;
+    for (size_t i = 0; i < SPRITE_CACHE_GHOSTS && !seen; ++i)
+        seen = c->ghosts[i] == hash;
+    if (!seen) {
+        c->ghosts[c->ghost_pos] = hash;
+        c->ghost_pos = (c->ghost_pos + 1) % SPRITE_CACHE_GHOSTS;
+    }
+    if (admit)
+        *admit = seen;
+    return NULL;
+}
+
+/**
+ * 加入精灵, 已有相同的键时替换。像素和列段的内存随精灵一起分配, 由调用者填写,
+ * 以及 advance/reach。内存不够时先淘汰最久没有使用的精灵。
+ *
+ * @param c 指向缓存的指针。
+ * @param key 键。
+ * @param key_len 键的字节数。
+ * @param width 像素宽。
+ * @param height 像素高。
+ * @param span_count 列段数。
+ * @param pinned 是否固定。
+ * @return 成功返回精灵, 超过上限或内存不足返回 NULL。
+ */
+sprite_t* sprite_cache_insert(sprite_cache_t* c, const void* key, size_t key_len, size_t width, size_t height,
+    size_t span_count, int pinned)
+{
+    assert(c && key && "arg failed!");
+    uint64_t hash = sprite_cache_hash(key, key_len);
+    for (sprite_t* s = c->head; s; s = s->next) {
+        if (s->hash == hash && s->key_len == key_len && !memcmp(s->key, key, key_len)) {
+            sprite_cache_unlink(c, s);
+            break;
+        }
+    }
+
+    // 精灵、像素、列段、键一次分配
+    size_t pixels = width * height * sizeof(framebuffer_color_t);
+    size_t bytes = sizeof(sprite_t) + pixels + span_count * sizeof(sprite_span_t) + key_len;
+    if (sprite_cache_evict(c, bytes) < 0) {
+        LOG_DBG("sprite(%zu bytes) over limit(%zu)", bytes, c->max_bytes);
+        return NULL;
+    }
+    sprite_t* s = (sprite_t*)malloc(bytes);
+    if (!s) {
+        LOG_ERR("fail to malloc sprite(%zu bytes)", bytes);
+        return NULL;
+    }
+    memset(s, 0, sizeof(sprite_t));
+    s->hash = hash;
+    s->width = width;
+    s->height = height;
+    s->pixels = (framebuffer_color_t*)(s + 1);
+    s->spans = (sprite_span_t*)((uint8_t*)s->pixels + pixels);
+    s->span_count = span_count;
+    s->key = (const uint8_t*)(s->spans + span_count);
+    s->key_len = key_len;
+    memcpy((uint8_t*)s->key, key, key_len);
+    s->pinned = !!pinned;
+    s->bytes = bytes;
+
+    s->next = c->head;
+    c->head = s;
+    c->stat.count++;
+    c->stat.bytes += bytes;
+    if (s->pinned)
+        c->stat.pinned++;
+    return s;
+}
+
+/**
+ * 删除精灵。
+ *
+ * @param c 指向缓存的指针。
+ * @param s 要删除的精灵。
+ */
+void sprite_cache_remove(sprite_cache_t* c, sprite_t* s)
+{
+    if (!c || !s)
+        return;
+    sprite_cache_unlink(c, s);
+}
+
+/**
+ * 获取统计。
+ *
+ * @param c 指向缓存的指针。
+ * @param stat 输出统计。
+ */
+void sprite_cache_get_stat(sprite_cache_t* c, sprite_cache_stat_t* stat)
+{
+    assert(c && stat && "arg failed!");
+    *stat = c->stat;
+}
+
+#ifdef __XTEST__
+
+char g_dbg_enable = 1;
+
+static sprite_t* test_insert(sprite_cache_t* c, const char* key, int pinned)
+{
+    sprite_t* s = sprite_cache_insert(c, key, strlen(key), 10, 10, 1, pinned);
+    if (s) {
+        memset(s->pixels, key[0], 10 * 10 * sizeof(framebuffer_color_t));
+        s->spans[0].width = 10;
+    }
+    return s;
+}
+
+int main(void)
+{
+    const size_t one = sizeof(sprite_t) + 10 * 10 * sizeof(framebuffer_color_t) + sizeof(sprite_span_t) + 1;
+    sprite_cache_t* c = sprite_cache_init(3 * one);
+    assert(c);
+
+    // 第一次未命中不建议加入, 第二次才建议
+    int admit = -1;
+    assert(!sprite_cache_find(c, "a", 1, &admit) && admit == 0);
+    assert(!sprite_cache_find(c, "a", 1, &admit) && admit == 1);
+    sprite_t* a = test_insert(c, "a", 1);
+    assert(a && sprite_cache_find(c, "a", 1, NULL) == a);
+    assert(a->pixels[99] == ('a' | 'a' << 8) && a->key_len == 1 && a->key[0] == 'a');
+
+    // 满了淘汰最久没用的, 固定的不淘汰
+    assert(test_insert(c, "b", 0) && test_insert(c, "c", 0));
+    assert(sprite_cache_find(c, "b", 1, NULL));
+    assert(test_insert(c, "d", 0));
+    assert(!sprite_cache_find(c, "c", 1, NULL));
+    assert(sprite_cache_find(c, "a", 1, NULL) && sprite_cache_find(c, "b", 1, NULL) && sprite_cache_find(c, "d", 1, NULL));
+    sprite_cache_stat_t stat;
+    sprite_cache_get_stat(c, &stat);
+    assert(stat.count == 3 && stat.pinned == 1 && stat.evictions == 1 && stat.bytes == 3 * one);
+
+    // 相同的键替换; 放不下的精灵不加入
+    assert(test_insert(c, "d", 1));
+    sprite_cache_get_stat(c, &stat);
+    assert(stat.count == 3 && stat.pinned == 2);
+    assert(!sprite_cache_insert(c, "big", 3, 100, 100, 1, 0));
+
+    // 缩小上限只淘汰没有固定的精灵
+    sprite_cache_set_limit(c, 2 * one);
+    assert(!sprite_cache_find(c, "b", 1, NULL));
+    assert(sprite_cache_find(c, "a", 1, NULL) && sprite_cache_find(c, "d", 1, NULL));
+    assert(!test_insert(c, "e", 0));
+    sprite_cache_remove(c, sprite_cache_find(c, "a", 1, NULL));
+    assert(test_insert(c, "e", 0));
+    sprite_cache_get_stat(c, &stat);
+    assert(stat.count == 2 && stat.pinned == 1 && stat.bytes == 2 * one);
+
+    // 未命中的键记录有限个, 很久以前的不再建议加入
+    for (size_t i = 0; i < SPRITE_CACHE_GHOSTS; ++i) {
+        char key[16];
+        snprintf(key, sizeof(key), "k%zu", i);
+        assert(!sprite_cache_find(c, key, strlen(key), &admit) && admit == 0);
+    }
+    assert(!sprite_cache_find(c, "k0", 2, &admit) && admit == 1);
+    assert(!sprite_cache_find(c, "a", 1, &admit) && admit == 0);
+
+    sprite_cache_exit(c);
+    printf("sprite cache test pass\n");
+    return 0;
+}
+
+#endif //__XTEST__
@@ -0,0 +1,130 @@
+#ifndef __SPRITE_CACHE_H__
+#define __SPRITE_CACHE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "framebuffer.h"
+
+// 功能: 字符串精灵缓存. 反复打印的界面标签(如 "USER: (Listening...)")按 (字体, 颜色, 编码, 文字)
+// 作为键保存绘制好的像素, 命中时直接整行拷贝, 不用再转码、排版和展开字形.
+// 按最近使用顺序淘汰, 总内存不超过上限; 固定的精灵不淘汰, 也计入上限.
+// 只出现一次的文字(如流式回答的片段)不值得缓存, 最近未命中过一次的键第二次未命中时才建议加入.
+//
+// example:
+//   sprite_cache_t* c = sprite_cache_init(64 * 1024);
+//   int admit = 0;
+//   sprite_t* s = sprite_cache_find(c, key, key_len, &admit);
+//   if (!s && admit)
+//       s = sprite_cache_insert(c, key, key_len, width, height, spans, 0);
+//   sprite_cache_exit(c);
+
+#define SPRITE_CACHE_GHOSTS (32)  // 记住最近未命中的键的个数
+
+typedef struct sprite_span_t {
+    uint16_t x;              // 绘制的列开始, 相对精灵左侧
+    uint16_t width;          // 绘制的列数
+} sprite_span_t;
+
+typedef struct sprite_t {
+    uint64_t hash;           // 键的哈希
+    const uint8_t* key;      // 键
+    size_t key_len;          // 键的字节数
+    size_t width;            // 像素宽
+    size_t height;           // 像素高
+    framebuffer_color_t* pixels; // 像素, 每行 width 个, 只有 spans 内的列有效
+    sprite_span_t* spans;    // 绘制的列, 每一行相同, 空格等只移动光标不绘制的列不在其中
+    size_t span_count;       // 绘制的列段数
+    size_t advance;          // 绘制后光标前进的宽度
+    size_t reach;            // 相对开始位置, 排版过程中不换行需要右侧至少剩余的宽度
+    int pinned;              // 是否固定不淘汰
+    size_t bytes;            // 占用内存
+    struct sprite_t* next;   // 按最近使用排列的下一个精灵
+} sprite_t;
+
+typedef struct sprite_cache_stat_t {
+    size_t count;            // 精灵个数
+    size_t bytes;            // 占用内存
+    size_t pinned;           // 固定的精灵个数
+    size_t hits;             // 命中次数
+    size_t misses;           // 未命中次数
+    size_t evictions;        // 淘汰次数
+} sprite_cache_stat_t;
+
+struct sprite_cache_t;
+
+/**
+ * 创建精灵缓存。
+ *
+ * @param max_bytes 内存上限。
+ * @return 成功返回缓存指针，失败返回 NULL。
+ */
+sprite_cache_t* sprite_cache_init(size_t max_bytes);
+
+/**
+ * 释放精灵缓存和全部精灵。
+ *
+ * @param c 指向缓存的指针。
+ */
+void sprite_cache_exit(sprite_cache_t* c);
+
+/**
+ * 修改内存上限, 超出时按最近使用顺序淘汰没有固定的精灵。
+ *
+ * @param c 指向缓存的指针。
+ * @param max_bytes 内存上限。
+ */
+void sprite_cache_set_limit(sprite_cache_t* c, size_t max_bytes);
+
+/**
+ * 查找精灵, 找到时移到最近使用。
+ *
+ * @param c 指向缓存的指针。
+ * @param key 键。
+ * @param key_len 键的字节数。
+ * @param admit 未找到时输出是否建议加入(最近未命中过), 可以为 NULL。
+ * @return 找到返回精灵, 否则返回 NULL。
+ */
+sprite_t* sprite_cache_find(sprite_cache_t* c, const void* key, size_t key_len, int* admit);
+
+/**
+ * 加入精灵, 已有相同的键时替换。像素和列段的内存随精灵一起分配, 由调用者填写,
+ * 以及 advance/reach。内存不够时先淘汰最久没有使用的精灵。
+ *
+ * @param c 指向缓存的指针。
+ * @param key 键。
+ * @param key_len 键的字节数。
+ * @param width 像素宽。
+ * @param height 像素高。
+ * @param span_count 列段数。
+ * @param pinned 是否固定。
+ * @return 成功返回精灵, 超过上限或内存不足返回 NULL。
+ */
+sprite_t* sprite_cache_insert(sprite_cache_t* c, const void* key, size_t key_len, size_t width, size_t height,
+    size_t span_count, int pinned);
+
+/**
+ * 删除精灵。
+ *
+ * @param c 指向缓存的指针。
+ * @param s 要删除的精灵。
+ */
+void sprite_cache_remove(sprite_cache_t* c, sprite_t* s);
+
+/**
+ * 获取统计。
+ *
+ * @param c 指向缓存的指针。
+ * @param stat 输出统计。
+ */
+void sprite_cache_get_stat(sprite_cache_t* c, sprite_cache_stat_t* stat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__SPRITE_CACHE_H__
@@ -0,0 +1,169 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "text_style.h"
+
+#define TEXT_STYLE_MAX_PARAMS (16) // 单个序列最多参数个数
+
+// xterm 默认 16 色
+static const uint16_t s_text_style_base[16] = {
+    TEXT_STYLE_RGB565(0x00, 0x00, 0x00), TEXT_STYLE_RGB565(0xcd, 0x00, 0x00),
+    TEXT_STYLE_RGB565(0x00, 0xcd, 0x00), TEXT_STYLE_RGB565(0xcd, 0xcd, 0x00),
+    TEXT_STYLE_RGB565(0x00, 0x00, 0xee), TEXT_STYLE_RGB565(0xcd, 0x00, 0xcd),
+    TEXT_STYLE_RGB565(0x00, 0xcd, 0xcd), TEXT_STYLE_RGB565(0xe5, 0xe5, 0xe5),
+    TEXT_STYLE_RGB565(0x7f, 0x7f, 0x7f), TEXT_STYLE_RGB565(0xff, 0x00, 0x00),
+    TEXT_STYLE_RGB565(0x00, 0xff, 0x00), TEXT_STYLE_RGB565(0xff, 0xff, 0x00),
+    TEXT_STYLE_RGB565(0x5c, 0x5c, 0xff), TEXT_STYLE_RGB565(0xff, 0x00, 0xff),
+    TEXT_STYLE_RGB565(0x00, 0xff, 0xff), TEXT_STYLE_RGB565(0xff, 0xff, 0xff),
+};
+
+/**
+ * 获取 256 色调色板中的颜色。
+ *
+ * @param index 颜色序号, 0-15 为标准/高亮 16 色, 16-231 为 6x6x6 色块, 232-255 为灰阶。
+ * @return RGB565 颜色。
+ */
+uint16_t text_style_palette(uint8_t index)
+{
+    if (index < 16)
+        return s_text_style_base[index];
+    if (index < 232) {
+        static const uint8_t level[6] = { 0, 95, 135, 175, 215, 255 };
+        index -= 16;
+        return TEXT_STYLE_RGB565(level[index / 36], level[index / 6 % 6], level[index % 6]);
+    }
+    uint8_t gray = 8 + (index - 232) * 10;
+    return TEXT_STYLE_RGB565(gray, gray, gray);
+}
+
+/**
+ * @brief 解析 38/48 扩展颜色参数
+ *
+ * @param p 参数数组, p[0] 为 38 或 48。
+ * @param n 剩余参数个数。
+ * @param color 输出颜色。
+ * @return 使用的参数个数。
+ */
+static size_t text_style_parse_extend(const unsigned* p, size_t n, uint16_t* color)
+{
+    if (n >= 3 && p[1] == 5) {
+        *color = text_style_palette((uint8_t)p[2]);
+        return 3;
+    }
+    if (n >= 5 && p[1] == 2) {
+        *color = TEXT_STYLE_RGB565(p[2] & 0xff, p[3] & 0xff, p[4] & 0xff);
+        return 5;
+    }
+    return n;
+}
+
+/**
+ * 解析一段 CSI 转义序列, 是 SGR(以 m 结尾)时修改样式。
+ *
+ * @param st 要修改的样式。
+ * @param def 默认样式, 用于参数 0/39/49。
+ * @param str 指向转义字符 ESC。
+ * @param len str 剩余字节数。
+ * @return 转义序列的字节数, 不是完整的 CSI 序列返回 0。
+ */
+size_t text_style_parse_sgr(text_style_t* st, const text_style_t* def, const char* str, size_t len)
+{
+    assert(st && def && str && "arg failed!");
+    if (len < 3 || str[0] != TEXT_STYLE_ESC || str[1] != '[')
+        return 0;
+
+    unsigned params[TEXT_STYLE_MAX_PARAMS] = { 0 };
+    size_t count = 0;
+    size_t i = 2;
+    for (; i < len; ++i) {
+        uint8_t c = (uint8_t)str[i];
+        if (c >= '0' && c <= '9') {
+            if (count < TEXT_STYLE_MAX_PARAMS)
+                params[count] = params[count] * 10 + (c - '0');
+        } else if (c == ';') {
+            count++;
+        } else if (c >= 0x40 && c <= 0x7e) {
+            break;
+        } else if (c < 0x20 || c > 0x3f) {
+            return 0; // 不是合法的 CSI 序列
+        }
+    }
+    if (i >= len)
+        return 0;
+    // 最后一个参数没有 `;` 结尾, 空参数按 0 处理
+    count = count + 1 < TEXT_STYLE_MAX_PARAMS ? count + 1 : TEXT_STYLE_MAX_PARAMS;
+    if (str[i] != 'm')
+        return i + 1;
+
+    for (size_t k = 0; k < count; ++k) {
+        unsigned p = params[k];
+        if (p == 0) {
+            *st = *def;
+        } else if (p == 7) {
+            st->reverse = 1;
+        } else if (p == 27) {
+            st->reverse = 0;
+        } else if (p >= 30 && p <= 37) {
+            st->fg = s_text_style_base[p - 30];
+        } else if (p >= 90 && p <= 97) {
+            st->fg = s_text_style_base[p - 90 + 8];
+        } else if (p >= 40 && p <= 47) {
+            st->bg = s_text_style_base[p - 40];
+        } else if (p >= 100 && p <= 107) {
+            st->bg = s_text_style_base[p - 100 + 8];
+        } else if (p == 39) {
+            st->fg = def->fg;
+        } else if (p == 49) {
+            st->bg = def->bg;
+        } else if (p == 38) {
+            k += text_style_parse_extend(params + k, count - k, &st->fg) - 1;
+        } else if (p == 48) {
+            k += text_style_parse_extend(params + k, count - k, &st->bg) - 1;
+        }
+    }
+
+    return i + 1;
+}
+
+#ifdef __XTEST__
+
+static size_t test_parse(text_style_t* st, const text_style_t* def, const char* s)
+{
+    return text_style_parse_sgr(st, def, s, strlen(s));
+}
+
+int main(void)
+{
+    const text_style_t def = { 0xffff, 0x0000, 0 };
+    text_style_t st = def;
+
+    assert(test_parse(&st, &def, "\x1b[32mAI") == 5);
+    assert(st.fg == text_style_palette(2) && st.bg == def.bg);
+    assert(test_parse(&st, &def, "\x1b[1;97;44m") == 10);
+    assert(st.fg == TEXT_STYLE_RGB565(0xff, 0xff, 0xff) && st.bg == text_style_palette(4));
+
+    assert(test_parse(&st, &def, "\x1b[7m") == 4);
+    assert(st.reverse && text_style_fg(&st) == text_style_palette(4));
+    assert(test_parse(&st, &def, "\x1b[27;39;49m") == 11);
+    assert(!st.reverse && st.fg == def.fg && st.bg == def.bg);
+
+    assert(test_parse(&st, &def, "\x1b[38;2;255;0;0;48;5;196m") == 24);
+    assert(st.fg == 0xf800 && st.bg == TEXT_STYLE_RGB565(255, 0, 0));
+    assert(text_style_palette(232) == TEXT_STYLE_RGB565(8, 8, 8));
+
+    // 空参数等价于 0
+    assert(test_parse(&st, &def, "\x1b[m") == 3);
+    assert(st.fg == def.fg && st.bg == def.bg && !st.reverse);
+
+    // 非 SGR 序列跳过但不修改样式, 不完整或非法序列返回 0
+    assert(test_parse(&st, &def, "\x1b[2J") == 4 && st.fg == def.fg);
+    assert(test_parse(&st, &def, "\x1b[31") == 0);
+    assert(test_parse(&st, &def, "\x1b(B") == 0);
+    assert(test_parse(&st, &def, "\x1b[3\x01m") == 0);
+
+    printf("text style test pass\n");
+    return 0;
+}
+
+#endif //__XTEST__
@@ -0,0 +1,79 @@
+#ifndef __TEXT_STYLE_H__
+#define __TEXT_STYLE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 功能: 文字绘制样式, 以及 ANSI SGR 转义序列(ESC [ ... m)的解析.
+//
+// 支持的参数:
+//   0            恢复默认样式
+//   7 / 27       反显 / 取消反显
+//   30-37 90-97  前景色(标准/高亮 8 色)
+//   40-47 100-107 背景色(标准/高亮 8 色)
+//   39 / 49      默认前景色 / 默认背景色
+//   38;5;n 48;5;n           256 色
+//   38;2;r;g;b 48;2;r;g;b   24 位真彩色
+// 其它 CSI 序列整段跳过, 不支持的参数忽略.
+
+#define TEXT_STYLE_ESC (0x1b)  // 转义字符
+
+#define TEXT_STYLE_RGB565(r, g, b) \
+    ((uint16_t)((((r) & 0xf8) << 8) | (((g) & 0xfc) << 3) | ((b) >> 3)))
+
+typedef struct text_style_t {
+    uint16_t fg;      // 前景色, RGB565
+    uint16_t bg;      // 背景色, RGB565
+    uint8_t reverse;  // 是否反显(前景色与背景色互换)
+} text_style_t;
+
+/**
+ * 获取实际绘制的前景色。
+ *
+ * @param st 指向样式的指针。
+ * @return 前景色。
+ */
+static inline uint16_t text_style_fg(const text_style_t* st)
+{
+    return st->reverse ? st->bg : st->fg;
+}
+
+/**
+ * 获取实际绘制的背景色。
+ *
+ * @param st 指向样式的指针。
+ * @return 背景色。
+ */
+static inline uint16_t text_style_bg(const text_style_t* st)
+{
+    return st->reverse ? st->fg : st->bg;
+}
+
+/**
+ * 获取 256 色调色板中的颜色。
+ *
+ * @param index 颜色序号, 0-15 为标准/高亮 16 色, 16-231 为 6x6x6 色块, 232-255 为灰阶。
+ * @return RGB565 颜色。
+ */
+uint16_t text_style_palette(uint8_t index);
+
+/**
+ * 解析一段 CSI 转义序列, 是 SGR(以 m 结尾)时修改样式。
+ *
+ * @param st 要修改的样式。
+ * @param def 默认样式, 用于参数 0/39/49。
+ * @param str 指向转义字符 ESC。
+ * @param len str 剩余字节数。
+ * @return 转义序列的字节数, 不是完整的 CSI 序列返回 0。
+ */
+size_t text_style_parse_sgr(text_style_t* st, const text_style_t* def, const char* str, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__TEXT_STYLE_H__
@@ -0,0 +1,51 @@
+// 显示守护进程: 独占帧缓冲区并开启显示服务, 其它进程以 `client:` 设备连接后在共享内存图层上绘制.
+//
+// usage:
+//   display_daemon <fb_dev> <font_path> <sock_path>
+// 收到 SIGINT/SIGTERM 后断开所有客户端并退出.
+//
+// client example:
+//   display_t* d = display_init("client:/run/aimi-display.sock@0,200,240x40,1", font_path);
+//   display_view_print(d, v, "UTF-8", str, len);
+//   display_fflush(d);
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+
+#include "display.h"
+
+int main(int argc, char* argv[])
+{
+    if (argc != 4) {
+        fprintf(stderr, "usage: %s <fb_dev> <font_path> <sock_path>\n", argv[0]);
+        return -1;
+    }
+
+    // 信号只在 sigwait 中处理, 服务线程继承屏蔽字
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    display_t* d = display_init(argv[1], argv[2]);
+    if (!d) {
+        fprintf(stderr, "fail to open %s\n", argv[1]);
+        return -1;
+    }
+    if (display_server_start(d, argv[3]) < 0) {
+        fprintf(stderr, "fail to listen %s\n", argv[3]);
+        display_exit(d);
+        return -1;
+    }
+    display_fflush(d);
+
+    int sig = 0;
+    sigwait(&set, &sig);
+    fprintf(stderr, "display daemon exit on signal %d\n", sig);
+
+    display_server_stop(d);
+    display_exit(d);
+    return 0;
+}
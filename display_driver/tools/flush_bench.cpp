@@ -0,0 +1,68 @@
+// 刷新拷贝测速工具: 在实际的帧缓冲区上测量每个拷贝内核刷新整屏和刷新一行文字的耗时,
+// 用于比较不同平台/驱动下各内核的表现. 测速会往屏幕写入测试图案.
+//
+// usage:
+//   flush_bench [fb_dev] [rounds]    fb_dev 默认 /dev/fb0, 可以是 mem:WxH; rounds 默认 20
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "fb_copy.h"
+#include "framebuffer.h"
+
+char g_dbg_enable = 0;
+
+#define TEXT_ROW_HEIGHT (16) // 一行文字的高度
+
+int main(int argc, char* argv[])
+{
+    const char* dev = argc > 1 ? argv[1] : "/dev/fb0";
+    int rounds = argc > 2 ? atoi(argv[2]) : 20;
+    if (rounds <= 0) {
+        fprintf(stderr, "usage: %s [fb_dev] [rounds]\n", argv[0]);
+        return -1;
+    }
+
+    framebuffer_t* fb = framebuffer_init(dev);
+    if (!fb) {
+        fprintf(stderr, "fail to open %s\n", dev);
+        return -1;
+    }
+
+    size_t row_bytes = fb->width * COLOR_SIZE;
+    uint8_t* cache = (uint8_t*)malloc(row_bytes * fb->height);
+    if (!cache) {
+        fprintf(stderr, "out of memory\n");
+        framebuffer_exit(fb);
+        return -1;
+    }
+    for (size_t i = 0; i < row_bytes * fb->height; ++i)
+        cache[i] = (uint8_t)(i * 13);
+
+    size_t text_rows = fb->height < TEXT_ROW_HEIGHT ? fb->height : TEXT_ROW_HEIGHT;
+    printf("%s: %zux%zu, line %zu bytes, %d rounds\n", dev, fb->width, fb->height,
+        fb->line_length, rounds);
+    printf("%-8s %12s %10s %12s\n", "kernel", "full(us)", "MB/s", "text row(us)");
+
+    size_t count = 0;
+    const fb_copy_kernel_t* ks = fb_copy_kernels(&count);
+    fb_copy_rows(&ks[0], fb->screen, fb->line_length, cache, row_bytes, row_bytes, fb->height);
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t full = fb_copy_bench(&ks[i], fb->screen, fb->line_length, cache, row_bytes,
+            row_bytes, fb->height, rounds);
+        uint64_t text = fb_copy_bench(&ks[i], fb->screen, fb->line_length, cache, row_bytes,
+            row_bytes, text_rows, rounds);
+        printf("%-8s %12.1f %10.1f %12.1f\n", ks[i].name, full / 1000.0,
+            full ? row_bytes * fb->height * 1000.0 / full : 0.0, text / 1000.0);
+    }
+
+    const fb_copy_kernel_t* k = fb_copy_select(fb->screen, fb->line_length, cache, row_bytes,
+        row_bytes, fb->height);
+    printf("selected: %s\n", k->name);
+
+    free(cache);
+    framebuffer_exit(fb);
+    return 0;
+}
@@ -0,0 +1,87 @@
+// 抗锯齿字体生成工具: 把 N 倍大小的点阵字体按 N x N 方块求覆盖度, 缩小为 4 位抗锯齿字体.
+// 例如从 ascii_16x32/gb2312_32x32 生成 16 号的 ascii_8x16_aa/gb2312_16x16_aa,
+// 输出的字符顺序与输入相同, 每行 (字宽 + 1) / 2 字节, 高 4 位在左.
+//
+// usage:
+//   font_aa <src> <src_width> <src_height> <dst> [factor]    factor 默认 2, 取 1~4
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "font_bitmap.h"
+
+#define FONT_AA_MAX_FACTOR (4)  // 最大缩小倍数
+
+int main(int argc, char* argv[])
+{
+    if (argc != 5 && argc != 6) {
+        fprintf(stderr, "usage: %s <src> <src_width> <src_height> <dst> [factor]\n", argv[0]);
+        return -1;
+    }
+    size_t width = strtoul(argv[2], NULL, 10);
+    size_t height = strtoul(argv[3], NULL, 10);
+    size_t factor = argc > 5 ? strtoul(argv[5], NULL, 10) : 2;
+    if (!factor || factor > FONT_AA_MAX_FACTOR || !width || !height
+        || width % factor || height % factor || width / factor > 32 * FONT_AA_MAX_FACTOR) {
+        fprintf(stderr, "bad size %zux%zu or factor %zu\n", width, height, factor);
+        return -1;
+    }
+
+    FILE* in = fopen(argv[1], "rb");
+    if (!in) {
+        fprintf(stderr, "fail to open %s\n", argv[1]);
+        return -1;
+    }
+    FILE* out = fopen(argv[4], "wb");
+    if (!out) {
+        fprintf(stderr, "fail to open %s\n", argv[4]);
+        fclose(in);
+        return -1;
+    }
+
+    size_t cols = FONT_ROW_BYTES(width);
+    size_t dst_width = width / factor;
+    size_t dst_cols = FONT_AA_ROW_BYTES(dst_width);
+    size_t samples = factor * factor;
+    uint8_t* glyph = (uint8_t*)malloc(cols * height);
+    uint8_t* row = (uint8_t*)malloc(dst_cols);
+    size_t count = 0;
+    int ret = 0;
+    if (!glyph || !row) {
+        fprintf(stderr, "out of memory\n");
+        ret = -1;
+        goto out;
+    }
+
+    while (fread(glyph, 1, cols * height, in) == cols * height) {
+        for (size_t k = 0; k < height / factor; ++k) {
+            memset(row, 0, dst_cols);
+            for (size_t i = 0; i < dst_width; ++i) {
+                // 方块内点亮的像素数换算为 0~15 的覆盖度, 四舍五入
+                size_t on = 0;
+                for (size_t y = k * factor; y < (k + 1) * factor; ++y) {
+                    for (size_t x = i * factor; x < (i + 1) * factor; ++x)
+                        on += !!(glyph[y * cols + x / BIT_SIZE] & (0x80 >> (x % BIT_SIZE)));
+                }
+                uint8_t c = (uint8_t)((on * 15 + samples / 2) / samples);
+                row[i / 2] |= i & 1 ? c : c << 4;
+            }
+            if (fwrite(row, 1, dst_cols, out) != dst_cols) {
+                fprintf(stderr, "fail to write %s\n", argv[4]);
+                ret = -1;
+                goto out;
+            }
+        }
+        count++;
+    }
+    printf("%s: %zu glyphs %zux%zu -> %s: %zux%zu\n", argv[1], count, width, height, argv[4],
+        dst_width, height / factor);
+
+out:
+    free(glyph);
+    free(row);
+    fclose(in);
+    fclose(out);
+    return ret;
+}
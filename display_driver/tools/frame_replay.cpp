@@ -0,0 +1,114 @@
+// 录像回放工具: 解析 display_record_start 生成的录像文件, 列出帧信息或导出为 PPM.
+//
+// usage:
+//   frame_replay <record>                  列出所有帧
+//   frame_replay <record> <index> <out.ppm> 导出第 index 帧, -1 为最后一帧
+//   frame_replay <record> all <dir>        导出所有帧为 <dir>/frame_<index>.ppm
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "frame_delta.h"
+#include "frame_recorder.h"
+
+char g_dbg_enable = 0;
+
+static int usage(const char* name)
+{
+    fprintf(stderr, "usage:\n"
+                    "  %s <record>\n"
+                    "  %s <record> <index> <out.ppm>\n"
+                    "  %s <record> all <dir>\n",
+        name, name, name);
+    return -1;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2 && argc != 4)
+        return usage(argv[0]);
+
+    FILE* fp = fopen(argv[1], "rb");
+    if (!fp) {
+        perror("fail to open record");
+        return -1;
+    }
+
+    frame_record_file_t file_hdr;
+    if (1 != fread(&file_hdr, sizeof(file_hdr), 1, fp)
+        || memcmp(file_hdr.magic, FRAME_RECORD_FILE_MAGIC, sizeof(file_hdr.magic))
+        || file_hdr.format != FRAME_RECORD_FORMAT_RGB565) {
+        fprintf(stderr, "%s: not a frame record\n", argv[1]);
+        fclose(fp);
+        return -1;
+    }
+
+    int dump_all = argc == 4 && 0 == strcmp(argv[2], "all");
+    long target = argc == 4 && !dump_all ? strtol(argv[2], NULL, 0) : -2;
+
+    size_t width = file_hdr.width;
+    size_t height = file_hdr.height;
+    framebuffer_color_t* frame = (framebuffer_color_t*)calloc(width * height, COLOR_SIZE);
+    frame_rect_t full = { 0, 0, file_hdr.width, file_hdr.height };
+    size_t payload_size = frame_delta_bound(&full);
+    uint8_t* payload = (uint8_t*)malloc(payload_size);
+    if (!frame || !payload) {
+        fprintf(stderr, "out of memory\n");
+        return -1;
+    }
+
+    if (argc == 2)
+        printf("record %zux%zu\n", width, height);
+
+    long index = 0;
+    int ret = 0;
+    uint64_t first_us = 0;
+    frame_record_hdr_t hdr;
+    while (1 == fread(&hdr, sizeof(hdr), 1, fp)) {
+        if (hdr.magic != FRAME_RECORD_HDR_MAGIC || hdr.size > payload_size
+            || hdr.size != fread(payload, 1, hdr.size, fp)
+            || frame_delta_apply(frame, width, height, width, &hdr.rect, payload, hdr.size) < 0) {
+            fprintf(stderr, "frame %ld corrupted, stop\n", index);
+            ret = -1;
+            break;
+        }
+        if (!index)
+            first_us = hdr.timestamp_us;
+
+        if (argc == 2) {
+            printf("%6ld  +%10.3fms  rect(%u, %u, %u, %u)  %u bytes\n", index,
+                (hdr.timestamp_us - first_us) / 1000.0,
+                hdr.rect.x, hdr.rect.y, hdr.rect.w, hdr.rect.h, hdr.size);
+        } else if (dump_all) {
+            char path[4096];
+            snprintf(path, sizeof(path), "%s/frame_%06ld.ppm", argv[3], index);
+            if (frame_write_ppm(path, frame, width, height, width) < 0) {
+                fprintf(stderr, "fail to write %s\n", path);
+                ret = -1;
+                break;
+            }
+        } else if (index == target) {
+            break;
+        }
+        ++index;
+    }
+
+    if (argc == 4 && !dump_all && ret == 0) {
+        if (target >= 0 && index != target) {
+            fprintf(stderr, "frame %ld not found, record has %ld frames\n", target, index);
+            ret = -1;
+        } else if (frame_write_ppm(argv[3], frame, width, height, width) < 0) {
+            fprintf(stderr, "fail to write %s\n", argv[3]);
+            ret = -1;
+        }
+    }
+    if (argc == 2)
+        printf("%ld frames\n", index);
+
+    free(payload);
+    free(frame);
+    fclose(fp);
+    return ret;
+}
@@ -0,0 +1,108 @@
+// 镜像参考客户端: 连接 display_mirror_start 开启的镜像服务, 重建画面并保存为 PPM.
+//
+// usage:
+//   mirror_client <addr> <out.ppm> [updates]
+// 每收到一次更新就覆盖写 out.ppm, 收到 updates 次更新后退出, 不指定则一直运行.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "debug.h"
+#include "frame_delta.h"
+#include "frame_mirror.h"
+
+char g_dbg_enable = 0;
+
+static int read_full(int fd, void* buf, size_t len)
+{
+    uint8_t* p = (uint8_t*)buf;
+    while (len) {
+        ssize_t ret = read(fd, p, len);
+        if (ret <= 0)
+            return -1;
+        p += ret;
+        len -= ret;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3 && argc != 4) {
+        fprintf(stderr, "usage: %s <unix:/path | tcp:host:port> <out.ppm> [updates]\n", argv[0]);
+        return -1;
+    }
+    long updates = argc == 4 ? strtol(argv[3], NULL, 0) : -1;
+
+    int fd = frame_mirror_connect(argv[1]);
+    if (fd < 0) {
+        fprintf(stderr, "fail to connect %s\n", argv[1]);
+        return -1;
+    }
+
+    frame_record_file_t hello;
+    if (read_full(fd, &hello, sizeof(hello)) < 0
+        || memcmp(hello.magic, FRAME_MIRROR_MAGIC, sizeof(hello.magic))
+        || hello.format != FRAME_RECORD_FORMAT_RGB565) {
+        fprintf(stderr, "bad mirror hello\n");
+        close(fd);
+        return -1;
+    }
+
+    size_t width = hello.width;
+    size_t height = hello.height;
+    frame_rect_t full = { 0, 0, hello.width, hello.height };
+    size_t payload_size = frame_delta_bound(&full);
+    framebuffer_color_t* frame = (framebuffer_color_t*)calloc(width * height, COLOR_SIZE);
+    uint8_t* payload = (uint8_t*)malloc(payload_size);
+    if (!frame || !payload) {
+        fprintf(stderr, "out of memory\n");
+        return -1;
+    }
+    printf("mirror %zux%zu\n", width, height);
+
+    std::string tmp_path = std::string(argv[2]) + ".tmp";
+    int ret = 0;
+    for (long count = 0; updates < 0 || count < updates; ++count) {
+        frame_record_hdr_t hdr;
+        if (read_full(fd, &hdr, sizeof(hdr)) < 0) {
+            printf("server closed\n");
+            break;
+        }
+        // 矩形来自网络, 清零前按 64 位检查是否在画面内
+        frame_rect_t r = hdr.rect;
+        if (hdr.magic != FRAME_RECORD_HDR_MAGIC || hdr.size > payload_size
+            || !frame_rect_inside(&r, width, height)
+            || read_full(fd, payload, hdr.size) < 0) {
+            fprintf(stderr, "bad mirror update\n");
+            ret = -1;
+            break;
+        }
+        // 镜像流是关键帧编码, 先清零再 XOR 还原
+        for (uint32_t y = r.y; y < r.y + r.h; ++y)
+            memset(frame + y * width + r.x, 0, r.w * COLOR_SIZE);
+        if (frame_delta_apply(frame, width, height, width, &r, payload, hdr.size) < 0) {
+            fprintf(stderr, "bad mirror payload\n");
+            ret = -1;
+            break;
+        }
+
+        if (frame_write_ppm(tmp_path.c_str(), frame, width, height, width) < 0
+            || rename(tmp_path.c_str(), argv[2]) < 0) {
+            fprintf(stderr, "fail to write %s\n", argv[2]);
+            ret = -1;
+            break;
+        }
+        printf("update %ld: rect(%u, %u, %u, %u) %u bytes\n", count, r.x, r.y, r.w, r.h, hdr.size);
+        fflush(stdout);
+    }
+
+    free(payload);
+    free(frame);
+    close(fd);
+    return ret;
+}
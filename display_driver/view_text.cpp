@@ -0,0 +1,260 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "view_text.h"
+
+#define VIEW_TEXT_DEFAULT_CAP (256) // 缓存初始大小
+
+/**
+ * 创建视图文字。
+ *
+ * @param key 所属视图。
+ * @return 成功返回视图文字指针，失败返回 NULL。
+ */
+view_text_t* view_text_init(const void* key)
+{
+    view_text_t* t = (view_text_t*)malloc(sizeof(view_text_t));
+    if (!t) {
+        LOG_ERR("fail to malloc view text");
+        return NULL;
+    }
+    memset(t, 0, sizeof(view_text_t));
+    t->key = key;
+
+    return t;
+}
+
+/**
+ * 释放视图文字。
+ *
+ * @param t 指向视图文字的指针。
+ */
+void view_text_exit(view_text_t* t)
+{
+    if (!t)
+        return;
+    free(t->text);
+    free(t->glyphs);
+    free(t);
+}
+
+/**
+ * 清空文字内容, 保留缓存。
+ *
+ * @param t 指向视图文字的指针。
+ * @param x 清空后的光标 x。
+ * @param y 清空后的光标 y。
+ */
+void view_text_reset(view_text_t* t, size_t x, size_t y)
+{
+    if (!t)
+        return;
+    t->len = 0;
+    t->count = 0;
+    t->wrapped = 0;
+    t->font = 0;
+    t->end_x = x;
+    t->end_y = y;
+}
+
+/**
+ * 记录下一个字符的位置, 字符偏移相对于下一次 view_text_append 的开头。
+ *
+ * @param t 指向视图文字的指针。
+ * @param offset 字符在本次追加文字中的字节偏移。
+ * @param x 绘制该字符前的光标 x。
+ * @param y 绘制该字符前的光标 y。
+ * @param style 绘制该字符前的样式。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int view_text_mark(view_text_t* t, size_t offset, size_t x, size_t y, const text_style_t* style)
+{
+    if (!t || !style)
+        return -1;
+
+    if (t->count == t->glyph_cap) {
+        size_t cap = t->glyph_cap ? t->glyph_cap * 2 : VIEW_TEXT_DEFAULT_CAP;
+        view_text_glyph_t* glyphs = (view_text_glyph_t*)realloc(t->glyphs, cap * sizeof(view_text_glyph_t));
+        if (!glyphs) {
+            LOG_ERR("fail to malloc view text glyphs(%zu)", cap);
+            return -1;
+        }
+        t->glyphs = glyphs;
+        t->glyph_cap = cap;
+    }
+
+    // 光标往回走说明超出视图后回绕到了开头
+    if (t->count && y < t->glyphs[t->count - 1].y)
+        t->wrapped = 1;
+
+    view_text_glyph_t* g = &t->glyphs[t->count++];
+    g->offset = t->len + offset;
+    g->x = x;
+    g->y = y;
+    g->style = *style;
+
+    return 0;
+}
+
+/**
+ * 追加文字内容, 并记录绘制后的光标位置。
+ *
+ * @param t 指向视图文字的指针。
+ * @param str 文字, GB2312。
+ * @param len 文字字节数。
+ * @param x 绘制后的光标 x。
+ * @param y 绘制后的光标 y。
+ * @param style 绘制后的样式。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int view_text_append(view_text_t* t, const char* str, size_t len, size_t x, size_t y,
+    const text_style_t* style)
+{
+    if (!t || !style)
+        return -1;
+
+    if (t->len + len > t->text_cap) {
+        size_t cap = t->text_cap ? t->text_cap : VIEW_TEXT_DEFAULT_CAP;
+        while (cap < t->len + len)
+            cap *= 2;
+        char* text = (char*)realloc(t->text, cap);
+        if (!text) {
+            LOG_ERR("fail to malloc view text(%zu)", cap);
+            return -1;
+        }
+        t->text = text;
+        t->text_cap = cap;
+    }
+    memcpy(t->text + t->len, str, len);
+    t->len += len;
+
+    if (t->count && y < t->glyphs[t->count - 1].y)
+        t->wrapped = 1;
+    t->end_x = x;
+    t->end_y = y;
+    t->end_style = *style;
+
+    return 0;
+}
+
+/**
+ * 与新文字比较, 找到第一个变化的字符。
+ *
+ * @param t 指向视图文字的指针。
+ * @param str 新文字, GB2312。
+ * @param len 新文字字节数。
+ * @return 第一个变化字符的序号, 新文字只是在旧文字后面追加时返回字符个数。
+ */
+size_t view_text_diff(const view_text_t* t, const char* str, size_t len)
+{
+    assert(t && "arg failed!");
+
+    size_t n = len < t->len ? len : t->len;
+    size_t same = 0;
+    while (same < n && t->text[same] == str[same])
+        ++same;
+    if (same == t->len)
+        return t->count;
+
+    // 变化位置可能落在双字节字符中间, 找到包含它的字符
+    size_t lo = 0, hi = t->count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (t->glyphs[mid].offset <= same)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo ? lo - 1 : 0;
+}
+
+/**
+ * 丢弃从指定字符开始的内容, 光标和样式回到该字符绘制前的状态。
+ *
+ * @param t 指向视图文字的指针。
+ * @param glyph 字符序号, 不小于字符个数时不做处理。
+ */
+void view_text_truncate(view_text_t* t, size_t glyph)
+{
+    if (!t || glyph >= t->count)
+        return;
+    t->len = t->glyphs[glyph].offset;
+    t->end_x = t->glyphs[glyph].x;
+    t->end_y = t->glyphs[glyph].y;
+    t->end_style = t->glyphs[glyph].style;
+    t->count = glyph;
+}
+
+#ifdef __XTEST__
+
+char g_dbg_enable = 1;
+
+/**
+ * @brief 模拟绘制: 每个字节 8 像素宽, 高位置 1 的按双字节 16 像素宽
+ */
+static void test_print(view_text_t* t, const char* str, size_t* x)
+{
+    size_t len = strlen(str);
+    text_style_t st = { 0xffff, 0, 0 };
+    for (size_t i = 0; i < len;) {
+        size_t w = (uint8_t)str[i] >= 0xa1 ? 2 : 1;
+        assert(0 == view_text_mark(t, i, *x, 0, &st));
+        *x += w * 8;
+        i += w;
+        st.fg = (uint16_t)(*x); // 每个字符样式不同, 便于检查回退
+    }
+    assert(0 == view_text_append(t, str, len, *x, 0, &st));
+}
+
+int main(void)
+{
+    int key = 0;
+    view_text_t* t = view_text_init(&key);
+    assert(t && t->key == &key);
+
+    size_t x = 0;
+    test_print(t, "AI: ", &x);
+    test_print(t, "hello\xc4\xe3\xba\xc3", &x);
+    assert(t->len == 13 && t->count == 11 && t->end_x == 13 * 8);
+
+    // 完全相同 / 追加
+    assert(view_text_diff(t, "AI: hello\xc4\xe3\xba\xc3", 13) == 11);
+    assert(view_text_diff(t, "AI: hello\xc4\xe3\xba\xc3 (ok)", 18) == 11);
+
+    // 在 ASCII 处变化
+    assert(view_text_diff(t, "AI: help", 8) == 7);
+    // 在双字节字符的第二个字节变化, 要从这个字符开始重绘
+    assert(view_text_diff(t, "AI: hello\xc4\xe3\xba\xc4", 13) == 10);
+    // 新文字更短
+    assert(view_text_diff(t, "AI", 2) == 2);
+    assert(view_text_diff(t, "", 0) == 0);
+
+    view_text_truncate(t, 10);
+    assert(t->len == 11 && t->count == 10 && t->end_x == 11 * 8);
+    assert(t->end_style.fg == 11 * 8);
+    x = t->end_x;
+    test_print(t, "\xba\xc4", &x);
+    assert(t->len == 13 && t->count == 11 && !t->wrapped);
+    assert(0 == memcmp(t->text, "AI: hello\xc4\xe3\xba\xc4", 13));
+
+    // 回绕检测
+    text_style_t st = { 0, 0, 0 };
+    assert(0 == view_text_mark(t, 0, 0, 0, &st));
+    assert(!t->wrapped);
+    view_text_reset(t, 0, 16);
+    assert(0 == view_text_mark(t, 0, 0, 16, &st));
+    assert(0 == view_text_mark(t, 1, 8, 0, &st));
+    assert(t->wrapped);
+    view_text_reset(t, 0, 0);
+    assert(!t->len && !t->count && !t->wrapped);
+
+    view_text_exit(t);
+
+    printf("view text test pass\n");
+    return 0;
+}
+
+#endif //__XTEST__
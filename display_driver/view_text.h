@@ -0,0 +1,111 @@
+#ifndef __VIEW_TEXT_H__
+#define __VIEW_TEXT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "text_style.h"
+
+// 功能: 视图保留的文字内容(GB2312)以及每个字符绘制前的光标位置和样式,
+// 更新文字时与旧内容比较, 只需要从第一个变化的字符开始重新绘制.
+
+typedef struct view_text_glyph_t {
+    uint32_t offset;     // 字符在文字中的字节偏移
+    uint32_t x;          // 绘制该字符前的光标 x
+    uint32_t y;          // 绘制该字符前的光标 y
+    text_style_t style;  // 绘制该字符前的样式
+} view_text_glyph_t;
+
+typedef struct view_text_t {
+    const void* key;            // 所属视图
+    char* text;                 // 文字内容, GB2312
+    size_t len;                 // 文字字节数
+    size_t text_cap;            // 文字缓存大小
+    view_text_glyph_t* glyphs;  // 每个字符的位置
+    size_t count;               // 字符个数
+    size_t glyph_cap;           // 字符位置缓存个数
+    size_t end_x;               // 最后一个字符绘制后的光标 x
+    size_t end_y;               // 最后一个字符绘制后的光标 y
+    text_style_t end_style;     // 最后一个字符绘制后的样式
+    int wrapped;                // 绘制时是否回绕到视图开头覆盖了前面的内容
+    size_t font;                // 排版使用的字体, 由使用者设置, 0 表示未知或混用了多种字体
+    struct view_text_t* next;   // 下一个视图的文字
+} view_text_t;
+
+/**
+ * 创建视图文字。
+ *
+ * @param key 所属视图。
+ * @return 成功返回视图文字指针，失败返回 NULL。
+ */
+view_text_t* view_text_init(const void* key);
+
+/**
+ * 释放视图文字。
+ *
+ * @param t 指向视图文字的指针。
+ */
+void view_text_exit(view_text_t* t);
+
+/**
+ * 清空文字内容, 保留缓存。
+ *
+ * @param t 指向视图文字的指针。
+ * @param x 清空后的光标 x。
+ * @param y 清空后的光标 y。
+ */
+void view_text_reset(view_text_t* t, size_t x, size_t y);
+
+/**
+ * 记录下一个字符的位置, 字符偏移相对于下一次 view_text_append 的开头。
+ *
+ * @param t 指向视图文字的指针。
+ * @param offset 字符在本次追加文字中的字节偏移。
+ * @param x 绘制该字符前的光标 x。
+ * @param y 绘制该字符前的光标 y。
+ * @param style 绘制该字符前的样式。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int view_text_mark(view_text_t* t, size_t offset, size_t x, size_t y, const text_style_t* style);
+
+/**
+ * 追加文字内容, 并记录绘制后的光标位置。
+ *
+ * @param t 指向视图文字的指针。
+ * @param str 文字, GB2312。
+ * @param len 文字字节数。
+ * @param x 绘制后的光标 x。
+ * @param y 绘制后的光标 y。
+ * @param style 绘制后的样式。
+ * @return 成功返回 0，失败返回 -1。
+ */
+int view_text_append(view_text_t* t, const char* str, size_t len, size_t x, size_t y,
+    const text_style_t* style);
+
+/**
+ * 与新文字比较, 找到第一个变化的字符。
+ *
+ * @param t 指向视图文字的指针。
+ * @param str 新文字, GB2312。
+ * @param len 新文字字节数。
+ * @return 第一个变化字符的序号, 新文字只是在旧文字后面追加时返回字符个数。
+ */
+size_t view_text_diff(const view_text_t* t, const char* str, size_t len);
+
+/**
+ * 丢弃从指定字符开始的内容, 光标和样式回到该字符绘制前的状态。
+ *
+ * @param t 指向视图文字的指针。
+ * @param glyph 字符序号, 不小于字符个数时不做处理。
+ */
+void view_text_truncate(view_text_t* t, size_t glyph);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__VIEW_TEXT_H__
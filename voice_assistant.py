@@ -1,13 +1,20 @@
-from display_driver import Display, View, Color
+from display_driver import Display, View, Color, Meter, Cache
 from button_driver import Button, ButtonType
-from audio_driver import record, chat_to_audio, audio_to_speak, splicing_audio
+from audio_driver import record, chat_to_audio, audio_to_speak, chat_to_pcm_stream, splicing_audio, vad_trim, resample, AudioCapture, AudioPlayer, SentenceSplitter
 from openai_api import OpenAIAPI
 from azure_api import voice_recognition
 import threading
 import time
+import os
 
 log_dbg = print
 
+# 角色标签, 用 ANSI 颜色转义和正文在一次打印中完成
+AI_LABEL = "\033[32mAI:\033[0m "
+USER_LABEL = "\033[36mUSER:\033[0m "
+# 录音状态动画的每一帧, 由显示驱动的动画线程切换
+LISTENING_FRAMES = [f"{USER_LABEL}(Listening{'.' * i})" for i in range(4)]
+
 
 class AssistantView(View):
     def __init__(self, driver_width: int, driver_height: int):
@@ -33,6 +40,32 @@ class UserView(View):
             font_color = Color.While,
         )
 
+class StatusView(View):
+    # 用户视图第一行, 录音时显示状态动画
+    def __init__(self, driver_width: int, driver_height: int):
+        super().__init__(
+            start_x = 0,
+            start_y = int(11 * driver_height / 15),
+            width = driver_width,
+            height = 16,
+            now_x = 0,
+            now_y = int(11 * driver_height / 15),
+            font_color = Color.While,
+        )
+
+class MeterView(View):
+    # 用户视图第二行, 录音时显示实时波形
+    def __init__(self, driver_width: int, driver_height: int):
+        super().__init__(
+            start_x = 0,
+            start_y = int(11 * driver_height / 15) + 16,
+            width = driver_width,
+            height = 16,
+            now_x = 0,
+            now_y = int(11 * driver_height / 15) + 16,
+            font_color = Color.Green,
+        )
+
 
 class VoiceAssistant:
     preset: str = "你是个AI助手, 请尽可能简短的回复. 如我问: `你好`, 你回答: `我很好, 你呢?` "
@@ -48,6 +81,19 @@ class VoiceAssistant:
 
     def __record_init(self):
         self.record_device = "hw:0,0"
+        self.capture = None
+        try:
+            # 常驻采集, 按下时回退 300ms 避免丢失第一个字
+            self.capture = AudioCapture("./audio_driver/audio.so", self.record_device, preroll_ms=300)
+        except Exception as e:
+            log_dbg(f"native capture unavailable, fallback to arecord: {e}")
+
+        self.player = None
+        try:
+            # 流式播放, 合成出第一段音频就开始出声
+            self.player = AudioPlayer("./audio_driver/audio.so", "default", rate=24000, prebuffer_ms=200)
+        except Exception as e:
+            log_dbg(f"native player unavailable, fallback to mplayer: {e}")
 
     def __display_init(self):
         self.display = Display("./display_driver/display.so", "/dev/fb0", "./display_driver/font/")
@@ -55,57 +101,166 @@ class VoiceAssistant:
         height = self.display.display_get_height()
         log_dbg(f"width: {width}, height: {height}")
 
+        self.display.display_set_ansi(True)
+        # 界面只有黑底彩色文字, 4 位调色板缓存足够, 显示缓存只占 RGB565 的 1/4
+        self.display.display_set_cache_format(Cache.INDEX4)
         self.uv = UserView(width, height)
         self.av = AssistantView(width, height)
-
-        self.display.display_view_print(self.uv, "UTF-8", "USER: 1+1=? \n")
-        self.display.display_view_print(self.av, "UTF-8", "AI: 1+1=2")
+        self.sv = StatusView(width, height)
+        self.mv = MeterView(width, height)
+        # 状态标签反复打印, 预先绘制成精灵固定下来, 之后打印只拷贝像素
+        self.display.display_set_sprite_cache(64 * 1024)
+        for label in ("(voice recognition...)", "(splicing audio...)"):
+            self.display.display_sprite_pin(self.uv, "UTF-8", f"{USER_LABEL}{label}")
+        self.meter = None
+        self.status = None
+
+        self.display.display_view_print(self.uv, "UTF-8", f"{USER_LABEL}1+1=? \n")
+        self.display.display_view_set_text(self.av, "UTF-8", f"{AI_LABEL}1+1=2")
         self.display.display_fflush()
 
 
     def __buttun_init(self):
-        self.button = Button('/dev/input/event0')  
+        self.button = Button('/dev/input/event0', './button_driver/button.so')
         buttun_thread = threading.Thread(target=self.button.server)
         buttun_thread.setDaemon(True)  # 将线程设置为守护线程
         buttun_thread.start()  # 启动按键监听线程
     
-    def speak_chat(self, chat: str):
+    def __speak(self, chat: str, status=None) -> bool:
         """
-        将文本转换为语音并播放出来。
+        将文本转换为语音并播放出来, 不改动界面。
 
         Args:
             chat (str): 要转换并播放的文本内容。
+            status (Callable[[str], None]): 各阶段的提示回调, 为 None 时不提示。
+
+        Returns:
+            bool: 是否播放成功。
         """
-        
-        self.display.display_view_clear(self.av)
-        self.display.display_view_print(self.av, "UTF-8", f"AI: {chat}\n(conceive a sound...)")
-        self.display.display_fflush()
-        
+
+        def show(tip: str):
+            if status:
+                status(tip)
+
+        if self.player:
+            show("(try to speak...)")
+
+            proc = chat_to_pcm_stream(chat)
+            ret = self.player.play_stream(proc.stdout)
+            if ret != 0:
+                proc.kill()
+            proc.wait()
+            stat = self.player.stat()
+            log_dbg(f"speak: first sound {stat.first_play_us / 1000:.0f} ms, underruns {stat.underruns}")
+            if ret == 0 and proc.returncode == 0:
+                return True
+            log_dbg(f"stream speak err: {proc.stderr.read().decode('utf-8', 'ignore')}")
+
+        show("(conceive a sound...)")
+
         ret = chat_to_audio(chat, "/tmp/audio.mp3")
         if ret.returncode != 0:
             log_dbg(f"create audio err: {ret.stdout}\n{ret.stderr}")
-            self.display.display_view_clear(self.av)
-            self.display.display_view_print(self.av, "UTF-8", f"AI: {chat}\n(speak err...)")
-            self.display.display_fflush()
-            return
+            show("(speak err...)")
+            return False
         log_dbg(f"create audio: {ret.stdout}")
-        
-        self.display.display_view_clear(self.av)
-        self.display.display_view_print(self.av, "UTF-8", f"AI: {chat}\n(try to speak...)")
-        self.display.display_fflush()
-        
+
+        show("(try to speak...)")
+
         ret = audio_to_speak("/tmp/audio.mp3")
         if ret.returncode != 0:
             log_dbg(f"speak err: {ret.stdout}\n{ret.stderr}")
-            self.display.display_view_clear(self.av)
-            self.display.display_view_print(self.av, "UTF-8", f"AI: {chat}\n(speak err...)")
-            self.display.display_fflush()
-            return
-        
+            show("(speak err...)")
+            return False
+
         log_dbg(f"speak: {ret.stdout}")
-        self.display.display_view_clear(self.av)
-        self.display.display_view_print(self.av, "UTF-8", f"AI: {chat}")
-        self.display.display_fflush()
+        return True
+
+    def speak_chat(self, chat: str):
+        """
+        将文本转换为语音并播放出来, 播放过程中在回答视图中提示进度。
+
+        Args:
+            chat (str): 要转换并播放的文本内容。
+        """
+
+        def status(tip: str):
+            self.display.display_view_set_text(self.av, "UTF-8", f"{AI_LABEL}{chat}\n{tip}")
+            self.display.display_fflush()
+
+        if self.__speak(chat, status):
+            self.display.display_view_set_text(self.av, "UTF-8", f"{AI_LABEL}{chat}")
+            self.display.display_fflush()
+
+    def __speak_sentences(self, splitter: SentenceSplitter, result: list):
+        """
+        TTS 线程: 从分句器依次取出句子合成并写入播放器。句子之间不等播放完,
+        下一句的合成与上一句的播放以及后面句子的生成同时进行。
+        结束时 result 中放入没有说出的句子: 合成失败的句子和之后的所有句子,
+        只有播放结束时出错则是最后一句。
+        """
+
+        unspoken = []
+        last = None
+        while True:
+            sentence = splitter.pop()
+            if sentence is None:
+                break
+            if not sentence:
+                continue
+            if unspoken:
+                unspoken.append(sentence)
+                continue
+            last = sentence
+            proc = chat_to_pcm_stream(sentence)
+            ok = self.player.write_stream(proc.stdout) == 0
+            if not ok:
+                proc.kill()
+            proc.wait()
+            if proc.returncode != 0:
+                log_dbg(f"stream speak err: {proc.stderr.read().decode('utf-8', 'ignore')}")
+                ok = False
+            if not ok:
+                unspoken.append(sentence)
+        self.player.finish()
+        if self.player.wait() != 0 and not unspoken and last:
+            unspoken.append(last)
+        result.append(unspoken)
+
+    def speak_start(self):
+        """
+        开始边生成边说, 返回分句器, 生成的文字写入分句器; 没有流式播放器时返回 None。
+        """
+
+        if not self.player:
+            return None
+        try:
+            splitter = SentenceSplitter("./audio_driver/audio.so", queue=2)
+        except Exception as e:
+            log_dbg(f"native splitter unavailable: {e}")
+            return None
+        result = []
+        thread = threading.Thread(target=self.__speak_sentences, args=(splitter, result))
+        thread.start()
+        return splitter, thread, result
+
+    def speak_finish(self, speaking):
+        """
+        文字生成完, 等待说完, 流式合成中途失败时只重新合成还没说出的部分。
+        """
+
+        splitter, thread, result = speaking
+        splitter.finish()
+        thread.join()
+        stat = splitter.stat()
+        player_stat = self.player.stat()
+        log_dbg(f"speak: {stat.sentences} sentences, first sentence {stat.first_us / 1000:.0f} ms, "
+                f"first sound {player_stat.first_play_us / 1000:.0f} ms, underruns {player_stat.underruns}")
+        if result[0]:
+            # 回答已经完整显示, 只补说没说出的句子, 不改动回答视图
+            log_dbg(f"stream speak fail, speak {len(result[0])} left sentences")
+            if not self.__speak(" ".join(result[0])):
+                log_dbg("speak left sentences fail")
 
     def voices_to_chat(self, audio_records: list[str]):
         """
@@ -119,26 +274,40 @@ class VoiceAssistant:
             str: 转换后的文本内容。
         """
 
-        log_dbg(f"splicing audio..")
-        self.display.display_view_clear(self.uv)
-        self.display.display_view_print(self.uv, "UTF-8", f"USER: (splicing audio...)")
-        self.display.display_fflush()
+        save_record = audio_records[0]
+        if len(audio_records) > 1:
+            log_dbg(f"splicing audio..")
+            self.display.display_view_clear(self.uv)
+            self.display.display_view_print(self.uv, "UTF-8", f"{USER_LABEL}(splicing audio...)")
+            self.display.display_fflush()
 
-        save_record = "/tmp/record/recoed.wav"
-        ret = splicing_audio(audio_records, save_record)
-        if ret.returncode != 0:
-            log_dbg(f"splicing_audio err: {ret.stdout}\n{ret.stderr}")
-            return False, "(splicing audio Error..)"
-    
-        log_dbg(f"splicing_audio: {ret.stdout}")
+            save_record = "/tmp/record/recoed.wav"
+            ret = splicing_audio(audio_records, save_record)
+            if ret.returncode != 0:
+                log_dbg(f"splicing_audio err: {ret.stdout}\n{ret.stderr}")
+                return False, "(splicing audio Error..)"
+        
+            log_dbg(f"splicing_audio: {ret.stdout}")
+
+        # 转为 16kHz 单声道并去掉静音再上传
+        trimmed = "/tmp/record/trimmed.wav"
+        if resample(save_record, trimmed, 16000) > 0:
+            save_record = trimmed
+        stat = vad_trim(save_record, trimmed)
+        if stat is not None:
+            log_dbg(f"vad: {stat.segments} segments, keep {stat.out_frames}/{stat.in_frames} frames, "
+                    f"noise {stat.noise_db:.1f} dB")
+            if stat.segments == 0:
+                return False, "(no voice detected..)"
+            save_record = trimmed
 
         self.display.display_view_clear(self.uv)
-        self.display.display_view_print(self.uv, "UTF-8", f"USER: (voice recognition...)")
+        self.display.display_view_print(self.uv, "UTF-8", f"{USER_LABEL}(voice recognition...)")
         self.display.display_fflush()
 
         chat = voice_recognition(save_record)
         self.display.display_view_clear(self.uv)
-        self.display.display_view_print(self.uv, "UTF-8", f"USER: {chat}")
+        self.display.display_view_print(self.uv, "UTF-8", f"{USER_LABEL}{chat}")
         self.display.display_fflush()
 
         return True, chat
@@ -156,15 +325,12 @@ class VoiceAssistant:
 
         log_dbg(f"record..")
         
-        Listening = "Listening"
-        for _ in range(0, idx):
-            Listening += "."
         self.display.display_view_clear(self.uv)
-        self.display.display_view_print(self.uv, "UTF-8", f"USER: ({Listening})")
-        self.display.display_fflush()
+        self.status_start(LISTENING_FRAMES)
 
         filename = f"/tmp/record/{idx}.wav"
         ret = record(self.record_device, filename)
+        self.status_stop()
         if ret.returncode != 0:
             log_dbg(f"record err: {ret.stdout}\n{ret.stderr}")
             return None
@@ -173,8 +339,62 @@ class VoiceAssistant:
         
         return filename
 
+    def capture_voice(self, idx: int):
+        """
+        按键松开时从常驻采集引擎取出整段语音并保存到文件。
+
+        Args:
+            idx (int): 语音记录的编号, 每次按键保存到不同的文件, 之后一起拼接。
+
+        Return:
+            str: 文件名称含路径, 失败返回 None
+        """
+
+        frames = self.capture.end()
+        if frames <= 0:
+            log_dbg(f"capture err: {frames}")
+            return None
+
+        os.makedirs("/tmp/record", exist_ok=True)
+        filename = f"/tmp/record/{idx}.wav"
+        if self.capture.save_wav(filename) != 0:
+            log_dbg(f"fail to save capture: {filename}")
+            return None
+        log_dbg(f"capture: {frames} frames")
+
+        return filename
+
+    def status_start(self, frames: list[str], period_ms: int = 400):
+        """
+        在用户视图第一行显示状态动画, 由显示驱动的动画线程切换帧并刷新, 不需要循环重画。
+        """
+
+        self.status_stop()
+        self.status = self.display.display_anim_start(self.sv, "UTF-8", frames, period_ms)
+
+    def status_stop(self):
+        if self.status:
+            self.display.display_anim_stop(self.status)
+            self.status = None
+
+    def meter_start(self):
+        """
+        录音期间在用户视图第二行显示实时波形, 采集线程直接把 PCM 送给显示控件线程。
+        """
+
+        self.meter = self.display.display_meter_start(self.mv, Meter.WAVE, 30, self.capture.rate // 50)
+        if self.meter:
+            self.capture.set_tap(self.display.meter_tap, self.meter)
+
+    def meter_stop(self):
+        if self.meter:
+            self.capture.set_tap(None, None)
+            self.display.display_meter_stop(self.meter)
+            self.meter = None
+
     def run(self):
         audio_records = []
+        capturing = False
 
         log_dbg("start listen. ")
         
@@ -182,7 +402,25 @@ class VoiceAssistant:
         self.display.display_fflush()
 
         while True:
-            if self.button.is_key_pressed(ButtonType.KEY_RIGHT):
+            if self.capture and self.button.is_key_pressed(ButtonType.KEY_RIGHT):
+                if not capturing:
+                    self.capture.begin()
+                    capturing = True
+                    self.display.display_view_clear(self.uv)
+                    self.status_start(LISTENING_FRAMES)
+                    self.meter_start()
+                # 松开时立即返回
+                self.button.wait_event(0.1)
+
+            elif capturing:
+                capturing = False
+                self.status_stop()
+                self.meter_stop()
+                filename = self.capture_voice(len(audio_records))
+                if filename:
+                    audio_records.append(filename)
+
+            elif self.button.is_key_pressed(ButtonType.KEY_RIGHT):
                 filename = self.recording_voice(len(audio_records))
                 if not filename:
                     continue
@@ -190,19 +428,22 @@ class VoiceAssistant:
 
             elif len(audio_records) and not self.button.is_key_pressed(ButtonType.KEY_RIGHT):
                 status, chat = self.voices_to_chat(audio_records)
+                # 识别失败也丢弃这几段录音, 否则会不停重试同一批文件
+                audio_records = []
                 if not status:
                     log_dbg(f"fail to trans chat: {chat}")
                     continue
 
-                audio_records = []
                 log_dbg(f"voice_recognition: {chat}")
 
                 self.display.display_view_clear(self.av)
-                self.display.display_view_print(self.av, "UTF-8", f"AI: ")
+                self.display.display_view_print(self.av, "UTF-8", f"{AI_LABEL}")
                 self.display.display_fflush()
 
                 chunk = ""
                 prev_text = ""
+                # 句子生成完就开始合成, 不等整段回答
+                speaking = self.speak_start()
                 for res in self.bot.ask(question=chat, preset=self.preset):
                     if res["message"] == -1:
                         continue
@@ -211,14 +452,19 @@ class VoiceAssistant:
                     chunk = res["message"][len(prev_text) :]
                     self.display.display_view_print(self.av, "UTF-8", chunk)
                     self.display.display_fflush()
+                    if speaking:
+                        speaking[0].feed(chunk)
 
                     prev_text = res["message"]
 
-                if len(prev_text):
+                if speaking:
+                    self.speak_finish(speaking)
+                elif len(prev_text):
                     self.speak_chat(prev_text)
                     
             else:
-                time.sleep(0.1)
+                # 有按键沿时立即返回, 不再固定等待 100ms
+                self.button.wait_event(0.1)
 
 
 if __name__ == '__main__':